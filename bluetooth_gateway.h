@@ -32,7 +32,6 @@
 
 #define MESH_GATEWAY_ERROR( X )        printf X
 
-extern mesh_dct_t mesh_dct_info;
 extern const char* aws_thing_name;
 extern const char* aws_thing_certificate;
 extern const char* aws_thing_private_key;
@@ -41,7 +40,7 @@ extern const char* aws_root_cert;
 /* Public Application-level methods - required for interaction between Mesh and Cloud-modules */
 void do_mesh_connect(void);
 void do_mesh_disconnect(void);
-void do_mesh_send_data(char* payload);
+void do_mesh_send_data(char* payload, uint32_t trace = 0, uint16_t dst = 0);
 
 cy_rslt_t http_response(uint8_t* value, int len);
 cy_rslt_t setup_http_server(NetworkInterface* network);
@@ -34,6 +34,30 @@
 
 #include "gateway_config.h"
 #include "bluetooth_gateway.h"
+#include "gateway_mesh_pdu.h"
+#include "gateway_node_cache.h"
+#include "gateway_uplink_filter.h"
+#include "gateway_sensor_agg.h"
+#include "gateway_metrics.h"
+#include "gateway_trace.h"
+#include "gateway_latency.h"
+#include "gateway_alloc.h"
+#include "gateway_threads.h"
+#include "gateway_idle.h"
+#include "gateway_spool.h"
+#include "gateway_connection.h"
+#include "gateway_topics.h"
+#include "gateway_rules.h"
+#include "gateway_delivery.h"
+#include "gateway_command_dedup.h"
+#include "gateway_mesh_decode.h"
+#include "gateway_fanout.h"
+#include "gateway_proxy_sar.h"
+#include "gateway_proxy_filter.h"
+#include "gateway_history.h"
+#include "gateway_uplink_batch.h"
+#include "gateway_supervisor.h"
+#include "gateway_warmboot.h"
 
 #include "JSON.h"
 #include "cy_string_utils.h"
@@ -42,17 +66,38 @@ using namespace cypress::embedded;
 using namespace std;
 
 #define MESH_DATA_JSON_KEY             "status"
+#define MESH_DATA_JSON_ID_KEY          "id"
 
-#define MESH_NODE_UNPROVISIONED         0   // NODE in UNPROVISIONED STATE
-#define MESH_NODE_PROVISIONED           1   // NODE in PROVISIONED STATE
 #define MESH_PROVISION_RESULT_SUCCESS   0   ///< Provisioning succeeded
 #define MESH_PROVISION_RESULT_TIMEOUT   1   ///< Provisioning failed due to timeout
 #define MESH_PROVISION_RESULT_FAILED    2   ///< Provisioning  failed
 
 #define MQTT_SUBSCRIBE_RETRY_COUNT          (3)
-#define MESH_JSON_SCRATCHPAD_SIZE           (120)
-#define MESH_AWS_YIELD_TIMEOUT_IN_MSEC      (1000)
+#define MESH_JSON_SCRATCHPAD_SIZE           (GATEWAY_FOOTPRINT_JSON_SCRATCHPAD_SIZE)
+#define MESH_AWS_YIELD_TIMEOUT_IN_MSEC      (100)
+/* Without a publish for this long the yield runs up to the next slot boundary */
+#define MESH_AWS_ACTIVE_TIMEOUT_IN_MSEC     (2000)
 #define MESH_AWS_KEEP_ALIVE_TIMEOUT_IN_SEC  (60)
+#define MESH_NODE_STATE_JSON_SIZE           (256)
+#define MESH_SENSOR_SUMMARY_JSON_SIZE       (160)
+#define MESH_LATENCY_REPORT_JSON_SIZE       (192)
+
+/* Largest uplink proxy PDU; longer ones are dropped and counted in "uplink_sar_errors" */
+#define MESH_UPLINK_PACKET_MAX              (GATEWAY_PROXY_SAR_MAX)
+
+/* Its hex text, with terminator, must fit a pool block and a queued or spooled publish */
+MBED_STATIC_ASSERT(MESH_UPLINK_PACKET_MAX * 2 + 1 <= GATEWAY_POOL_LARGE_BLOCK_SIZE, "Hex text of an uplink packet exceeds the large pool block");
+MBED_STATIC_ASSERT(MESH_UPLINK_PACKET_MAX * 2 <= GATEWAY_PUBLISH_MAX_PAYLOAD, "Hex text of an uplink packet exceeds GATEWAY_PUBLISH_MAX_PAYLOAD");
+#if APP_CONFIG_UPLINK_SPOOL
+MBED_STATIC_ASSERT(MESH_UPLINK_PACKET_MAX * 2 <= GATEWAY_SPOOL_PAYLOAD_MAX, "Hex text of an uplink packet exceeds GATEWAY_SPOOL_PAYLOAD_MAX");
+#endif
+
+MBED_STATIC_ASSERT(GATEWAY_FOOTPRINT_RAM <= GATEWAY_FOOTPRINT_RAM_BUDGET, "Gateway RAM exceeds the footprint profile budget");
+MBED_STATIC_ASSERT(GATEWAY_FOOTPRINT_KVSTORE <= GATEWAY_FOOTPRINT_KVSTORE_BUDGET, "Gateway KVStore records exceed the footprint profile budget");
+#if APP_CONFIG_PROXY_FILTER
+MBED_STATIC_ASSERT(GATEWAY_PROXY_FILTER_TEXT_SIZE - 1 <= GATEWAY_PUBLISH_MAX_PAYLOAD, "The wanted proxy filter exceeds GATEWAY_PUBLISH_MAX_PAYLOAD");
+#endif
+MBED_STATIC_ASSERT((MESH_AWS_KEEP_ALIVE_TIMEOUT_IN_SEC * 1000) % GATEWAY_IDLE_SLOT_MSEC == 0, "The MQTT keepalive must fall on the idle slots");
 
 #ifdef __cplusplus
 extern "C" {
@@ -70,7 +115,29 @@ typedef struct
 
 #if APP_CONFIG_AWS_CLOUD
 static CloudClientFactory factory;
+/* The client keeps a pointer to the security parameters; they are set up once and reused by every reconnect */
+static ClientSecurity aws_security(CLIENT_SECURITY_TYPE_TLS);
 static char received_data[MESH_JSON_SCRATCHPAD_SIZE] = { 0 };
+static char received_id[GATEWAY_LATENCY_ID_MAX_LEN + 1] = { 0 };
+static uint32_t received_id_len = 0;
+static char metrics_json[GATEWAY_METRICS_JSON_SIZE];
+static char heap_report_json[GATEWAY_ALLOC_JSON_SIZE];
+/* Only used on the network thread */
+static uint32_t last_publish_ms = 0;
+#if APP_CONFIG_LOCAL_RULES
+static char rules_json[MESH_RULES_JSON_SIZE];
+#endif
+#if APP_CONFIG_DOWNLINK_FANOUT
+static char groups_json[GATEWAY_FANOUT_JSON_SIZE];
+#endif
+#if APP_CONFIG_PROXY_FILTER
+static char proxy_nodes_json[GATEWAY_PROXY_FILTER_JSON_SIZE];
+#endif
+#if APP_CONFIG_STATE_HISTORY
+static char history_json[GATEWAY_PUBLISH_MAX_PAYLOAD];
+static gateway_history_query_t history_replay;
+static bool history_replaying = false;
+#endif
 #endif
 
 struct bluetooth_gateway
@@ -122,12 +189,15 @@ public:
 static mesh_value_handle_t* reverse_mesh_byte_stream( mesh_value_handle_t* val )
 {
     uint32_t i;
-    mesh_value_handle_t* ret_val = (mesh_value_handle_t*) malloc( sizeof(mesh_value_handle_t) + val->length );
-    MESH_GATEWAY_INFO(("\n Received mesh proxy packet : "));
+    mesh_value_handle_t* ret_val = (mesh_value_handle_t*) gateway_malloc( GATEWAY_ALLOC_TAG_DOWNLINK_REVERSED, sizeof(mesh_value_handle_t) + val->length );
+    if (ret_val == NULL)
+    {
+        return NULL;
+    }
+    MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_DEBUG, "[App] Received mesh proxy packet (%lu bytes)\n", val->length);
     for (i = 0; i < val->length; i++ )
     {
         ret_val->value[ i ] = val->value[ val->length - 1 - i ];
-        MESH_GATEWAY_INFO((" %02X " , ret_val->value[ i ]));
     }
     ret_val->length = val->length;
     return ret_val;
@@ -136,7 +206,7 @@ static mesh_value_handle_t* reverse_mesh_byte_stream( mesh_value_handle_t* val )
 static mesh_value_handle_t* create_mesh_value( const char* payload )
 {
     uint32_t temp  = strlen( payload ) / 2;
-    mesh_value_handle_t* value = (mesh_value_handle_t*)malloc(sizeof( mesh_value_handle_t ) + temp );
+    mesh_value_handle_t* value = (mesh_value_handle_t*)gateway_malloc( GATEWAY_ALLOC_TAG_DOWNLINK_VALUE, sizeof( mesh_value_handle_t ) + temp );
     if ( value != NULL )
     {
         uint32_t a;
@@ -161,7 +231,7 @@ static char* to_text(const uint8_t* bytes, uint16_t len, uint16_t *ret_len)
     if (len == 0)
         return NULL;
 
-    char* buffer = (char*) malloc ((len*2)+1);
+    char* buffer = (char*) gateway_malloc (GATEWAY_ALLOC_TAG_UPLINK_TEXT, (len*2)+1);
     *ret_len = (len * 2);
     if (buffer == NULL)
         return NULL;
@@ -192,12 +262,162 @@ static char* to_text(const uint8_t* bytes, uint16_t len, uint16_t *ret_len)
     buffer[index] = '\0';
     return buffer;
 }
+
+#if APP_CONFIG_NODE_STATE_CACHE
+static void publish_node_state(uint16_t src)
+{
+    char json[MESH_NODE_STATE_JSON_SIZE];
+    uint32_t len = mesh_node_cache_to_json(src, json, sizeof(json));
+    if (len > 0)
+    {
+        gateway_publish(AWS_PUB_TOPIC_MESH_STATE, (uint8_t*)json, len);
+    }
+}
+#endif
+
+static void publish_metrics(void)
+{
+    uint32_t len = gateway_metrics_to_json(metrics_json, sizeof(metrics_json));
+    if (len > 0)
+    {
+        gateway_publish(AWS_PUB_TOPIC_GATEWAY_STATS, (uint8_t*)metrics_json, len);
+    }
+}
+
+static void mesh_aws_topic_heap_callback(aws_iot_message_t& md)
+{
+    uint32_t len = gateway_alloc_report_to_json(heap_report_json, sizeof(heap_report_json));
+    if (len > 0)
+    {
+        gateway_publish(AWS_PUB_TOPIC_GATEWAY_HEAP, (uint8_t*)heap_report_json, len);
+    }
+}
+
+#if APP_CONFIG_LOCAL_RULES
+static void mesh_aws_topic_rules_callback(aws_iot_message_t& md)
+{
+    const char* payload = (const char *)md.message.payload;
+    uint32_t payload_length = md.message.payloadlen;
+    uint32_t len;
+
+    MESH_GATEWAY_DEBUG(("[App] Subscriber callback received Rule request(from AWS) -- Payload: %.*s\n",(int)payload_length, payload));
+
+    if (payload_length > 0 && mesh_rules_apply_request(payload, payload_length) != CY_RSLT_SUCCESS)
+    {
+        MESH_GATEWAY_INFO(("[App] Invalid rule request\n"));
+    }
+
+    len = mesh_rules_to_json(rules_json, sizeof(rules_json));
+    if (len > 0)
+    {
+        gateway_publish(AWS_PUB_TOPIC_GATEWAY_RULES, (uint8_t*)rules_json, len);
+    }
+}
+#endif
+
+#if APP_CONFIG_DOWNLINK_FANOUT
+static void mesh_aws_topic_groups_callback(aws_iot_message_t& md)
+{
+    const char* payload = (const char *)md.message.payload;
+    uint32_t payload_length = md.message.payloadlen;
+    uint32_t len;
+
+    MESH_GATEWAY_DEBUG(("[App] Subscriber callback received Group request(from AWS) -- Payload: %.*s\n",(int)payload_length, payload));
+
+    if (payload_length > 0 && gateway_fanout_apply_request(payload, payload_length) != CY_RSLT_SUCCESS)
+    {
+        MESH_GATEWAY_INFO(("[App] Invalid group request\n"));
+    }
+
+    len = gateway_fanout_groups_to_json(groups_json, sizeof(groups_json));
+    if (len > 0)
+    {
+        gateway_publish(AWS_PUB_TOPIC_GATEWAY_GROUPS, (uint8_t*)groups_json, len);
+    }
+}
+#endif
+
+#if APP_CONFIG_PROXY_FILTER
+static void mesh_aws_topic_proxy_nodes_callback(aws_iot_message_t& md)
+{
+    const char* payload = (const char *)md.message.payload;
+    uint32_t payload_length = md.message.payloadlen;
+    uint32_t len;
+
+    MESH_GATEWAY_DEBUG(("[App] Subscriber callback received Proxy filter request(from AWS) -- Payload: %.*s\n",(int)payload_length, payload));
+
+    if (payload_length > 0 && gateway_proxy_filter_apply_request(payload, payload_length) != CY_RSLT_SUCCESS)
+    {
+        MESH_GATEWAY_INFO(("[App] Invalid proxy filter request\n"));
+    }
+
+    len = gateway_proxy_filter_to_json(proxy_nodes_json, sizeof(proxy_nodes_json));
+    if (len > 0)
+    {
+        gateway_publish(AWS_PUB_TOPIC_PROXY_NODES, (uint8_t*)proxy_nodes_json, len);
+    }
+}
+#endif
+
+#if APP_CONFIG_UPLINK_DECODE
+static void publish_decoded(const mesh_pdu_t* pdu)
+{
+    mesh_decoded_t record;
+    uint8_t buffer[MESH_DECODE_FORMAT == MESH_DECODE_FORMAT_BINARY ? MESH_DECODE_BINARY_SIZE : MESH_DECODE_JSON_SIZE];
+
+    if (mesh_decode(pdu, &record) != CY_RSLT_SUCCESS)
+    {
+        return;
+    }
+    uint32_t len = mesh_decode_render(&record, buffer, sizeof(buffer));
+    if (len > 0)
+    {
+        gateway_publish(AWS_PUB_TOPIC_MESH_DECODED, buffer, len);
+    }
+}
+#endif
+
+#if APP_CONFIG_DELIVERY_TRACKING
+static void publish_delivery_report(const gateway_delivery_report_t* report)
+{
+    char json[GATEWAY_DELIVERY_JSON_SIZE];
+    uint32_t len = gateway_delivery_report_to_json(report, json, sizeof(json));
+    if (len > 0)
+    {
+        gateway_publish(AWS_PUB_TOPIC_MESH_ACK, (uint8_t*)json, len);
+    }
+}
+#endif
+
+#if GATEWAY_LATENCY_ECHO_IN_ACK
+static void publish_latency_report(const gateway_latency_report_t* report)
+{
+    char json[MESH_LATENCY_REPORT_JSON_SIZE];
+    uint32_t len = gateway_latency_report_to_json(report, json, sizeof(json));
+    if (len > 0)
+    {
+        gateway_publish(AWS_PUB_TOPIC_MESH_ACK, (uint8_t*)json, len);
+    }
+}
+#endif
+
+#if APP_CONFIG_SENSOR_AGGREGATION
+static void publish_sensor_summary(const mesh_sensor_series_t* summary)
+{
+    char json[MESH_SENSOR_SUMMARY_JSON_SIZE];
+    uint32_t len = mesh_sensor_agg_to_json(summary, json, sizeof(json));
+    if (len > 0)
+    {
+        gateway_publish(AWS_PUB_TOPIC_SENSOR_SUMMARY, (uint8_t*)json, len);
+    }
+}
+#endif
 #endif
 
 static void mesh_event_callback(Mesh::BluetoothMeshEvent event, Mesh::MeshEventCallbackData* payload)
 {
 
-    MESH_GATEWAY_DEBUG(("[App] %s Mesh Event:%02x Payload:%p\n", __func__, event, payload));
+    MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_DEBUG, "[App] %s Mesh Event:%02x Payload:%p\n", __func__, event, payload);
     switch(event)
     {
         /* Provisioning status of Bluetooth device */
@@ -208,8 +428,7 @@ static void mesh_event_callback(Mesh::BluetoothMeshEvent event, Mesh::MeshEventC
                 MESH_GATEWAY_INFO(("[App] Mesh-Provisioning status %2x\n", payload->provisioning.status));
                 if(payload->provisioning.status == MESH_PROVISION_RESULT_SUCCESS)
                 {
-                    mesh_dct_info.node_authenticated = MESH_NODE_PROVISIONED;
-                    mesh_kvstore_write();
+                    gateway_persist_post(GATEWAY_PERSIST_PROVISIONED, 0, NULL, 0);
                 }
             }
         }
@@ -229,9 +448,89 @@ static void mesh_event_callback(Mesh::BluetoothMeshEvent event, Mesh::MeshEventC
             {
                 uint32_t packet_len = payload->network.length;
                 uint8_t* packet = payload->network.packet;
-                MESH_GATEWAY_DEBUG(("[App] Proxy Data received %p %lu\n", payload->network.packet, payload->network.length));
-                uint8_t* val = (uint8_t*)malloc(sizeof(uint8_t)*(packet_len+1));
+                bool state_changed = true;
+                mesh_pdu_t pdu;
+                MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_DEBUG, "[App] Proxy Data received %p %lu\n", payload->network.packet, payload->network.length);
+                gateway_metrics_increment(GATEWAY_COUNTER_UPLINK_PACKETS, 1);
+                gateway_metrics_increment(GATEWAY_COUNTER_UPLINK_BYTES, packet_len);
+
+#if APP_CONFIG_PROXY_SAR
+                const uint8_t* message = NULL;
+                uint32_t message_len = 0;
+                if (gateway_proxy_sar_process(packet, packet_len, &message, &message_len) != GATEWAY_PROXY_SAR_COMPLETE)
+                {
+                    break;
+                }
+                packet = (uint8_t*)message;
+                packet_len = message_len;
+#endif
+                if (packet_len == 0 || packet_len > MESH_UPLINK_PACKET_MAX)
+                {
+                    gateway_metrics_increment(GATEWAY_COUNTER_UPLINK_SAR_ERRORS, 1);
+                    break;
+                }
+#if APP_CONFIG_PROXY_FILTER
+                if ((packet[0] & 0x3F) == MESH_PROXY_TYPE_PROXY_CONFIG)
+                {
+                    /* Filter Status from the proxy node; not mesh data */
+                    gateway_proxy_filter_status(packet, packet_len);
+                    break;
+                }
+#endif
+#if APP_CONFIG_UPLINK_FILTER
+                if (mesh_uplink_filter_is_duplicate(packet, packet_len))
+                {
+                    break;
+                }
+#endif
+                mesh_pdu_parse(packet, packet_len, &pdu);
+                if (pdu.src != MESH_ADDR_UNASSIGNED)
+                {
+                    gateway_latency_complete(pdu.src);
+                }
+#if APP_CONFIG_DELIVERY_TRACKING
+                gateway_delivery_match(&pdu);
+#endif
+#if APP_CONFIG_LOCAL_RULES
+                mesh_rules_process(&pdu);
+#endif
+#if APP_CONFIG_NODE_STATE_CACHE
+                state_changed = mesh_node_cache_update(&pdu);
+#if APP_CONFIG_AWS_CLOUD
+                if (state_changed)
+                {
+                    publish_node_state(pdu.src);
+                }
+#endif
+#endif
+#if APP_CONFIG_STATE_HISTORY
+                if (state_changed)
+                {
+                    gateway_history_record(&pdu);
+                    /* A full block is written to flash by the network thread */
+                    gateway_threads_wake_net(GATEWAY_IDLE_SLOT_MSEC);
+                }
+#endif
+#if APP_CONFIG_SENSOR_AGGREGATION && APP_CONFIG_AWS_CLOUD
+                if (mesh_sensor_agg_process(&pdu))
+                {
+                    break;
+                }
+#endif
+#if APP_CONFIG_UPLINK_FILTER
+                if (!mesh_uplink_filter_should_publish(&pdu, state_changed))
+                {
+                    break;
+                }
+#endif
+                (void)state_changed;
+
+                uint8_t* val = (uint8_t*)gateway_malloc(GATEWAY_ALLOC_TAG_UPLINK_PACKET, sizeof(uint8_t)*(packet_len+1));
                 uint8_t* ptr;
+                if (!val)
+                {
+                    break;
+                }
                 ptr = val;
                 ptr++;
                 memcpy(ptr, packet,packet_len);
@@ -241,13 +540,28 @@ static void mesh_event_callback(Mesh::BluetoothMeshEvent event, Mesh::MeshEventC
                     http_response(val, packet_len + 1);
 #endif
 #ifdef APP_CONFIG_AWS_CLOUD
+#if APP_CONFIG_UPLINK_BATCH
+                gateway_uplink_batch_add(packet, packet_len);
+                gateway_threads_wake_net(GATEWAY_UPLINK_BATCH_WINDOW_MSEC);
+#else
                 uint16_t len = 0;
                 char* data = to_text(packet, packet_len, &len);
-                AWSMQTTClient* client = (AWSMQTTClient* )app_data.cloud;
-                if (app_data.cloud)
-                    client->publish(AWS_PUB_TOPIC_MESH_DATA, (uint8_t*)data, len);
+#if APP_CONFIG_NODE_TOPICS
+                const char* topic = gateway_topic_for_node(pdu.src);
+#else
+                const char* topic = AWS_PUB_TOPIC_MESH_DATA;
+#endif
+                if (data && gateway_publish(topic, (uint8_t*)data, len) != CY_RSLT_SUCCESS)
+                {
+                    gateway_metrics_increment(GATEWAY_COUNTER_UPLINK_PUBLISH_ERRORS, 1);
+                }
+                gateway_free(data);
+#endif
+#if APP_CONFIG_UPLINK_DECODE
+                publish_decoded(&pdu);
 #endif
-                free(val);
+#endif
+                gateway_free(val);
                 ptr = NULL;
             }
         }
@@ -265,7 +579,7 @@ static void mesh_event_callback(Mesh::BluetoothMeshEvent event, Mesh::MeshEventC
         {
             if (payload)
             {
-                mesh_write_dct(payload->nvram.id, payload->nvram.data, payload->nvram.length);
+                gateway_persist_post(GATEWAY_PERSIST_CHUNK, payload->nvram.id, payload->nvram.data, payload->nvram.length);
             }
         }
         break;
@@ -334,6 +648,13 @@ static cy_rslt_t parse_json_shadow_status(cy_JSON_object_t * json_object )
           received_data[json_object->value_length] = '\0';
         }
      }
+    else if (json_object->object_string_length == strlen(MESH_DATA_JSON_ID_KEY) &&
+             strncmp(json_object->object_string, MESH_DATA_JSON_ID_KEY, strlen(MESH_DATA_JSON_ID_KEY)) == 0)
+    {
+        received_id_len = (json_object->value_length < sizeof(received_id)) ? json_object->value_length : sizeof(received_id) - 1;
+        memcpy(received_id, json_object->value, received_id_len);
+        received_id[received_id_len] = '\0';
+    }
 
     return CY_RSLT_SUCCESS;
 }
@@ -343,41 +664,221 @@ static void mesh_aws_topic_connection_callback(aws_iot_message_t& md)
     uint8_t* payload = (uint8_t *)md.message.payload;
     uint32_t payload_length = md.message.payloadlen;
 
-    MESH_GATEWAY_INFO(("[App] Subscriber callback received Mesh Connection status(from AWS) -- Payload: %.*s\n",(int)payload_length, payload));
+    MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_DEBUG, "[App] Subscriber callback received Mesh Connection status(from AWS) -- %lu bytes\n", payload_length);
 
     if (payload_length == 1 && payload[0] == 49) //comparing to connected "1"
     {
-        MESH_GATEWAY_INFO(("[App] Mesh Connection status: CONNECT\n"));
-        do_mesh_connect();
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_INFO, "[App] Mesh Connection status: CONNECT\n");
+        gateway_mesh_tx_post(GATEWAY_MESH_TX_CONNECT, NULL, GATEWAY_LATENCY_NO_TRACE, MESH_ADDR_UNASSIGNED);
     }
     else if (payload_length == 1 && payload[0] == 48)
     {
-        MESH_GATEWAY_INFO(("[App] Mesh Connection status: DISCONNECT\n"));
-        do_mesh_disconnect();
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_INFO, "[App] Mesh Connection status: DISCONNECT\n");
+        gateway_mesh_tx_post(GATEWAY_MESH_TX_DISCONNECT, NULL, GATEWAY_LATENCY_NO_TRACE, MESH_ADDR_UNASSIGNED);
     }
 }
 
-static void mesh_aws_topic_data_callback(aws_iot_message_t& md)
+static void mesh_aws_data_received(aws_iot_message_t& md, uint32_t received_us, uint16_t dst)
 {
     uint8_t* payload = (uint8_t *)md.message.payload;
     uint32_t payload_length = md.message.payloadlen;
-    MESH_GATEWAY_DEBUG(("[App] Subscriber callback received Mesh Data(from AWS) -- Payload: %.*s\n",(int)payload_length, payload));
+    received_id_len = 0;
     cy_rslt_t ret = cy_JSON_parser((const char*) payload, payload_length);
-    if (ret == CY_RSLT_SUCCESS)
+    if (ret != CY_RSLT_SUCCESS)
+    {
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_WARN, "[App] Subscriber Callback failed to parse Mesh Data (%lu)\n", ret);
+    }
+
+#if APP_CONFIG_COMMAND_DEDUP
+    if (gateway_command_dedup_is_duplicate(received_id, received_id_len))
     {
-        MESH_GATEWAY_DEBUG(("[App] Subscriber Callback Reported data :  [%s]\n", received_data));
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_INFO, "[App] Duplicate Mesh Data command dropped\n");
+        return;
     }
+#endif
+
+    gateway_latency_handle_t trace = gateway_latency_start(received_us, received_id_len ? received_id : NULL, received_id_len);
+    gateway_latency_stamp(trace, GATEWAY_LATENCY_STAGE_PARSED);
 
     /* Now Send data received from AWS to Mesh Network */
-    do_mesh_send_data(received_data);
+    if (gateway_mesh_tx_post(GATEWAY_MESH_TX_DATA, received_data, trace, dst) != CY_RSLT_SUCCESS)
+    {
+        gateway_latency_abort(trace);
+#if APP_CONFIG_COMMAND_DEDUP
+        /* Not sent, so a redelivery must not be dropped as a duplicate */
+        gateway_command_dedup_forget(received_id, received_id_len);
+#endif
+    }
 }
 
+static void mesh_aws_topic_data_callback(aws_iot_message_t& md)
+{
+    uint32_t received_us = gateway_metrics_now_us();
+    MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_DEBUG, "[App] Subscriber callback received Mesh Data(from AWS) -- %lu bytes\n", (uint32_t)md.message.payloadlen);
+    mesh_aws_data_received(md, received_us, MESH_ADDR_UNASSIGNED);
+}
+
+#if APP_CONFIG_NODE_TOPICS
+static void mesh_aws_topic_node_data_callback(aws_iot_message_t& md)
+{
+    uint32_t received_us = gateway_metrics_now_us();
+    uint16_t dst;
+
+    if (gateway_topic_parse_node(md.topicName.lenstring.data, md.topicName.lenstring.len, &dst) != CY_RSLT_SUCCESS)
+    {
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_WARN, "[App] Mesh Data received on a topic without a node address\n");
+        gateway_metrics_increment(GATEWAY_COUNTER_DOWNLINK_ERRORS, 1);
+        return;
+    }
+    MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_DEBUG, "[App] Subscriber callback received Mesh Data(from AWS) for node %04X -- %lu bytes\n", dst, (uint32_t)md.message.payloadlen);
+    mesh_aws_data_received(md, received_us, dst);
+}
+#endif
+
+
+#if APP_CONFIG_NODE_STATE_CACHE
+static void mesh_aws_topic_state_callback(aws_iot_message_t& md)
+{
+    const char* payload = (const char *)md.message.payload;
+    uint32_t payload_length = md.message.payloadlen;
+    uint32_t src = 0;
+
+    MESH_GATEWAY_DEBUG(("[App] Subscriber callback received Node State request(from AWS) -- Payload: %.*s\n",(int)payload_length, payload));
+
+    if (payload_length == 0 || payload_length > 4 || cy_string_to_unsigned(payload, payload_length, &src, 1) == 0)
+    {
+        MESH_GATEWAY_INFO(("[App] Invalid node address in state request\n"));
+        return;
+    }
+    publish_node_state((uint16_t)src);
+}
+#endif
+
+static void mesh_aws_topic_trace_callback(aws_iot_message_t& md)
+{
+    const char* payload = (const char *)md.message.payload;
+    uint32_t payload_length = md.message.payloadlen;
+
+    if (payload_length != 1 || payload[0] < '0' || payload[0] > '0' + GATEWAY_TRACE_LEVEL_DEBUG)
+    {
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_WARN, "[App] Invalid trace level request\n");
+        return;
+    }
+    gateway_trace_set_level(payload[0] - '0');
+}
+
+#if (APP_CONFIG_UPLINK_FILTER && APP_CONFIG_NODE_STATE_CACHE) || APP_CONFIG_SENSOR_AGGREGATION
+/* Parses "<node address in hex>,<0|1>" */
+static cy_rslt_t parse_node_switch(const char* payload, uint32_t payload_length, uint16_t* src, bool* enable)
+{
+    const char* separator = (const char*)memchr(payload, ',', payload_length);
+    uint32_t value = 0;
+
+    if (!separator || separator == payload || (separator - payload) > 4 || (uint32_t)(separator - payload) + 2 != payload_length ||
+        cy_string_to_unsigned(payload, separator - payload, &value, 1) == 0)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    *src = (uint16_t)value;
+    *enable = (separator[1] == '1');
+    return CY_RSLT_SUCCESS;
+}
+#endif
+
+#if APP_CONFIG_UPLINK_FILTER && APP_CONFIG_NODE_STATE_CACHE
+static void mesh_aws_topic_filter_callback(aws_iot_message_t& md)
+{
+    const char* payload = (const char *)md.message.payload;
+    uint32_t payload_length = md.message.payloadlen;
+    uint16_t src;
+    bool enable;
+
+    MESH_GATEWAY_DEBUG(("[App] Subscriber callback received Uplink filter request(from AWS) -- Payload: %.*s\n",(int)payload_length, payload));
+
+    if (parse_node_switch(payload, payload_length, &src, &enable) != CY_RSLT_SUCCESS)
+    {
+        MESH_GATEWAY_INFO(("[App] Invalid uplink filter request\n"));
+        return;
+    }
+
+    if (mesh_uplink_filter_set_change_only(src, enable) != CY_RSLT_SUCCESS)
+    {
+        MESH_GATEWAY_INFO(("[App] Failed to update uplink filter for node %04X\n", src));
+    }
+}
+#endif
+
+#if APP_CONFIG_SENSOR_AGGREGATION
+static void mesh_aws_topic_sensor_callback(aws_iot_message_t& md)
+{
+    const char* payload = (const char *)md.message.payload;
+    uint32_t payload_length = md.message.payloadlen;
+    uint16_t src;
+    bool raw;
+
+    MESH_GATEWAY_DEBUG(("[App] Subscriber callback received Sensor aggregation request(from AWS) -- Payload: %.*s\n",(int)payload_length, payload));
+
+    if (parse_node_switch(payload, payload_length, &src, &raw) != CY_RSLT_SUCCESS)
+    {
+        MESH_GATEWAY_INFO(("[App] Invalid sensor aggregation request\n"));
+        return;
+    }
+
+    if (mesh_sensor_agg_set_raw(src, raw) != CY_RSLT_SUCCESS)
+    {
+        MESH_GATEWAY_INFO(("[App] Failed to update sensor aggregation for node %04X\n", src));
+    }
+}
+#endif
+
+static const struct
+{
+    const char* topic;
+    void (*callback)(aws_iot_message_t& md);
+} aws_subscriptions[] =
+{
+    { AWS_SUB_TOPIC_MESH_CONN,      mesh_aws_topic_connection_callback },
+    { AWS_SUB_TOPIC_MESH_DATA,      mesh_aws_topic_data_callback },
+#if APP_CONFIG_NODE_TOPICS
+    { AWS_SUB_TOPIC_MESH_DATA_NODE, mesh_aws_topic_node_data_callback },
+#endif
+    { AWS_SUB_TOPIC_TRACE_LEVEL,    mesh_aws_topic_trace_callback },
+    { AWS_SUB_TOPIC_GATEWAY_HEAP,   mesh_aws_topic_heap_callback },
+#if APP_CONFIG_LOCAL_RULES
+    { AWS_SUB_TOPIC_GATEWAY_RULES,  mesh_aws_topic_rules_callback },
+#endif
+#if APP_CONFIG_DOWNLINK_FANOUT
+    { AWS_SUB_TOPIC_GATEWAY_GROUPS, mesh_aws_topic_groups_callback },
+#endif
+#if APP_CONFIG_PROXY_FILTER
+    { AWS_SUB_TOPIC_PROXY_NODES,    mesh_aws_topic_proxy_nodes_callback },
+#endif
+#if APP_CONFIG_NODE_STATE_CACHE
+    { AWS_SUB_TOPIC_MESH_STATE,     mesh_aws_topic_state_callback },
+#endif
+#if APP_CONFIG_UPLINK_FILTER && APP_CONFIG_NODE_STATE_CACHE
+    { AWS_SUB_TOPIC_UPLINK_FILTER,  mesh_aws_topic_filter_callback },
+#endif
+#if APP_CONFIG_SENSOR_AGGREGATION
+    { AWS_SUB_TOPIC_SENSOR_CONFIG,  mesh_aws_topic_sensor_callback },
+#endif
+};
+
+#define AWS_SUBSCRIPTION_COUNT  (sizeof(aws_subscriptions) / sizeof(aws_subscriptions[0]))
+
+static cy_rslt_t connect_aws_cloud(void);
+static void disconnect_aws_cloud(void);
+
+static const gateway_connection_handlers_t aws_connection_handlers =
+{
+    connect_aws_cloud,
+    disconnect_aws_cloud,
+};
 
 static cy_rslt_t setup_aws_cloud(void)
 {
     /* Initialize Security params for this client */
-    ClientSecurity aws_security(CLIENT_SECURITY_TYPE_TLS);
-
     int result = aws_security.set_tls_params(aws_thing_name, aws_thing_private_key, aws_thing_certificate);
     if (result != CY_RSLT_SUCCESS)
     {
@@ -403,69 +904,359 @@ static cy_rslt_t setup_aws_cloud(void)
 
     app_data.cloud = c;
 
+    /* Without a connection the gateway starts disconnected, and the network thread retries */
+    result = connect_aws_cloud();
+    if (result != CY_RSLT_SUCCESS)
+    {
+        MESH_GATEWAY_INFO(("[App] AWS IoT not reachable, retrying in the background\n"));
+    }
+    gateway_connection_init(&aws_connection_handlers, result == CY_RSLT_SUCCESS);
+    return CY_RSLT_SUCCESS;
+}
+
+/* Connects to the broker and (re)subscribes to all topics */
+static cy_rslt_t connect_aws_cloud(void)
+{
+    CloudClient* c = app_data.cloud;
+
     /* Get the Remote server endpoint */
 
     ClientConnectionParams aws_connection(AWS_BROKER_ADDRESS, AWS_MQTT_DEFAULT_SECURE_PORT, MESH_AWS_KEEP_ALIVE_TIMEOUT_IN_SEC);
 
-    result = c->connect(&aws_connection);
+    uint64_t start_ms = Kernel::get_ms_count();
+    cy_rslt_t result = c->connect(&aws_connection);
     if (result != CY_RSLT_SUCCESS)
     {
         MESH_GATEWAY_INFO(("Failed to connect to AWS IoT , result = %d \n", result));
         return result;
     }
-    int retries = 0;
-    int ret = 0;
-    do
+    /* TCP connect, TLS handshake and MQTT CONNECT */
+    gateway_metrics_set(GATEWAY_GAUGE_CLOUD_CONNECT_MSEC, (uint32_t)(Kernel::get_ms_count() - start_ms));
+
+    /* Send every SUBSCRIBE once before retrying any, so one slow topic does not hold up the others */
+    bool subscribed[AWS_SUBSCRIPTION_COUNT] = { false };
+    uint32_t pending = AWS_SUBSCRIPTION_COUNT;
+    for (uint32_t pass = 0; pass < MQTT_SUBSCRIBE_RETRY_COUNT && pending > 0; pass++)
     {
-        MESH_GATEWAY_INFO(("[App] Subscribing to topic: \"%s\"\n", AWS_SUB_TOPIC_MESH_CONN));
-        ret = ((AWSMQTTClient *)c)->subscribe(AWS_SUB_TOPIC_MESH_CONN, mesh_aws_topic_connection_callback);
-        retries ++;
-    } while ( ( ret != CY_RSLT_SUCCESS ) && ( retries < MQTT_SUBSCRIBE_RETRY_COUNT ) );
+        for (uint32_t i = 0; i < AWS_SUBSCRIPTION_COUNT; i++)
+        {
+            if (!subscribed[i] && ((AWSMQTTClient *)c)->subscribe(aws_subscriptions[i].topic, aws_subscriptions[i].callback) == CY_RSLT_SUCCESS)
+            {
+                subscribed[i] = true;
+                pending--;
+            }
+        }
+    }
 
-    if (ret != CY_RSLT_SUCCESS)
+    if (pending > 0)
     {
-        MESH_GATEWAY_INFO(("Failed\n"));
+        MESH_GATEWAY_INFO(("[App] Failed to subscribe to %lu AWS topics\n", pending));
+        c->disconnect();
         return CY_RSLT_MW_ERROR;
     }
-    retries = 0;
-    do
+    MESH_GATEWAY_INFO(("[App] AWS Subscriptions Successful.\n"));
+
+    return CY_RSLT_SUCCESS;
+}
+
+static void disconnect_aws_cloud(void)
+{
+    app_data.cloud->disconnect();
+}
+#endif
+
+#if APP_CONFIG_AWS_CLOUD
+#define AWS_RETAIN_PAYLOAD_MAX      (32)
+
+/* What happens to a message that cannot be published. cloud_publish() uses
+ * the client's default QoS 0 and gets no PUBACK, so spooling only covers
+ * publishes that fail at the gateway, not messages lost after them.
+ */
+typedef enum
+{
+    AWS_ON_FAILURE_DROP,
+    AWS_ON_FAILURE_SPOOL
+} aws_on_failure_t;
+
+typedef struct
+{
+    const char*         topic;
+    aws_on_failure_t    on_failure;
+    bool                retain;
+} aws_publish_policy_t;
+
+/* Publish policy of the topics. An entry also covers the per-node
+ * topics below it, e.g. "proxy_data" covers "proxy_data/0002".
+ *
+ * Messages of a 'drop' topic are dropped when they cannot be published.
+ * Messages of a 'spool' topic are spooled and sent again once the
+ * connection is back (APP_CONFIG_UPLINK_SPOOL), and dropped without it.
+ * The last message of a retained topic is published again after every
+ * reconnect, so that the state it carries is not lost with the session.
+ * For "proxy_state" these are the states of all nodes in the node cache.
+ */
+static const aws_publish_policy_t aws_publish_policies[] =
+{
+    { AWS_PUB_TOPIC_MESH_CONN,          AWS_ON_FAILURE_SPOOL,   true  },
+    { AWS_PUB_TOPIC_MESH_ACK,           AWS_ON_FAILURE_SPOOL,   false },
+    { AWS_PUB_TOPIC_MESH_DATA,          AWS_ON_FAILURE_SPOOL,   false },
+    { AWS_PUB_TOPIC_MESH_DATA_BATCH,    AWS_ON_FAILURE_SPOOL,   false },
+    { AWS_PUB_TOPIC_MESH_STATE,         AWS_ON_FAILURE_SPOOL,   true  },
+    { AWS_PUB_TOPIC_MESH_DECODED,       AWS_ON_FAILURE_DROP,    false },
+    { AWS_PUB_TOPIC_SENSOR_SUMMARY,     AWS_ON_FAILURE_DROP,    false },
+    { AWS_PUB_TOPIC_GATEWAY_STATS,      AWS_ON_FAILURE_DROP,    false },
+    { AWS_PUB_TOPIC_GATEWAY_HEAP,       AWS_ON_FAILURE_DROP,    false },
+#if APP_CONFIG_PROXY_FILTER
+    { AWS_PUB_TOPIC_PROXY_FILTER,       AWS_ON_FAILURE_SPOOL,   false },
+#endif
+};
+
+#define AWS_PUBLISH_POLICY_COUNT    (sizeof(aws_publish_policies) / sizeof(aws_publish_policies[0]))
+
+static const aws_publish_policy_t aws_default_publish_policy = { NULL, AWS_ON_FAILURE_DROP, false };
+
+static struct
+{
+    uint16_t    len;
+    uint8_t     payload[AWS_RETAIN_PAYLOAD_MAX];
+} aws_retained[AWS_PUBLISH_POLICY_COUNT];
+
+static const aws_publish_policy_t* aws_publish_policy(const char* topic)
+{
+    uint32_t i;
+
+    for (i = 0; i < AWS_PUBLISH_POLICY_COUNT; i++)
     {
-        MESH_GATEWAY_INFO(("[App] Subscribing to topic: \"%s\"\n", AWS_SUB_TOPIC_MESH_DATA));
-        ret = ((AWSMQTTClient *)c)->subscribe(AWS_SUB_TOPIC_MESH_DATA, mesh_aws_topic_data_callback);
-        retries ++;
-    } while ( ( ret != CY_RSLT_SUCCESS ) && ( retries < MQTT_SUBSCRIBE_RETRY_COUNT ) );
+        uint32_t len = strlen(aws_publish_policies[i].topic);
+        if (strncmp(topic, aws_publish_policies[i].topic, len) == 0 && (topic[len] == '\0' || topic[len] == '/'))
+        {
+            return &aws_publish_policies[i];
+        }
+    }
+    return &aws_default_publish_policy;
+}
 
-    if (ret != CY_RSLT_SUCCESS)
+static cy_rslt_t cloud_publish(const char* topic, const uint8_t* payload, uint32_t len)
+{
+    AWSMQTTClient* client = (AWSMQTTClient* )app_data.cloud;
+    if (!client || !gateway_connection_is_up())
     {
-        MESH_GATEWAY_INFO(("Failed\n"));
         return CY_RSLT_MW_ERROR;
     }
-    MESH_GATEWAY_INFO(("[App] AWS Subscriptions Successful.\n"));
-    wait_us(100 * 1000);
 
-    return CY_RSLT_SUCCESS;
+    uint32_t start_us = gateway_metrics_now_us();
+    cy_rslt_t result = client->publish(topic, (uint8_t*)payload, len);
+    if (result != CY_RSLT_SUCCESS)
+    {
+        gateway_metrics_increment(GATEWAY_COUNTER_UPLINK_PUBLISH_ERRORS, 1);
+    }
+    gateway_metrics_observe(GATEWAY_HISTOGRAM_UPLINK_PUBLISH_US, gateway_metrics_now_us() - start_us);
+    last_publish_ms = (uint32_t)Kernel::get_ms_count();
+    return result;
 }
+
+/* Publishes the retained messages again, e.g. after a reconnect */
+static void publish_retained(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < AWS_PUBLISH_POLICY_COUNT; i++)
+    {
+        if (aws_retained[i].len > 0)
+        {
+            cloud_publish(aws_publish_policies[i].topic, aws_retained[i].payload, aws_retained[i].len);
+        }
+    }
+
+#if APP_CONFIG_NODE_STATE_CACHE
+    uint16_t src = MESH_ADDR_UNASSIGNED;
+    while ((src = mesh_node_cache_next_node(src)) != MESH_ADDR_UNASSIGNED)
+    {
+        char json[MESH_NODE_STATE_JSON_SIZE];
+        uint32_t len = mesh_node_cache_to_json(src, json, sizeof(json));
+        if (len > 0)
+        {
+            cloud_publish(AWS_PUB_TOPIC_MESH_STATE, (uint8_t*)json, len);
+        }
+    }
 #endif
+}
 
-static void do_main_loop(void)
+static cy_rslt_t net_publish(const char* topic, const uint8_t* payload, uint32_t len)
 {
-    cy_rslt_t result = CY_RSLT_SUCCESS;
+    const aws_publish_policy_t* policy = aws_publish_policy(topic);
+    cy_rslt_t result;
 
-    while(result == CY_RSLT_SUCCESS)
+    /* Retained topics have no per-node subtopics, so one message per entry is enough.
+     * The node states are kept by the node cache. */
+    if (policy->retain && len > 0 && len <= AWS_RETAIN_PAYLOAD_MAX && strcmp(policy->topic, AWS_PUB_TOPIC_MESH_STATE) != 0)
     {
-#if APP_CONFIG_AWS_CLOUD
-        if (app_data.cloud)
+        uint32_t index = policy - aws_publish_policies;
+        memcpy(aws_retained[index].payload, payload, len);
+        aws_retained[index].len = (uint16_t)len;
+    }
+
+#if APP_CONFIG_UPLINK_SPOOL
+    if (policy->on_failure == AWS_ON_FAILURE_SPOOL)
+    {
+        /* While anything is spooled, new messages queue up behind it to keep the order */
+        if (gateway_spool_is_empty() && cloud_publish(topic, payload, len) == CY_RSLT_SUCCESS)
         {
-            result = ((AWSMQTTClient *)app_data.cloud)->yield(MESH_AWS_YIELD_TIMEOUT_IN_MSEC);
-            if ( result == CY_RSLT_AWS_ERROR_DISCONNECTED )
-            {
-                MESH_GATEWAY_INFO(("Disconnected from AWS broker, one reason could be that the Thing name is not unique \n"));
-            }
+            return CY_RSLT_SUCCESS;
         }
+        return gateway_spool_push(topic, payload, len);
+    }
 #endif
-        wait_us(200 * 1000);
+
+    result = cloud_publish(topic, payload, len);
+    if (result != CY_RSLT_SUCCESS)
+    {
+        gateway_metrics_increment(GATEWAY_COUNTER_UPLINK_DROPPED, 1);
+    }
+    return result;
+}
+#endif
+
+#if APP_CONFIG_AWS_CLOUD && APP_CONFIG_UPLINK_BATCH
+#if APP_CONFIG_UPLINK_SPOOL
+MBED_STATIC_ASSERT(GATEWAY_UPLINK_BATCH_FRAME_MAX <= GATEWAY_SPOOL_PAYLOAD_MAX, "Uplink frames must fit in the spool");
+#endif
+
+/* Runs on the network thread; a dropped frame is counted by net_publish() */
+static cy_rslt_t publish_uplink_batch(const uint8_t* frame, uint32_t len)
+{
+    return gateway_publish(AWS_PUB_TOPIC_MESH_DATA_BATCH, frame, len);
+}
+#endif
+
+#if APP_CONFIG_AWS_CLOUD && APP_CONFIG_STATE_HISTORY
+/* Sends the history recorded during an outage, a few messages per poll */
+static void publish_history_replay(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < GATEWAY_HISTORY_REPLAY_PER_POLL && history_replaying; i++)
+    {
+        gateway_history_query_t cursor = history_replay;
+        uint32_t len = gateway_history_render(&history_replay, history_json + 1, sizeof(history_json) - 2);
+        if (len == 0)
+        {
+            history_replaying = false;
+            break;
+        }
+        history_json[0] = '[';
+        history_json[len + 1] = ']';
+        if (cloud_publish(AWS_PUB_TOPIC_MESH_HISTORY, (uint8_t*)history_json, len + 2) != CY_RSLT_SUCCESS)
+        {
+            /* Try again on the next poll */
+            history_replay = cursor;
+            break;
+        }
+    }
+}
+#endif
+
+/* Lowers 'next_ms' to 'due_ms' if that is earlier */
+static void earliest_timer(uint32_t* next_ms, uint32_t due_ms)
+{
+    if (due_ms < *next_ms)
+    {
+        *next_ms = due_ms;
     }
-    return;
+}
+
+/* Runs on the network thread between publishes */
+static cy_rslt_t net_poll(uint32_t* wait_ms)
+{
+    uint32_t next_ms = GATEWAY_IDLE_FOREVER;
+#if APP_CONFIG_AWS_CLOUD
+    static uint32_t metrics_published_ms = gateway_idle_slot_start((uint32_t)Kernel::get_ms_count());
+    static bool cloud_was_up = true;
+    bool cloud_up = app_data.cloud && gateway_connection_poll();
+    uint32_t now;
+
+    if (cloud_up && !cloud_was_up)
+    {
+        publish_retained();
+#if APP_CONFIG_STATE_HISTORY
+        /* Everything recorded from the start of the outage until now */
+        history_replay.end_seq = gateway_history_next_seq();
+        history_replaying = true;
+#endif
+    }
+#if APP_CONFIG_STATE_HISTORY
+    if (!cloud_up && cloud_was_up && !history_replaying)
+    {
+        gateway_history_query_init(&history_replay, MESH_ADDR_UNASSIGNED, 0, GATEWAY_HISTORY_TIME_END);
+        history_replay.next_seq = gateway_history_next_seq();
+    }
+#endif
+    cloud_was_up = cloud_up;
+
+#if APP_CONFIG_UPLINK_SPOOL
+    if (gateway_connection_is_up())
+    {
+        gateway_spool_drain(cloud_publish, GATEWAY_SPOOL_DRAIN_PER_POLL);
+        earliest_timer(&next_ms, gateway_spool_is_empty() ? GATEWAY_IDLE_FOREVER : 0);
+    }
+#endif
+#if APP_CONFIG_STATE_HISTORY
+    if (history_replaying && cloud_up)
+    {
+        publish_history_replay();
+        earliest_timer(&next_ms, history_replaying ? 0 : GATEWAY_IDLE_FOREVER);
+    }
+#endif
+#if APP_CONFIG_UPLINK_BATCH
+    earliest_timer(&next_ms, gateway_uplink_batch_poll());
+#endif
+#if APP_CONFIG_SENSOR_AGGREGATION
+    earliest_timer(&next_ms, mesh_sensor_agg_poll());
+#endif
+    now = (uint32_t)Kernel::get_ms_count();
+    if (now - metrics_published_ms >= GATEWAY_METRICS_PUBLISH_INTERVAL_MSEC)
+    {
+        publish_metrics();
+        metrics_published_ms = gateway_idle_slot_start(now);
+    }
+    earliest_timer(&next_ms, gateway_idle_until(now, metrics_published_ms + GATEWAY_METRICS_PUBLISH_INTERVAL_MSEC));
+    /* Reconnects with backoff while the connection is down */
+    earliest_timer(&next_ms, gateway_connection_retry_ms());
+#endif
+#if APP_CONFIG_STATE_HISTORY
+    gateway_history_poll();
+#endif
+
+#if APP_CONFIG_AWS_CLOUD
+    if (cloud_up && gateway_connection_is_up())
+    {
+        /* Sleeps in the socket until the next timer, taking in MQTT messages and sending the keepalive.
+         * Queued publishes wait for the yield to end: while they keep coming the yield is short, as before,
+         * otherwise it runs up to the next slot boundary, where the other threads wake up too.
+         */
+        uint32_t yield_ms = MESH_AWS_YIELD_TIMEOUT_IN_MSEC;
+        now = (uint32_t)Kernel::get_ms_count();
+        if (now - last_publish_ms >= MESH_AWS_ACTIVE_TIMEOUT_IN_MSEC && next_ms > MESH_AWS_YIELD_TIMEOUT_IN_MSEC)
+        {
+            yield_ms = gateway_idle_align(now, MESH_AWS_YIELD_TIMEOUT_IN_MSEC);
+            yield_ms = (next_ms < yield_ms) ? next_ms : yield_ms;
+        }
+
+        uint32_t start_us = gateway_metrics_now_us();
+        cy_rslt_t result = ((AWSMQTTClient *)app_data.cloud)->yield(yield_ms);
+        gateway_metrics_observe(GATEWAY_HISTOGRAM_MQTT_YIELD_US, gateway_metrics_now_us() - start_us);
+        gateway_idle_wakeup(GATEWAY_WAKE_SOCKET);
+        if ( result == CY_RSLT_AWS_ERROR_DISCONNECTED )
+        {
+            MESH_GATEWAY_INFO(("Disconnected from AWS broker, one reason could be that the Thing name is not unique \n"));
+            gateway_connection_lost();
+        }
+        /* The yield did the sleeping, unless it failed right away */
+        next_ms = (result == CY_RSLT_SUCCESS) ? 0 : MESH_AWS_YIELD_TIMEOUT_IN_MSEC;
+    }
+#endif
+    *wait_ms = next_ms;
+    return CY_RSLT_SUCCESS;
 }
 
 void do_mesh_connect(void)
@@ -475,6 +1266,10 @@ void do_mesh_connect(void)
     /* Wait sufficient time to allow GATT disconnection */
     osDelay(1000);
     mesh.connectMesh();
+#if APP_CONFIG_PROXY_FILTER
+    /* A new proxy connection starts with the default filter */
+    gateway_proxy_filter_reset();
+#endif
 #ifdef APP_CONFIG_HTTP_SERVER
     uint8_t value[] = {0x00, 0x01};
     http_response(value, 2);
@@ -482,8 +1277,7 @@ void do_mesh_connect(void)
 
 #if APP_CONFIG_AWS_CLOUD
     const char* val = "1";
-    if (app_data.cloud)
-        ((AWSMQTTClient *)app_data.cloud)->publish(AWS_PUB_TOPIC_MESH_CONN, (uint8_t*)val, 1);
+    gateway_publish(AWS_PUB_TOPIC_MESH_CONN, (const uint8_t*)val, 1);
 #endif
 
 }
@@ -501,25 +1295,200 @@ void do_mesh_disconnect(void)
 
 #if APP_CONFIG_AWS_CLOUD
     const char* val = "0";
-    if (app_data.cloud)
-        ((AWSMQTTClient *)app_data.cloud)->publish(AWS_PUB_TOPIC_MESH_CONN, (uint8_t*)val, 1);
+    gateway_publish(AWS_PUB_TOPIC_MESH_CONN, (const uint8_t*)val, 1);
 #endif
 }
 
-void do_mesh_send_data(char* payload)
+/* Throttles and hands a proxy packet to the mesh; runs on the mesh TX thread */
+static void mesh_send_packet(const uint8_t* packet, uint32_t length, gateway_latency_handle_t trace, uint16_t dst)
 {
-    mesh_value_handle_t* value = create_mesh_value(payload);
-    mesh_value_handle_t* reversed_value = reverse_mesh_byte_stream(value);
     /* Get EmbeddedBLE singleton object */
     BLE& ble = BLE::Instance();
     Mesh& mesh = ble.mesh();
     /* Throttling the mesh data that is sent to the Controller */
-    wait_us(100 * 1000);
-    mesh.sendData(reversed_value->value, reversed_value->length);
-    free( value );
-    free( reversed_value );
+    ThisThread::sleep_for(100);
+    gateway_latency_sent(trace, dst);
+    uint32_t start_us = gateway_metrics_now_us();
+    mesh.sendData((uint8_t*)packet, length);
+    gateway_metrics_observe(GATEWAY_HISTOGRAM_DOWNLINK_SEND_US, gateway_metrics_now_us() - start_us);
+    gateway_metrics_increment(GATEWAY_COUNTER_DOWNLINK_PACKETS, 1);
+    gateway_metrics_increment(GATEWAY_COUNTER_DOWNLINK_BYTES, length);
+}
+
+/* Sends a downlink command and starts tracking its delivery */
+static void mesh_send_command(const uint8_t* packet, uint32_t length, gateway_latency_handle_t trace)
+{
+    mesh_pdu_t pdu;
+#if APP_CONFIG_DOWNLINK_FANOUT
+    uint16_t members[GATEWAY_FANOUT_MAX_MEMBERS];
+    uint32_t member_count;
+    uint32_t i;
+#endif
+
+    mesh_pdu_parse(packet, length, &pdu);
+#if APP_CONFIG_PROXY_FILTER
+    if ((pdu.dst & 0x8000) == 0)
+    {
+        gateway_proxy_filter_note_command(pdu.dst);
+    }
+#endif
+    mesh_send_packet(packet, length, trace, pdu.dst);
+#if APP_CONFIG_DOWNLINK_FANOUT
+    /* A group copy from the cloud is tracked for each configured member */
+    member_count = gateway_fanout_members(pdu.dst, members, GATEWAY_FANOUT_MAX_MEMBERS);
+    if (member_count > 0)
+    {
+        for (i = 0; i < member_count; i++)
+        {
+            pdu.dst = members[i];
+#if APP_CONFIG_PROXY_FILTER
+            gateway_proxy_filter_note_command(pdu.dst);
+#endif
+#if APP_CONFIG_DELIVERY_TRACKING
+            gateway_delivery_track(&pdu, trace);
+#endif
+        }
+        gateway_metrics_increment(GATEWAY_COUNTER_FANOUT_GROUP_SENDS, 1);
+        return;
+    }
+#endif
+#if APP_CONFIG_DELIVERY_TRACKING
+    gateway_delivery_track(&pdu, trace);
+#endif
+}
+
+#if APP_CONFIG_PROXY_FILTER
+/* The cloud holds the network key and applies the wanted filter */
+static void mesh_proxy_filter_changed(void)
+{
+#if APP_CONFIG_AWS_CLOUD
+    static char wanted[GATEWAY_PROXY_FILTER_TEXT_SIZE];
+    uint32_t len = gateway_proxy_filter_wanted_to_text(wanted, sizeof(wanted));
+    if (len > 0)
+    {
+        gateway_publish(AWS_PUB_TOPIC_PROXY_FILTER, (uint8_t*)wanted, len);
+    }
+#endif
+}
+#endif
+
+static uint32_t mesh_tx_poll(void)
+{
+    uint32_t next_ms = GATEWAY_IDLE_FOREVER;
+
+#if APP_CONFIG_DELIVERY_TRACKING
+    earliest_timer(&next_ms, gateway_delivery_poll());
+#endif
+#if APP_CONFIG_PROXY_FILTER
+    earliest_timer(&next_ms, gateway_proxy_filter_poll());
+#endif
+    return next_ms;
+}
+
+void do_mesh_send_data(char* payload, uint32_t trace, uint16_t dst)
+{
+    mesh_pdu_t pdu;
+
+    gateway_latency_stamp(trace, GATEWAY_LATENCY_STAGE_QUEUED);
+    mesh_value_handle_t* value = create_mesh_value(payload);
+    if (!value)
+    {
+        gateway_metrics_increment(GATEWAY_COUNTER_DOWNLINK_ERRORS, 1);
+        gateway_latency_abort(trace);
+        return;
+    }
+    mesh_value_handle_t* reversed_value = reverse_mesh_byte_stream(value);
+    if (!reversed_value)
+    {
+        gateway_metrics_increment(GATEWAY_COUNTER_DOWNLINK_ERRORS, 1);
+        gateway_latency_abort(trace);
+        gateway_free( value );
+        return;
+    }
+    mesh_pdu_parse(reversed_value->value, reversed_value->length, &pdu);
+    if (dst != MESH_ADDR_UNASSIGNED && pdu.dst != dst)
+    {
+        /* Sent on the topic of one node but addressed to another */
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_WARN, "[App] Mesh Data for node %04X is addressed to %04X, dropped\n", dst, pdu.dst);
+        gateway_metrics_increment(GATEWAY_COUNTER_DOWNLINK_ERRORS, 1);
+        gateway_latency_abort(trace);
+        gateway_free( value );
+        gateway_free( reversed_value );
+        return;
+    }
+    mesh_send_command(reversed_value->value, reversed_value->length, trace);
+    gateway_free( value );
+    gateway_free( reversed_value );
+}
+
+#if APP_CONFIG_SUPERVISOR
+#if !(APP_CONFIG_AWS_CLOUD && APP_CONFIG_UPLINK_SPOOL)
+/* gateway_publish() keeps the topic pointer, and the warm boot store is rewritten by the next restart */
+static char restored_topics[GATEWAY_NET_QUEUE_DEPTH][GATEWAY_WARMBOOT_TOPIC_MAX + 1];
+#endif
+
+/* The supervisor may find a stalled thread up to a period late; the watchdog must not fire while the traffic is saved */
+#if APP_CONFIG_AWS_CLOUD && APP_CONFIG_UPLINK_SPOOL
+MBED_STATIC_ASSERT(GATEWAY_SUPERVISOR_PERIOD_MSEC + GATEWAY_SPOOL_RETAIN_WAIT_MSEC + GATEWAY_PERSIST_FLUSH_MSEC < GATEWAY_WATCHDOG_TIMEOUT_MSEC,
+                   "Retaining the queued traffic takes longer than the watchdog allows");
+#else
+MBED_STATIC_ASSERT(GATEWAY_SUPERVISOR_PERIOD_MSEC + GATEWAY_PERSIST_FLUSH_MSEC < GATEWAY_WATCHDOG_TIMEOUT_MSEC,
+                   "Retaining the queued traffic takes longer than the watchdog allows");
+#endif
+
+/* Saves the queued traffic before a warm restart; runs on the main thread */
+static void retain_queued_traffic(void)
+{
+#if APP_CONFIG_AWS_CLOUD && APP_CONFIG_UPLINK_SPOOL
+    /* Older than anything in the publish queue */
+    gateway_spool_retain();
+#endif
+    gateway_threads_retain();
 }
 
+/* Queues the traffic saved by the previous run again, before the worker threads start */
+static void restore_queued_traffic(void)
+{
+    gateway_warmboot_record_t record;
+    uint32_t offset = 0;
+#if !(APP_CONFIG_AWS_CLOUD && APP_CONFIG_UPLINK_SPOOL)
+    uint32_t restored = 0;
+#endif
+    char payload[GATEWAY_MESH_TX_MAX_PAYLOAD + 1];
+
+    while (gateway_warmboot_next(&offset, &record))
+    {
+#if APP_CONFIG_AWS_CLOUD && APP_CONFIG_UPLINK_SPOOL
+        if (record.type == GATEWAY_WARMBOOT_SPOOLED && record.topic)
+        {
+            /* Ahead of the flash ring, which gateway_spool_init() left in place */
+            gateway_spool_restore(record.topic, record.data, record.len);
+        }
+        else
+#endif
+        if (record.type == GATEWAY_WARMBOOT_UPLINK && record.topic)
+        {
+#if APP_CONFIG_AWS_CLOUD && APP_CONFIG_UPLINK_SPOOL
+            gateway_spool_push(record.topic, record.data, record.len);
+#else
+            if (restored < GATEWAY_NET_QUEUE_DEPTH)
+            {
+                strncpy(restored_topics[restored], record.topic, GATEWAY_WARMBOOT_TOPIC_MAX);
+                gateway_publish(restored_topics[restored], record.data, record.len);
+                restored++;
+            }
+#endif
+        }
+        else if (record.type == GATEWAY_WARMBOOT_DOWNLINK && record.len <= GATEWAY_MESH_TX_MAX_PAYLOAD)
+        {
+            memcpy(payload, record.data, record.len);
+            payload[record.len] = '\0';
+            gateway_mesh_tx_post((gateway_mesh_tx_type_t)record.arg, payload, GATEWAY_LATENCY_NO_TRACE, record.dst);
+        }
+    }
+}
+#endif
+
 int main(void)
 {
     cy_rslt_t ret = CY_RSLT_MW_ERROR;
@@ -527,16 +1496,41 @@ int main(void)
     ButtonHandler btn_handler;
     InterruptIn flash_button(RESET_FLASH_BUTTON_PIN_NAME, RESET_FLASH_BUTTON_PIN_PULL);
     int timeout = 0; // Wait for 5 seconds for User to trigger the button for resetting flash
+#if APP_CONFIG_SUPERVISOR
+    gateway_warmboot_info_t warmboot = { 0 };
+    bool warm_boot = gateway_warmboot_load(&warmboot);
+#else
+    bool warm_boot = false;
+#endif
+
+    if (gateway_trace_init() != CY_RSLT_SUCCESS)
+    {
+        MESH_GATEWAY_INFO(("[App] Failed to start trace thread\n"));
+    }
+    MESH_GATEWAY_INFO(("[App] Footprint profile %s: %u of %u bytes RAM, %u of %u bytes KVStore\n", GATEWAY_FOOTPRINT_NAME,
+                       GATEWAY_FOOTPRINT_RAM, GATEWAY_FOOTPRINT_RAM_BUDGET, GATEWAY_FOOTPRINT_KVSTORE, GATEWAY_FOOTPRINT_KVSTORE_BUDGET));
 
     flash_button.fall(Callback<void()>(&btn_handler, &ButtonHandler::button_pressed));
     flash_button.rise(Callback<void()>(&btn_handler, &ButtonHandler::button_released));
 
-    MESH_GATEWAY_INFO(("[App] Press USER_BTN1 on the board to reset the Flash(Timeout in 5 Seconds...) >>\n"));
-
-    while(!btn_handler.is_button_pressed_and_released() && timeout < 5)
+    if (warm_boot)
+    {
+#if APP_CONFIG_SUPERVISOR
+        /* The supervisor restarted the gateway; nobody is waiting to press the button */
+        MESH_GATEWAY_INFO(("[App] Warm restart %lu (reason %u, thread %u), %u queued messages kept, %u lost\n",
+                           warmboot.restarts, warmboot.reason, warmboot.detail, warmboot.records, warmboot.dropped));
+        gateway_metrics_set(GATEWAY_GAUGE_WARM_RESTARTS, warmboot.restarts);
+#endif
+    }
+    else
     {
-        wait_us(1000 * 1000);
-        timeout += 1;
+        MESH_GATEWAY_INFO(("[App] Press USER_BTN1 on the board to reset the Flash(Timeout in 5 Seconds...) >>\n"));
+
+        while(!btn_handler.is_button_pressed_and_released() && timeout < 5)
+        {
+            wait_us(1000 * 1000);
+            timeout += 1;
+        }
     }
 
     if (btn_handler.is_button_pressed_and_released())
@@ -574,6 +1568,24 @@ int main(void)
         MESH_GATEWAY_INFO(("[App] Failed to register JSON Parser callback\n"));
         return -1;
     }
+#if APP_CONFIG_SENSOR_AGGREGATION
+    mesh_sensor_agg_init(publish_sensor_summary);
+#endif
+#if GATEWAY_LATENCY_ECHO_IN_ACK
+    gateway_latency_init(publish_latency_report);
+#endif
+#if APP_CONFIG_UPLINK_SPOOL
+    gateway_spool_init();
+#endif
+#if APP_CONFIG_UPLINK_BATCH
+    gateway_uplink_batch_init(publish_uplink_batch);
+#endif
+#if APP_CONFIG_NODE_TOPICS
+    if (gateway_topics_init(AWS_PUB_TOPIC_MESH_DATA_NODE, AWS_PUB_TOPIC_MESH_DATA) != CY_RSLT_SUCCESS)
+    {
+        MESH_GATEWAY_INFO(("[App] Per-node topic template too long, publishing on %s\n", AWS_PUB_TOPIC_MESH_DATA));
+    }
+#endif
 #endif
 
     ret = mesh_init_nvram_data();
@@ -582,6 +1594,12 @@ int main(void)
         MESH_GATEWAY_INFO(("[App] Error loading/initializing NVRAM data\n"));
         return -1;
     }
+#if APP_CONFIG_LOCAL_RULES
+    mesh_rules_init();
+#endif
+#if APP_CONFIG_STATE_HISTORY
+    gateway_history_init();
+#endif
 
     /* Get EmbeddedBLE singleton object */
     BLE& ble = BLE::Instance();
@@ -597,21 +1615,65 @@ int main(void)
 
     Mesh& mesh = ble.mesh();
 
-    MESH_GATEWAY_INFO(("mesh_dct_info.node_authenticated = %d ...\n", mesh_dct_info.node_authenticated));
-    if (mesh_dct_info.node_authenticated == MESH_NODE_PROVISIONED)
+    mesh_dct_t* mesh_dct = mesh_get_dct();
+    MESH_GATEWAY_INFO(("mesh_dct_info.node_authenticated = %d ...\n", mesh_dct->node_authenticated));
+    if (mesh_dct->node_authenticated == MESH_NODE_PROVISIONED)
     {
         MESH_GATEWAY_DEBUG("Write NVRam chunks to BLE Controller...\n");
         for(int i = 0; i < MESH_NV_DATA_MAX_ENTRIES ; i++)
         {
-            mesh.pushNVData( mesh_dct_info.mesh_nv_data[ i ].data, mesh_dct_info.mesh_nv_data[ i ].len, mesh_dct_info.mesh_nv_data[ i ].index );
+            mesh.pushNVData( mesh_dct->mesh_nv_data[ i ].data, mesh_dct->mesh_nv_data[ i ].len, mesh_dct->mesh_nv_data[ i ].index );
             /* TO DO : push nvm chunks with a delay */
             wait_us(100 * 1000);
         }
      }
+    /* From here on only the persistence thread needs it */
+    mesh_release_nvram_data();
 
     mesh.initialize();
+
+    gateway_thread_handlers_t handlers = { 0 };
+    handlers.net_poll = net_poll;
+#if APP_CONFIG_AWS_CLOUD
+    handlers.publish  = net_publish;
+#endif
+#if APP_CONFIG_DELIVERY_TRACKING
+#if APP_CONFIG_AWS_CLOUD
+    gateway_delivery_init(publish_delivery_report);
+#else
+    gateway_delivery_init(NULL);
+#endif
+#endif
+#if APP_CONFIG_DOWNLINK_FANOUT
+    gateway_fanout_init();
+#endif
+#if APP_CONFIG_PROXY_FILTER
+#if APP_CONFIG_LOCAL_RULES
+    gateway_proxy_filter_init(mesh_proxy_filter_changed, mesh_rules_get_sources);
+#else
+    gateway_proxy_filter_init(mesh_proxy_filter_changed, NULL);
+#endif
+#endif
+    handlers.mesh_tx_poll = mesh_tx_poll;
+#if APP_CONFIG_SUPERVISOR
+    if (warm_boot)
+    {
+        restore_queued_traffic();
+    }
+#endif
+    if (gateway_threads_start(&handlers) != CY_RSLT_SUCCESS)
+    {
+        MESH_GATEWAY_INFO(("[App] Failed to start worker threads\n"));
+        return -1;
+    }
+    /* Last, so that every module and thread the callback uses is ready */
     mesh.registerMeshEventcallback(mesh_event_callback);
 
-    do_main_loop();
+#if APP_CONFIG_SUPERVISOR
+    gateway_supervisor_run(retain_queued_traffic, warm_boot ? warmboot.restarts : 0);
+#else
+    gateway_threads_join();
+    gateway_alloc_checkpoint();
+#endif
     return 1;
 }
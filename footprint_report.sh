@@ -0,0 +1,49 @@
+#!/bin/sh
+#
+# Copyright 2020 Cypress Semiconductor Corporation
+# SPDX-License-Identifier: Apache-2.0
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Builds the gateway once for every footprint profile and writes the RAM and
+# flash used per module, as reported by mbed compile --stats-depth, to
+# BUILD/footprint/<profile>.txt. The totals of all profiles are printed last.
+#
+# Usage: ./footprint_report.sh [target] [toolchain] [stats depth]
+
+TARGET=${1:-CY8CKIT_062S2_43012}
+TOOLCHAIN=${2:-GCC_ARM}
+DEPTH=${3:-2}
+OUT=BUILD/footprint
+
+mkdir -p "$OUT" || exit 1
+
+for PROFILE in SMALL BALANCED HIGH_THROUGHPUT
+do
+    NAME=$(echo "$PROFILE" | tr 'A-Z' 'a-z')
+    echo "Building the $NAME profile"
+    if ! mbed compile -m "$TARGET" -t "$TOOLCHAIN" -D APP_CONFIG_FOOTPRINT_PROFILE=GATEWAY_FOOTPRINT_$PROFILE \
+         --stats-depth "$DEPTH" --build "$OUT/$NAME" > "$OUT/$NAME.txt" 2>&1
+    then
+        cat "$OUT/$NAME.txt"
+        echo "The $NAME profile failed to build"
+        exit 1
+    fi
+done
+
+for PROFILE in SMALL BALANCED HIGH_THROUGHPUT
+do
+    NAME=$(echo "$PROFILE" | tr 'A-Z' 'a-z')
+    echo "$NAME:"
+    grep -E "Total (Static RAM|Flash) memory" "$OUT/$NAME.txt"
+done
@@ -0,0 +1,322 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway allocation tracking implementation
+ */
+
+#include "mbed.h"
+
+#include "gateway_alloc.h"
+
+#define GATEWAY_ALLOC_MAGIC     (0xA10C)
+
+/* Keeps the 8 byte alignment of the pool blocks */
+typedef struct
+{
+    uint16_t    magic;
+    uint8_t     tag;
+    uint8_t     pool;
+    uint32_t    size;
+} alloc_header_t;
+
+MBED_STATIC_ASSERT(sizeof(alloc_header_t) == 8, "alloc_header_t must keep block alignment");
+MBED_STATIC_ASSERT(GATEWAY_POOL_SMALL_BLOCK_SIZE < GATEWAY_POOL_MEDIUM_BLOCK_SIZE &&
+                   GATEWAY_POOL_MEDIUM_BLOCK_SIZE < GATEWAY_POOL_LARGE_BLOCK_SIZE, "pool block sizes must be ascending");
+
+#define POOL_BLOCK_WORDS(size)  (((size) + sizeof(alloc_header_t) + 7) / 8)
+
+typedef struct { uint64_t words[POOL_BLOCK_WORDS(GATEWAY_POOL_SMALL_BLOCK_SIZE)]; } small_block_t;
+typedef struct { uint64_t words[POOL_BLOCK_WORDS(GATEWAY_POOL_MEDIUM_BLOCK_SIZE)]; } medium_block_t;
+typedef struct { uint64_t words[POOL_BLOCK_WORDS(GATEWAY_POOL_LARGE_BLOCK_SIZE)]; } large_block_t;
+
+static MemoryPool<small_block_t, GATEWAY_POOL_SMALL_BLOCK_COUNT> small_pool;
+static MemoryPool<medium_block_t, GATEWAY_POOL_MEDIUM_BLOCK_COUNT> medium_pool;
+static MemoryPool<large_block_t, GATEWAY_POOL_LARGE_BLOCK_COUNT> large_pool;
+
+static gateway_pool_stats_t pool_stats[GATEWAY_POOL_MAX] =
+{
+    { GATEWAY_POOL_SMALL_BLOCK_SIZE,  GATEWAY_POOL_SMALL_BLOCK_COUNT,  0, 0, 0 },
+    { GATEWAY_POOL_MEDIUM_BLOCK_SIZE, GATEWAY_POOL_MEDIUM_BLOCK_COUNT, 0, 0, 0 },
+    { GATEWAY_POOL_LARGE_BLOCK_SIZE,  GATEWAY_POOL_LARGE_BLOCK_COUNT,  0, 0, 0 },
+};
+
+static const char* tag_names[GATEWAY_ALLOC_TAG_MAX] =
+{
+    "uplink_packet",
+    "uplink_text",
+    "downlink_value",
+    "downlink_reversed",
+    "http_response",
+};
+
+static gateway_alloc_stats_t tag_stats[GATEWAY_ALLOC_TAG_MAX];
+static uint32_t live_bytes = 0;
+static uint32_t peak_bytes = 0;
+
+/* Leak heuristics, only touched while reporting */
+static uint32_t reported_live_count[GATEWAY_ALLOC_TAG_MAX];
+static uint8_t growth_reports[GATEWAY_ALLOC_TAG_MAX];
+static uint32_t reported_allocs = 0;
+static uint64_t reported_ms = 0;
+static Mutex report_mutex;
+
+static void* pool_alloc(uint32_t pool)
+{
+    switch (pool)
+    {
+        case GATEWAY_POOL_SMALL:
+            return small_pool.alloc();
+        case GATEWAY_POOL_MEDIUM:
+            return medium_pool.alloc();
+        case GATEWAY_POOL_LARGE:
+            return large_pool.alloc();
+    }
+    return NULL;
+}
+
+static void pool_free(uint32_t pool, void* block)
+{
+    switch (pool)
+    {
+        case GATEWAY_POOL_SMALL:
+            small_pool.free((small_block_t*)block);
+            break;
+        case GATEWAY_POOL_MEDIUM:
+            medium_pool.free((medium_block_t*)block);
+            break;
+        case GATEWAY_POOL_LARGE:
+            large_pool.free((large_block_t*)block);
+            break;
+    }
+}
+
+void* gateway_malloc(gateway_alloc_tag_t tag, size_t size)
+{
+    alloc_header_t* header = NULL;
+    uint32_t pool;
+
+    if (tag >= GATEWAY_ALLOC_TAG_MAX)
+    {
+        return NULL;
+    }
+
+    for (pool = 0; pool < GATEWAY_POOL_MAX; pool++)
+    {
+        if (size > pool_stats[pool].block_size)
+        {
+            continue;
+        }
+        header = (alloc_header_t*)pool_alloc(pool);
+        if (header)
+        {
+            break;
+        }
+        core_util_critical_section_enter();
+        pool_stats[pool].exhausted++;
+        core_util_critical_section_exit();
+    }
+
+    core_util_critical_section_enter();
+    if (!header)
+    {
+        tag_stats[tag].failures++;
+        core_util_critical_section_exit();
+        return NULL;
+    }
+    pool_stats[pool].in_use++;
+    if (pool_stats[pool].in_use > pool_stats[pool].peak)
+    {
+        pool_stats[pool].peak = pool_stats[pool].in_use;
+    }
+    tag_stats[tag].allocs++;
+    tag_stats[tag].live_count++;
+    tag_stats[tag].live_bytes += size;
+    if (tag_stats[tag].live_bytes > tag_stats[tag].peak_bytes)
+    {
+        tag_stats[tag].peak_bytes = tag_stats[tag].live_bytes;
+    }
+    live_bytes += size;
+    if (live_bytes > peak_bytes)
+    {
+        peak_bytes = live_bytes;
+    }
+    core_util_critical_section_exit();
+
+    header->magic = GATEWAY_ALLOC_MAGIC;
+    header->tag   = (uint8_t)tag;
+    header->pool  = (uint8_t)pool;
+    header->size  = (uint32_t)size;
+    return header + 1;
+}
+
+void gateway_free(void* ptr)
+{
+    alloc_header_t* header;
+
+    if (!ptr)
+    {
+        return;
+    }
+
+    header = (alloc_header_t*)ptr - 1;
+    MBED_ASSERT(header->magic == GATEWAY_ALLOC_MAGIC && header->tag < GATEWAY_ALLOC_TAG_MAX && header->pool < GATEWAY_POOL_MAX);
+
+    core_util_critical_section_enter();
+    tag_stats[header->tag].live_count--;
+    tag_stats[header->tag].live_bytes -= header->size;
+    live_bytes -= header->size;
+    pool_stats[header->pool].in_use--;
+    core_util_critical_section_exit();
+
+    header->magic = 0;
+    pool_free(header->pool, header);
+}
+
+void gateway_alloc_get_stats(gateway_alloc_tag_t tag, gateway_alloc_stats_t* stats)
+{
+    if (tag >= GATEWAY_ALLOC_TAG_MAX || !stats)
+    {
+        return;
+    }
+    core_util_critical_section_enter();
+    memcpy(stats, &tag_stats[tag], sizeof(gateway_alloc_stats_t));
+    core_util_critical_section_exit();
+}
+
+void gateway_alloc_get_pool_stats(gateway_pool_class_t pool, gateway_pool_stats_t* stats)
+{
+    if (pool >= GATEWAY_POOL_MAX || !stats)
+    {
+        return;
+    }
+    core_util_critical_section_enter();
+    memcpy(stats, &pool_stats[pool], sizeof(gateway_pool_stats_t));
+    core_util_critical_section_exit();
+}
+
+uint32_t gateway_alloc_checkpoint(void)
+{
+    gateway_alloc_stats_t stats[GATEWAY_ALLOC_TAG_MAX];
+    uint32_t live_blocks = 0;
+    uint32_t i;
+
+    core_util_critical_section_enter();
+    memcpy(stats, tag_stats, sizeof(stats));
+    for (i = 0; i < GATEWAY_POOL_MAX; i++)
+    {
+        live_blocks += pool_stats[i].in_use;
+    }
+    core_util_critical_section_exit();
+
+    for (i = 0; i < GATEWAY_ALLOC_TAG_MAX; i++)
+    {
+        if (stats[i].live_count > 0)
+        {
+            printf("[Alloc] Leak: %lu %s block(s), %lu bytes\n", (unsigned long)stats[i].live_count,
+                   tag_names[i], (unsigned long)stats[i].live_bytes);
+        }
+    }
+#if GATEWAY_ALLOC_STRICT
+    MBED_ASSERT(live_blocks == 0);
+#endif
+
+    return live_blocks;
+}
+
+uint32_t gateway_alloc_report_to_json(char* buffer, uint32_t buffer_len)
+{
+    gateway_alloc_stats_t stats[GATEWAY_ALLOC_TAG_MAX];
+    gateway_pool_stats_t pools[GATEWAY_POOL_MAX];
+    uint32_t total_allocs = 0;
+    uint32_t current_live;
+    uint32_t current_peak;
+    uint32_t allocs_per_sec = 0;
+    uint64_t now = Kernel::get_ms_count();
+    uint32_t written;
+    uint32_t i;
+    int ret;
+
+    if (!buffer || buffer_len == 0)
+    {
+        return 0;
+    }
+
+    core_util_critical_section_enter();
+    memcpy(stats, tag_stats, sizeof(stats));
+    memcpy(pools, pool_stats, sizeof(pools));
+    current_live = live_bytes;
+    current_peak = peak_bytes;
+    core_util_critical_section_exit();
+
+    for (i = 0; i < GATEWAY_ALLOC_TAG_MAX; i++)
+    {
+        total_allocs += stats[i].allocs;
+    }
+
+    report_mutex.lock();
+    if (now > reported_ms)
+    {
+        allocs_per_sec = (uint32_t)(((uint64_t)(total_allocs - reported_allocs) * 1000) / (now - reported_ms));
+    }
+    reported_allocs = total_allocs;
+    reported_ms = now;
+
+    ret = snprintf(buffer, buffer_len, "{\"live_bytes\":%lu,\"peak_bytes\":%lu,\"allocs_per_sec\":%lu,\"tags\":[",
+                   (unsigned long)current_live, (unsigned long)current_peak, (unsigned long)allocs_per_sec);
+    written = (ret < 0) ? buffer_len : ret;
+
+    for (i = 0; i < GATEWAY_ALLOC_TAG_MAX && written < buffer_len; i++)
+    {
+        if (stats[i].live_count > 0 && stats[i].live_count > reported_live_count[i])
+        {
+            growth_reports[i] = (growth_reports[i] < GATEWAY_ALLOC_LEAK_REPORTS) ? growth_reports[i] + 1 : growth_reports[i];
+        }
+        else if (stats[i].live_count == 0)
+        {
+            growth_reports[i] = 0;
+        }
+        reported_live_count[i] = stats[i].live_count;
+
+        ret = snprintf(buffer + written, buffer_len - written,
+                       "%s{\"tag\":\"%s\",\"live\":%lu,\"live_bytes\":%lu,\"peak_bytes\":%lu,\"allocs\":%lu,\"failures\":%lu,\"suspected_leak\":%s}",
+                       (i > 0) ? "," : "", tag_names[i],
+                       (unsigned long)stats[i].live_count, (unsigned long)stats[i].live_bytes, (unsigned long)stats[i].peak_bytes,
+                       (unsigned long)stats[i].allocs, (unsigned long)stats[i].failures,
+                       (growth_reports[i] >= GATEWAY_ALLOC_LEAK_REPORTS) ? "true" : "false");
+        written = (ret < 0) ? buffer_len : written + ret;
+    }
+    report_mutex.unlock();
+
+    for (i = 0; i < GATEWAY_POOL_MAX && written < buffer_len; i++)
+    {
+        ret = snprintf(buffer + written, buffer_len - written,
+                       "%s{\"block_size\":%lu,\"blocks\":%lu,\"in_use\":%lu,\"peak\":%lu,\"exhausted\":%lu}",
+                       (i > 0) ? "," : "],\"pools\":[",
+                       (unsigned long)pools[i].block_size, (unsigned long)pools[i].block_count, (unsigned long)pools[i].in_use,
+                       (unsigned long)pools[i].peak, (unsigned long)pools[i].exhausted);
+        written = (ret < 0) ? buffer_len : written + ret;
+    }
+
+    if (written + 3 > buffer_len)
+    {
+        return 0;
+    }
+    written += snprintf(buffer + written, buffer_len - written, "]}");
+
+    return written;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway allocation tracking
+ *
+ * Packet buffers are taken from fixed-block pools in three size classes
+ * instead of the heap, so that TLS and the packet paths cannot fragment each
+ * other. Allocation and free are O(1) and may be called from interrupts. A
+ * request that does not fit its class while the class is exhausted moves up to
+ * the next larger class; each class counts how often it ran out.
+ *
+ * Every allocation carries a call-site tag with live, peak and total figures.
+ * A tag whose live allocation count grows across GATEWAY_ALLOC_LEAK_REPORTS
+ * consecutive reports is flagged as a suspected leak. At a checkpoint where no
+ * packet is in flight, such as shutdown, every block must be free again;
+ * builds with GATEWAY_ALLOC_STRICT stop there on any leak.
+ *
+ * Block sizes are set in mbed_app.json, block counts by the footprint profile.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cy_result_mw.h"
+#include "gateway_footprint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GATEWAY_ALLOC_LEAK_REPORTS      (3)
+#define GATEWAY_POOL_SMALL_BLOCK_COUNT  (GATEWAY_FOOTPRINT_POOL_SMALL_BLOCKS)
+#define GATEWAY_POOL_MEDIUM_BLOCK_COUNT (GATEWAY_FOOTPRINT_POOL_MEDIUM_BLOCKS)
+#define GATEWAY_POOL_LARGE_BLOCK_COUNT  (GATEWAY_FOOTPRINT_POOL_LARGE_BLOCKS)
+
+/* On by default in debug builds; can also be set in mbed_app.json */
+#ifndef GATEWAY_ALLOC_STRICT
+#ifdef MBED_DEBUG
+#define GATEWAY_ALLOC_STRICT            (1)
+#else
+#define GATEWAY_ALLOC_STRICT            (0)
+#endif
+#endif
+#define GATEWAY_ALLOC_JSON_SIZE         (1536)
+
+typedef enum
+{
+    GATEWAY_ALLOC_TAG_UPLINK_PACKET,
+    GATEWAY_ALLOC_TAG_UPLINK_TEXT,
+    GATEWAY_ALLOC_TAG_DOWNLINK_VALUE,
+    GATEWAY_ALLOC_TAG_DOWNLINK_REVERSED,
+    GATEWAY_ALLOC_TAG_HTTP_RESPONSE,
+    GATEWAY_ALLOC_TAG_MAX
+} gateway_alloc_tag_t;
+
+typedef enum
+{
+    GATEWAY_POOL_SMALL,
+    GATEWAY_POOL_MEDIUM,
+    GATEWAY_POOL_LARGE,
+    GATEWAY_POOL_MAX
+} gateway_pool_class_t;
+
+typedef struct
+{
+    uint32_t    live_count;
+    uint32_t    live_bytes;
+    uint32_t    peak_bytes;
+    uint32_t    allocs;
+    uint32_t    failures;
+} gateway_alloc_stats_t;
+
+typedef struct
+{
+    uint32_t    block_size;
+    uint32_t    block_count;
+    uint32_t    in_use;
+    uint32_t    peak;
+    uint32_t    exhausted;
+} gateway_pool_stats_t;
+
+void* gateway_malloc(gateway_alloc_tag_t tag, size_t size);
+void gateway_free(void* ptr);
+
+void gateway_alloc_get_stats(gateway_alloc_tag_t tag, gateway_alloc_stats_t* stats);
+void gateway_alloc_get_pool_stats(gateway_pool_class_t pool, gateway_pool_stats_t* stats);
+
+/* Checks that every pool block has been freed. Returns the number of blocks still allocated;
+ * with GATEWAY_ALLOC_STRICT, asserts that there are none. */
+uint32_t gateway_alloc_checkpoint(void);
+
+/* Renders the per-tag report as JSON and updates the leak heuristics. Returns the length written. */
+uint32_t gateway_alloc_report_to_json(char* buffer, uint32_t buffer_len);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
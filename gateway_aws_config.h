@@ -40,6 +40,119 @@
  */
 #define AWS_SUB_TOPIC_MESH_DATA             "mesh_data"
 
+/* Template of the per-node topics on which the Gateway publishes the Mesh data
+ * of each node (APP_CONFIG_NODE_TOPICS). It takes the source address of the
+ * packet, e.g. "proxy_data/0002", and must expand to at most GATEWAY_TOPIC_MAX
+ * characters.
+ */
+#define AWS_PUB_TOPIC_MESH_DATA_NODE        AWS_PUB_TOPIC_MESH_DATA "/%04X"
+
+/* AWS Topic filter on which the Gateway receives Mesh data for one node
+ * (APP_CONFIG_NODE_TOPICS), e.g. on "mesh_data/0002". Commands whose
+ * destination is not the node in the topic are rejected.
+ */
+#define AWS_SUB_TOPIC_MESH_DATA_NODE        AWS_SUB_TOPIC_MESH_DATA "/+"
+
+/* AWS Topic on which the Gateway publishes the decoded form of the Mesh data
+ * it understands (APP_CONFIG_UPLINK_DECODE), next to the raw packet on
+ * AWS_PUB_TOPIC_MESH_DATA. See gateway_mesh_decode.h for the format.
+ */
+#define AWS_PUB_TOPIC_MESH_DECODED          "proxy_decoded"
+
+/* AWS Topic on which the Gateway acknowledges downlink commands received on
+ * AWS_SUB_TOPIC_MESH_DATA, e.g. with the latency breakdown of each command
+ * and, for acknowledged messages, whether the node answered ("result").
+ */
+#define AWS_PUB_TOPIC_MESH_ACK              "proxy_data_ack"
+
+/* AWS Topic on which the Gateway receives the trace level to use, as a
+ * single digit from 0 (off) to 4 (debug).
+ */
+#define AWS_SUB_TOPIC_TRACE_LEVEL           "gateway_trace_level"
+
+/* AWS Topic on which the Gateway publishes the cached state of a node
+ * whenever it changes, or when requested on AWS_SUB_TOPIC_MESH_STATE.
+ */
+#define AWS_PUB_TOPIC_MESH_STATE            "proxy_state"
+
+/* AWS Topic on which the Gateway receives node state queries. The payload
+ * is the node address in hex (e.g. "0002"), answered from the state cache.
+ */
+#define AWS_SUB_TOPIC_MESH_STATE            "proxy_state_request"
+
+/* AWS Topic on which the Gateway receives "publish only on change" settings
+ * for a node, as "<node address in hex>,<0|1>". Address FFFF applies to all nodes.
+ * Only subscribed with the node state cache (APP_CONFIG_NODE_STATE_CACHE).
+ */
+#define AWS_SUB_TOPIC_UPLINK_FILTER         "proxy_filter_request"
+
+/* AWS Topic on which the Gateway publishes one summary per sensor property
+ * and aggregation window.
+ */
+#define AWS_PUB_TOPIC_SENSOR_SUMMARY        "proxy_sensor_summary"
+
+/* AWS Topic on which the Gateway receives raw pass-through settings for the
+ * sensor readings of a node, as "<node address in hex>,<0|1>" (1 = raw).
+ */
+#define AWS_SUB_TOPIC_SENSOR_CONFIG         "proxy_sensor_request"
+
+/* AWS Topic on which the Gateway periodically publishes its runtime metrics */
+#define AWS_PUB_TOPIC_GATEWAY_STATS         "gateway_stats"
+
+/* AWS Topic on which the Gateway receives heap report requests (any payload) */
+#define AWS_SUB_TOPIC_GATEWAY_HEAP          "gateway_heap_request"
+
+/* AWS Topic on which the Gateway publishes the per call-site heap report */
+#define AWS_PUB_TOPIC_GATEWAY_HEAP          "gateway_heap"
+
+/* AWS Topic on which the Gateway receives local rule updates, as
+ * "<source address>,<opcode>,<hex proxy packet>[,<hex proxy packet>...]"
+ * (all hex) to add or replace a rule and "<source address>,<opcode>" to
+ * remove it. An empty payload only requests the rule list.
+ */
+#define AWS_SUB_TOPIC_GATEWAY_RULES         "gateway_rules_request"
+
+/* AWS Topic on which the Gateway publishes its local rules after every request */
+#define AWS_PUB_TOPIC_GATEWAY_RULES         "gateway_rules"
+
+/* AWS Topic on which the Gateway receives fan-out group updates, as
+ * "<group address>,<member>,<member>,..." (all hex) to add or replace a
+ * group and "<group address>" to remove it. An empty payload only requests
+ * the group list.
+ */
+#define AWS_SUB_TOPIC_GATEWAY_GROUPS        "gateway_groups_request"
+
+/* AWS Topic on which the Gateway publishes its fan-out groups after every request */
+#define AWS_PUB_TOPIC_GATEWAY_GROUPS        "gateway_groups"
+
+/* AWS Topic on which the Gateway receives the node addresses of interest for
+ * the proxy filter, as "<addr>,<addr>,..." (all hex), replacing the previous
+ * list. "0000" clears the list; an empty payload only requests it.
+ */
+#define AWS_SUB_TOPIC_PROXY_NODES           "proxy_nodes_request"
+
+/* AWS Topic on which the Gateway publishes the proxy filter after every request */
+#define AWS_PUB_TOPIC_PROXY_NODES           "proxy_nodes"
+
+/* AWS Topic on which the Gateway publishes the proxy filter it wants whenever
+ * that changes, as "<addr>,<addr>,..." (all hex) for an accept list or "0000"
+ * for the default filter. The proxy configuration messages need the network
+ * key, so the cloud sends them to the proxy node as mesh data.
+ */
+#define AWS_PUB_TOPIC_PROXY_FILTER          "proxy_nodes_filter"
+
+/* AWS Topic on which the Gateway publishes the node state changes recorded
+ * while AWS was unreachable, as a JSON array of history records, once the
+ * connection is back.
+ */
+#define AWS_PUB_TOPIC_MESH_HISTORY          "proxy_history"
+
+/* AWS Topic on which the Gateway publishes batched uplink frames
+ * (APP_CONFIG_UPLINK_BATCH); the frame format is described in
+ * gateway_uplink_batch.h.
+ */
+#define AWS_PUB_TOPIC_MESH_DATA_BATCH       "proxy_data_batch"
+
 /* User can set the AWS credentials using below macros.
  * By default, Don't use these default credentials. These exist
  * to quickly try the application, debugging, running tests etc.
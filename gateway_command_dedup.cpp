@@ -0,0 +1,141 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway downlink command de-duplication implementation
+ */
+
+#include "mbed.h"
+
+#include "gateway_command_dedup.h"
+#include "gateway_metrics.h"
+
+MBED_STATIC_ASSERT((GATEWAY_COMMAND_DEDUP_SLOTS & (GATEWAY_COMMAND_DEDUP_SLOTS - 1)) == 0, "GATEWAY_COMMAND_DEDUP_SLOTS must be a power of two");
+
+typedef struct
+{
+    uint32_t    hash;
+    uint32_t    seen_ms;
+    uint8_t     id_len;
+    char        id[GATEWAY_LATENCY_ID_MAX_LEN];
+} command_id_entry_t;
+
+static command_id_entry_t command_ids[GATEWAY_COMMAND_DEDUP_SLOTS];
+
+MBED_STATIC_ASSERT(sizeof(command_id_entry_t) <= GATEWAY_FOOTPRINT_COMMAND_DEDUP_ENTRY, "A command ID slot exceeds its size in the footprint profile");
+MBED_STATIC_ASSERT(sizeof(command_ids) <= GATEWAY_FOOTPRINT_COMMAND_DEDUP_RAM, "Command ID slots exceed their share of the footprint profile");
+
+static Mutex command_ids_mutex;
+
+/* FNV-1a */
+static uint32_t id_hash(const char* id, uint32_t id_len)
+{
+    uint32_t hash = 2166136261u;
+    uint32_t i;
+
+    for (i = 0; i < id_len; i++)
+    {
+        hash ^= (uint8_t)id[i];
+        hash *= 16777619u;
+    }
+    /* 0 marks an empty slot */
+    return (hash == 0) ? 1 : hash;
+}
+
+bool gateway_command_dedup_is_duplicate(const char* id, uint32_t id_len)
+{
+    uint32_t now = (uint32_t)Kernel::get_ms_count();
+    command_id_entry_t* victim = NULL;
+    bool victim_expired = false;
+    uint32_t hash;
+    uint32_t slot;
+    uint32_t i;
+
+    if (!id || id_len == 0)
+    {
+        return false;
+    }
+    /* IDs are compared as far as the latency trace keeps them */
+    id_len = (id_len > GATEWAY_LATENCY_ID_MAX_LEN) ? GATEWAY_LATENCY_ID_MAX_LEN : id_len;
+    hash = id_hash(id, id_len);
+    slot = hash & (GATEWAY_COMMAND_DEDUP_SLOTS - 1);
+
+    command_ids_mutex.lock();
+    for (i = 0; i < GATEWAY_COMMAND_DEDUP_PROBES; i++)
+    {
+        command_id_entry_t* entry = &command_ids[(slot + i) & (GATEWAY_COMMAND_DEDUP_SLOTS - 1)];
+        bool expired = (entry->hash == 0) || (now - entry->seen_ms >= GATEWAY_COMMAND_DEDUP_TTL_MSEC);
+
+        if (!expired && entry->hash == hash && entry->id_len == id_len && memcmp(entry->id, id, id_len) == 0)
+        {
+            command_ids_mutex.unlock();
+            gateway_metrics_increment(GATEWAY_COUNTER_COMMAND_DUPLICATES, 1);
+            return true;
+        }
+
+        /* Reuse an expired slot, otherwise evict the oldest one in the probe sequence */
+        if (victim_expired)
+        {
+            continue;
+        }
+        if (expired || !victim || (now - entry->seen_ms) > (now - victim->seen_ms))
+        {
+            victim = entry;
+            victim_expired = expired;
+        }
+    }
+
+    if (!victim_expired)
+    {
+        gateway_metrics_increment(GATEWAY_COUNTER_COMMAND_DEDUP_EVICTIONS, 1);
+    }
+    victim->hash    = hash;
+    victim->seen_ms = now;
+    victim->id_len  = (uint8_t)id_len;
+    memcpy(victim->id, id, id_len);
+    command_ids_mutex.unlock();
+
+    return false;
+}
+
+void gateway_command_dedup_forget(const char* id, uint32_t id_len)
+{
+    uint32_t hash;
+    uint32_t slot;
+    uint32_t i;
+
+    if (!id || id_len == 0)
+    {
+        return;
+    }
+    id_len = (id_len > GATEWAY_LATENCY_ID_MAX_LEN) ? GATEWAY_LATENCY_ID_MAX_LEN : id_len;
+    hash = id_hash(id, id_len);
+    slot = hash & (GATEWAY_COMMAND_DEDUP_SLOTS - 1);
+
+    command_ids_mutex.lock();
+    for (i = 0; i < GATEWAY_COMMAND_DEDUP_PROBES; i++)
+    {
+        command_id_entry_t* entry = &command_ids[(slot + i) & (GATEWAY_COMMAND_DEDUP_SLOTS - 1)];
+
+        if (entry->hash == hash && entry->id_len == id_len && memcmp(entry->id, id, id_len) == 0)
+        {
+            entry->hash = 0;
+            break;
+        }
+    }
+    command_ids_mutex.unlock();
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway downlink command de-duplication
+ *
+ * Remembers the IDs of recently received downlink commands so that a command
+ * delivered twice, e.g. redelivered by the broker after a reconnect or
+ * retried by an HTTP client, is sent to the mesh only once. An ID is
+ * remembered for GATEWAY_COMMAND_DEDUP_TTL_MSEC in a fixed table of
+ * GATEWAY_COMMAND_DEDUP_SLOTS entries; when the probed slots are all in use
+ * the oldest ID is forgotten first. Commands without an ID are never dropped.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+#include "gateway_latency.h"
+#include "gateway_footprint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Must be a power of two */
+#define GATEWAY_COMMAND_DEDUP_SLOTS         (GATEWAY_FOOTPRINT_COMMAND_DEDUP_SLOTS)
+#define GATEWAY_COMMAND_DEDUP_PROBES        (4)
+/* Covers a redelivery after the longest reconnect backoff */
+#define GATEWAY_COMMAND_DEDUP_TTL_MSEC      (120000)
+
+/* Returns true if 'id' was seen within the TTL; otherwise remembers it */
+bool gateway_command_dedup_is_duplicate(const char* id, uint32_t id_len);
+
+/* Forgets 'id' again, so that a command that could not be queued is accepted when retried */
+void gateway_command_dedup_forget(const char* id, uint32_t id_len);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
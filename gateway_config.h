@@ -16,10 +16,99 @@
  */
 #pragma once
 
+// Sizes of the tables, rings and queues: GATEWAY_FOOTPRINT_SMALL,
+// GATEWAY_FOOTPRINT_BALANCED or GATEWAY_FOOTPRINT_HIGH_THROUGHPUT (see
+// gateway_footprint.h); can also be set on the command line
+#ifndef APP_CONFIG_FOOTPRINT_PROFILE
+#define APP_CONFIG_FOOTPRINT_PROFILE GATEWAY_FOOTPRINT_BALANCED
+#endif
+
 // Note : currently user can enable only one transport
 #define APP_CONFIG_AWS_CLOUD 1
 // #define APP_CONFIG_HTTP_SERVER 1
 
+// The mesh controller hands over network PDUs with a deobfuscated header and
+// a decrypted access payload. The features marked "needs decrypted PDUs" read
+// the source, destination and opcode of a PDU, which are otherwise obfuscated
+// or encrypted. No library in this tree does that: the bluetooth-gateway
+// library passes the PDUs on unchanged.
+#define APP_CONFIG_MESH_PDU_DECRYPTED 0
+
+// Cache the last known state of every node for local queries (needs decrypted PDUs)
+#define APP_CONFIG_NODE_STATE_CACHE 0
+
+// Drop mesh retransmissions and, per node, status messages that carry no change.
+// "Publish only on change" and its "proxy_filter_request" topic need
+// APP_CONFIG_NODE_STATE_CACHE and are left out without it
+#define APP_CONFIG_UPLINK_FILTER 1
+
+// Publish windowed min/max/mean/count summaries of sensor readings instead of
+// every Sensor Status (AWS cloud only, needs decrypted PDUs)
+#define APP_CONFIG_SENSOR_AGGREGATION 0
+
+// Keep messages that could not be published while AWS is unreachable (RAM,
+// overflowing into KVStore) and send them once it is back (AWS cloud only)
+#define APP_CONFIG_UPLINK_SPOOL 1
+
+// Publish uplink data on a topic per node ("proxy_data/<addr>") and accept
+// downlink data for one node on "mesh_data/<addr>" (AWS cloud only, needs
+// decrypted PDUs). Subscribers of "proxy_data" no longer receive the data,
+// so it is off by default.
+#define APP_CONFIG_NODE_TOPICS 0
+
+// Run local automation rules (uplink source/opcode -> downlink packet) on the
+// gateway, without a cloud round trip (needs decrypted PDUs)
+#define APP_CONFIG_LOCAL_RULES 0
+
+// Track acknowledged downlink commands until the node's status arrives and
+// report them delivered, or failed after an adaptive timeout
+// (needs decrypted PDUs)
+#define APP_CONFIG_DELIVERY_TRACKING 0
+
+// Drop downlink commands whose "id" was already received recently, e.g. MQTT
+// redeliveries after a reconnect or repeated HTTP requests
+#define APP_CONFIG_COMMAND_DEDUP 1
+
+// Also publish common SIG model messages (Generic OnOff/Level, Light
+// Lightness/CTL/HSL, Sensor Status) as decoded records (AWS cloud only, needs
+// decrypted PDUs)
+#define APP_CONFIG_UPLINK_DECODE 0
+
+// Track the latency and delivery of a group command for each member of the
+// configured group (needs decrypted PDUs)
+#define APP_CONFIG_DOWNLINK_FANOUT 0
+
+// Reassemble segmented proxy PDUs, so that each proxy message is handled
+// and published once
+#define APP_CONFIG_PROXY_SAR 1
+
+// Work out a proxy filter limited to the nodes of interest once these are
+// configured and report it to the cloud, which applies it, so that other
+// traffic stays off the BLE link (needs decrypted PDUs)
+#define APP_CONFIG_PROXY_FILTER 0
+
+// Keep a compact history of node state changes (RAM, overflowing into
+// KVStore), queryable over HTTP and sent to AWS after an outage (needs
+// decrypted PDUs)
+#define APP_CONFIG_STATE_HISTORY 0
+
+// Publish uplink packets in batched, LZ4 compressed binary frames on
+// "proxy_data_batch" instead of one message per packet (AWS cloud only).
+// Changes what the cloud receives, so it is off by default.
+#define APP_CONFIG_UPLINK_BATCH 0
+
+// Supervise the worker threads with heartbeats and the hardware watchdog;
+// when one stops or hangs, restart quickly (no reset-flash button window)
+// and keep the queued uplink/downlink messages in RAM over the reset
+#define APP_CONFIG_SUPERVISOR 1
+
+#if !APP_CONFIG_MESH_PDU_DECRYPTED && (APP_CONFIG_NODE_STATE_CACHE ||                              \
+    APP_CONFIG_SENSOR_AGGREGATION || APP_CONFIG_NODE_TOPICS || APP_CONFIG_LOCAL_RULES ||           \
+    APP_CONFIG_DELIVERY_TRACKING || APP_CONFIG_UPLINK_DECODE || APP_CONFIG_DOWNLINK_FANOUT ||      \
+    APP_CONFIG_PROXY_FILTER || APP_CONFIG_STATE_HISTORY)
+#error "Enabled features need APP_CONFIG_MESH_PDU_DECRYPTED"
+#endif
+
 #ifdef APP_CONFIG_AWS_CLOUD
 #include "gateway_aws_config.h"
 #endif
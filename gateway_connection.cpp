@@ -0,0 +1,130 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway cloud connection manager implementation
+ */
+
+#include "mbed.h"
+
+#include "gateway_connection.h"
+#include "gateway_idle.h"
+#include "gateway_metrics.h"
+#include "gateway_trace.h"
+
+static gateway_connection_handlers_t connection_handlers;
+static bool connection_up = false;
+static uint32_t connection_attempts = 0;
+static uint64_t connection_lost_ms = 0;
+static uint64_t next_attempt_ms = 0;
+static uint32_t jitter_state = 0;
+
+static uint32_t next_random(void)
+{
+    /* xorshift32, seeded from the microsecond ticker */
+    if (jitter_state == 0)
+    {
+        jitter_state = us_ticker_read() | 1;
+    }
+    jitter_state ^= jitter_state << 13;
+    jitter_state ^= jitter_state >> 17;
+    jitter_state ^= jitter_state << 5;
+    return jitter_state;
+}
+
+static uint32_t backoff_delay_ms(uint32_t attempt)
+{
+    uint32_t delay = GATEWAY_RECONNECT_MAX_MSEC;
+
+    if (attempt < 16 && (GATEWAY_RECONNECT_BASE_MSEC << attempt) < GATEWAY_RECONNECT_MAX_MSEC)
+    {
+        delay = GATEWAY_RECONNECT_BASE_MSEC << attempt;
+    }
+    return (delay / 2) + (next_random() % (delay / 2 + 1));
+}
+
+void gateway_connection_init(const gateway_connection_handlers_t* handlers, bool connected)
+{
+    if (handlers)
+    {
+        connection_handlers = *handlers;
+    }
+    connection_up = connected;
+    connection_attempts = 0;
+    connection_lost_ms = Kernel::get_ms_count();
+    next_attempt_ms = connection_lost_ms;
+}
+
+bool gateway_connection_is_up(void)
+{
+    return connection_up;
+}
+
+void gateway_connection_lost(void)
+{
+    if (!connection_up)
+    {
+        return;
+    }
+    connection_up = false;
+    connection_attempts = 0;
+    connection_lost_ms = Kernel::get_ms_count();
+    /* The first attempt goes out right away; most drops are a single hiccup */
+    next_attempt_ms = connection_lost_ms;
+    MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_WARN, "[App] Cloud connection lost\n");
+}
+
+bool gateway_connection_poll(void)
+{
+    uint64_t now = Kernel::get_ms_count();
+
+    if (connection_up || !connection_handlers.connect || now < next_attempt_ms)
+    {
+        return connection_up;
+    }
+
+    if (connection_handlers.disconnect)
+    {
+        connection_handlers.disconnect();
+    }
+
+    if (connection_handlers.connect() == CY_RSLT_SUCCESS)
+    {
+        uint32_t recovery_ms = (uint32_t)(Kernel::get_ms_count() - connection_lost_ms);
+        connection_up = true;
+        gateway_metrics_increment(GATEWAY_COUNTER_CLOUD_RECONNECTS, 1);
+        gateway_metrics_set(GATEWAY_GAUGE_CLOUD_RECOVERY_MSEC, recovery_ms);
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_INFO, "[App] Cloud connection recovered after %lu ms (%lu attempts)\n",
+                           recovery_ms, connection_attempts + 1);
+        return true;
+    }
+
+    next_attempt_ms = Kernel::get_ms_count() + backoff_delay_ms(connection_attempts);
+    connection_attempts++;
+    return false;
+}
+
+uint32_t gateway_connection_retry_ms(void)
+{
+    uint64_t now = Kernel::get_ms_count();
+
+    if (connection_up || !connection_handlers.connect)
+    {
+        return GATEWAY_IDLE_FOREVER;
+    }
+    return (now < next_attempt_ms) ? (uint32_t)(next_attempt_ms - now) : 0;
+}
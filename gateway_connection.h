@@ -0,0 +1,67 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway cloud connection manager
+ *
+ * Tracks whether the cloud connection is up and, once it is lost, retries
+ * the connect callback with exponential backoff: the n-th attempt waits a
+ * random time between half and all of min(BASE * 2^n, MAX), so that many
+ * gateways losing the same broker do not reconnect in lockstep.
+ *
+ * The time from losing the connection to being connected again is reported
+ * in the "cloud_recovery_ms" gauge and the reconnects in "cloud_reconnects".
+ *
+ * Only used from the network thread.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GATEWAY_RECONNECT_BASE_MSEC         (1000)
+#define GATEWAY_RECONNECT_MAX_MSEC          (60000)
+
+typedef struct
+{
+    /* Connects and subscribes; must leave no half-open connection behind on failure */
+    cy_rslt_t (*connect)(void);
+    void (*disconnect)(void);
+} gateway_connection_handlers_t;
+
+/* Called once the initial connection is up */
+void gateway_connection_init(const gateway_connection_handlers_t* handlers, bool connected);
+
+bool gateway_connection_is_up(void);
+
+/* Reports a lost connection, e.g. when yield returns a disconnect error */
+void gateway_connection_lost(void);
+
+/* Attempts to reconnect when the backoff delay has expired. Returns true if the connection is up. */
+bool gateway_connection_poll(void);
+
+/* Time until the next reconnect attempt; GATEWAY_IDLE_FOREVER while the connection is up */
+uint32_t gateway_connection_retry_ms(void);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
@@ -0,0 +1,296 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway downlink delivery tracking implementation
+ */
+
+#include "mbed.h"
+
+#include "gateway_delivery.h"
+#include "gateway_idle.h"
+#include "gateway_metrics.h"
+#include "gateway_trace.h"
+
+typedef struct
+{
+    uint32_t    set_opcode;
+    uint32_t    status_opcode;
+} ack_opcode_pair_t;
+
+/* Acknowledged messages and the status message that answers them */
+static const ack_opcode_pair_t ack_opcode_pairs[] =
+{
+    { 0x8202, 0x8204 },     /* Generic OnOff Set */
+    { 0x8206, 0x8208 },     /* Generic Level Set */
+    { 0x8209, 0x8208 },     /* Generic Delta Set */
+    { 0x820B, 0x8208 },     /* Generic Move Set */
+    { 0x8213, 0x8212 },     /* Generic OnPowerUp Set */
+    { 0x824C, 0x824E },     /* Light Lightness Set */
+    { 0x8250, 0x8252 },     /* Light Lightness Linear Set */
+    { 0x825E, 0x8260 },     /* Light CTL Set */
+    { 0x8276, 0x8278 },     /* Light HSL Set */
+};
+
+#define ACK_OPCODE_PAIR_COUNT   (sizeof(ack_opcode_pairs) / sizeof(ack_opcode_pairs[0]))
+
+typedef struct
+{
+    bool        in_use;
+    uint16_t    dst;
+    uint32_t    status_opcode;
+    uint32_t    sent_ms;
+    uint32_t    timeout_ms;
+    char        id[GATEWAY_LATENCY_ID_MAX_LEN + 1];
+} pending_command_t;
+
+static pending_command_t pending_commands[GATEWAY_DELIVERY_MAX_PENDING];
+
+MBED_STATIC_ASSERT(sizeof(pending_command_t) <= GATEWAY_FOOTPRINT_DELIVERY_ENTRY, "A pending command exceeds its size in the footprint profile");
+MBED_STATIC_ASSERT(sizeof(pending_commands) <= GATEWAY_FOOTPRINT_DELIVERY_RAM, "Pending commands exceed their share of the footprint profile");
+
+static uint32_t srtt_ms = 0;
+static uint32_t rttvar_ms = 0;
+static uint32_t rto_ms = GATEWAY_DELIVERY_INITIAL_RTO_MSEC;
+static gateway_delivery_report_callback_t report_callback = NULL;
+static Mutex delivery_mutex;
+
+static uint32_t status_opcode_for(uint32_t opcode)
+{
+    uint32_t i;
+
+    for (i = 0; i < ACK_OPCODE_PAIR_COUNT; i++)
+    {
+        if (ack_opcode_pairs[i].set_opcode == opcode)
+        {
+            return ack_opcode_pairs[i].status_opcode;
+        }
+    }
+    return MESH_PDU_OPCODE_INVALID;
+}
+
+static uint32_t clamp_rto(uint32_t value)
+{
+    if (value < GATEWAY_DELIVERY_MIN_RTO_MSEC)
+    {
+        return GATEWAY_DELIVERY_MIN_RTO_MSEC;
+    }
+    if (value > GATEWAY_DELIVERY_MAX_RTO_MSEC)
+    {
+        return GATEWAY_DELIVERY_MAX_RTO_MSEC;
+    }
+    return value;
+}
+
+/* Must be called with delivery_mutex held */
+static void update_rto(uint32_t rtt_ms)
+{
+    if (srtt_ms == 0)
+    {
+        srtt_ms   = rtt_ms;
+        rttvar_ms = rtt_ms / 2;
+    }
+    else
+    {
+        uint32_t delta = (srtt_ms > rtt_ms) ? srtt_ms - rtt_ms : rtt_ms - srtt_ms;
+        /* RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, SRTT = 7/8 SRTT + 1/8 R */
+        rttvar_ms = (3 * rttvar_ms + delta) / 4;
+        srtt_ms   = (7 * srtt_ms + rtt_ms) / 8;
+    }
+    rto_ms = clamp_rto(srtt_ms + 4 * rttvar_ms);
+    gateway_metrics_set(GATEWAY_GAUGE_COMMAND_RTO_MSEC, rto_ms);
+}
+
+static void fill_report(const pending_command_t* command, gateway_delivery_result_t result, uint32_t now, gateway_delivery_report_t* report)
+{
+    memcpy(report->id, command->id, sizeof(report->id));
+    report->dst        = command->dst;
+    report->opcode     = command->status_opcode;
+    report->result     = result;
+    report->elapsed_ms = now - command->sent_ms;
+}
+
+void gateway_delivery_init(gateway_delivery_report_callback_t callback)
+{
+    delivery_mutex.lock();
+    memset(pending_commands, 0, sizeof(pending_commands));
+    srtt_ms   = 0;
+    rttvar_ms = 0;
+    rto_ms    = GATEWAY_DELIVERY_INITIAL_RTO_MSEC;
+    report_callback = callback;
+    delivery_mutex.unlock();
+    gateway_metrics_set(GATEWAY_GAUGE_COMMAND_RTO_MSEC, rto_ms);
+}
+
+bool gateway_delivery_track(const mesh_pdu_t* pdu, gateway_latency_handle_t trace)
+{
+    uint32_t now = (uint32_t)Kernel::get_ms_count();
+    pending_command_t* command = NULL;
+    uint32_t status_opcode;
+    uint32_t i;
+
+    if (!pdu || pdu->dst == MESH_ADDR_UNASSIGNED || (pdu->dst & 0x8000) != 0)
+    {
+        /* Group and virtual addresses get any number of answers */
+        return false;
+    }
+    status_opcode = status_opcode_for(pdu->opcode);
+    if (status_opcode == MESH_PDU_OPCODE_INVALID)
+    {
+        return false;
+    }
+
+    delivery_mutex.lock();
+    for (i = 0; i < GATEWAY_DELIVERY_MAX_PENDING && !command; i++)
+    {
+        if (!pending_commands[i].in_use)
+        {
+            command = &pending_commands[i];
+        }
+    }
+    if (!command)
+    {
+        delivery_mutex.unlock();
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_WARN, "[App] Delivery table full, command to %04X not tracked\n", pdu->dst);
+        return false;
+    }
+
+    memset(command, 0, sizeof(pending_command_t));
+    command->in_use        = true;
+    command->dst           = pdu->dst;
+    command->status_opcode = status_opcode;
+    command->sent_ms       = now;
+    command->timeout_ms    = rto_ms;
+    gateway_latency_get_id(trace, command->id, sizeof(command->id));
+    delivery_mutex.unlock();
+
+    return true;
+}
+
+bool gateway_delivery_match(const mesh_pdu_t* pdu)
+{
+    uint32_t now = (uint32_t)Kernel::get_ms_count();
+    gateway_delivery_report_t report;
+    pending_command_t* oldest = NULL;
+    uint32_t i;
+
+    if (!pdu || pdu->opcode == MESH_PDU_OPCODE_INVALID)
+    {
+        return false;
+    }
+
+    delivery_mutex.lock();
+    for (i = 0; i < GATEWAY_DELIVERY_MAX_PENDING; i++)
+    {
+        pending_command_t* command = &pending_commands[i];
+        if (command->in_use && command->dst == pdu->src && command->status_opcode == pdu->opcode &&
+            (!oldest || (int32_t)(command->sent_ms - oldest->sent_ms) < 0))
+        {
+            oldest = command;
+        }
+    }
+
+    if (!oldest)
+    {
+        delivery_mutex.unlock();
+        return false;
+    }
+
+    update_rto(now - oldest->sent_ms);
+    fill_report(oldest, GATEWAY_DELIVERY_DELIVERED, now, &report);
+    oldest->in_use = false;
+    delivery_mutex.unlock();
+
+    gateway_metrics_increment(GATEWAY_COUNTER_COMMANDS_DELIVERED, 1);
+    gateway_metrics_observe(GATEWAY_HISTOGRAM_COMMAND_ACK_US, report.elapsed_ms * 1000);
+    if (report_callback)
+    {
+        report_callback(&report);
+    }
+    return true;
+}
+
+uint32_t gateway_delivery_poll(void)
+{
+    gateway_delivery_report_t report;
+    uint32_t next_ms = GATEWAY_IDLE_FOREVER;
+    uint32_t now;
+    uint32_t i;
+
+    for (i = 0; i < GATEWAY_DELIVERY_MAX_PENDING; i++)
+    {
+        uint32_t now = (uint32_t)Kernel::get_ms_count();
+
+        delivery_mutex.lock();
+        pending_command_t* command = &pending_commands[i];
+        if (!command->in_use || now - command->sent_ms < command->timeout_ms)
+        {
+            delivery_mutex.unlock();
+            continue;
+        }
+        fill_report(command, GATEWAY_DELIVERY_FAILED, now, &report);
+        command->in_use = false;
+        /* Back off; the answer may just be slower than the estimate */
+        rto_ms = clamp_rto(rto_ms * 2);
+        delivery_mutex.unlock();
+
+        gateway_metrics_set(GATEWAY_GAUGE_COMMAND_RTO_MSEC, rto_ms);
+        gateway_metrics_increment(GATEWAY_COUNTER_COMMANDS_FAILED, 1);
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_WARN, "[App] Command to %04X not acknowledged within %lu ms\n",
+                           report.dst, report.elapsed_ms);
+        if (report_callback)
+        {
+            report_callback(&report);
+        }
+    }
+
+    now = (uint32_t)Kernel::get_ms_count();
+    delivery_mutex.lock();
+    for (i = 0; i < GATEWAY_DELIVERY_MAX_PENDING; i++)
+    {
+        const pending_command_t* command = &pending_commands[i];
+        uint32_t remaining = command->in_use ? gateway_idle_until(now, command->sent_ms + command->timeout_ms) : GATEWAY_IDLE_FOREVER;
+        if (remaining < next_ms)
+        {
+            next_ms = remaining;
+        }
+    }
+    delivery_mutex.unlock();
+    return next_ms;
+}
+
+uint32_t gateway_delivery_report_to_json(const gateway_delivery_report_t* report, char* buffer, uint32_t buffer_len)
+{
+    int ret;
+
+    if (!report || !buffer)
+    {
+        return 0;
+    }
+
+    ret = snprintf(buffer, buffer_len,
+                   "{\"id\":\"%s\",\"dst\":\"%04X\",\"status_opcode\":\"%lX\",\"result\":\"%s\",\"elapsed_ms\":%lu}",
+                   report->id, report->dst, (unsigned long)report->opcode,
+                   (report->result == GATEWAY_DELIVERY_DELIVERED) ? "delivered" : "failed",
+                   (unsigned long)report->elapsed_ms);
+
+    if (ret < 0 || (uint32_t)ret >= buffer_len)
+    {
+        return 0;
+    }
+    return ret;
+}
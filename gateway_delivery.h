@@ -0,0 +1,88 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway downlink delivery tracking
+ *
+ * Acknowledged downlink commands (e.g. Generic OnOff Set) sent to a unicast
+ * node are kept in a small table until the matching status message (Generic
+ * OnOff Status) arrives from that node. A command that is not answered within
+ * the timeout is reported as failed.
+ *
+ * The timeout adapts to the mesh as in RFC 6298: every answer updates the
+ * smoothed round trip time SRTT and its variation RTTVAR, and RTO = SRTT +
+ * 4 * RTTVAR, clamped to [MIN, MAX]. An unanswered command doubles RTO, so
+ * that a timeout that is too short cannot keep failing every command.
+ *
+ * The gateway does not retransmit: a copy of the network PDU has the same
+ * sequence number and would be dropped by replay protection. A failed
+ * result tells the sender to issue the command again.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+#include "gateway_mesh_pdu.h"
+#include "gateway_latency.h"
+#include "gateway_footprint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GATEWAY_DELIVERY_MAX_PENDING        (GATEWAY_FOOTPRINT_DELIVERY_PENDING)
+#define GATEWAY_DELIVERY_INITIAL_RTO_MSEC   (2000)
+#define GATEWAY_DELIVERY_MIN_RTO_MSEC       (300)
+#define GATEWAY_DELIVERY_MAX_RTO_MSEC       (8000)
+#define GATEWAY_DELIVERY_JSON_SIZE          (160)
+
+typedef enum
+{
+    GATEWAY_DELIVERY_DELIVERED,
+    GATEWAY_DELIVERY_FAILED
+} gateway_delivery_result_t;
+
+typedef struct
+{
+    char                        id[GATEWAY_LATENCY_ID_MAX_LEN + 1];
+    uint16_t                    dst;
+    uint32_t                    opcode;
+    gateway_delivery_result_t   result;
+    uint32_t                    elapsed_ms;
+} gateway_delivery_report_t;
+
+typedef void (*gateway_delivery_report_callback_t)(const gateway_delivery_report_t* report);
+
+void gateway_delivery_init(gateway_delivery_report_callback_t callback);
+
+/* Starts tracking a command that was just sent, if it is an acknowledged message to a unicast node.
+ * Returns true if it is tracked.
+ */
+bool gateway_delivery_track(const mesh_pdu_t* pdu, gateway_latency_handle_t trace);
+
+/* Closes the oldest command answered by the uplink 'pdu'. Returns true if one was found. */
+bool gateway_delivery_match(const mesh_pdu_t* pdu);
+
+/* Fails the commands whose timeout expired. Returns the time until the next timeout expires. */
+uint32_t gateway_delivery_poll(void);
+
+uint32_t gateway_delivery_report_to_json(const gateway_delivery_report_t* report, char* buffer, uint32_t buffer_len);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
@@ -0,0 +1,262 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway downlink group fan-out implementation
+ */
+
+#include "mbed.h"
+
+#include "KVStore.h"
+#include "kvstore_global_api.h"
+
+#include "gateway_fanout.h"
+#include "gateway_mesh_pdu.h"
+#include "gateway_metrics.h"
+#include "gateway_trace.h"
+#include "cy_string_utils.h"
+
+#define err_code(res) MBED_GET_ERROR_CODE(res)
+
+#define GROUPS_STORE_MAGIC          (0x47525053)
+#define MESH_ADDR_IS_UNICAST(addr)  ((addr) != MESH_ADDR_UNASSIGNED && ((addr) & 0x8000) == 0)
+#define MESH_ADDR_IS_GROUP(addr)    ((addr) >= 0xC000 && (addr) < 0xFF00)
+
+typedef struct
+{
+    uint16_t    addr;
+    uint16_t    count;
+    uint16_t    members[GATEWAY_FANOUT_MAX_MEMBERS];   /* Sorted */
+} fanout_group_t;
+
+typedef struct
+{
+    uint32_t        magic;
+    uint32_t        count;
+    fanout_group_t  groups[GATEWAY_FANOUT_MAX_GROUPS];
+} fanout_groups_store_t;
+
+static const char* groups_key = "/kv/fanout_groups";
+static fanout_groups_store_t groups_store;
+static Mutex groups_mutex;
+
+MBED_STATIC_ASSERT(sizeof(fanout_group_t) <= GATEWAY_FOOTPRINT_FANOUT_GROUP, "A fan-out group exceeds its size in the footprint profile");
+MBED_STATIC_ASSERT(sizeof(groups_store) <= GATEWAY_FOOTPRINT_FANOUT_KVSTORE, "The stored fan-out groups exceed their KVStore share of the footprint profile");
+MBED_STATIC_ASSERT(sizeof(groups_store) <= GATEWAY_FOOTPRINT_FANOUT_RAM, "Fan-out groups exceed their share of the footprint profile");
+
+static void sort_addresses(uint16_t* addresses, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 1; i < count; i++)
+    {
+        uint16_t addr = addresses[i];
+        uint32_t j = i;
+        while (j > 0 && addresses[j - 1] > addr)
+        {
+            addresses[j] = addresses[j - 1];
+            j--;
+        }
+        addresses[j] = addr;
+    }
+}
+
+static cy_rslt_t groups_save(void)
+{
+    size_t size = offsetof(fanout_groups_store_t, groups) + groups_store.count * sizeof(fanout_group_t);
+
+    if (err_code(kv_set(groups_key, &groups_store, size, 0)) != 0)
+    {
+        gateway_metrics_increment(GATEWAY_COUNTER_NVRAM_ERRORS, 1);
+        return CY_RSLT_MW_ERROR;
+    }
+    gateway_metrics_increment(GATEWAY_COUNTER_NVRAM_WRITES, 1);
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t gateway_fanout_init(void)
+{
+    size_t actual_size = 0;
+
+    groups_mutex.lock();
+    if (err_code(kv_get(groups_key, &groups_store, sizeof(groups_store), &actual_size)) != 0 ||
+        actual_size < offsetof(fanout_groups_store_t, groups) || groups_store.magic != GROUPS_STORE_MAGIC ||
+        groups_store.count > GATEWAY_FANOUT_MAX_GROUPS ||
+        actual_size != offsetof(fanout_groups_store_t, groups) + groups_store.count * sizeof(fanout_group_t))
+    {
+        groups_store.magic = GROUPS_STORE_MAGIC;
+        groups_store.count = 0;
+    }
+    groups_mutex.unlock();
+
+    return CY_RSLT_SUCCESS;
+}
+
+uint32_t gateway_fanout_members(uint16_t group, uint16_t* members, uint32_t max_members)
+{
+    uint32_t count = 0;
+    uint32_t i;
+
+    if (!members || !MESH_ADDR_IS_GROUP(group))
+    {
+        return 0;
+    }
+
+    groups_mutex.lock();
+    for (i = 0; i < groups_store.count; i++)
+    {
+        if (groups_store.groups[i].addr == group)
+        {
+            count = (groups_store.groups[i].count < max_members) ? groups_store.groups[i].count : max_members;
+            memcpy(members, groups_store.groups[i].members, count * sizeof(uint16_t));
+            break;
+        }
+    }
+    groups_mutex.unlock();
+
+    return count;
+}
+
+cy_rslt_t gateway_fanout_apply_request(const char* request, uint32_t request_len)
+{
+    fanout_group_t group;
+    uint32_t start = 0;
+    uint32_t field = 0;
+    uint32_t i;
+    cy_rslt_t result;
+
+    if (!request || request_len == 0)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    memset(&group, 0, sizeof(group));
+    for (i = 0; i <= request_len; i++)
+    {
+        uint32_t value = 0;
+
+        if (i < request_len && request[i] != ',')
+        {
+            continue;
+        }
+        if (i == start || i - start > 4 || cy_string_to_unsigned(&request[start], i - start, &value, 1) == 0)
+        {
+            return CY_RSLT_MW_ERROR;
+        }
+        if (field == 0)
+        {
+            if (!MESH_ADDR_IS_GROUP(value))
+            {
+                return CY_RSLT_MW_ERROR;
+            }
+            group.addr = (uint16_t)value;
+        }
+        else
+        {
+            if (!MESH_ADDR_IS_UNICAST(value) || group.count == GATEWAY_FANOUT_MAX_MEMBERS)
+            {
+                return CY_RSLT_MW_ERROR;
+            }
+            group.members[group.count++] = (uint16_t)value;
+        }
+        field++;
+        start = i + 1;
+    }
+    sort_addresses(group.members, group.count);
+
+    groups_mutex.lock();
+    for (i = 0; i < groups_store.count && groups_store.groups[i].addr != group.addr; i++)
+    {
+    }
+    if (group.count == 0)
+    {
+        if (i < groups_store.count)
+        {
+            /* Keep the groups packed */
+            groups_store.groups[i] = groups_store.groups[groups_store.count - 1];
+            groups_store.count--;
+        }
+    }
+    else if (i < groups_store.count)
+    {
+        groups_store.groups[i] = group;
+    }
+    else if (groups_store.count < GATEWAY_FANOUT_MAX_GROUPS)
+    {
+        groups_store.groups[groups_store.count++] = group;
+    }
+    else
+    {
+        groups_mutex.unlock();
+        return CY_RSLT_MW_ERROR;
+    }
+    result = groups_save();
+    groups_mutex.unlock();
+
+    return result;
+}
+
+uint32_t gateway_fanout_groups_to_json(char* buffer, uint32_t buffer_len)
+{
+    uint32_t written = 0;
+    uint32_t i;
+    uint32_t j;
+    int ret;
+
+    if (!buffer || buffer_len == 0)
+    {
+        return 0;
+    }
+
+    ret = snprintf(buffer, buffer_len, "{\"groups\":[");
+    if (ret < 0 || (uint32_t)ret >= buffer_len)
+    {
+        return 0;
+    }
+    written = ret;
+
+    groups_mutex.lock();
+    for (i = 0; i < groups_store.count; i++)
+    {
+        const fanout_group_t* group = &groups_store.groups[i];
+        ret = snprintf(buffer + written, buffer_len - written, "%s{\"group\":\"%04X\",\"members\":[", (i > 0) ? "," : "", group->addr);
+        for (j = 0; ret >= 0 && (uint32_t)ret < buffer_len - written && j < group->count; j++)
+        {
+            written += ret;
+            ret = snprintf(buffer + written, buffer_len - written, "%s\"%04X\"", (j > 0) ? "," : "", group->members[j]);
+        }
+        if (ret >= 0 && (uint32_t)ret < buffer_len - written)
+        {
+            written += ret;
+            ret = snprintf(buffer + written, buffer_len - written, "]}");
+        }
+        if (ret < 0 || (uint32_t)ret >= buffer_len - written)
+        {
+            groups_mutex.unlock();
+            return 0;
+        }
+        written += ret;
+    }
+    groups_mutex.unlock();
+
+    ret = snprintf(buffer + written, buffer_len - written, "]}");
+    if (ret < 0 || (uint32_t)ret >= buffer_len - written)
+    {
+        return 0;
+    }
+    return written + ret;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway downlink group fan-out
+ *
+ * A command for several nodes is sent once to a group address. The group copy
+ * must come from the cloud as it was encrypted by the controller: its network
+ * header and MICs are bound to the destination address, so the gateway cannot
+ * make one from a unicast command. Unicast commands are always sent one by one,
+ * paced as usual.
+ *
+ * The configured groups list the members of each group address, so that the
+ * latency and delivery of a group command can still be tracked per node.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+#include "gateway_footprint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GATEWAY_FANOUT_MAX_GROUPS           (GATEWAY_FOOTPRINT_FANOUT_GROUPS)
+#define GATEWAY_FANOUT_MAX_MEMBERS          (32)
+#define GATEWAY_FANOUT_JSON_SIZE            (GATEWAY_FANOUT_MAX_GROUPS * (24 + GATEWAY_FANOUT_MAX_MEMBERS * 7) + 16)
+
+/* Loads the configured groups */
+cy_rslt_t gateway_fanout_init(void);
+
+/* Copies the members of 'group' into 'members'. Returns their number, 0 if the group is not configured. */
+uint32_t gateway_fanout_members(uint16_t group, uint16_t* members, uint32_t max_members);
+
+/* Applies a request "<group>,<member>,<member>,..." (all hex); "<group>" alone removes the group.
+ * The groups are saved to KVStore.
+ */
+cy_rslt_t gateway_fanout_apply_request(const char* request, uint32_t request_len);
+
+/* Renders the configured groups as JSON into 'buffer'. Returns the length written. */
+uint32_t gateway_fanout_groups_to_json(char* buffer, uint32_t buffer_len);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
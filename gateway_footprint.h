@@ -0,0 +1,314 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway footprint profiles
+ *
+ * Sizes every table, ring, queue, thread stack and buffer pool of the gateway from one named
+ * profile, selected with APP_CONFIG_FOOTPRINT_PROFILE in gateway_config.h:
+ *
+ *  - small: a few hundred nodes, short outages; fits next to a large TLS heap
+ *  - balanced: the default
+ *  - high throughput: large networks (1000+ nodes), long outages and bursty downlink
+ *
+ * Each module checks the sizeof of its entry types against the entry sizes
+ * below (GATEWAY_FOOTPRINT_*_ENTRY), and of its static tables and KVStore
+ * records against its shares (GATEWAY_FOOTPRINT_*_RAM and *_KVSTORE). The
+ * application checks that the shares of the modules enabled in
+ * gateway_config.h, the thread stacks, mail queues and buffer pools of the
+ * profile add up to no more than GATEWAY_FOOTPRINT_RAM_BUDGET, and
+ * the KVStore shares to no more than GATEWAY_FOOTPRINT_KVSTORE_BUDGET.
+ * A profile that does not fit fails to build.
+ *
+ * The shares are meant to be used where the module headers are included.
+ */
+
+#pragma once
+
+#include "gateway_config.h"
+
+#define GATEWAY_FOOTPRINT_SMALL                 (0)
+#define GATEWAY_FOOTPRINT_BALANCED              (1)
+#define GATEWAY_FOOTPRINT_HIGH_THROUGHPUT       (2)
+
+#if APP_CONFIG_FOOTPRINT_PROFILE == GATEWAY_FOOTPRINT_SMALL
+
+#define GATEWAY_FOOTPRINT_NAME                  "small"
+#define GATEWAY_FOOTPRINT_RAM_BUDGET            (48 * 1024)
+#define GATEWAY_FOOTPRINT_KVSTORE_BUDGET        (16 * 1024)
+
+/* Thread stacks, mail queues and packet buffer pools */
+#define GATEWAY_FOOTPRINT_NET_STACK_SIZE        (6144)
+#define GATEWAY_FOOTPRINT_MESH_TX_STACK_SIZE    (2048)
+#define GATEWAY_FOOTPRINT_PERSIST_STACK_SIZE    (3072)
+#define GATEWAY_FOOTPRINT_NET_QUEUE_DEPTH       (4)
+#define GATEWAY_FOOTPRINT_MESH_TX_QUEUE_DEPTH   (4)
+#define GATEWAY_FOOTPRINT_PERSIST_QUEUE_DEPTH   (16)
+#define GATEWAY_FOOTPRINT_POOL_SMALL_BLOCKS     (8)
+#define GATEWAY_FOOTPRINT_POOL_MEDIUM_BLOCKS    (4)
+#define GATEWAY_FOOTPRINT_POOL_LARGE_BLOCKS     (2)
+
+#define GATEWAY_FOOTPRINT_JSON_SCRATCHPAD_SIZE  (120)
+#define GATEWAY_FOOTPRINT_HTTP_SOCKETS          (2)
+/* Load the NVRAM image only while it is used, instead of keeping it in RAM */
+#define GATEWAY_FOOTPRINT_NVRAM_RESIDENT        (0)
+#define GATEWAY_FOOTPRINT_NODE_CACHE_SLOTS      (64)
+#define GATEWAY_FOOTPRINT_TOPIC_SLOTS           (16)
+#define GATEWAY_FOOTPRINT_TRACE_RING_SIZE       (32)
+#define GATEWAY_FOOTPRINT_SPOOL_RAM_ENTRIES     (4)
+#define GATEWAY_FOOTPRINT_SPOOL_FLASH_ENTRIES   (16)
+#define GATEWAY_FOOTPRINT_HISTORY_RAM_BLOCKS    (4)
+#define GATEWAY_FOOTPRINT_HISTORY_FLASH_BLOCKS  (16)
+#define GATEWAY_FOOTPRINT_RULES_MAX             (4)
+#define GATEWAY_FOOTPRINT_RULES_INDEX_SLOTS     (8)
+#define GATEWAY_FOOTPRINT_FANOUT_GROUPS         (2)
+#define GATEWAY_FOOTPRINT_DELIVERY_PENDING      (4)
+#define GATEWAY_FOOTPRINT_COMMAND_DEDUP_SLOTS   (16)
+#define GATEWAY_FOOTPRINT_UPLINK_DEDUP_SLOTS    (16)
+#define GATEWAY_FOOTPRINT_CHANGE_ONLY_NODES     (8)
+#define GATEWAY_FOOTPRINT_SENSOR_SERIES         (8)
+#define GATEWAY_FOOTPRINT_SENSOR_RAW_NODES      (4)
+#define GATEWAY_FOOTPRINT_UPLINK_BATCH_DEPTH    (1)
+#define GATEWAY_FOOTPRINT_WARMBOOT_SIZE         (4096)
+
+#elif APP_CONFIG_FOOTPRINT_PROFILE == GATEWAY_FOOTPRINT_BALANCED
+
+#define GATEWAY_FOOTPRINT_NAME                  "balanced"
+#define GATEWAY_FOOTPRINT_RAM_BUDGET            (96 * 1024)
+#define GATEWAY_FOOTPRINT_KVSTORE_BUDGET        (48 * 1024)
+
+/* Thread stacks, mail queues and packet buffer pools */
+#define GATEWAY_FOOTPRINT_NET_STACK_SIZE        (6144)
+#define GATEWAY_FOOTPRINT_MESH_TX_STACK_SIZE    (2048)
+#define GATEWAY_FOOTPRINT_PERSIST_STACK_SIZE    (3072)
+#define GATEWAY_FOOTPRINT_NET_QUEUE_DEPTH       (8)
+#define GATEWAY_FOOTPRINT_MESH_TX_QUEUE_DEPTH   (8)
+#define GATEWAY_FOOTPRINT_PERSIST_QUEUE_DEPTH   (16)
+#define GATEWAY_FOOTPRINT_POOL_SMALL_BLOCKS     (16)
+#define GATEWAY_FOOTPRINT_POOL_MEDIUM_BLOCKS    (8)
+#define GATEWAY_FOOTPRINT_POOL_LARGE_BLOCKS     (4)
+
+#define GATEWAY_FOOTPRINT_JSON_SCRATCHPAD_SIZE  (120)
+#define GATEWAY_FOOTPRINT_HTTP_SOCKETS          (4)
+#define GATEWAY_FOOTPRINT_NVRAM_RESIDENT        (1)
+#define GATEWAY_FOOTPRINT_NODE_CACHE_SLOTS      (256)
+#define GATEWAY_FOOTPRINT_TOPIC_SLOTS           (64)
+#define GATEWAY_FOOTPRINT_TRACE_RING_SIZE       (64)
+#define GATEWAY_FOOTPRINT_SPOOL_RAM_ENTRIES     (16)
+#define GATEWAY_FOOTPRINT_SPOOL_FLASH_ENTRIES   (64)
+#define GATEWAY_FOOTPRINT_HISTORY_RAM_BLOCKS    (32)
+#define GATEWAY_FOOTPRINT_HISTORY_FLASH_BLOCKS  (64)
+#define GATEWAY_FOOTPRINT_RULES_MAX             (16)
+#define GATEWAY_FOOTPRINT_RULES_INDEX_SLOTS     (32)
+#define GATEWAY_FOOTPRINT_FANOUT_GROUPS         (8)
+#define GATEWAY_FOOTPRINT_DELIVERY_PENDING      (8)
+#define GATEWAY_FOOTPRINT_COMMAND_DEDUP_SLOTS   (32)
+#define GATEWAY_FOOTPRINT_UPLINK_DEDUP_SLOTS    (32)
+#define GATEWAY_FOOTPRINT_CHANGE_ONLY_NODES     (32)
+#define GATEWAY_FOOTPRINT_SENSOR_SERIES         (32)
+#define GATEWAY_FOOTPRINT_SENSOR_RAW_NODES      (16)
+#define GATEWAY_FOOTPRINT_UPLINK_BATCH_DEPTH    (2)
+#define GATEWAY_FOOTPRINT_WARMBOOT_SIZE         (8192)
+
+#elif APP_CONFIG_FOOTPRINT_PROFILE == GATEWAY_FOOTPRINT_HIGH_THROUGHPUT
+
+#define GATEWAY_FOOTPRINT_NAME                  "high throughput"
+#define GATEWAY_FOOTPRINT_RAM_BUDGET            (192 * 1024)
+#define GATEWAY_FOOTPRINT_KVSTORE_BUDGET        (128 * 1024)
+
+/* Thread stacks, mail queues and packet buffer pools */
+#define GATEWAY_FOOTPRINT_NET_STACK_SIZE        (6144)
+#define GATEWAY_FOOTPRINT_MESH_TX_STACK_SIZE    (2048)
+#define GATEWAY_FOOTPRINT_PERSIST_STACK_SIZE    (3072)
+#define GATEWAY_FOOTPRINT_NET_QUEUE_DEPTH       (12)
+#define GATEWAY_FOOTPRINT_MESH_TX_QUEUE_DEPTH   (12)
+#define GATEWAY_FOOTPRINT_PERSIST_QUEUE_DEPTH   (20)
+#define GATEWAY_FOOTPRINT_POOL_SMALL_BLOCKS     (24)
+#define GATEWAY_FOOTPRINT_POOL_MEDIUM_BLOCKS    (12)
+#define GATEWAY_FOOTPRINT_POOL_LARGE_BLOCKS     (6)
+
+/* Room for the largest command the mesh TX queue takes */
+#define GATEWAY_FOOTPRINT_JSON_SCRATCHPAD_SIZE  (168)
+#define GATEWAY_FOOTPRINT_HTTP_SOCKETS          (8)
+#define GATEWAY_FOOTPRINT_NVRAM_RESIDENT        (1)
+/* 1536 (node, opcode) states, one or more for each of 1000+ nodes */
+#define GATEWAY_FOOTPRINT_NODE_CACHE_SLOTS      (2048)
+#define GATEWAY_FOOTPRINT_TOPIC_SLOTS           (256)
+#define GATEWAY_FOOTPRINT_TRACE_RING_SIZE       (128)
+#define GATEWAY_FOOTPRINT_SPOOL_RAM_ENTRIES     (64)
+#define GATEWAY_FOOTPRINT_SPOOL_FLASH_ENTRIES   (160)
+#define GATEWAY_FOOTPRINT_HISTORY_RAM_BLOCKS    (96)
+#define GATEWAY_FOOTPRINT_HISTORY_FLASH_BLOCKS  (256)
+#define GATEWAY_FOOTPRINT_RULES_MAX             (32)
+#define GATEWAY_FOOTPRINT_RULES_INDEX_SLOTS     (64)
+#define GATEWAY_FOOTPRINT_FANOUT_GROUPS         (16)
+#define GATEWAY_FOOTPRINT_DELIVERY_PENDING      (16)
+#define GATEWAY_FOOTPRINT_COMMAND_DEDUP_SLOTS   (64)
+#define GATEWAY_FOOTPRINT_UPLINK_DEDUP_SLOTS    (64)
+#define GATEWAY_FOOTPRINT_CHANGE_ONLY_NODES     (64)
+#define GATEWAY_FOOTPRINT_SENSOR_SERIES         (64)
+#define GATEWAY_FOOTPRINT_SENSOR_RAW_NODES      (32)
+#define GATEWAY_FOOTPRINT_UPLINK_BATCH_DEPTH    (4)
+#define GATEWAY_FOOTPRINT_WARMBOOT_SIZE         (16384)
+
+#else
+#error "Unknown APP_CONFIG_FOOTPRINT_PROFILE"
+#endif
+
+/* One table entry of each module in bytes, as an upper bound for 32 and 64 bit
+ * targets; each module checks the sizeof of its entry types against these */
+#define GATEWAY_FOOTPRINT_NODE_CACHE_ENTRY      (MESH_NODE_CACHE_MAX_STATE_LEN + 19)
+#define GATEWAY_FOOTPRINT_TOPIC_ENTRY           (GATEWAY_TOPIC_MAX + 4)
+#define GATEWAY_FOOTPRINT_TRACE_ENTRY           (48)
+#define GATEWAY_FOOTPRINT_SPOOL_ENTRY           (GATEWAY_SPOOL_TOPIC_MAX + GATEWAY_SPOOL_PAYLOAD_MAX + 4)
+#define GATEWAY_FOOTPRINT_HISTORY_HEADER        (16)
+#define GATEWAY_FOOTPRINT_HISTORY_BLOCK         (GATEWAY_HISTORY_BLOCK_SIZE + GATEWAY_FOOTPRINT_HISTORY_HEADER)
+#define GATEWAY_FOOTPRINT_RULE_ENTRY            (MESH_RULES_ACTIONS_PER_RULE * (MESH_RULES_PDU_MAX + 1) + 8)
+#define GATEWAY_FOOTPRINT_FANOUT_GROUP          (GATEWAY_FANOUT_MAX_MEMBERS * 2 + 4)
+#define GATEWAY_FOOTPRINT_DELIVERY_ENTRY        (GATEWAY_LATENCY_ID_MAX_LEN + 20)
+#define GATEWAY_FOOTPRINT_COMMAND_DEDUP_ENTRY   (GATEWAY_LATENCY_ID_MAX_LEN + 12)
+#define GATEWAY_FOOTPRINT_UPLINK_DEDUP_ENTRY    (16)
+#define GATEWAY_FOOTPRINT_SENSOR_SERIES_ENTRY   (32)
+#define GATEWAY_FOOTPRINT_UPLINK_BATCH_BUFFER   (GATEWAY_UPLINK_BATCH_RECORDS_MAX + 4)
+#define GATEWAY_FOOTPRINT_WARMBOOT_REGION       (GATEWAY_WARMBOOT_SIZE + 32)
+#define GATEWAY_FOOTPRINT_NVRAM_IMAGE           (MESH_NV_DATA_MAX_ENTRIES * (MESH_NV_DATA_MAX_PAYLOAD + 4) + 2)
+
+/* Static RAM of each module in bytes */
+#define GATEWAY_FOOTPRINT_NODE_CACHE_RAM    (MESH_NODE_CACHE_SLOTS * (GATEWAY_FOOTPRINT_NODE_CACHE_ENTRY + 2) + 16)
+#define GATEWAY_FOOTPRINT_TOPICS_RAM        (GATEWAY_TOPIC_TABLE_SLOTS * GATEWAY_FOOTPRINT_TOPIC_ENTRY + 32)
+#define GATEWAY_FOOTPRINT_TRACE_RAM         (GATEWAY_TRACE_RING_SIZE * GATEWAY_FOOTPRINT_TRACE_ENTRY + 16)
+#define GATEWAY_FOOTPRINT_SPOOL_RAM         ((GATEWAY_SPOOL_RAM_ENTRIES + 1) * GATEWAY_FOOTPRINT_SPOOL_ENTRY + 32)
+#define GATEWAY_FOOTPRINT_HISTORY_RAM       ((GATEWAY_HISTORY_RAM_BLOCKS + 2) * GATEWAY_FOOTPRINT_HISTORY_BLOCK +          \
+                                             GATEWAY_HISTORY_FLASH_BLOCKS * GATEWAY_FOOTPRINT_HISTORY_HEADER + 64)
+#define GATEWAY_FOOTPRINT_RULES_RAM         (MESH_RULES_MAX * (GATEWAY_FOOTPRINT_RULE_ENTRY + 5) + MESH_RULES_INDEX_SLOTS + 32)
+#define GATEWAY_FOOTPRINT_FANOUT_RAM        (GATEWAY_FANOUT_MAX_GROUPS * GATEWAY_FOOTPRINT_FANOUT_GROUP + 16)
+#define GATEWAY_FOOTPRINT_DELIVERY_RAM      (GATEWAY_DELIVERY_MAX_PENDING * GATEWAY_FOOTPRINT_DELIVERY_ENTRY + 32)
+#define GATEWAY_FOOTPRINT_COMMAND_DEDUP_RAM (GATEWAY_COMMAND_DEDUP_SLOTS * GATEWAY_FOOTPRINT_COMMAND_DEDUP_ENTRY + 16)
+#define GATEWAY_FOOTPRINT_UPLINK_FILTER_RAM (MESH_UPLINK_DEDUP_SLOTS * GATEWAY_FOOTPRINT_UPLINK_DEDUP_ENTRY +            \
+                                             GATEWAY_FOOTPRINT_HAS_NODE_CACHE * MESH_UPLINK_CHANGE_ONLY_MAX_NODES * 2 + 32)
+#define GATEWAY_FOOTPRINT_SENSOR_AGG_RAM    (MESH_SENSOR_AGG_MAX_SERIES * GATEWAY_FOOTPRINT_SENSOR_SERIES_ENTRY +          \
+                                             MESH_SENSOR_AGG_MAX_RAW_NODES * 2 + 32)
+#define GATEWAY_FOOTPRINT_UPLINK_BATCH_RAM  ((GATEWAY_UPLINK_BATCH_QUEUE_DEPTH + 2) * GATEWAY_FOOTPRINT_UPLINK_BATCH_BUFFER + \
+                                             GATEWAY_UPLINK_BATCH_FRAME_MAX + 32)
+#define GATEWAY_FOOTPRINT_WARMBOOT_RAM      (GATEWAY_FOOTPRINT_WARMBOOT_REGION)
+#define GATEWAY_FOOTPRINT_NVRAM_RAM         (MESH_NVRAM_RESIDENT * GATEWAY_FOOTPRINT_NVRAM_IMAGE)
+
+/* Records of each module kept in KVStore, without the KVStore's own overhead */
+#define GATEWAY_FOOTPRINT_SPOOL_KVSTORE     (GATEWAY_SPOOL_FLASH_ENTRIES * GATEWAY_FOOTPRINT_SPOOL_ENTRY)
+#define GATEWAY_FOOTPRINT_HISTORY_KVSTORE   (GATEWAY_HISTORY_FLASH_BLOCKS * GATEWAY_FOOTPRINT_HISTORY_BLOCK)
+#define GATEWAY_FOOTPRINT_RULES_KVSTORE     (MESH_RULES_MAX * GATEWAY_FOOTPRINT_RULE_ENTRY + 8)
+#define GATEWAY_FOOTPRINT_FANOUT_KVSTORE    (GATEWAY_FANOUT_MAX_GROUPS * GATEWAY_FOOTPRINT_FANOUT_GROUP + 8)
+#define GATEWAY_FOOTPRINT_NVRAM_KVSTORE     (GATEWAY_FOOTPRINT_NVRAM_IMAGE)
+/* Spool index, used rule actions and proxy filter */
+#define GATEWAY_FOOTPRINT_OTHER_KVSTORE     (512)
+
+/* Modules left out in gateway_config.h are not counted: their tables are
+ * unreferenced and dropped by the linker */
+#if APP_CONFIG_NODE_STATE_CACHE
+#define GATEWAY_FOOTPRINT_HAS_NODE_CACHE    (1)
+#else
+#define GATEWAY_FOOTPRINT_HAS_NODE_CACHE    (0)
+#endif
+#if APP_CONFIG_NODE_TOPICS
+#define GATEWAY_FOOTPRINT_HAS_TOPICS        (1)
+#else
+#define GATEWAY_FOOTPRINT_HAS_TOPICS        (0)
+#endif
+#if APP_CONFIG_UPLINK_SPOOL
+#define GATEWAY_FOOTPRINT_HAS_SPOOL         (1)
+#else
+#define GATEWAY_FOOTPRINT_HAS_SPOOL         (0)
+#endif
+#if APP_CONFIG_STATE_HISTORY
+#define GATEWAY_FOOTPRINT_HAS_HISTORY       (1)
+#else
+#define GATEWAY_FOOTPRINT_HAS_HISTORY       (0)
+#endif
+#if APP_CONFIG_LOCAL_RULES
+#define GATEWAY_FOOTPRINT_HAS_RULES         (1)
+#else
+#define GATEWAY_FOOTPRINT_HAS_RULES         (0)
+#endif
+#if APP_CONFIG_DOWNLINK_FANOUT
+#define GATEWAY_FOOTPRINT_HAS_FANOUT        (1)
+#else
+#define GATEWAY_FOOTPRINT_HAS_FANOUT        (0)
+#endif
+#if APP_CONFIG_DELIVERY_TRACKING
+#define GATEWAY_FOOTPRINT_HAS_DELIVERY      (1)
+#else
+#define GATEWAY_FOOTPRINT_HAS_DELIVERY      (0)
+#endif
+#if APP_CONFIG_COMMAND_DEDUP
+#define GATEWAY_FOOTPRINT_HAS_COMMAND_DEDUP (1)
+#else
+#define GATEWAY_FOOTPRINT_HAS_COMMAND_DEDUP (0)
+#endif
+#if APP_CONFIG_UPLINK_FILTER
+#define GATEWAY_FOOTPRINT_HAS_UPLINK_FILTER (1)
+#else
+#define GATEWAY_FOOTPRINT_HAS_UPLINK_FILTER (0)
+#endif
+#if APP_CONFIG_SENSOR_AGGREGATION
+#define GATEWAY_FOOTPRINT_HAS_SENSOR_AGG    (1)
+#else
+#define GATEWAY_FOOTPRINT_HAS_SENSOR_AGG    (0)
+#endif
+#if APP_CONFIG_UPLINK_BATCH
+#define GATEWAY_FOOTPRINT_HAS_UPLINK_BATCH  (1)
+#else
+#define GATEWAY_FOOTPRINT_HAS_UPLINK_BATCH  (0)
+#endif
+#if APP_CONFIG_SUPERVISOR
+#define GATEWAY_FOOTPRINT_HAS_WARMBOOT      (1)
+#else
+#define GATEWAY_FOOTPRINT_HAS_WARMBOOT      (0)
+#endif
+
+#define GATEWAY_FOOTPRINT_MODULES_RAM       (GATEWAY_FOOTPRINT_HAS_NODE_CACHE * GATEWAY_FOOTPRINT_NODE_CACHE_RAM +          \
+                                             GATEWAY_FOOTPRINT_HAS_TOPICS * GATEWAY_FOOTPRINT_TOPICS_RAM +                  \
+                                             GATEWAY_FOOTPRINT_TRACE_RAM +                                                  \
+                                             GATEWAY_FOOTPRINT_HAS_SPOOL * GATEWAY_FOOTPRINT_SPOOL_RAM +                    \
+                                             GATEWAY_FOOTPRINT_HAS_HISTORY * GATEWAY_FOOTPRINT_HISTORY_RAM +                \
+                                             GATEWAY_FOOTPRINT_HAS_RULES * GATEWAY_FOOTPRINT_RULES_RAM +                    \
+                                             GATEWAY_FOOTPRINT_HAS_FANOUT * GATEWAY_FOOTPRINT_FANOUT_RAM +                  \
+                                             GATEWAY_FOOTPRINT_HAS_DELIVERY * GATEWAY_FOOTPRINT_DELIVERY_RAM +              \
+                                             GATEWAY_FOOTPRINT_HAS_COMMAND_DEDUP * GATEWAY_FOOTPRINT_COMMAND_DEDUP_RAM +    \
+                                             GATEWAY_FOOTPRINT_HAS_UPLINK_FILTER * GATEWAY_FOOTPRINT_UPLINK_FILTER_RAM +    \
+                                             GATEWAY_FOOTPRINT_HAS_SENSOR_AGG * GATEWAY_FOOTPRINT_SENSOR_AGG_RAM +          \
+                                             GATEWAY_FOOTPRINT_HAS_UPLINK_BATCH * GATEWAY_FOOTPRINT_UPLINK_BATCH_RAM +      \
+                                             GATEWAY_FOOTPRINT_HAS_WARMBOOT * GATEWAY_FOOTPRINT_WARMBOOT_RAM +              \
+                                             GATEWAY_FOOTPRINT_NVRAM_RAM)
+
+/* Thread stacks, mail queues and buffer pools */
+#define GATEWAY_FOOTPRINT_THREADS_RAM       (GATEWAY_NET_THREAD_STACK_SIZE + GATEWAY_MESH_TX_THREAD_STACK_SIZE +            \
+                                             GATEWAY_PERSIST_THREAD_STACK_SIZE + GATEWAY_TRACE_THREAD_STACK_SIZE +          \
+                                             GATEWAY_NET_QUEUE_DEPTH * (GATEWAY_PUBLISH_MAX_PAYLOAD + 16) +                 \
+                                             GATEWAY_MESH_TX_QUEUE_DEPTH * (GATEWAY_MESH_TX_MAX_PAYLOAD + 16) +             \
+                                             GATEWAY_PERSIST_QUEUE_DEPTH * (MESH_NV_DATA_MAX_PAYLOAD + 16))
+#define GATEWAY_FOOTPRINT_POOLS_RAM         (GATEWAY_POOL_SMALL_BLOCK_COUNT * (GATEWAY_POOL_SMALL_BLOCK_SIZE + 8) +         \
+                                             GATEWAY_POOL_MEDIUM_BLOCK_COUNT * (GATEWAY_POOL_MEDIUM_BLOCK_SIZE + 8) +       \
+                                             GATEWAY_POOL_LARGE_BLOCK_COUNT * (GATEWAY_POOL_LARGE_BLOCK_SIZE + 8))
+
+#define GATEWAY_FOOTPRINT_RAM               (GATEWAY_FOOTPRINT_MODULES_RAM + GATEWAY_FOOTPRINT_THREADS_RAM + GATEWAY_FOOTPRINT_POOLS_RAM)
+
+/* Records kept in KVStore, without the KVStore's own overhead */
+#define GATEWAY_FOOTPRINT_KVSTORE           (GATEWAY_FOOTPRINT_HAS_SPOOL * GATEWAY_FOOTPRINT_SPOOL_KVSTORE +                \
+                                             GATEWAY_FOOTPRINT_HAS_HISTORY * GATEWAY_FOOTPRINT_HISTORY_KVSTORE +            \
+                                             GATEWAY_FOOTPRINT_HAS_RULES * GATEWAY_FOOTPRINT_RULES_KVSTORE +                \
+                                             GATEWAY_FOOTPRINT_HAS_FANOUT * GATEWAY_FOOTPRINT_FANOUT_KVSTORE +              \
+                                             GATEWAY_FOOTPRINT_NVRAM_KVSTORE + GATEWAY_FOOTPRINT_OTHER_KVSTORE)
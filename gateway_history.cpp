@@ -0,0 +1,563 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway node state history implementation
+ */
+
+#include "mbed.h"
+
+#include "KVStore.h"
+#include "kvstore_global_api.h"
+
+#include "gateway_history.h"
+#include "gateway_metrics.h"
+#include "gateway_trace.h"
+
+#define err_code(res) MBED_GET_ERROR_CODE(res)
+
+#define HISTORY_KEY_SIZE            (24)
+/* Largest encoded record: time, address/flag and opcode varints, length and parameters */
+#define HISTORY_RECORD_MAX          (5 + 3 + 5 + 1 + GATEWAY_HISTORY_MAX_STATE_LEN)
+
+MBED_STATIC_ASSERT(GATEWAY_HISTORY_RAM_BLOCKS >= 2, "The history needs at least two RAM blocks");
+MBED_STATIC_ASSERT(GATEWAY_HISTORY_BLOCK_SIZE >= HISTORY_RECORD_MAX, "A history block must hold a record");
+
+typedef struct
+{
+    uint32_t    first_seq;
+    uint32_t    first_ms;
+    uint32_t    last_ms;
+    uint16_t    used;
+    uint16_t    count;
+} history_header_t;
+
+typedef struct
+{
+    history_header_t    header;
+    uint8_t             data[GATEWAY_HISTORY_BLOCK_SIZE];
+} history_block_t;
+
+typedef struct
+{
+    uint32_t    seq;
+    uint32_t    time_ms;
+    uint32_t    opcode;
+    uint16_t    src;
+    uint8_t     len;
+    uint8_t     state[GATEWAY_HISTORY_MAX_STATE_LEN];
+} history_record_t;
+
+/* Decoding state within a block */
+typedef struct
+{
+    const history_block_t*  block;
+    uint32_t                offset;
+    uint32_t                index;
+    history_record_t        record;
+} history_cursor_t;
+
+#define HISTORY_BLOCK_BYTES(block)  (sizeof(history_header_t) + (block)->header.used)
+
+/* RAM ring; the newest block is the one being written */
+static history_block_t ram_blocks[GATEWAY_HISTORY_RAM_BLOCKS];
+static uint32_t ram_head = 0;
+static uint32_t ram_count = 0;
+static uint32_t next_seq = 0;
+static uint16_t last_src = MESH_ADDR_UNASSIGNED;
+static uint32_t last_opcode = MESH_PDU_OPCODE_INVALID;
+static gateway_history_stats_t history_stats;
+static Mutex history_mutex;
+
+#if GATEWAY_HISTORY_FLASH_BLOCKS > 0
+/* Block waiting for gateway_history_poll() to write it to flash */
+static history_block_t pending_block;
+static bool pending = false;
+
+/* Flash ring, with the headers kept in RAM so that queries can skip blocks; guarded by flash_mutex */
+static history_header_t flash_headers[GATEWAY_HISTORY_FLASH_BLOCKS];
+static uint32_t flash_head = 0;
+static uint32_t flash_count = 0;
+static history_block_t flash_scratch;
+static Mutex flash_mutex;
+#endif
+
+MBED_STATIC_ASSERT(sizeof(history_header_t) <= GATEWAY_FOOTPRINT_HISTORY_HEADER, "A history block header exceeds its size in the footprint profile");
+MBED_STATIC_ASSERT(sizeof(history_block_t) <= GATEWAY_FOOTPRINT_HISTORY_BLOCK, "A history block exceeds its size in the footprint profile");
+MBED_STATIC_ASSERT(GATEWAY_HISTORY_FLASH_BLOCKS * sizeof(history_block_t) <= GATEWAY_FOOTPRINT_HISTORY_KVSTORE, "History blocks exceed their KVStore share of the footprint profile");
+
+#if GATEWAY_HISTORY_FLASH_BLOCKS > 0
+MBED_STATIC_ASSERT(sizeof(ram_blocks) + sizeof(pending_block) + sizeof(flash_headers) + sizeof(flash_scratch) <= GATEWAY_FOOTPRINT_HISTORY_RAM, "History blocks exceed their share of the footprint profile");
+#else
+MBED_STATIC_ASSERT(sizeof(ram_blocks) <= GATEWAY_FOOTPRINT_HISTORY_RAM, "History blocks exceed their share of the footprint profile");
+#endif
+
+static uint32_t put_varint(uint8_t* out, uint32_t value)
+{
+    uint32_t len = 0;
+
+    while (value >= 0x80)
+    {
+        out[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[len++] = (uint8_t)value;
+    return len;
+}
+
+static bool get_varint(const uint8_t* data, uint32_t size, uint32_t* offset, uint32_t* value)
+{
+    uint32_t shift = 0;
+
+    *value = 0;
+    while (*offset < size && shift < 35)
+    {
+        uint8_t byte = data[(*offset)++];
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+        shift += 7;
+    }
+    return false;
+}
+
+static uint32_t zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static void cursor_init(history_cursor_t* cursor, const history_block_t* block)
+{
+    cursor->block          = block;
+    cursor->offset         = 0;
+    cursor->index          = 0;
+    cursor->record.seq     = block->header.first_seq;
+    cursor->record.time_ms = block->header.first_ms;
+    cursor->record.src     = MESH_ADDR_UNASSIGNED;
+    cursor->record.opcode  = MESH_PDU_OPCODE_INVALID;
+    cursor->record.len     = 0;
+}
+
+/* Decodes the next record of the block into cursor->record */
+static bool cursor_next(history_cursor_t* cursor)
+{
+    const uint8_t* data = cursor->block->data;
+    uint32_t used = cursor->block->header.used;
+    uint32_t delta_ms;
+    uint32_t addr;
+    uint32_t len;
+
+    if (cursor->index == cursor->block->header.count ||
+        !get_varint(data, used, &cursor->offset, &delta_ms) ||
+        !get_varint(data, used, &cursor->offset, &addr))
+    {
+        return false;
+    }
+    if ((addr & 1) == 0 && !get_varint(data, used, &cursor->offset, &cursor->record.opcode))
+    {
+        return false;
+    }
+    if (!get_varint(data, used, &cursor->offset, &len) || len > GATEWAY_HISTORY_MAX_STATE_LEN || cursor->offset + len > used)
+    {
+        return false;
+    }
+
+    if (cursor->index > 0)
+    {
+        cursor->record.seq++;
+    }
+    cursor->record.time_ms += delta_ms;
+    cursor->record.src      = (uint16_t)(cursor->record.src + unzigzag(addr >> 1));
+    cursor->record.len      = (uint8_t)len;
+    memcpy(cursor->record.state, &data[cursor->offset], len);
+    cursor->offset += len;
+    cursor->index++;
+    return true;
+}
+
+static void update_gauges(void)
+{
+    gateway_metrics_set(GATEWAY_GAUGE_HISTORY_RECORDS, history_stats.records);
+    gateway_metrics_set(GATEWAY_GAUGE_HISTORY_BYTES, history_stats.bytes);
+}
+
+static void block_open(history_block_t* block, uint32_t now)
+{
+    block->header.first_seq = next_seq;
+    block->header.first_ms  = now;
+    block->header.last_ms   = now;
+    block->header.used      = 0;
+    block->header.count     = 0;
+    last_src    = MESH_ADDR_UNASSIGNED;
+    last_opcode = MESH_PDU_OPCODE_INVALID;
+}
+
+/* Makes room for a new block at the end of the RAM ring; called with history_mutex held */
+static void ram_advance(uint32_t now)
+{
+    if (ram_count == GATEWAY_HISTORY_RAM_BLOCKS)
+    {
+        history_block_t* oldest = &ram_blocks[ram_head];
+#if GATEWAY_HISTORY_FLASH_BLOCKS > 0
+        if (!pending)
+        {
+            memcpy(&pending_block, oldest, HISTORY_BLOCK_BYTES(oldest));
+            pending = true;
+        }
+        else
+#endif
+        {
+            history_stats.records -= oldest->header.count;
+            history_stats.bytes   -= oldest->header.used;
+            history_stats.dropped_blocks++;
+        }
+        ram_head = (ram_head + 1) % GATEWAY_HISTORY_RAM_BLOCKS;
+        ram_count--;
+    }
+    block_open(&ram_blocks[(ram_head + ram_count) % GATEWAY_HISTORY_RAM_BLOCKS], now);
+    ram_count++;
+}
+
+cy_rslt_t gateway_history_init(void)
+{
+    history_mutex.lock();
+    memset(&history_stats, 0, sizeof(history_stats));
+    ram_head  = 0;
+    ram_count = 0;
+    next_seq  = 0;
+#if GATEWAY_HISTORY_FLASH_BLOCKS > 0
+    pending = false;
+#endif
+    ram_advance((uint32_t)Kernel::get_ms_count());
+    history_mutex.unlock();
+
+#if GATEWAY_HISTORY_FLASH_BLOCKS > 0
+    flash_mutex.lock();
+    flash_head  = 0;
+    flash_count = 0;
+    flash_mutex.unlock();
+#endif
+    return CY_RSLT_SUCCESS;
+}
+
+void gateway_history_record(const mesh_pdu_t* pdu)
+{
+    uint8_t encoded[HISTORY_RECORD_MAX];
+    uint32_t now = (uint32_t)Kernel::get_ms_count();
+    uint32_t len = 0;
+    uint32_t attempt;
+    history_block_t* block;
+
+    if (!pdu || pdu->opcode == MESH_PDU_OPCODE_INVALID || pdu->params_len > GATEWAY_HISTORY_MAX_STATE_LEN)
+    {
+        return;
+    }
+
+    history_mutex.lock();
+    block = &ram_blocks[(ram_head + ram_count - 1) % GATEWAY_HISTORY_RAM_BLOCKS];
+    for (attempt = 0; attempt < 2; attempt++)
+    {
+        bool same_opcode = block->header.count > 0 && pdu->opcode == last_opcode;
+
+        len  = put_varint(encoded, now - block->header.last_ms);
+        len += put_varint(&encoded[len], (zigzag((int32_t)pdu->src - (int32_t)last_src) << 1) | (same_opcode ? 1 : 0));
+        if (!same_opcode)
+        {
+            len += put_varint(&encoded[len], pdu->opcode);
+        }
+        len += put_varint(&encoded[len], pdu->params_len);
+        if (pdu->params_len > 0)
+        {
+            memcpy(&encoded[len], pdu->params, pdu->params_len);
+            len += pdu->params_len;
+        }
+
+        if (block->header.used + len <= GATEWAY_HISTORY_BLOCK_SIZE)
+        {
+            break;
+        }
+        /* Full; the record is encoded again against the new block */
+        ram_advance(now);
+        block = &ram_blocks[(ram_head + ram_count - 1) % GATEWAY_HISTORY_RAM_BLOCKS];
+    }
+
+    memcpy(&block->data[block->header.used], encoded, len);
+    block->header.used += len;
+    block->header.count++;
+    block->header.last_ms = now;
+    last_src    = pdu->src;
+    last_opcode = pdu->opcode;
+    next_seq++;
+    history_stats.records++;
+    history_stats.bytes += len;
+    update_gauges();
+    history_mutex.unlock();
+}
+
+void gateway_history_poll(void)
+{
+#if GATEWAY_HISTORY_FLASH_BLOCKS > 0
+    char key[HISTORY_KEY_SIZE];
+    uint32_t slot;
+    bool written;
+
+    history_mutex.lock();
+    written = pending;
+    history_mutex.unlock();
+    if (!written)
+    {
+        return;
+    }
+
+    /* The pending block is not touched by the recording side while 'pending' is set */
+    flash_mutex.lock();
+    if (flash_count == GATEWAY_HISTORY_FLASH_BLOCKS)
+    {
+        slot = flash_head;
+        flash_head = (flash_head + 1) % GATEWAY_HISTORY_FLASH_BLOCKS;
+        flash_count--;
+        history_mutex.lock();
+        history_stats.records -= flash_headers[slot].count;
+        history_stats.bytes   -= flash_headers[slot].used;
+        history_mutex.unlock();
+    }
+    else
+    {
+        slot = (flash_head + flash_count) % GATEWAY_HISTORY_FLASH_BLOCKS;
+    }
+    snprintf(key, sizeof(key), "/kv/hist_%02lu", (unsigned long)slot);
+    written = err_code(kv_set(key, &pending_block, HISTORY_BLOCK_BYTES(&pending_block), 0)) == 0;
+    if (written)
+    {
+        flash_headers[slot] = pending_block.header;
+        flash_count++;
+    }
+    flash_mutex.unlock();
+
+    history_mutex.lock();
+    if (!written)
+    {
+        history_stats.records -= pending_block.header.count;
+        history_stats.bytes   -= pending_block.header.used;
+        history_stats.flash_errors++;
+        history_stats.dropped_blocks++;
+    }
+    update_gauges();
+    pending = false;
+    history_mutex.unlock();
+#endif
+}
+
+uint32_t gateway_history_next_seq(void)
+{
+    uint32_t seq;
+
+    history_mutex.lock();
+    seq = next_seq;
+    history_mutex.unlock();
+    return seq;
+}
+
+void gateway_history_query_init(gateway_history_query_t* query, uint16_t src, uint32_t from_ms, uint32_t to_ms)
+{
+    if (!query)
+    {
+        return;
+    }
+    query->src      = src;
+    query->from_ms  = from_ms;
+    query->to_ms    = to_ms;
+    query->next_seq = 0;
+    query->end_seq  = GATEWAY_HISTORY_TIME_END;
+}
+
+static uint32_t hex_state(char* out, const uint8_t* state, uint32_t len)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    uint32_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        out[2 * i]     = hex[state[i] >> 4];
+        out[2 * i + 1] = hex[state[i] & 0x0F];
+    }
+    out[2 * len] = '\0';
+    return 2 * len;
+}
+
+/* Renders the matching records of 'block'. Returns false once the buffer is full or the query is complete. */
+static bool render_block(const history_block_t* block, gateway_history_query_t* query, char* buffer, uint32_t buffer_len, uint32_t* written)
+{
+    history_cursor_t cursor;
+    char state[2 * GATEWAY_HISTORY_MAX_STATE_LEN + 1];
+
+    if (block->header.first_seq + block->header.count <= query->next_seq)
+    {
+        return true;
+    }
+    if (block->header.last_ms < query->from_ms || block->header.first_ms >= query->to_ms)
+    {
+        /* Nothing in the time range */
+        query->next_seq = block->header.first_seq + block->header.count;
+        return query->next_seq < query->end_seq;
+    }
+
+    cursor_init(&cursor, block);
+    while (cursor_next(&cursor))
+    {
+        const history_record_t* record = &cursor.record;
+        int ret;
+
+        if (record->seq >= query->end_seq)
+        {
+            query->next_seq = query->end_seq;
+            return false;
+        }
+        if (record->seq < query->next_seq)
+        {
+            continue;
+        }
+        if ((query->src == MESH_ADDR_UNASSIGNED || record->src == query->src) &&
+            record->time_ms >= query->from_ms && record->time_ms < query->to_ms)
+        {
+            hex_state(state, record->state, record->len);
+            ret = snprintf(buffer + *written, buffer_len - *written, "%s{\"seq\":%lu,\"src\":\"%04X\",\"t\":%lu,\"opcode\":\"%lX\",\"state\":\"%s\"}",
+                           (*written > 0) ? "," : "", (unsigned long)record->seq, record->src, (unsigned long)record->time_ms,
+                           (unsigned long)record->opcode, state);
+            if (ret < 0 || (uint32_t)ret >= buffer_len - *written)
+            {
+                buffer[*written] = '\0';
+                return false;
+            }
+            *written += ret;
+        }
+        query->next_seq = record->seq + 1;
+    }
+    /* Skip whatever could not be decoded */
+    query->next_seq = block->header.first_seq + block->header.count;
+    return true;
+}
+
+uint32_t gateway_history_render(gateway_history_query_t* query, char* buffer, uint32_t buffer_len)
+{
+    uint32_t written = 0;
+    uint32_t i;
+
+    if (!query || !buffer || buffer_len < GATEWAY_HISTORY_RECORD_JSON_MAX || query->next_seq >= query->end_seq)
+    {
+        return 0;
+    }
+    buffer[0] = '\0';
+
+#if GATEWAY_HISTORY_FLASH_BLOCKS > 0
+    flash_mutex.lock();
+    for (i = 0; i < flash_count; i++)
+    {
+        uint32_t slot = (flash_head + i) % GATEWAY_HISTORY_FLASH_BLOCKS;
+        const history_header_t* header = &flash_headers[slot];
+        char key[HISTORY_KEY_SIZE];
+        size_t actual_size = 0;
+        bool more;
+
+        if (header->first_seq + header->count <= query->next_seq)
+        {
+            continue;
+        }
+        if (header->last_ms < query->from_ms || header->first_ms >= query->to_ms)
+        {
+            /* Decided on the cached header, without reading the block */
+            query->next_seq = header->first_seq + header->count;
+            continue;
+        }
+        snprintf(key, sizeof(key), "/kv/hist_%02lu", (unsigned long)slot);
+        if (err_code(kv_get(key, &flash_scratch, sizeof(flash_scratch), &actual_size)) != 0 ||
+            actual_size < sizeof(history_header_t) || actual_size != HISTORY_BLOCK_BYTES(&flash_scratch))
+        {
+            query->next_seq = header->first_seq + header->count;
+            continue;
+        }
+        more = render_block(&flash_scratch, query, buffer, buffer_len, &written);
+        if (!more)
+        {
+            flash_mutex.unlock();
+            return written;
+        }
+    }
+    flash_mutex.unlock();
+#endif
+
+    history_mutex.lock();
+#if GATEWAY_HISTORY_FLASH_BLOCKS > 0
+    /* Evicted from RAM but not in flash yet */
+    if (pending && !render_block(&pending_block, query, buffer, buffer_len, &written))
+    {
+        history_mutex.unlock();
+        return written;
+    }
+#endif
+    for (i = 0; i < ram_count; i++)
+    {
+        if (!render_block(&ram_blocks[(ram_head + i) % GATEWAY_HISTORY_RAM_BLOCKS], query, buffer, buffer_len, &written))
+        {
+            break;
+        }
+    }
+    if (i == ram_count)
+    {
+        /* Everything recorded so far has been looked at */
+        if (query->end_seq > next_seq)
+        {
+            query->end_seq = next_seq;
+        }
+        if (query->next_seq < query->end_seq)
+        {
+            query->next_seq = query->end_seq;
+        }
+    }
+    history_mutex.unlock();
+
+    return written;
+}
+
+void gateway_history_get_stats(gateway_history_stats_t* stats)
+{
+    if (!stats)
+    {
+        return;
+    }
+
+    history_mutex.lock();
+    memcpy(stats, &history_stats, sizeof(gateway_history_stats_t));
+    stats->oldest_ms = ram_blocks[ram_head].header.first_ms;
+    history_mutex.unlock();
+
+#if GATEWAY_HISTORY_FLASH_BLOCKS > 0
+    flash_mutex.lock();
+    if (flash_count > 0)
+    {
+        stats->oldest_ms = flash_headers[flash_head].first_ms;
+    }
+    flash_mutex.unlock();
+#endif
+}
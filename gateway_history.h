@@ -0,0 +1,110 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway node state history
+ *
+ * Records every state change seen on the uplink (source, opcode, parameters
+ * and time) in a fixed size ring, so that it can be looked at on site and
+ * sent to the cloud after a WAN outage.
+ *
+ * The ring is made of GATEWAY_HISTORY_RAM_BLOCKS blocks of
+ * GATEWAY_HISTORY_BLOCK_SIZE bytes. Within a block each record is stored as
+ * varints relative to the previous one:
+ *
+ *   varint  time since the previous record (ms)
+ *   varint  zigzag(source - previous source) << 1 | same opcode as previous
+ *   varint  opcode, only if it differs
+ *   varint  parameter length, followed by the parameters
+ *
+ * A block starts from its own base time and address 0, so it can be decoded
+ * on its own. When the RAM ring is full its oldest block moves to a ring of
+ * GATEWAY_HISTORY_FLASH_BLOCKS KVStore records, or is dropped if that is 0.
+ * The flash write itself is done by gateway_history_poll() on the network
+ * thread. The history covers the time since boot; the flash ring is reused
+ * from the start after a reset.
+ *
+ * Records are numbered with a sequence number, which queries use as cursor,
+ * and time stamped with the gateway uptime in ms.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+#include "gateway_mesh_pdu.h"
+#include "gateway_footprint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GATEWAY_HISTORY_BLOCK_SIZE          (256)
+#define GATEWAY_HISTORY_RAM_BLOCKS          (GATEWAY_FOOTPRINT_HISTORY_RAM_BLOCKS)
+/* Set to 0 to keep the history in RAM only */
+#define GATEWAY_HISTORY_FLASH_BLOCKS        (GATEWAY_FOOTPRINT_HISTORY_FLASH_BLOCKS)
+/* Longer parameters are not recorded */
+#define GATEWAY_HISTORY_MAX_STATE_LEN       (16)
+/* Space one rendered record can take, separator included */
+#define GATEWAY_HISTORY_RECORD_JSON_MAX     (112)
+/* History messages published per network poll after a reconnect */
+#define GATEWAY_HISTORY_REPLAY_PER_POLL     (2)
+
+#define GATEWAY_HISTORY_TIME_END            (0xFFFFFFFF)
+
+typedef struct
+{
+    uint16_t    src;        /* MESH_ADDR_UNASSIGNED for all nodes */
+    uint32_t    from_ms;
+    uint32_t    to_ms;      /* Exclusive */
+    uint32_t    next_seq;   /* First record not rendered yet */
+    uint32_t    end_seq;    /* Records from here on are not rendered */
+} gateway_history_query_t;
+
+typedef struct
+{
+    uint32_t    records;        /* Held in RAM and flash */
+    uint32_t    bytes;          /* Encoded size of those records */
+    uint32_t    oldest_ms;
+    uint32_t    dropped_blocks;
+    uint32_t    flash_errors;
+} gateway_history_stats_t;
+
+cy_rslt_t gateway_history_init(void);
+
+/* Records the state carried by 'pdu'; packets without an opcode are ignored */
+void gateway_history_record(const mesh_pdu_t* pdu);
+
+/* Moves a block evicted from RAM to flash */
+void gateway_history_poll(void);
+
+/* Sequence number the next record will get */
+uint32_t gateway_history_next_seq(void);
+
+/* Sets up a query for the records of 'src' with from_ms <= time < to_ms */
+void gateway_history_query_init(gateway_history_query_t* query, uint16_t src, uint32_t from_ms, uint32_t to_ms);
+
+/* Renders the next matching records as comma separated JSON objects and advances the cursor. 'buffer_len'
+ * must be at least GATEWAY_HISTORY_RECORD_JSON_MAX. Returns the length written, 0 once the query is complete.
+ */
+uint32_t gateway_history_render(gateway_history_query_t* query, char* buffer, uint32_t buffer_len);
+
+void gateway_history_get_stats(gateway_history_stats_t* stats);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
@@ -23,9 +23,23 @@
 
 #include "gateway_config.h"
 #include "bluetooth_gateway.h"
+#include "gateway_node_cache.h"
+#include "gateway_metrics.h"
+#include "gateway_trace.h"
+#include "gateway_latency.h"
+#include "gateway_alloc.h"
+#include "gateway_threads.h"
+#include "gateway_rules.h"
+#include "gateway_command_dedup.h"
+#include "gateway_fanout.h"
+#include "gateway_proxy_filter.h"
+#include "gateway_history.h"
+#include "cy_string_utils.h"
 
 #define HTTP_SERVER_DEFAULT_PORT            (80)
-#define HTTP_SERVER_DEFAULT_MAX_SOCKETS     (4)
+#define HTTP_SERVER_DEFAULT_MAX_SOCKETS     (GATEWAY_FOOTPRINT_HTTP_SOCKETS)
+#define HTTP_NODE_STATE_JSON_SIZE           (256)
+#define HTTP_HISTORY_CHUNK_SIZE             (512)
 
 static cy_http_response_stream_t* http_event_stream = NULL;
 static cy_network_interface_t http_nw_interface;
@@ -35,17 +49,74 @@ static const char json_object_start         [] = "{";
 static const char json_data_actuator_status [] = "\"data \": \"";
 static const char json_data_end4            [] = "\"}\n";
 
+#if APP_CONFIG_NODE_STATE_CACHE
+static char node_state_json[HTTP_NODE_STATE_JSON_SIZE];
+#endif
+static char heap_report_json[GATEWAY_ALLOC_JSON_SIZE];
+#if APP_CONFIG_LOCAL_RULES
+static char rules_json[MESH_RULES_JSON_SIZE];
+#endif
+#if APP_CONFIG_DOWNLINK_FANOUT
+static char groups_json[GATEWAY_FANOUT_JSON_SIZE];
+#endif
+#if APP_CONFIG_PROXY_FILTER
+static char proxy_nodes_json[GATEWAY_PROXY_FILTER_JSON_SIZE];
+#endif
+#if APP_CONFIG_STATE_HISTORY
+static char history_json[HTTP_HISTORY_CHUNK_SIZE];
+#endif
+
 static const char* gateway_server_uris[] = {
     "/mesh/meshdata/value/*",
     "/mesh/subscribe/sse",
     "/mesh/connect",
     "/mesh/disconnect",
+#if APP_CONFIG_NODE_STATE_CACHE
+    "/mesh/nodestate/value/*",
+#endif
+    "/metrics",
+    "/heap",
+#if APP_CONFIG_LOCAL_RULES
+    "/mesh/rules/value/*",
+    "/mesh/rules",
+#endif
+#if APP_CONFIG_DOWNLINK_FANOUT
+    "/mesh/groups/value/*",
+    "/mesh/groups",
+#endif
+#if APP_CONFIG_PROXY_FILTER
+    "/mesh/proxynodes/value/*",
+    "/mesh/proxynodes",
+#endif
+#if APP_CONFIG_STATE_HISTORY
+    "/mesh/history/value/*",
+#endif
 };
 
 static int32_t http_request_mesh_connect(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body);
 static int32_t http_request_mesh_disconnect(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body);
 static int32_t http_request_mesh_data_received(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body);
 static int32_t http_subscribe_event_request(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body);
+#if APP_CONFIG_NODE_STATE_CACHE
+static int32_t http_request_node_state(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body);
+#endif
+static int32_t http_request_metrics(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body);
+static int32_t http_request_heap(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body);
+#if APP_CONFIG_LOCAL_RULES
+static int32_t http_request_rule_set(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body);
+static int32_t http_request_rules(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body);
+#endif
+#if APP_CONFIG_DOWNLINK_FANOUT
+static int32_t http_request_group_set(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body);
+static int32_t http_request_groups(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body);
+#endif
+#if APP_CONFIG_PROXY_FILTER
+static int32_t http_request_proxy_nodes_set(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body);
+static int32_t http_request_proxy_nodes(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body);
+#endif
+#if APP_CONFIG_STATE_HISTORY
+static int32_t http_request_history(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body);
+#endif
 
 static cy_resource_dynamic_data_t gateway_server_resources[] =
 {
@@ -53,6 +124,26 @@ static cy_resource_dynamic_data_t gateway_server_resources[] =
     { http_subscribe_event_request,     NULL},
     { http_request_mesh_connect,        NULL},
     { http_request_mesh_disconnect,     NULL},
+#if APP_CONFIG_NODE_STATE_CACHE
+    { http_request_node_state,          NULL},
+#endif
+    { http_request_metrics,             NULL},
+    { http_request_heap,                NULL},
+#if APP_CONFIG_LOCAL_RULES
+    { http_request_rule_set,            NULL},
+    { http_request_rules,               NULL},
+#endif
+#if APP_CONFIG_DOWNLINK_FANOUT
+    { http_request_group_set,           NULL},
+    { http_request_groups,              NULL},
+#endif
+#if APP_CONFIG_PROXY_FILTER
+    { http_request_proxy_nodes_set,     NULL},
+    { http_request_proxy_nodes,         NULL},
+#endif
+#if APP_CONFIG_STATE_HISTORY
+    { http_request_history,             NULL},
+#endif
 };
 
 static void hex_bytes_to_chars( char* cptr, const uint8_t* bptr, uint32_t blen )
@@ -114,33 +205,261 @@ static char* get_payload( const char* url_path )
     return current_path;
 }
 
+/* Finds the value of the "id" query parameter, e.g. "id=cmd-42&..." */
+static const char* get_query_param(const char* url_parameters, const char* name, uint32_t* value_len)
+{
+    const char* param = url_parameters;
+    uint32_t name_len = strlen(name);
+
+    *value_len = 0;
+    while (param && *param != '\0')
+    {
+        const char* end = strchr(param, '&');
+        uint32_t param_len = end ? (uint32_t)(end - param) : strlen(param);
+        if (param_len > name_len + 1 && strncmp(param, name, name_len) == 0 && param[name_len] == '=')
+        {
+            *value_len = param_len - name_len - 1;
+            return param + name_len + 1;
+        }
+        param = end ? end + 1 : NULL;
+    }
+    return NULL;
+}
+
 static int32_t http_request_mesh_data_received(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body)
 {
+    /* /mesh/meshdata/value/<hex proxy packet>[?id=<command id>] */
+    uint32_t received_us = gateway_metrics_now_us();
     char* payload = get_payload(url_path);
+    uint32_t id_len = 0;
+    const char* id = get_query_param(url_parameters, "id", &id_len);
+
+#if APP_CONFIG_COMMAND_DEDUP
+    if (gateway_command_dedup_is_duplicate(id, id_len))
+    {
+        /* Already sent; the retry is answered like the original */
+        http_server->http_response_stream_write_header(stream, CY_HTTP_200_TYPE, CHUNKED_CONTENT_LENGTH, CY_HTTP_CACHE_DISABLED, MIME_TYPE_TEXT_PLAIN);
+        http_server->http_response_stream_disconnect(stream);
+        return CY_RSLT_SUCCESS;
+    }
+#endif
+    gateway_latency_handle_t trace = gateway_latency_start(received_us, id, id_len);
+    gateway_latency_stamp(trace, GATEWAY_LATENCY_STAGE_PARSED);
+    if (!payload || gateway_mesh_tx_post(GATEWAY_MESH_TX_DATA, payload, trace, MESH_ADDR_UNASSIGNED) != CY_RSLT_SUCCESS)
+    {
+        gateway_latency_abort(trace);
+#if APP_CONFIG_COMMAND_DEDUP
+        /* Not sent, so the client's retry must not be dropped as a duplicate */
+        gateway_command_dedup_forget(id, id_len);
+#endif
+        http_server->http_response_stream_write_header(stream, CY_HTTP_400_TYPE, CHUNKED_CONTENT_LENGTH, CY_HTTP_CACHE_DISABLED, MIME_TYPE_TEXT_PLAIN);
+        http_server->http_response_stream_disconnect(stream);
+        return CY_RSLT_MW_ERROR;
+    }
     http_server->http_response_stream_write_header(stream, CY_HTTP_200_TYPE, CHUNKED_CONTENT_LENGTH, CY_HTTP_CACHE_DISABLED, MIME_TYPE_TEXT_PLAIN);
-    http_server->http_response_stream_disconnect( stream );
-    do_mesh_send_data(payload);
+    http_server->http_response_stream_disconnect(stream);
     return CY_RSLT_SUCCESS;
 }
 
 static int32_t http_request_mesh_connect(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body)
 {
-    MESH_GATEWAY_INFO(("\n [HTTP] %s",__func__));
+    MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_INFO, "[HTTP] %s\n", __func__);
     http_server->http_response_stream_write_header(stream, CY_HTTP_200_TYPE, CHUNKED_CONTENT_LENGTH, CY_HTTP_CACHE_DISABLED, MIME_TYPE_TEXT_PLAIN);
     http_server->http_response_stream_disconnect(stream);
-    do_mesh_connect();
+    gateway_mesh_tx_post(GATEWAY_MESH_TX_CONNECT, NULL, GATEWAY_LATENCY_NO_TRACE, MESH_ADDR_UNASSIGNED);
     return CY_RSLT_SUCCESS;
 }
 
 static int32_t http_request_mesh_disconnect(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body)
 {
-    MESH_GATEWAY_INFO(("\n [HTTP] %s",__func__));
+    MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_INFO, "[HTTP] %s\n", __func__);
+    http_server->http_response_stream_write_header(stream, CY_HTTP_200_TYPE, CHUNKED_CONTENT_LENGTH, CY_HTTP_CACHE_DISABLED, MIME_TYPE_TEXT_PLAIN);
+    http_server->http_response_stream_disconnect(stream);
+    gateway_mesh_tx_post(GATEWAY_MESH_TX_DISCONNECT, NULL, GATEWAY_LATENCY_NO_TRACE, MESH_ADDR_UNASSIGNED);
+    return CY_RSLT_SUCCESS;
+}
+
+#if APP_CONFIG_NODE_STATE_CACHE
+static int32_t http_request_node_state(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body)
+{
+    /* /mesh/nodestate/value/<node address in hex> */
+    char* payload = get_payload(url_path);
+    uint32_t src = 0;
+    uint32_t len = 0;
+
+    if (payload && strlen(payload) > 0 && strlen(payload) <= 4)
+    {
+        if (cy_string_to_unsigned(payload, strlen(payload), &src, 1) != 0)
+        {
+            len = mesh_node_cache_to_json((uint16_t)src, node_state_json, sizeof(node_state_json));
+        }
+    }
+
+    if (len == 0)
+    {
+        http_server->http_response_stream_write_header(stream, CY_HTTP_400_TYPE, CHUNKED_CONTENT_LENGTH, CY_HTTP_CACHE_DISABLED, MIME_TYPE_TEXT_PLAIN);
+        http_server->http_response_stream_disconnect(stream);
+        return CY_RSLT_SUCCESS;
+    }
+
+    http_server->http_response_stream_write_header(stream, CY_HTTP_200_TYPE, CHUNKED_CONTENT_LENGTH, CY_HTTP_CACHE_DISABLED, MIME_TYPE_JSON);
+    http_server->http_response_stream_write(stream, node_state_json, len);
+    http_server->http_response_stream_disconnect(stream);
+    return CY_RSLT_SUCCESS;
+}
+#endif
+
+static void http_metrics_writer(const char* text, uint32_t length, void* arg)
+{
+    http_server->http_response_stream_write((cy_http_response_stream_t*)arg, text, length);
+}
+
+static int32_t http_request_metrics(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body)
+{
     http_server->http_response_stream_write_header(stream, CY_HTTP_200_TYPE, CHUNKED_CONTENT_LENGTH, CY_HTTP_CACHE_DISABLED, MIME_TYPE_TEXT_PLAIN);
+    gateway_metrics_write_text(http_metrics_writer, stream);
     http_server->http_response_stream_disconnect(stream);
-    do_mesh_disconnect();
     return CY_RSLT_SUCCESS;
 }
 
+static int32_t http_request_heap(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body)
+{
+    uint32_t len = gateway_alloc_report_to_json(heap_report_json, sizeof(heap_report_json));
+
+    http_server->http_response_stream_write_header(stream, CY_HTTP_200_TYPE, CHUNKED_CONTENT_LENGTH, CY_HTTP_CACHE_DISABLED, MIME_TYPE_JSON);
+    http_server->http_response_stream_write(stream, heap_report_json, len);
+    http_server->http_response_stream_disconnect(stream);
+    return CY_RSLT_SUCCESS;
+}
+
+#if APP_CONFIG_LOCAL_RULES
+static int32_t http_request_rules(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body)
+{
+    uint32_t len = mesh_rules_to_json(rules_json, sizeof(rules_json));
+
+    http_server->http_response_stream_write_header(stream, CY_HTTP_200_TYPE, CHUNKED_CONTENT_LENGTH, CY_HTTP_CACHE_DISABLED, MIME_TYPE_JSON);
+    http_server->http_response_stream_write(stream, rules_json, len);
+    http_server->http_response_stream_disconnect(stream);
+    return CY_RSLT_SUCCESS;
+}
+
+static int32_t http_request_rule_set(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body)
+{
+    /* /mesh/rules/value/<src>,<opcode>[,<hex proxy packet>...] */
+    char* payload = get_payload(url_path);
+
+    if (!payload || mesh_rules_apply_request(payload, strlen(payload)) != CY_RSLT_SUCCESS)
+    {
+        http_server->http_response_stream_write_header(stream, CY_HTTP_400_TYPE, CHUNKED_CONTENT_LENGTH, CY_HTTP_CACHE_DISABLED, MIME_TYPE_TEXT_PLAIN);
+        http_server->http_response_stream_disconnect(stream);
+        return CY_RSLT_SUCCESS;
+    }
+    return http_request_rules(url_path, url_parameters, stream, arg, http_message_body);
+}
+#endif
+
+#if APP_CONFIG_DOWNLINK_FANOUT
+static int32_t http_request_groups(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body)
+{
+    uint32_t len = gateway_fanout_groups_to_json(groups_json, sizeof(groups_json));
+
+    http_server->http_response_stream_write_header(stream, CY_HTTP_200_TYPE, CHUNKED_CONTENT_LENGTH, CY_HTTP_CACHE_DISABLED, MIME_TYPE_JSON);
+    http_server->http_response_stream_write(stream, groups_json, len);
+    http_server->http_response_stream_disconnect(stream);
+    return CY_RSLT_SUCCESS;
+}
+
+static int32_t http_request_group_set(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body)
+{
+    /* /mesh/groups/value/<group>[,<member>,...] */
+    char* payload = get_payload(url_path);
+
+    if (!payload || gateway_fanout_apply_request(payload, strlen(payload)) != CY_RSLT_SUCCESS)
+    {
+        http_server->http_response_stream_write_header(stream, CY_HTTP_400_TYPE, CHUNKED_CONTENT_LENGTH, CY_HTTP_CACHE_DISABLED, MIME_TYPE_TEXT_PLAIN);
+        http_server->http_response_stream_disconnect(stream);
+        return CY_RSLT_SUCCESS;
+    }
+    return http_request_groups(url_path, url_parameters, stream, arg, http_message_body);
+}
+#endif
+
+#if APP_CONFIG_PROXY_FILTER
+static int32_t http_request_proxy_nodes(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body)
+{
+    uint32_t len = gateway_proxy_filter_to_json(proxy_nodes_json, sizeof(proxy_nodes_json));
+
+    http_server->http_response_stream_write_header(stream, CY_HTTP_200_TYPE, CHUNKED_CONTENT_LENGTH, CY_HTTP_CACHE_DISABLED, MIME_TYPE_JSON);
+    http_server->http_response_stream_write(stream, proxy_nodes_json, len);
+    http_server->http_response_stream_disconnect(stream);
+    return CY_RSLT_SUCCESS;
+}
+
+static int32_t http_request_proxy_nodes_set(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body)
+{
+    /* /mesh/proxynodes/value/<addr>,<addr>,... */
+    char* payload = get_payload(url_path);
+
+    if (!payload || gateway_proxy_filter_apply_request(payload, strlen(payload)) != CY_RSLT_SUCCESS)
+    {
+        http_server->http_response_stream_write_header(stream, CY_HTTP_400_TYPE, CHUNKED_CONTENT_LENGTH, CY_HTTP_CACHE_DISABLED, MIME_TYPE_TEXT_PLAIN);
+        http_server->http_response_stream_disconnect(stream);
+        return CY_RSLT_SUCCESS;
+    }
+    return http_request_proxy_nodes(url_path, url_parameters, stream, arg, http_message_body);
+}
+#endif
+
+#if APP_CONFIG_STATE_HISTORY
+static uint32_t get_time_param(const char* url_parameters, const char* name, uint32_t default_ms)
+{
+    uint32_t value_len = 0;
+    const char* value = get_query_param(url_parameters, name, &value_len);
+    uint32_t time_ms = 0;
+
+    if (!value || value_len > 10 || cy_string_to_unsigned(value, value_len, &time_ms, 0) == 0)
+    {
+        return default_ms;
+    }
+    return time_ms;
+}
+
+static int32_t http_request_history(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body)
+{
+    /* /mesh/history/value/<node address in hex, or "all">[?from=<uptime ms>&to=<uptime ms>] */
+    char* payload = get_payload(url_path);
+    gateway_history_query_t query;
+    uint32_t src = MESH_ADDR_UNASSIGNED;
+    uint32_t len;
+    bool first = true;
+
+    if (!payload || (strcmp(payload, "all") != 0 &&
+        (strlen(payload) == 0 || strlen(payload) > 4 || cy_string_to_unsigned(payload, strlen(payload), &src, 1) == 0)))
+    {
+        http_server->http_response_stream_write_header(stream, CY_HTTP_400_TYPE, CHUNKED_CONTENT_LENGTH, CY_HTTP_CACHE_DISABLED, MIME_TYPE_TEXT_PLAIN);
+        http_server->http_response_stream_disconnect(stream);
+        return CY_RSLT_SUCCESS;
+    }
+
+    gateway_history_query_init(&query, (uint16_t)src, get_time_param(url_parameters, "from", 0),
+                               get_time_param(url_parameters, "to", GATEWAY_HISTORY_TIME_END));
+
+    http_server->http_response_stream_write_header(stream, CY_HTTP_200_TYPE, CHUNKED_CONTENT_LENGTH, CY_HTTP_CACHE_DISABLED, MIME_TYPE_JSON);
+    len = snprintf(history_json, sizeof(history_json), "{\"now\":%lu,\"records\":[", (unsigned long)Kernel::get_ms_count());
+    http_server->http_response_stream_write(stream, history_json, len);
+    /* The records are rendered a chunk at a time, so the history is not locked while the stream is written */
+    while ((len = gateway_history_render(&query, history_json + 1, sizeof(history_json) - 1)) > 0)
+    {
+        history_json[0] = ',';
+        http_server->http_response_stream_write(stream, first ? history_json + 1 : history_json, first ? len : len + 1);
+        first = false;
+    }
+    http_server->http_response_stream_write(stream, "]}", 2);
+    http_server->http_response_stream_disconnect(stream);
+    return CY_RSLT_SUCCESS;
+}
+#endif
+
 static int32_t http_subscribe_event_request(const char* url_path, const char* url_parameters, cy_http_response_stream_t* stream, void* arg, cy_http_message_body_t* http_message_body)
 {
     MESH_GATEWAY_INFO(("\n [HTTP] %s \n",__func__));
@@ -159,8 +478,6 @@ static int32_t http_subscribe_event_request(const char* url_path, const char* ur
 
 cy_rslt_t http_response(uint8_t* value, int len)
 {
-    int i;
-
     if (http_event_stream == NULL)
     {
         MESH_GATEWAY_ERROR(("\n [App] Error sending HTTP Response: Server-side Event stream is not set\n"));
@@ -173,24 +490,20 @@ cy_rslt_t http_response(uint8_t* value, int len)
         return CY_RSLT_ERROR;
     }
 
-    char*  adv_data = (char*) malloc( sizeof(char) * ((len*2) + 1) );
+    char*  adv_data = (char*) gateway_malloc( GATEWAY_ALLOC_TAG_HTTP_RESPONSE, sizeof(char) * ((len*2) + 1) );
     if (!adv_data)
     {
         MESH_GATEWAY_ERROR(("\n [App] Failed to malloc while sending HTTP Response"));
         return CY_RSLT_ERROR;
     }
 
+    gateway_metrics_increment(GATEWAY_COUNTER_HTTP_EVENTS, 1);
     http_server->http_response_stream_write( http_event_stream, json_object_start, sizeof( json_object_start ) - 1 );
     http_server->http_response_stream_write( http_event_stream, json_data_actuator_status, sizeof( json_data_actuator_status ) - 1 );
 
-    for( i = 0; i < ( len ); i++ )
-    {
-        printf("%x",value[i]);
-    }
-
     hex_bytes_to_chars(adv_data, value, len);
     adv_data[len*2] = 0;
-    MESH_GATEWAY_INFO(("\n [App] sending HTTP response[Payload: %s ]\n",adv_data));
+    MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_DEBUG, "[App] sending HTTP response (%d bytes)\n", len);
 
     http_server->http_response_stream_write( http_event_stream, adv_data, strlen(adv_data) );
     http_server->http_response_stream_write( http_event_stream, json_data_end4, sizeof( json_data_end4 ) - 1 );
@@ -198,12 +511,12 @@ cy_rslt_t http_response(uint8_t* value, int len)
 
     if (value[0] == 0x00 && value[1] == 0x00 )
     {
-        MESH_GATEWAY_INFO(("\n [App] http_response : disconnecting the stream \n"));
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_INFO, "[App] http_response : disconnecting the stream\n");
         http_server->http_response_stream_disconnect(http_event_stream);
         http_event_stream = NULL;
     }
 
-    free(adv_data);
+    gateway_free(adv_data);
 
     return CY_RSLT_SUCCESS;
 }
@@ -226,7 +539,7 @@ cy_rslt_t setup_http_server(NetworkInterface* network)
         return CY_RSLT_ERROR;
     }
 
-    for (int i=0; i < 4; i++)
+    for (uint32_t i=0; i < sizeof(gateway_server_uris) / sizeof(gateway_server_uris[0]); i++)
     {
         http_server->register_resource((uint8_t*)gateway_server_uris[i], (uint8_t*)"application/json",
                             CY_RAW_DYNAMIC_URL_CONTENT, (void *)&gateway_server_resources[i]);
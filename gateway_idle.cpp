@@ -0,0 +1,68 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway idle scheduling implementation
+ */
+
+#include "mbed.h"
+
+#include "gateway_idle.h"
+#include "gateway_metrics.h"
+
+uint32_t gateway_idle_until(uint32_t now, uint32_t due_ms)
+{
+    int32_t remaining = (int32_t)(due_ms - now);
+
+    return remaining > 0 ? (uint32_t)remaining : 0;
+}
+
+uint32_t gateway_idle_align(uint32_t now, uint32_t delay_ms)
+{
+    uint32_t due = now + delay_ms;
+    uint32_t remainder = due % GATEWAY_IDLE_SLOT_MSEC;
+
+    if (delay_ms == GATEWAY_IDLE_FOREVER || remainder == 0)
+    {
+        return delay_ms;
+    }
+    return delay_ms + (GATEWAY_IDLE_SLOT_MSEC - remainder);
+}
+
+uint32_t gateway_idle_slot_start(uint32_t now)
+{
+    return now - (now % GATEWAY_IDLE_SLOT_MSEC);
+}
+
+void gateway_idle_wakeup(gateway_wake_cause_t cause)
+{
+    switch (cause)
+    {
+        case GATEWAY_WAKE_QUEUE:
+            gateway_metrics_increment(GATEWAY_COUNTER_WAKEUPS_QUEUE, 1);
+            break;
+        case GATEWAY_WAKE_SOCKET:
+            gateway_metrics_increment(GATEWAY_COUNTER_WAKEUPS_SOCKET, 1);
+            break;
+        case GATEWAY_WAKE_TIMER:
+            gateway_metrics_increment(GATEWAY_COUNTER_WAKEUPS_TIMER, 1);
+            break;
+        case GATEWAY_WAKE_HEARTBEAT:
+            gateway_metrics_increment(GATEWAY_COUNTER_WAKEUPS_HEARTBEAT, 1);
+            break;
+    }
+}
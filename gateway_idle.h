@@ -0,0 +1,71 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway idle scheduling
+ *
+ * The worker threads do not wake up at a fixed rate. Each one blocks until a
+ * message is queued for it, MQTT traffic arrives, or the earliest timer of
+ * the modules it polls is due; the polls return the time until they need to
+ * run again (GATEWAY_IDLE_FOREVER when nothing is pending). With tickless
+ * idle the MCU sleeps in between.
+ *
+ * Timers that can be a little late (heartbeats, metrics, sensor windows,
+ * the MQTT yield while idle) are moved to the next GATEWAY_IDLE_SLOT_MSEC
+ * boundary of the uptime, so that the threads and the MQTT keepalive wake
+ * up together instead of one after the other.
+ *
+ * Every wakeup is counted by cause in the "wakeups_*" metrics. The share of
+ * the uptime the MCU slept is in the "sleep_pct" gauge when the platform CPU
+ * statistics are enabled.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GATEWAY_IDLE_FOREVER                (0xFFFFFFFF)
+/* The MQTT keepalive must be a multiple of it */
+#define GATEWAY_IDLE_SLOT_MSEC              (1000)
+
+typedef enum
+{
+    GATEWAY_WAKE_QUEUE,         /* A message was queued for the thread */
+    GATEWAY_WAKE_SOCKET,        /* An MQTT yield window, which also sends the keepalive */
+    GATEWAY_WAKE_TIMER,         /* A module timer was due */
+    GATEWAY_WAKE_HEARTBEAT      /* Nothing was due; the thread reports to the supervisor */
+} gateway_wake_cause_t;
+
+/* Time from 'now' until 'due_ms', or 0 once it has passed */
+uint32_t gateway_idle_until(uint32_t now, uint32_t due_ms);
+
+/* Extends a delay of 'delay_ms' from 'now' to the next slot boundary */
+uint32_t gateway_idle_align(uint32_t now, uint32_t delay_ms);
+
+/* Start of the slot 'now' falls in. Periodic timers count from it, so that their period stays on the boundaries. */
+uint32_t gateway_idle_slot_start(uint32_t now);
+
+void gateway_idle_wakeup(gateway_wake_cause_t cause);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
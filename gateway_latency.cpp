@@ -0,0 +1,276 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway end-to-end latency tracing implementation
+ */
+
+#include "mbed.h"
+
+#include "gateway_config.h"
+#include "gateway_latency.h"
+#include "gateway_metrics.h"
+#include "gateway_mesh_pdu.h"
+
+#define LATENCY_HANDLE(slot, generation)    ((((uint32_t)(generation)) << 8) | ((slot) + 1))
+#define LATENCY_HANDLE_SLOT(handle)         (((handle) & 0xFF) - 1)
+
+typedef struct
+{
+    gateway_latency_handle_t    handle;
+    bool                        sent;
+    uint16_t                    dst;
+    uint32_t                    started_ms;
+    uint32_t                    stamps_us[GATEWAY_LATENCY_STAGE_MAX];
+    char                        id[GATEWAY_LATENCY_ID_MAX_LEN + 1];
+} latency_trace_t;
+
+static latency_trace_t latency_traces[GATEWAY_LATENCY_MAX_TRACES];
+static uint32_t latency_generation = 0;
+static uint32_t latency_next_id = 1;
+static gateway_latency_report_callback_t report_callback = NULL;
+static Mutex latency_mutex;
+
+/* Must be called with latency_mutex held */
+static latency_trace_t* find_trace(gateway_latency_handle_t handle)
+{
+    uint32_t slot;
+
+    if (handle == GATEWAY_LATENCY_NO_TRACE)
+    {
+        return NULL;
+    }
+    slot = LATENCY_HANDLE_SLOT(handle);
+    if (slot >= GATEWAY_LATENCY_MAX_TRACES || latency_traces[slot].handle != handle)
+    {
+        /* Completed, aborted or recycled meanwhile */
+        return NULL;
+    }
+    return &latency_traces[slot];
+}
+
+void gateway_latency_init(gateway_latency_report_callback_t callback)
+{
+    latency_mutex.lock();
+    memset(latency_traces, 0, sizeof(latency_traces));
+    report_callback = callback;
+    latency_mutex.unlock();
+}
+
+gateway_latency_handle_t gateway_latency_start(uint32_t received_us, const char* id, uint32_t id_len)
+{
+    uint32_t now = (uint32_t)Kernel::get_ms_count();
+    latency_trace_t* trace = NULL;
+    uint32_t slot = 0;
+    uint32_t i;
+
+    latency_mutex.lock();
+    for (i = 0; i < GATEWAY_LATENCY_MAX_TRACES; i++)
+    {
+        latency_trace_t* candidate = &latency_traces[i];
+        if (candidate->handle != GATEWAY_LATENCY_NO_TRACE && (now - candidate->started_ms) >= GATEWAY_LATENCY_TIMEOUT_MSEC)
+        {
+            /* The node never answered */
+            gateway_metrics_increment(GATEWAY_COUNTER_COMMAND_TIMEOUTS, 1);
+            candidate->handle = GATEWAY_LATENCY_NO_TRACE;
+        }
+        if (!trace && candidate->handle == GATEWAY_LATENCY_NO_TRACE)
+        {
+            trace = candidate;
+            slot = i;
+        }
+    }
+
+    if (!trace)
+    {
+        latency_mutex.unlock();
+        return GATEWAY_LATENCY_NO_TRACE;
+    }
+
+    memset(trace, 0, sizeof(latency_trace_t));
+    latency_generation = (latency_generation + 1) & 0x00FFFFFF;
+    trace->handle     = LATENCY_HANDLE(slot, latency_generation);
+    trace->started_ms = now;
+    trace->stamps_us[GATEWAY_LATENCY_STAGE_RECEIVED] = received_us;
+    if (id && id_len > 0)
+    {
+        id_len = (id_len > GATEWAY_LATENCY_ID_MAX_LEN) ? GATEWAY_LATENCY_ID_MAX_LEN : id_len;
+        for (i = 0; i < id_len; i++)
+        {
+            /* The ID is echoed in JSON; keep it free of characters that need escaping */
+            trace->id[i] = (id[i] == '"' || id[i] == '\\' || (uint8_t)id[i] < 0x20) ? '_' : id[i];
+        }
+    }
+    else
+    {
+        snprintf(trace->id, sizeof(trace->id), "gw-%lu", (unsigned long)latency_next_id++);
+    }
+    gateway_latency_handle_t handle = trace->handle;
+    latency_mutex.unlock();
+
+    return handle;
+}
+
+void gateway_latency_stamp(gateway_latency_handle_t handle, gateway_latency_stage_t stage)
+{
+    uint32_t now_us = gateway_metrics_now_us();
+    latency_trace_t* trace;
+
+    latency_mutex.lock();
+    trace = find_trace(handle);
+    if (trace && stage < GATEWAY_LATENCY_STAGE_MAX)
+    {
+        trace->stamps_us[stage] = now_us;
+    }
+    latency_mutex.unlock();
+}
+
+void gateway_latency_sent(gateway_latency_handle_t handle, uint16_t dst)
+{
+    uint32_t now_us = gateway_metrics_now_us();
+    latency_trace_t* trace;
+    uint32_t parse_us;
+    uint32_t queue_us;
+    uint32_t send_us;
+
+    latency_mutex.lock();
+    trace = find_trace(handle);
+    if (!trace)
+    {
+        latency_mutex.unlock();
+        return;
+    }
+    trace->stamps_us[GATEWAY_LATENCY_STAGE_SENT] = now_us;
+    trace->dst = dst;
+    parse_us = trace->stamps_us[GATEWAY_LATENCY_STAGE_PARSED] - trace->stamps_us[GATEWAY_LATENCY_STAGE_RECEIVED];
+    queue_us = trace->stamps_us[GATEWAY_LATENCY_STAGE_QUEUED] - trace->stamps_us[GATEWAY_LATENCY_STAGE_PARSED];
+    send_us  = now_us - trace->stamps_us[GATEWAY_LATENCY_STAGE_QUEUED];
+#if APP_CONFIG_MESH_PDU_DECRYPTED
+    /* Only unicast commands get a reply that can be matched */
+    trace->sent = (dst != MESH_ADDR_UNASSIGNED && (dst & 0x8000) == 0);
+#else
+    /* The destination of an encrypted command is unknown, so no reply can be matched */
+    trace->sent = false;
+#endif
+    if (!trace->sent)
+    {
+        trace->handle = GATEWAY_LATENCY_NO_TRACE;
+    }
+    latency_mutex.unlock();
+
+    /* The gateway side stages are known once the command is handed to the mesh */
+    gateway_metrics_observe(GATEWAY_HISTOGRAM_COMMAND_PARSE_US, parse_us);
+    gateway_metrics_observe(GATEWAY_HISTOGRAM_COMMAND_QUEUE_US, queue_us);
+    gateway_metrics_observe(GATEWAY_HISTOGRAM_COMMAND_SEND_US, send_us);
+}
+
+void gateway_latency_get_id(gateway_latency_handle_t handle, char* id, uint32_t id_size)
+{
+    latency_trace_t* trace;
+
+    if (!id || id_size == 0)
+    {
+        return;
+    }
+    id[0] = '\0';
+
+    latency_mutex.lock();
+    trace = find_trace(handle);
+    if (trace)
+    {
+        snprintf(id, id_size, "%s", trace->id);
+    }
+    latency_mutex.unlock();
+}
+
+void gateway_latency_abort(gateway_latency_handle_t handle)
+{
+    latency_trace_t* trace;
+
+    latency_mutex.lock();
+    trace = find_trace(handle);
+    if (trace)
+    {
+        trace->handle = GATEWAY_LATENCY_NO_TRACE;
+    }
+    latency_mutex.unlock();
+}
+
+bool gateway_latency_complete(uint16_t src)
+{
+    uint32_t now_us = gateway_metrics_now_us();
+    gateway_latency_report_t report;
+    latency_trace_t* oldest = NULL;
+    uint32_t i;
+
+    latency_mutex.lock();
+    for (i = 0; i < GATEWAY_LATENCY_MAX_TRACES; i++)
+    {
+        latency_trace_t* trace = &latency_traces[i];
+        if (trace->handle != GATEWAY_LATENCY_NO_TRACE && trace->sent && trace->dst == src &&
+            (!oldest || (int32_t)(trace->stamps_us[GATEWAY_LATENCY_STAGE_SENT] - oldest->stamps_us[GATEWAY_LATENCY_STAGE_SENT]) < 0))
+        {
+            oldest = trace;
+        }
+    }
+
+    if (!oldest)
+    {
+        latency_mutex.unlock();
+        return false;
+    }
+
+    memcpy(report.id, oldest->id, sizeof(report.id));
+    report.dst      = oldest->dst;
+    report.parse_us = oldest->stamps_us[GATEWAY_LATENCY_STAGE_PARSED] - oldest->stamps_us[GATEWAY_LATENCY_STAGE_RECEIVED];
+    report.queue_us = oldest->stamps_us[GATEWAY_LATENCY_STAGE_QUEUED] - oldest->stamps_us[GATEWAY_LATENCY_STAGE_PARSED];
+    report.send_us  = oldest->stamps_us[GATEWAY_LATENCY_STAGE_SENT] - oldest->stamps_us[GATEWAY_LATENCY_STAGE_QUEUED];
+    report.mesh_us  = now_us - oldest->stamps_us[GATEWAY_LATENCY_STAGE_SENT];
+    report.total_us = now_us - oldest->stamps_us[GATEWAY_LATENCY_STAGE_RECEIVED];
+    oldest->handle  = GATEWAY_LATENCY_NO_TRACE;
+    latency_mutex.unlock();
+
+    gateway_metrics_observe(GATEWAY_HISTOGRAM_COMMAND_MESH_US, report.mesh_us);
+    gateway_metrics_observe(GATEWAY_HISTOGRAM_COMMAND_TOTAL_US, report.total_us);
+
+    if (report_callback)
+    {
+        report_callback(&report);
+    }
+    return true;
+}
+
+uint32_t gateway_latency_report_to_json(const gateway_latency_report_t* report, char* buffer, uint32_t buffer_len)
+{
+    int ret;
+
+    if (!report || !buffer)
+    {
+        return 0;
+    }
+
+    ret = snprintf(buffer, buffer_len,
+                   "{\"id\":\"%s\",\"dst\":\"%04X\",\"parse_us\":%lu,\"queue_us\":%lu,\"send_us\":%lu,\"mesh_us\":%lu,\"total_us\":%lu}",
+                   report->id, report->dst, (unsigned long)report->parse_us, (unsigned long)report->queue_us,
+                   (unsigned long)report->send_us, (unsigned long)report->mesh_us, (unsigned long)report->total_us);
+
+    if (ret < 0 || (uint32_t)ret >= buffer_len)
+    {
+        return 0;
+    }
+    return ret;
+}
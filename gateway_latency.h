@@ -0,0 +1,102 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway end-to-end latency tracing
+ *
+ * Every downlink command gets a correlation ID (the optional "id" of the
+ * command, or a gateway generated number) and is time stamped when it is
+ * received, parsed, queued for the mesh and handed to Mesh::sendData. The
+ * parse, queue and send stages are recorded when the command is sent, where
+ * 'queue' is the wait before the command is picked up for sending and 'send'
+ * covers payload conversion and the downlink throttle.
+ *
+ * With APP_CONFIG_MESH_PDU_DECRYPTED, the first uplink message from the
+ * command's unicast destination closes the trace and adds the mesh stage,
+ * the time from Mesh::sendData until the node's reply is received:
+ *
+ *   total = parse + queue + send + mesh
+ *
+ * Without it the destination is unknown and the trace ends when sent.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GATEWAY_LATENCY_MAX_TRACES          (8)
+#define GATEWAY_LATENCY_TIMEOUT_MSEC        (5000)
+#define GATEWAY_LATENCY_ID_MAX_LEN          (24)
+
+/* Publish the per-stage breakdown of every completed command on the ack topic */
+#define GATEWAY_LATENCY_ECHO_IN_ACK         (1)
+
+#define GATEWAY_LATENCY_NO_TRACE            (0)
+
+typedef uint32_t gateway_latency_handle_t;
+
+typedef enum
+{
+    GATEWAY_LATENCY_STAGE_RECEIVED,
+    GATEWAY_LATENCY_STAGE_PARSED,
+    GATEWAY_LATENCY_STAGE_QUEUED,
+    GATEWAY_LATENCY_STAGE_SENT,
+    GATEWAY_LATENCY_STAGE_MAX
+} gateway_latency_stage_t;
+
+typedef struct
+{
+    char        id[GATEWAY_LATENCY_ID_MAX_LEN + 1];
+    uint16_t    dst;
+    uint32_t    parse_us;
+    uint32_t    queue_us;
+    uint32_t    send_us;
+    uint32_t    mesh_us;
+    uint32_t    total_us;
+} gateway_latency_report_t;
+
+typedef void (*gateway_latency_report_callback_t)(const gateway_latency_report_t* report);
+
+void gateway_latency_init(gateway_latency_report_callback_t callback);
+
+/* Opens a trace stamped at 'received_us'. 'id' may be NULL, in which case a number is assigned. */
+gateway_latency_handle_t gateway_latency_start(uint32_t received_us, const char* id, uint32_t id_len);
+
+void gateway_latency_stamp(gateway_latency_handle_t handle, gateway_latency_stage_t stage);
+
+/* Marks the command as handed to Mesh::sendData for destination 'dst' and records the gateway stages */
+void gateway_latency_sent(gateway_latency_handle_t handle, uint16_t dst);
+
+/* Copies the correlation ID of a trace into 'id'; empty if the trace is gone */
+void gateway_latency_get_id(gateway_latency_handle_t handle, char* id, uint32_t id_size);
+
+/* Drops a trace whose command was not sent */
+void gateway_latency_abort(gateway_latency_handle_t handle);
+
+/* Closes the oldest trace waiting for a reply from 'src'. Returns true if one was found. */
+bool gateway_latency_complete(uint16_t src);
+
+uint32_t gateway_latency_report_to_json(const gateway_latency_report_t* report, char* buffer, uint32_t buffer_len);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
@@ -0,0 +1,240 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway LZ compression implementation
+ */
+
+#include <string.h>
+
+#include "gateway_lz.h"
+
+#define LZ_MIN_MATCH            (4)
+/* The format requires the last 5 bytes to be literals and the last match to start 12 bytes before the end */
+#define LZ_LAST_LITERALS        (5)
+#define LZ_MATCH_LIMIT          (12)
+#define LZ_MAX_OFFSET           (0xFFFF)
+#define LZ_MAX_INPUT            (0xFFFF)
+#define LZ_EMPTY                (0xFFFF)
+
+static_assert((GATEWAY_LZ_HASH_SIZE & (GATEWAY_LZ_HASH_SIZE - 1)) == 0, "GATEWAY_LZ_HASH_SIZE must be a power of two");
+
+static uint32_t read32(const uint8_t* p)
+{
+    uint32_t value;
+
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t lz_hash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> 24 & (GATEWAY_LZ_HASH_SIZE - 1);
+}
+
+/* Writes the continuation bytes of a length that did not fit in its nibble */
+static bool put_length(uint8_t* dst, uint32_t dst_cap, uint32_t* out, uint32_t length)
+{
+    while (length >= 255)
+    {
+        if (*out >= dst_cap)
+        {
+            return false;
+        }
+        dst[(*out)++] = 255;
+        length -= 255;
+    }
+    if (*out >= dst_cap)
+    {
+        return false;
+    }
+    dst[(*out)++] = (uint8_t)length;
+    return true;
+}
+
+/* Emits 'literal_len' literals followed by a match, or the literals only if 'match_len' is 0 */
+static bool put_sequence(uint8_t* dst, uint32_t dst_cap, uint32_t* out, const uint8_t* literals, uint32_t literal_len,
+                         uint32_t offset, uint32_t match_len)
+{
+    uint32_t token_pos = *out;
+    uint32_t match_code = match_len ? match_len - LZ_MIN_MATCH : 0;
+
+    if (*out >= dst_cap)
+    {
+        return false;
+    }
+    dst[token_pos] = (uint8_t)(((literal_len < 15 ? literal_len : 15) << 4) | (match_code < 15 ? match_code : 15));
+    (*out)++;
+
+    if (literal_len >= 15 && !put_length(dst, dst_cap, out, literal_len - 15))
+    {
+        return false;
+    }
+    if (*out + literal_len > dst_cap)
+    {
+        return false;
+    }
+    memcpy(&dst[*out], literals, literal_len);
+    *out += literal_len;
+
+    if (match_len == 0)
+    {
+        return true;
+    }
+    if (*out + 2 > dst_cap)
+    {
+        return false;
+    }
+    dst[(*out)++] = (uint8_t)offset;
+    dst[(*out)++] = (uint8_t)(offset >> 8);
+    return match_code < 15 || put_length(dst, dst_cap, out, match_code - 15);
+}
+
+uint32_t gateway_lz_compress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_cap)
+{
+    uint16_t table[GATEWAY_LZ_HASH_SIZE];
+    uint32_t anchor = 0;
+    uint32_t ip = 0;
+    uint32_t out = 0;
+
+    if (!src || !dst || src_len > LZ_MAX_INPUT)
+    {
+        return 0;
+    }
+
+    memset(table, 0xFF, sizeof(table));
+    if (src_len > LZ_MATCH_LIMIT)
+    {
+        uint32_t match_start_limit = src_len - LZ_MATCH_LIMIT;
+        uint32_t match_end_limit = src_len - LZ_LAST_LITERALS;
+
+        while (ip < match_start_limit)
+        {
+            uint32_t sequence = read32(&src[ip]);
+            uint32_t h = lz_hash(sequence);
+            uint32_t ref = table[h];
+            uint32_t match_len;
+
+            table[h] = (uint16_t)ip;
+            if (ref == LZ_EMPTY || ip - ref > LZ_MAX_OFFSET || read32(&src[ref]) != sequence)
+            {
+                ip++;
+                continue;
+            }
+
+            match_len = LZ_MIN_MATCH;
+            while (ip + match_len < match_end_limit && src[ref + match_len] == src[ip + match_len])
+            {
+                match_len++;
+            }
+            if (!put_sequence(dst, dst_cap, &out, &src[anchor], ip - anchor, ip - ref, match_len))
+            {
+                return 0;
+            }
+            ip += match_len;
+            anchor = ip;
+        }
+    }
+
+    if (!put_sequence(dst, dst_cap, &out, &src[anchor], src_len - anchor, 0, 0))
+    {
+        return 0;
+    }
+    return out;
+}
+
+int32_t gateway_lz_decompress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_cap)
+{
+    uint32_t ip = 0;
+    uint32_t op = 0;
+
+    if (!src || !dst || src_len == 0)
+    {
+        return -1;
+    }
+
+    while (ip < src_len)
+    {
+        uint8_t token = src[ip++];
+        uint32_t literal_len = token >> 4;
+        uint32_t match_len = token & 0x0F;
+        uint32_t offset;
+        uint8_t byte;
+
+        if (literal_len == 15)
+        {
+            do
+            {
+                if (ip >= src_len)
+                {
+                    return -1;
+                }
+                byte = src[ip++];
+                literal_len += byte;
+            } while (byte == 255);
+        }
+        if (literal_len > src_len - ip || literal_len > dst_cap - op)
+        {
+            return -1;
+        }
+        memcpy(&dst[op], &src[ip], literal_len);
+        ip += literal_len;
+        op += literal_len;
+
+        if (ip == src_len)
+        {
+            /* The last sequence has no match */
+            return (int32_t)op;
+        }
+
+        if (src_len - ip < 2)
+        {
+            return -1;
+        }
+        offset = src[ip] | ((uint32_t)src[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op)
+        {
+            return -1;
+        }
+
+        if (match_len == 15)
+        {
+            do
+            {
+                if (ip >= src_len)
+                {
+                    return -1;
+                }
+                byte = src[ip++];
+                match_len += byte;
+            } while (byte == 255);
+        }
+        match_len += LZ_MIN_MATCH;
+        if (match_len > dst_cap - op)
+        {
+            return -1;
+        }
+        /* Byte by byte: the match may overlap the bytes it produces */
+        while (match_len-- > 0)
+        {
+            dst[op] = dst[op - offset];
+            op++;
+        }
+    }
+    return -1;
+}
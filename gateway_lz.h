@@ -0,0 +1,65 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway LZ compression
+ *
+ * A small LZ77 compressor producing the LZ4 block format, so that frames
+ * compressed on the gateway can be decompressed on the cloud side either
+ * with gateway_lz_decompress() or with any LZ4 library
+ * (LZ4_decompress_safe()). A block is a sequence of
+ *
+ *   token        literal length (high nibble), match length - 4 (low nibble);
+ *                15 means the length continues in the following bytes
+ *   [length]     bytes of 255 followed by the remainder
+ *   literals
+ *   offset       2 bytes little endian, back into the decompressed data
+ *   [length]     match length continuation
+ *
+ * where the last sequence has literals only.
+ *
+ * Matches are found through a hash table of GATEWAY_LZ_HASH_SIZE entries
+ * indexed by the next four bytes, which is the only state (512 bytes, on the
+ * caller's stack). Inputs are limited to 64 KB.
+ *
+ * This file has no mbed or middleware dependencies and builds as is on a
+ * host.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Must be a power of two */
+#define GATEWAY_LZ_HASH_SIZE                (256)
+
+/* Largest compressed size of 'len' input bytes */
+#define GATEWAY_LZ_BOUND(len)               ((len) + (len) / 255 + 16)
+
+/* Compresses 'src' into 'dst'. Returns the compressed length, or 0 if it does not fit in 'dst_cap'. */
+uint32_t gateway_lz_compress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_cap);
+
+/* Decompresses a block into 'dst'. Returns the decompressed length, or -1 if the block is malformed or does not fit. */
+int32_t gateway_lz_decompress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_cap);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
@@ -0,0 +1,304 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway SIG model message decoder implementation
+ */
+
+#include "mbed.h"
+
+#include "gateway_mesh_decode.h"
+#include "gateway_sensor_agg.h"
+
+MBED_STATIC_ASSERT(MESH_SENSOR_MAX_PROPERTIES_PER_STATUS <= MESH_DECODE_MAX_FIELDS, "a Sensor Status must fit a record");
+
+/* Field types: size in bytes, with the sign flag for two's complement values */
+#define FIELD_SIGNED            (0x80)
+#define FIELD_U8                (1)
+#define FIELD_U16               (2)
+#define FIELD_S16               (2 | FIELD_SIGNED)
+
+struct message_decoder_t;
+typedef cy_rslt_t (*decode_fn_t)(const message_decoder_t* decoder, const mesh_pdu_t* pdu, mesh_decoded_t* record);
+
+/* Messages end with an optional group of fields that is either complete or absent */
+struct message_decoder_t
+{
+    uint32_t            opcode;
+    const char*         message;
+    decode_fn_t         decode;
+    const char* const*  field_names;
+    uint8_t             required;
+    uint8_t             total;
+    uint8_t             types[MESH_DECODE_MAX_FIELDS];
+};
+
+static cy_rslt_t decode_fields(const message_decoder_t* decoder, const mesh_pdu_t* pdu, mesh_decoded_t* record);
+static cy_rslt_t decode_sensor(const message_decoder_t* decoder, const mesh_pdu_t* pdu, mesh_decoded_t* record);
+
+static const char* const onoff_set_fields[]     = { "onoff", "tid", "transition_time", "delay" };
+static const char* const onoff_status_fields[]  = { "present", "target", "remaining_time" };
+static const char* const level_set_fields[]     = { "level", "tid", "transition_time", "delay" };
+static const char* const lightness_set_fields[] = { "lightness", "tid", "transition_time", "delay" };
+static const char* const ctl_set_fields[]       = { "lightness", "temperature", "delta_uv", "tid", "transition_time", "delay" };
+static const char* const ctl_status_fields[]    = { "present_lightness", "present_temperature", "target_lightness", "target_temperature", "remaining_time" };
+static const char* const hsl_set_fields[]       = { "lightness", "hue", "saturation", "tid", "transition_time", "delay" };
+static const char* const hsl_status_fields[]    = { "lightness", "hue", "saturation", "remaining_time" };
+
+/* Must stay sorted by opcode */
+static constexpr message_decoder_t message_decoders[] =
+{
+    { 0x52,   "sensor_status",                  decode_sensor, NULL,                 0, 0, { 0 } },
+    { 0x8202, "generic_onoff_set",              decode_fields, onoff_set_fields,     2, 4, { FIELD_U8, FIELD_U8, FIELD_U8, FIELD_U8 } },
+    { 0x8203, "generic_onoff_set_unack",        decode_fields, onoff_set_fields,     2, 4, { FIELD_U8, FIELD_U8, FIELD_U8, FIELD_U8 } },
+    { 0x8204, "generic_onoff_status",           decode_fields, onoff_status_fields,  1, 3, { FIELD_U8, FIELD_U8, FIELD_U8 } },
+    { 0x8206, "generic_level_set",              decode_fields, level_set_fields,     2, 4, { FIELD_S16, FIELD_U8, FIELD_U8, FIELD_U8 } },
+    { 0x8207, "generic_level_set_unack",        decode_fields, level_set_fields,     2, 4, { FIELD_S16, FIELD_U8, FIELD_U8, FIELD_U8 } },
+    { 0x8208, "generic_level_status",           decode_fields, onoff_status_fields,  1, 3, { FIELD_S16, FIELD_S16, FIELD_U8 } },
+    { 0x824C, "light_lightness_set",            decode_fields, lightness_set_fields, 2, 4, { FIELD_U16, FIELD_U8, FIELD_U8, FIELD_U8 } },
+    { 0x824D, "light_lightness_set_unack",      decode_fields, lightness_set_fields, 2, 4, { FIELD_U16, FIELD_U8, FIELD_U8, FIELD_U8 } },
+    { 0x824E, "light_lightness_status",         decode_fields, onoff_status_fields,  1, 3, { FIELD_U16, FIELD_U16, FIELD_U8 } },
+    { 0x825E, "light_ctl_set",                  decode_fields, ctl_set_fields,       4, 6, { FIELD_U16, FIELD_U16, FIELD_S16, FIELD_U8, FIELD_U8, FIELD_U8 } },
+    { 0x825F, "light_ctl_set_unack",            decode_fields, ctl_set_fields,       4, 6, { FIELD_U16, FIELD_U16, FIELD_S16, FIELD_U8, FIELD_U8, FIELD_U8 } },
+    { 0x8260, "light_ctl_status",               decode_fields, ctl_status_fields,    2, 5, { FIELD_U16, FIELD_U16, FIELD_U16, FIELD_U16, FIELD_U8 } },
+    { 0x8276, "light_hsl_set",                  decode_fields, hsl_set_fields,       4, 6, { FIELD_U16, FIELD_U16, FIELD_U16, FIELD_U8, FIELD_U8, FIELD_U8 } },
+    { 0x8277, "light_hsl_set_unack",            decode_fields, hsl_set_fields,       4, 6, { FIELD_U16, FIELD_U16, FIELD_U16, FIELD_U8, FIELD_U8, FIELD_U8 } },
+    { 0x8278, "light_hsl_status",               decode_fields, hsl_status_fields,    3, 4, { FIELD_U16, FIELD_U16, FIELD_U16, FIELD_U8 } },
+};
+
+#define MESSAGE_DECODER_COUNT   (sizeof(message_decoders) / sizeof(message_decoders[0]))
+
+static constexpr bool decoders_sorted(uint32_t index)
+{
+    return (index + 1 >= MESSAGE_DECODER_COUNT) ||
+           (message_decoders[index].opcode < message_decoders[index + 1].opcode && decoders_sorted(index + 1));
+}
+
+static constexpr bool decoders_consistent(uint32_t index)
+{
+    return (index >= MESSAGE_DECODER_COUNT) ||
+           (message_decoders[index].required <= message_decoders[index].total &&
+            message_decoders[index].total <= MESH_DECODE_MAX_FIELDS && decoders_consistent(index + 1));
+}
+
+static_assert(decoders_sorted(0), "message_decoders must be sorted by opcode");
+static_assert(decoders_consistent(0), "message_decoders has an invalid field count");
+
+static const message_decoder_t* find_decoder(uint32_t opcode)
+{
+    uint32_t low = 0;
+    uint32_t high = MESSAGE_DECODER_COUNT;
+
+    while (low < high)
+    {
+        uint32_t mid = (low + high) / 2;
+        if (message_decoders[mid].opcode == opcode)
+        {
+            return &message_decoders[mid];
+        }
+        if (message_decoders[mid].opcode < opcode)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return NULL;
+}
+
+static uint32_t fields_size(const message_decoder_t* decoder, uint32_t from, uint32_t to)
+{
+    uint32_t size = 0;
+    uint32_t i;
+
+    for (i = from; i < to; i++)
+    {
+        size += decoder->types[i] & ~FIELD_SIGNED;
+    }
+    return size;
+}
+
+static cy_rslt_t decode_fields(const message_decoder_t* decoder, const mesh_pdu_t* pdu, mesh_decoded_t* record)
+{
+    uint32_t required_size = fields_size(decoder, 0, decoder->required);
+    uint32_t count = decoder->required;
+    uint32_t offset = 0;
+    uint32_t i;
+
+    if (pdu->params_len == required_size + fields_size(decoder, decoder->required, decoder->total))
+    {
+        count = decoder->total;
+    }
+    else if (pdu->params_len != required_size)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        uint8_t type = decoder->types[i];
+        int32_t value = pdu->params[offset];
+
+        if ((type & ~FIELD_SIGNED) == 2)
+        {
+            value |= (int32_t)pdu->params[offset + 1] << 8;
+            if (type & FIELD_SIGNED)
+            {
+                value = (int16_t)value;
+            }
+        }
+        record->fields[i].id    = (uint16_t)i;
+        record->fields[i].value = value;
+        offset += type & ~FIELD_SIGNED;
+    }
+    record->field_count = (uint8_t)count;
+    return CY_RSLT_SUCCESS;
+}
+
+static cy_rslt_t decode_sensor(const message_decoder_t* decoder, const mesh_pdu_t* pdu, mesh_decoded_t* record)
+{
+    mesh_sensor_reading_t readings[MESH_SENSOR_MAX_PROPERTIES_PER_STATUS];
+    int count = mesh_sensor_decode_status(pdu->params, pdu->params_len, readings);
+    int i;
+
+    (void)decoder;
+    if (count <= 0)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+    for (i = 0; i < count; i++)
+    {
+        record->fields[i].id    = readings[i].property_id;
+        record->fields[i].value = readings[i].value;
+    }
+    record->field_count = (uint8_t)count;
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t mesh_decode(const mesh_pdu_t* pdu, mesh_decoded_t* record)
+{
+    const message_decoder_t* decoder;
+
+    if (!pdu || !record || pdu->opcode == MESH_PDU_OPCODE_INVALID)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+    decoder = find_decoder(pdu->opcode);
+    if (!decoder)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    record->src         = pdu->src;
+    record->dst         = pdu->dst;
+    record->opcode      = pdu->opcode;
+    record->message     = decoder->message;
+    record->field_names = decoder->field_names;
+    record->field_count = 0;
+    return decoder->decode(decoder, pdu, record);
+}
+
+#if MESH_DECODE_FORMAT == MESH_DECODE_FORMAT_JSON
+static uint32_t render_json(const mesh_decoded_t* record, char* buffer, uint32_t buffer_len)
+{
+    uint32_t written;
+    uint32_t i;
+    int ret;
+
+    ret = snprintf(buffer, buffer_len, "{\"src\":\"%04X\",\"dst\":\"%04X\",\"msg\":\"%s\"",
+                   record->src, record->dst, record->message);
+    if (ret < 0 || (uint32_t)ret >= buffer_len)
+    {
+        return 0;
+    }
+    written = ret;
+
+    for (i = 0; i < record->field_count; i++)
+    {
+        if (record->field_names)
+        {
+            ret = snprintf(buffer + written, buffer_len - written, ",\"%s\":%ld",
+                           record->field_names[i], (long)record->fields[i].value);
+        }
+        else
+        {
+            ret = snprintf(buffer + written, buffer_len - written, ",\"%04X\":%ld",
+                           record->fields[i].id, (long)record->fields[i].value);
+        }
+        if (ret < 0 || (uint32_t)ret >= buffer_len - written)
+        {
+            return 0;
+        }
+        written += ret;
+    }
+
+    ret = snprintf(buffer + written, buffer_len - written, "}");
+    if (ret < 0 || (uint32_t)ret >= buffer_len - written)
+    {
+        return 0;
+    }
+    return written + ret;
+}
+#else
+static uint32_t put_le(uint8_t* buffer, uint32_t value, uint32_t size)
+{
+    uint32_t i;
+
+    for (i = 0; i < size; i++)
+    {
+        buffer[i] = (uint8_t)(value >> (8 * i));
+    }
+    return size;
+}
+
+static uint32_t render_binary(const mesh_decoded_t* record, uint8_t* buffer, uint32_t buffer_len)
+{
+    uint32_t written = 0;
+    uint32_t i;
+
+    if (buffer_len < 9 + (uint32_t)record->field_count * 6)
+    {
+        return 0;
+    }
+
+    written += put_le(buffer + written, record->src, 2);
+    written += put_le(buffer + written, record->dst, 2);
+    written += put_le(buffer + written, record->opcode, 4);
+    buffer[written++] = record->field_count;
+    for (i = 0; i < record->field_count; i++)
+    {
+        written += put_le(buffer + written, record->fields[i].id, 2);
+        written += put_le(buffer + written, (uint32_t)record->fields[i].value, 4);
+    }
+    return written;
+}
+#endif
+
+uint32_t mesh_decode_render(const mesh_decoded_t* record, uint8_t* buffer, uint32_t buffer_len)
+{
+    if (!record || !buffer || buffer_len == 0)
+    {
+        return 0;
+    }
+#if MESH_DECODE_FORMAT == MESH_DECODE_FORMAT_BINARY
+    return render_binary(record, buffer, buffer_len);
+#else
+    return render_json(record, (char*)buffer, buffer_len);
+#endif
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway SIG model message decoder
+ *
+ * Turns the access payload of common SIG model messages (Generic OnOff,
+ * Generic Level, Light Lightness, Light CTL, Light HSL and Sensor Status)
+ * into a record of named integer fields, so that cloud consumers do not have
+ * to parse mesh opcodes themselves. The supported messages are listed in a
+ * compile-time table sorted by opcode; an unknown opcode costs one binary
+ * search of that table.
+ *
+ * A record is rendered either as JSON, e.g.
+ *
+ *   {"src":"0002","dst":"0001","msg":"generic_onoff_status","present":1,"target":0,"remaining_time":10}
+ *
+ * or in a binary form, all integers little endian:
+ *
+ *   src(2) dst(2) opcode(4) count(1) count * (id(2) value(4))
+ *
+ * where 'id' is the property ID of a sensor reading and the position of the
+ * field in the message otherwise.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+#include "gateway_mesh_pdu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MESH_DECODE_MAX_FIELDS              (8)
+#define MESH_DECODE_JSON_SIZE               (256)
+#define MESH_DECODE_BINARY_SIZE             (9 + MESH_DECODE_MAX_FIELDS * 6)
+
+#define MESH_DECODE_FORMAT_JSON             (0)
+#define MESH_DECODE_FORMAT_BINARY           (1)
+#define MESH_DECODE_FORMAT                  MESH_DECODE_FORMAT_JSON
+
+typedef struct
+{
+    uint16_t    id;             /* Property ID of a sensor reading, field position otherwise */
+    int32_t     value;
+} mesh_decoded_field_t;
+
+typedef struct
+{
+    uint16_t                src;
+    uint16_t                dst;
+    uint32_t                opcode;
+    const char*             message;        /* e.g. "generic_onoff_status" */
+    const char* const*      field_names;    /* NULL for sensor readings */
+    uint8_t                 field_count;
+    mesh_decoded_field_t    fields[MESH_DECODE_MAX_FIELDS];
+} mesh_decoded_t;
+
+/* Decodes 'pdu' into 'record'. Fails for unknown opcodes and malformed parameters. */
+cy_rslt_t mesh_decode(const mesh_pdu_t* pdu, mesh_decoded_t* record);
+
+/* Renders 'record' in MESH_DECODE_FORMAT into 'buffer'. Returns the length written. */
+uint32_t mesh_decode_render(const mesh_decoded_t* record, uint8_t* buffer, uint32_t buffer_len);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
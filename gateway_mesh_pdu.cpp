@@ -0,0 +1,136 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway Proxy PDU parser implementation
+ */
+
+#include "mbed.h"
+
+#include "gateway_config.h"
+#include "gateway_mesh_pdu.h"
+
+#define MESH_PROXY_HEADER_LEN           (1)
+#define MESH_NETWORK_HEADER_LEN         (9)
+#define MESH_NETMIC_ACCESS_LEN          (4)
+#define MESH_NETMIC_CONTROL_LEN         (8)
+#define MESH_TRANSMIC_LEN               (4)
+#define MESH_LOWER_TRANSPORT_SEG_BIT    (0x80)
+
+static uint32_t parse_opcode(const uint8_t* data, uint16_t len, uint8_t* opcode_len)
+{
+    if (len == 0 || data[0] == 0x7F)
+    {
+        return MESH_PDU_OPCODE_INVALID;
+    }
+
+    if ((data[0] & 0x80) == 0)
+    {
+        *opcode_len = 1;
+        return data[0];
+    }
+
+    if ((data[0] & 0xC0) == 0x80)
+    {
+        if (len < 2)
+        {
+            return MESH_PDU_OPCODE_INVALID;
+        }
+        *opcode_len = 2;
+        return ((uint32_t)data[0] << 8) | data[1];
+    }
+
+    if (len < 3)
+    {
+        return MESH_PDU_OPCODE_INVALID;
+    }
+    *opcode_len = 3;
+    return ((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | data[2];
+}
+
+cy_rslt_t mesh_pdu_parse(const uint8_t* packet, uint32_t length, mesh_pdu_t* pdu)
+{
+    const uint8_t* net;
+    uint32_t netmic_len;
+    uint32_t transport_len;
+
+    if (!pdu)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    memset(pdu, 0, sizeof(mesh_pdu_t));
+    pdu->opcode = MESH_PDU_OPCODE_INVALID;
+    if (!packet || length < MESH_PROXY_HEADER_LEN)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    pdu->sar    = (packet[0] >> 6) & 0x03;
+    pdu->type   = packet[0] & 0x3F;
+
+    if (pdu->type != MESH_PROXY_TYPE_NETWORK_PDU || pdu->sar != MESH_PROXY_SAR_COMPLETE)
+    {
+        /* Only complete network PDUs carry addressing information */
+        return CY_RSLT_SUCCESS;
+    }
+
+#if !APP_CONFIG_MESH_PDU_DECRYPTED
+    /* The network header is obfuscated and the rest is encrypted */
+    return CY_RSLT_SUCCESS;
+#endif
+
+    net = packet + MESH_PROXY_HEADER_LEN;
+    length -= MESH_PROXY_HEADER_LEN;
+    if (length < MESH_NETWORK_HEADER_LEN + 1)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    netmic_len = (net[1] & 0x80) ? MESH_NETMIC_CONTROL_LEN : MESH_NETMIC_ACCESS_LEN;
+    if (length < MESH_NETWORK_HEADER_LEN + netmic_len + 1)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    pdu->ctl = (net[1] >> 7) & 0x01;
+    pdu->ttl = net[1] & 0x7F;
+    pdu->seq = ((uint32_t)net[2] << 16) | ((uint32_t)net[3] << 8) | net[4];
+    pdu->src = (uint16_t)((net[5] << 8) | net[6]);
+    pdu->dst = (uint16_t)((net[7] << 8) | net[8]);
+    transport_len = length - MESH_NETWORK_HEADER_LEN - netmic_len;
+
+    /* Segmented and control messages have no opcode visible in a single PDU */
+    const uint8_t* transport = net + MESH_NETWORK_HEADER_LEN;
+    if (pdu->ctl || (transport[0] & MESH_LOWER_TRANSPORT_SEG_BIT) || transport_len <= 1 + MESH_TRANSMIC_LEN)
+    {
+        return CY_RSLT_SUCCESS;
+    }
+
+    const uint8_t* access = transport + 1;
+    uint16_t access_len = (uint16_t)(transport_len - 1 - MESH_TRANSMIC_LEN);
+    uint8_t opcode_len = 0;
+
+    pdu->opcode = parse_opcode(access, access_len, &opcode_len);
+    if (pdu->opcode != MESH_PDU_OPCODE_INVALID)
+    {
+        pdu->params     = access + opcode_len;
+        pdu->params_len = (uint16_t)(access_len - opcode_len);
+    }
+
+    return CY_RSLT_SUCCESS;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway Proxy PDU parser
+ *
+ * Proxy packets exchanged with the Mesh controller are laid out as:
+ *
+ *   [0]      SAR(2 bits) | Message type(6 bits)
+ *   [1]      IVI | NID
+ *   [2]      CTL | TTL
+ *   [3..5]   SEQ
+ *   [6..7]   SRC
+ *   [8..9]   DST
+ *   [10..]   Transport PDU followed by the NetMIC(4 bytes, 8 for CTL)
+ *
+ * For an unsegmented access message the Transport PDU starts with the
+ * SEG|AKF|AID octet, followed by the access payload (opcode + parameters)
+ * and the TransMIC(4 bytes).
+ *
+ * On air, the CTL|TTL, SEQ and SRC octets are obfuscated and everything from
+ * DST on is encrypted. The fields are only read when the Mesh controller
+ * hands over decrypted PDUs (APP_CONFIG_MESH_PDU_DECRYPTED); otherwise the
+ * parser fills in the proxy header only, leaving the addresses unassigned.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MESH_PROXY_SAR_COMPLETE             (0x00)
+#define MESH_PROXY_SAR_FIRST                (0x01)
+#define MESH_PROXY_SAR_CONTINUATION         (0x02)
+#define MESH_PROXY_SAR_LAST                 (0x03)
+
+#define MESH_PROXY_TYPE_NETWORK_PDU         (0x00)
+#define MESH_PROXY_TYPE_MESH_BEACON         (0x01)
+#define MESH_PROXY_TYPE_PROXY_CONFIG        (0x02)
+#define MESH_PROXY_TYPE_PROVISIONING        (0x03)
+
+#define MESH_PDU_OPCODE_INVALID             (0xFFFFFFFF)
+
+/* Proxy header and network header, up to the Transport PDU */
+#define MESH_PDU_HEADER_LEN                 (10)
+
+#define MESH_ADDR_UNASSIGNED                (0x0000)
+
+typedef struct
+{
+    uint8_t         sar;
+    uint8_t         type;
+    uint8_t         ctl;
+    uint8_t         ttl;
+    uint32_t        seq;
+    uint16_t        src;
+    uint16_t        dst;
+    uint32_t        opcode;         /* MESH_PDU_OPCODE_INVALID unless an unsegmented access message */
+    const uint8_t*  params;
+    uint16_t        params_len;
+} mesh_pdu_t;
+
+/* Parses a complete proxy packet into 'pdu'. The parameters pointer refers into 'packet'. */
+cy_rslt_t mesh_pdu_parse(const uint8_t* packet, uint32_t length, mesh_pdu_t* pdu);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
@@ -0,0 +1,297 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway runtime metrics implementation
+ */
+
+#include <stdarg.h>
+
+#include "mbed.h"
+
+#include "gateway_metrics.h"
+#include "gateway_uplink_filter.h"
+#include "gateway_alloc.h"
+#include "gateway_spool.h"
+
+typedef struct
+{
+    uint32_t buckets[GATEWAY_METRICS_HISTOGRAM_BUCKETS];
+    uint64_t sum_us;
+} histogram_data_t;
+
+static const char counter_names[GATEWAY_COUNTER_MAX][GATEWAY_METRICS_NAME_MAX + 1] =
+{
+    "uplink_packets",
+    "uplink_bytes",
+    "uplink_publish_errors",
+    "downlink_packets",
+    "downlink_bytes",
+    "downlink_errors",
+    "nvram_writes",
+    "nvram_errors",
+    "http_events",
+    "command_timeouts",
+    "queue_drops",
+    "cloud_reconnects",
+    "uplink_dropped",
+    "rules_fired",
+    "rules_exhausted",
+    "commands_delivered",
+    "commands_failed",
+    "command_duplicates",
+    "command_dedup_evictions",
+    "fanout_group_sends",
+    "uplink_reassembled",
+    "uplink_sar_errors",
+    "uplink_batches",
+    "wakeups_queue",
+    "wakeups_socket",
+    "wakeups_timer",
+    "wakeups_heartbeat",
+};
+
+static const char gauge_names[GATEWAY_GAUGE_MAX][GATEWAY_METRICS_NAME_MAX + 1] =
+{
+    "heap_current_bytes",
+    "heap_max_bytes",
+    "heap_reserved_bytes",
+    "heap_alloc_failures",
+    "uplink_duplicates_suppressed",
+    "uplink_unchanged_suppressed",
+    "pool_exhausted",
+    "spool_depth",
+    "spool_dropped",
+    "cloud_recovery_ms",
+    "cloud_connect_ms",
+    "command_rto_ms",
+    "proxy_filter_size",
+    "history_records",
+    "history_bytes",
+    "uplink_batch_ratio_pct",
+    "warm_restarts",
+    "sleep_pct",
+};
+
+static const char histogram_names[GATEWAY_HISTOGRAM_MAX][GATEWAY_METRICS_NAME_MAX + 1] =
+{
+    "uplink_publish_us",
+    "downlink_send_us",
+    "nvram_write_us",
+    "mqtt_yield_us",
+    "command_parse_us",
+    "command_queue_us",
+    "command_send_us",
+    "command_mesh_us",
+    "command_total_us",
+    "command_ack_us",
+    "uplink_compress_us",
+};
+
+/* Longest line of the text format: the histogram sum and count, with 64 and 32 bit values */
+MBED_STATIC_ASSERT(2 * GATEWAY_METRICS_NAME_MAX + 61 <= GATEWAY_METRICS_LINE_SIZE, "GATEWAY_METRICS_LINE_SIZE is too small for the metric names");
+/* Longest JSON entries: a counter or gauge, and a histogram with all buckets at 32 bit maximum */
+MBED_STATIC_ASSERT(sizeof(",\"\":4294967295") - 1 + GATEWAY_METRICS_NAME_MAX <= GATEWAY_METRICS_NAME_MAX + 14 &&
+                   sizeof(",\"\":{\"sum\":18446744073709551615,\"buckets\":[]}") - 1 + GATEWAY_METRICS_NAME_MAX +
+                   GATEWAY_METRICS_HISTOGRAM_BUCKETS * 11 - 1 <= GATEWAY_METRICS_NAME_MAX + 45 + GATEWAY_METRICS_HISTOGRAM_BUCKETS * 11,
+                   "GATEWAY_METRICS_JSON_SIZE does not cover the registry");
+
+static uint32_t counters[GATEWAY_COUNTER_MAX];
+static uint32_t gauges[GATEWAY_GAUGE_MAX];
+static histogram_data_t histograms[GATEWAY_HISTOGRAM_MAX];
+
+void gateway_metrics_increment(gateway_counter_t counter, uint32_t value)
+{
+    core_util_atomic_incr_u32(&counters[counter], value);
+}
+
+void gateway_metrics_set(gateway_gauge_t gauge, uint32_t value)
+{
+    core_util_atomic_store_u32(&gauges[gauge], value);
+}
+
+void gateway_metrics_observe(gateway_histogram_t histogram, uint32_t value_us)
+{
+    uint32_t bucket = (value_us == 0) ? 0 : (32 - __CLZ(value_us));
+
+    if (bucket >= GATEWAY_METRICS_HISTOGRAM_BUCKETS)
+    {
+        bucket = GATEWAY_METRICS_HISTOGRAM_BUCKETS - 1;
+    }
+    core_util_atomic_incr_u32(&histograms[histogram].buckets[bucket], 1);
+    core_util_atomic_incr_u64(&histograms[histogram].sum_us, value_us);
+}
+
+uint32_t gateway_metrics_now_us(void)
+{
+    return us_ticker_read();
+}
+
+/* Refresh the gauges that are sampled rather than recorded */
+static void sample_gauges(void)
+{
+    mbed_stats_heap_t heap_stats;
+    mesh_uplink_filter_stats_t filter_stats;
+    gateway_pool_stats_t pool_stats;
+    gateway_spool_stats_t spool_stats;
+    uint32_t exhausted = 0;
+    uint32_t i;
+
+    mbed_stats_heap_get(&heap_stats);
+    gateway_metrics_set(GATEWAY_GAUGE_HEAP_CURRENT, heap_stats.current_size);
+    gateway_metrics_set(GATEWAY_GAUGE_HEAP_MAX, heap_stats.max_size);
+    gateway_metrics_set(GATEWAY_GAUGE_HEAP_RESERVED, heap_stats.reserved_size);
+    gateway_metrics_set(GATEWAY_GAUGE_HEAP_ALLOC_FAILURES, heap_stats.alloc_fail_cnt);
+
+#if defined(MBED_CPU_STATS_ENABLED)
+    mbed_stats_cpu_t cpu_stats;
+    mbed_stats_cpu_get(&cpu_stats);
+    if (cpu_stats.uptime > 0)
+    {
+        gateway_metrics_set(GATEWAY_GAUGE_SLEEP_PCT, (uint32_t)((cpu_stats.sleep_time + cpu_stats.deep_sleep_time) * 100 / cpu_stats.uptime));
+    }
+#endif
+
+    mesh_uplink_filter_get_stats(&filter_stats);
+    gateway_metrics_set(GATEWAY_GAUGE_UPLINK_DUPLICATES, filter_stats.duplicates_suppressed);
+    gateway_metrics_set(GATEWAY_GAUGE_UPLINK_UNCHANGED, filter_stats.unchanged_suppressed);
+
+    for (i = 0; i < GATEWAY_POOL_MAX; i++)
+    {
+        gateway_alloc_get_pool_stats((gateway_pool_class_t)i, &pool_stats);
+        exhausted += pool_stats.exhausted;
+    }
+    gateway_metrics_set(GATEWAY_GAUGE_POOL_EXHAUSTED, exhausted);
+
+    gateway_spool_get_stats(&spool_stats);
+    gateway_metrics_set(GATEWAY_GAUGE_SPOOL_DEPTH, spool_stats.depth);
+    gateway_metrics_set(GATEWAY_GAUGE_SPOOL_DROPPED, spool_stats.dropped + spool_stats.too_large);
+}
+
+static void append(char* buffer, uint32_t buffer_len, uint32_t* written, const char* format, ...)
+{
+    va_list args;
+    int ret;
+
+    if (*written >= buffer_len)
+    {
+        return;
+    }
+
+    va_start(args, format);
+    ret = vsnprintf(buffer + *written, buffer_len - *written, format, args);
+    va_end(args);
+
+    /* On truncation mark the buffer as full so nothing partial follows */
+    *written = (ret < 0 || (uint32_t)ret >= buffer_len - *written) ? buffer_len : *written + ret;
+}
+
+/* Upper bound of a bucket in us, as used for the Prometheus "le" label */
+static uint32_t bucket_upper_bound(uint32_t bucket)
+{
+    return (bucket == 0) ? 0 : ((1u << bucket) - 1);
+}
+
+void gateway_metrics_write_text(gateway_metrics_writer_t writer, void* arg)
+{
+    char line[GATEWAY_METRICS_LINE_SIZE];
+    uint32_t i;
+    uint32_t j;
+    int len;
+
+    if (!writer)
+    {
+        return;
+    }
+    sample_gauges();
+
+    for (i = 0; i < GATEWAY_COUNTER_MAX; i++)
+    {
+        len = snprintf(line, sizeof(line), "# TYPE gateway_%s counter\ngateway_%s %lu\n",
+                       counter_names[i], counter_names[i], (unsigned long)core_util_atomic_load_u32(&counters[i]));
+        writer(line, len, arg);
+    }
+
+    for (i = 0; i < GATEWAY_GAUGE_MAX; i++)
+    {
+        len = snprintf(line, sizeof(line), "# TYPE gateway_%s gauge\ngateway_%s %lu\n",
+                       gauge_names[i], gauge_names[i], (unsigned long)core_util_atomic_load_u32(&gauges[i]));
+        writer(line, len, arg);
+    }
+
+    for (i = 0; i < GATEWAY_HISTOGRAM_MAX; i++)
+    {
+        uint32_t cumulative = 0;
+
+        len = snprintf(line, sizeof(line), "# TYPE gateway_%s histogram\n", histogram_names[i]);
+        writer(line, len, arg);
+        for (j = 0; j < GATEWAY_METRICS_HISTOGRAM_BUCKETS - 1; j++)
+        {
+            cumulative += core_util_atomic_load_u32(&histograms[i].buckets[j]);
+            len = snprintf(line, sizeof(line), "gateway_%s_bucket{le=\"%lu\"} %lu\n",
+                           histogram_names[i], (unsigned long)bucket_upper_bound(j), (unsigned long)cumulative);
+            writer(line, len, arg);
+        }
+        cumulative += core_util_atomic_load_u32(&histograms[i].buckets[j]);
+        len = snprintf(line, sizeof(line), "gateway_%s_bucket{le=\"+Inf\"} %lu\n", histogram_names[i], (unsigned long)cumulative);
+        writer(line, len, arg);
+        len = snprintf(line, sizeof(line), "gateway_%s_sum %llu\ngateway_%s_count %lu\n",
+                       histogram_names[i], (unsigned long long)core_util_atomic_load_u64(&histograms[i].sum_us),
+                       histogram_names[i], (unsigned long)cumulative);
+        writer(line, len, arg);
+    }
+}
+
+uint32_t gateway_metrics_to_json(char* buffer, uint32_t buffer_len)
+{
+    uint32_t written = 0;
+    uint32_t i;
+    uint32_t j;
+
+    if (!buffer || buffer_len == 0)
+    {
+        return 0;
+    }
+    sample_gauges();
+
+    append(buffer, buffer_len, &written, "{\"uptime_ms\":%llu", (unsigned long long)Kernel::get_ms_count());
+
+    for (i = 0; i < GATEWAY_COUNTER_MAX; i++)
+    {
+        append(buffer, buffer_len, &written, ",\"%s\":%lu", counter_names[i], (unsigned long)core_util_atomic_load_u32(&counters[i]));
+    }
+
+    for (i = 0; i < GATEWAY_GAUGE_MAX; i++)
+    {
+        append(buffer, buffer_len, &written, ",\"%s\":%lu", gauge_names[i], (unsigned long)core_util_atomic_load_u32(&gauges[i]));
+    }
+
+    for (i = 0; i < GATEWAY_HISTOGRAM_MAX; i++)
+    {
+        append(buffer, buffer_len, &written, ",\"%s\":{\"sum\":%llu,\"buckets\":[",
+               histogram_names[i], (unsigned long long)core_util_atomic_load_u64(&histograms[i].sum_us));
+        for (j = 0; j < GATEWAY_METRICS_HISTOGRAM_BUCKETS; j++)
+        {
+            append(buffer, buffer_len, &written, (j == 0) ? "%lu" : ",%lu", (unsigned long)core_util_atomic_load_u32(&histograms[i].buckets[j]));
+        }
+        append(buffer, buffer_len, &written, "]}");
+    }
+
+    append(buffer, buffer_len, &written, "}");
+
+    return (written >= buffer_len) ? 0 : written;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway runtime metrics
+ *
+ * A static registry of counters, gauges and latency histograms. Recording is
+ * a single atomic increment (two for histograms) so it can be used on the
+ * uplink/downlink hot paths. Histograms use power-of-two microsecond buckets:
+ * bucket 0 holds 0 us, bucket N holds [2^(N-1), 2^N) us and the last bucket
+ * everything above.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GATEWAY_METRICS_HISTOGRAM_BUCKETS       (20)
+#define GATEWAY_METRICS_PUBLISH_INTERVAL_MSEC   (60 * 1000)
+/* Longest metric name; a longer name fails to build */
+#define GATEWAY_METRICS_NAME_MAX                (31)
+#define GATEWAY_METRICS_LINE_SIZE               (2 * GATEWAY_METRICS_NAME_MAX + 64)
+/* The JSON rendering of the whole registry with every value at its maximum */
+#define GATEWAY_METRICS_JSON_SIZE               (35 + (GATEWAY_COUNTER_MAX + GATEWAY_GAUGE_MAX) * (GATEWAY_METRICS_NAME_MAX + 14) + \
+                                                 GATEWAY_HISTOGRAM_MAX * (GATEWAY_METRICS_NAME_MAX + 45 +                     \
+                                                                          GATEWAY_METRICS_HISTOGRAM_BUCKETS * 11))
+
+typedef enum
+{
+    GATEWAY_COUNTER_UPLINK_PACKETS,
+    GATEWAY_COUNTER_UPLINK_BYTES,
+    GATEWAY_COUNTER_UPLINK_PUBLISH_ERRORS,
+    GATEWAY_COUNTER_DOWNLINK_PACKETS,
+    GATEWAY_COUNTER_DOWNLINK_BYTES,
+    GATEWAY_COUNTER_DOWNLINK_ERRORS,
+    GATEWAY_COUNTER_NVRAM_WRITES,
+    GATEWAY_COUNTER_NVRAM_ERRORS,
+    GATEWAY_COUNTER_HTTP_EVENTS,
+    GATEWAY_COUNTER_COMMAND_TIMEOUTS,
+    GATEWAY_COUNTER_QUEUE_DROPS,
+    GATEWAY_COUNTER_CLOUD_RECONNECTS,
+    GATEWAY_COUNTER_UPLINK_DROPPED,
+    GATEWAY_COUNTER_RULES_FIRED,
+    GATEWAY_COUNTER_RULES_EXHAUSTED,
+    GATEWAY_COUNTER_COMMANDS_DELIVERED,
+    GATEWAY_COUNTER_COMMANDS_FAILED,
+    GATEWAY_COUNTER_COMMAND_DUPLICATES,
+    GATEWAY_COUNTER_COMMAND_DEDUP_EVICTIONS,
+    GATEWAY_COUNTER_FANOUT_GROUP_SENDS,
+    GATEWAY_COUNTER_UPLINK_REASSEMBLED,
+    GATEWAY_COUNTER_UPLINK_SAR_ERRORS,
+    GATEWAY_COUNTER_UPLINK_BATCHES,
+    GATEWAY_COUNTER_WAKEUPS_QUEUE,
+    GATEWAY_COUNTER_WAKEUPS_SOCKET,
+    GATEWAY_COUNTER_WAKEUPS_TIMER,
+    GATEWAY_COUNTER_WAKEUPS_HEARTBEAT,
+    GATEWAY_COUNTER_MAX
+} gateway_counter_t;
+
+typedef enum
+{
+    GATEWAY_GAUGE_HEAP_CURRENT,
+    GATEWAY_GAUGE_HEAP_MAX,
+    GATEWAY_GAUGE_HEAP_RESERVED,
+    GATEWAY_GAUGE_HEAP_ALLOC_FAILURES,
+    GATEWAY_GAUGE_UPLINK_DUPLICATES,
+    GATEWAY_GAUGE_UPLINK_UNCHANGED,
+    GATEWAY_GAUGE_POOL_EXHAUSTED,
+    GATEWAY_GAUGE_SPOOL_DEPTH,
+    GATEWAY_GAUGE_SPOOL_DROPPED,
+    GATEWAY_GAUGE_CLOUD_RECOVERY_MSEC,
+    GATEWAY_GAUGE_CLOUD_CONNECT_MSEC,
+    GATEWAY_GAUGE_COMMAND_RTO_MSEC,
+    GATEWAY_GAUGE_PROXY_FILTER_SIZE,
+    GATEWAY_GAUGE_HISTORY_RECORDS,
+    GATEWAY_GAUGE_HISTORY_BYTES,
+    GATEWAY_GAUGE_UPLINK_BATCH_RATIO_PCT,
+    GATEWAY_GAUGE_WARM_RESTARTS,
+    GATEWAY_GAUGE_SLEEP_PCT,
+    GATEWAY_GAUGE_MAX
+} gateway_gauge_t;
+
+typedef enum
+{
+    GATEWAY_HISTOGRAM_UPLINK_PUBLISH_US,
+    GATEWAY_HISTOGRAM_DOWNLINK_SEND_US,
+    GATEWAY_HISTOGRAM_NVRAM_WRITE_US,
+    GATEWAY_HISTOGRAM_MQTT_YIELD_US,
+    GATEWAY_HISTOGRAM_COMMAND_PARSE_US,
+    GATEWAY_HISTOGRAM_COMMAND_QUEUE_US,
+    GATEWAY_HISTOGRAM_COMMAND_SEND_US,
+    GATEWAY_HISTOGRAM_COMMAND_MESH_US,
+    GATEWAY_HISTOGRAM_COMMAND_TOTAL_US,
+    GATEWAY_HISTOGRAM_COMMAND_ACK_US,
+    GATEWAY_HISTOGRAM_UPLINK_COMPRESS_US,
+    GATEWAY_HISTOGRAM_MAX
+} gateway_histogram_t;
+
+void gateway_metrics_increment(gateway_counter_t counter, uint32_t value);
+void gateway_metrics_set(gateway_gauge_t gauge, uint32_t value);
+void gateway_metrics_observe(gateway_histogram_t histogram, uint32_t value_us);
+
+/* Microsecond timestamp for latency measurements */
+uint32_t gateway_metrics_now_us(void);
+
+typedef void (*gateway_metrics_writer_t)(const char* text, uint32_t length, void* arg);
+
+/* Render all metrics in the Prometheus text format, one line at a time through 'writer' */
+void gateway_metrics_write_text(gateway_metrics_writer_t writer, void* arg);
+
+/* Render all metrics as a JSON object. Returns the length written. */
+uint32_t gateway_metrics_to_json(char* buffer, uint32_t buffer_len);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
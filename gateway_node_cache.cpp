@@ -0,0 +1,264 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway node state cache implementation
+ */
+
+#include "mbed.h"
+
+#include "gateway_node_cache.h"
+
+#define MESH_NODE_CACHE_MAX_USED    ((MESH_NODE_CACHE_SLOTS * 3) / 4)
+
+MBED_STATIC_ASSERT((MESH_NODE_CACHE_SLOTS & (MESH_NODE_CACHE_SLOTS - 1)) == 0, "MESH_NODE_CACHE_SLOTS must be a power of two");
+
+static mesh_node_state_t node_cache[MESH_NODE_CACHE_SLOTS];
+/* Slots in use, sorted by (source, opcode) */
+static uint16_t node_order[MESH_NODE_CACHE_MAX_USED];
+
+MBED_STATIC_ASSERT(sizeof(mesh_node_state_t) <= GATEWAY_FOOTPRINT_NODE_CACHE_ENTRY, "A node cache slot exceeds its size in the footprint profile");
+MBED_STATIC_ASSERT(sizeof(node_cache) + sizeof(node_order) <= GATEWAY_FOOTPRINT_NODE_CACHE_RAM, "Node cache slots exceed their share of the footprint profile");
+MBED_STATIC_ASSERT(MESH_NODE_CACHE_SLOTS <= 0x10000, "Node cache slots must be numbered in 16 bits");
+
+static uint32_t node_cache_used = 0;
+static Mutex node_cache_mutex;
+
+static uint32_t node_cache_hash(uint16_t src, uint32_t opcode)
+{
+    uint32_t key = ((uint32_t)src << 16) ^ opcode;
+    return (key * 2654435761u) & (MESH_NODE_CACHE_SLOTS - 1);
+}
+
+/* FNV-1a, 64 bit, of the length and the parameters */
+static uint64_t node_state_digest(const uint8_t* params, uint16_t len)
+{
+    uint64_t hash = 14695981039346656037ull;
+    uint32_t i;
+
+    hash = (hash ^ (uint8_t)len) * 1099511628211ull;
+    hash = (hash ^ (uint8_t)(len >> 8)) * 1099511628211ull;
+    for (i = 0; i < len; i++)
+    {
+        hash ^= params[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/* Returns the slot holding (src, opcode), or the free slot where it belongs. NULL if neither exists. */
+static mesh_node_state_t* node_cache_find(uint16_t src, uint32_t opcode)
+{
+    uint32_t slot = node_cache_hash(src, opcode);
+    uint32_t i;
+
+    for (i = 0; i < MESH_NODE_CACHE_SLOTS; i++)
+    {
+        mesh_node_state_t* entry = &node_cache[slot];
+        if (entry->src == MESH_ADDR_UNASSIGNED || (entry->src == src && entry->opcode == opcode))
+        {
+            return entry;
+        }
+        slot = (slot + 1) & (MESH_NODE_CACHE_SLOTS - 1);
+    }
+    return NULL;
+}
+
+/* Returns the position in node_order of the first slot at or above (src, opcode) */
+static uint32_t node_order_search(uint16_t src, uint32_t opcode)
+{
+    uint32_t low = 0;
+    uint32_t high = node_cache_used;
+
+    while (low < high)
+    {
+        uint32_t mid = (low + high) / 2;
+        const mesh_node_state_t* entry = &node_cache[node_order[mid]];
+
+        if (entry->src < src || (entry->src == src && entry->opcode < opcode))
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+bool mesh_node_cache_update(const mesh_pdu_t* pdu)
+{
+    mesh_node_state_t* entry;
+    uint64_t digest;
+    uint8_t len;
+    bool changed = false;
+
+    if (!pdu || pdu->src == MESH_ADDR_UNASSIGNED || pdu->opcode == MESH_PDU_OPCODE_INVALID)
+    {
+        return false;
+    }
+
+    len = (pdu->params_len > MESH_NODE_CACHE_MAX_STATE_LEN) ? MESH_NODE_CACHE_MAX_STATE_LEN : (uint8_t)pdu->params_len;
+    digest = node_state_digest(pdu->params, pdu->params_len);
+
+    node_cache_mutex.lock();
+    entry = node_cache_find(pdu->src, pdu->opcode);
+    if (entry && entry->src == MESH_ADDR_UNASSIGNED)
+    {
+        if (node_cache_used >= MESH_NODE_CACHE_MAX_USED)
+        {
+            /* Table is full; new nodes are not cached */
+            entry = NULL;
+        }
+        else
+        {
+            uint32_t pos = node_order_search(pdu->src, pdu->opcode);
+
+            memmove(&node_order[pos + 1], &node_order[pos], (node_cache_used - pos) * sizeof(node_order[0]));
+            node_order[pos] = (uint16_t)(entry - node_cache);
+            entry->src    = pdu->src;
+            entry->opcode = pdu->opcode;
+            entry->digest = ~digest;
+            node_cache_used++;
+        }
+    }
+
+    if (entry)
+    {
+        if (entry->digest != digest)
+        {
+            memcpy(entry->state, pdu->params, len);
+            entry->len    = len;
+            entry->digest = digest;
+            changed = true;
+        }
+        entry->updated_ms = (uint32_t)Kernel::get_ms_count();
+    }
+    node_cache_mutex.unlock();
+
+    return changed;
+}
+
+cy_rslt_t mesh_node_cache_lookup(uint16_t src, uint32_t opcode, mesh_node_state_t* state)
+{
+    cy_rslt_t result = CY_RSLT_MW_ERROR;
+    mesh_node_state_t* entry;
+
+    if (!state || src == MESH_ADDR_UNASSIGNED)
+    {
+        return result;
+    }
+
+    node_cache_mutex.lock();
+    entry = node_cache_find(src, opcode);
+    if (entry && entry->src == src)
+    {
+        memcpy(state, entry, sizeof(mesh_node_state_t));
+        result = CY_RSLT_SUCCESS;
+    }
+    node_cache_mutex.unlock();
+
+    return result;
+}
+
+uint16_t mesh_node_cache_next_node(uint16_t src)
+{
+    uint16_t next = MESH_ADDR_UNASSIGNED;
+    uint32_t pos;
+
+    if (src == 0xFFFF)
+    {
+        return next;
+    }
+
+    node_cache_mutex.lock();
+    pos = node_order_search(src + 1, 0);
+    if (pos < node_cache_used)
+    {
+        next = node_cache[node_order[pos]].src;
+    }
+    node_cache_mutex.unlock();
+
+    return next;
+}
+
+uint32_t mesh_node_cache_to_json(uint16_t src, char* buffer, uint32_t buffer_len)
+{
+    uint32_t now = (uint32_t)Kernel::get_ms_count();
+    uint32_t written = 0;
+    uint32_t count = 0;
+    uint32_t pos;
+    int ret;
+
+    if (!buffer || buffer_len == 0)
+    {
+        return 0;
+    }
+
+    ret = snprintf(buffer, buffer_len, "{\"src\":\"%04X\",\"states\":[", src);
+    if (ret < 0 || (uint32_t)ret >= buffer_len)
+    {
+        return 0;
+    }
+    written = ret;
+
+    node_cache_mutex.lock();
+    for (pos = node_order_search(src, 0); pos < node_cache_used; pos++)
+    {
+        const mesh_node_state_t* entry = &node_cache[node_order[pos]];
+        uint8_t j;
+
+        if (entry->src != src)
+        {
+            break;
+        }
+
+        /* Worst case for one state: fixed text + hex of the state bytes */
+        if (written + 64 + (MESH_NODE_CACHE_MAX_STATE_LEN * 2) >= buffer_len)
+        {
+            break;
+        }
+
+        written += snprintf(buffer + written, buffer_len - written, "%s{\"opcode\":\"%lX\",\"state\":\"",
+                            (count > 0) ? "," : "", (unsigned long)entry->opcode);
+        for (j = 0; j < entry->len; j++)
+        {
+            written += snprintf(buffer + written, buffer_len - written, "%02X", entry->state[j]);
+        }
+        written += snprintf(buffer + written, buffer_len - written, "\",\"age_ms\":%lu}",
+                            (unsigned long)(now - entry->updated_ms));
+        count++;
+    }
+    node_cache_mutex.unlock();
+
+    if (written + 3 > buffer_len)
+    {
+        return 0;
+    }
+    written += snprintf(buffer + written, buffer_len - written, "]}");
+
+    return written;
+}
+
+void mesh_node_cache_reset(void)
+{
+    node_cache_mutex.lock();
+    memset(node_cache, 0, sizeof(node_cache));
+    node_cache_used = 0;
+    node_cache_mutex.unlock();
+}
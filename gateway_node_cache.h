@@ -0,0 +1,73 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway node state cache
+ *
+ * Keeps the last known state of every node, keyed by mesh source address and
+ * opcode, so that state queries can be answered without a mesh round trip.
+ * Each slot costs sizeof(mesh_node_state_t) = 32 bytes; the table is an open
+ * addressed hash with MESH_NODE_CACHE_SLOTS slots (8 KB for 256 slots) and is
+ * kept at most 3/4 full, i.e. 192 node/opcode pairs by default.
+ *
+ * Only the first MESH_NODE_CACHE_MAX_STATE_LEN bytes of the parameters are
+ * kept for queries; a change is detected on a digest of all of them. The
+ * used slots are also listed in (source, opcode) order, so that the states of
+ * one node and the next cached node are found with a binary search.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+#include "gateway_mesh_pdu.h"
+#include "gateway_footprint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Must be a power of two */
+#define MESH_NODE_CACHE_SLOTS           (GATEWAY_FOOTPRINT_NODE_CACHE_SLOTS)
+#define MESH_NODE_CACHE_MAX_STATE_LEN   (13)
+
+typedef struct
+{
+    uint64_t    digest;         /* Of the length and all parameters */
+    uint32_t    opcode;
+    uint32_t    updated_ms;
+    uint16_t    src;
+    uint8_t     len;
+    uint8_t     state[MESH_NODE_CACHE_MAX_STATE_LEN];
+} mesh_node_state_t;
+
+/* Stores the parameters of 'pdu'. Returns true if the cached state changed. */
+bool mesh_node_cache_update(const mesh_pdu_t* pdu);
+
+cy_rslt_t mesh_node_cache_lookup(uint16_t src, uint32_t opcode, mesh_node_state_t* state);
+
+/* Returns the lowest cached node address above 'src', or MESH_ADDR_UNASSIGNED after the last one */
+uint16_t mesh_node_cache_next_node(uint16_t src);
+
+/* Renders every cached state of 'src' as JSON into 'buffer'. Returns the length written. */
+uint32_t mesh_node_cache_to_json(uint16_t src, char* buffer, uint32_t buffer_len);
+
+void mesh_node_cache_reset(void);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
@@ -26,10 +26,20 @@
 #include "kvstore_global_api.h"
 
 #include "gateway_nvram.h"
+#include "gateway_metrics.h"
 
 #define err_code(res) MBED_GET_ERROR_CODE(res)
 
-mesh_dct_t mesh_dct_info;
+MBED_STATIC_ASSERT(sizeof(mesh_dct_t) <= GATEWAY_FOOTPRINT_NVRAM_IMAGE, "The NVRAM image exceeds its size in the footprint profile");
+
+#if MESH_NVRAM_RESIDENT
+static mesh_dct_t dct_storage;
+MBED_STATIC_ASSERT(sizeof(dct_storage) <= GATEWAY_FOOTPRINT_NVRAM_RAM, "The NVRAM image exceeds its share of the footprint profile");
+static mesh_dct_t* dct = &dct_storage;
+#else
+/* Only allocated while the image is in use */
+static mesh_dct_t* dct = NULL;
+#endif
 static const char* mesh_key_kvstore = "/kv/mesh";
 
 #ifdef ENABLE_NVRAM_DEBUG
@@ -46,17 +56,17 @@ static void print_mesh_dct_info()
     uint8_t i,j;
     MESH_GATEWAY_NVRAM_DEBUG(("==== Dumping Mesh NVRAM Data ====\n\n"));
 
-    MESH_GATEWAY_NVRAM_DEBUG(("Node-Authenticate status: %d\n", mesh_dct_info.node_authenticated));
-    MESH_GATEWAY_NVRAM_DEBUG(("Chunk-Index in use: %d\n", mesh_dct_info.index_used));
+    MESH_GATEWAY_NVRAM_DEBUG(("Node-Authenticate status: %d\n", dct->node_authenticated));
+    MESH_GATEWAY_NVRAM_DEBUG(("Chunk-Index in use: %d\n", dct->index_used));
 
     for (i = 0 ; i < MESH_NV_DATA_MAX_ENTRIES ; i++)
     {
-        MESH_GATEWAY_NVRAM_DEBUG(("\n data_len = %d \n" , mesh_dct_info.mesh_nv_data[i].len));
-        MESH_GATEWAY_NVRAM_DEBUG(("\n index = %d \n" , mesh_dct_info.mesh_nv_data[i].index));
+        MESH_GATEWAY_NVRAM_DEBUG(("\n data_len = %d \n" , dct->mesh_nv_data[i].len));
+        MESH_GATEWAY_NVRAM_DEBUG(("\n index = %d \n" , dct->mesh_nv_data[i].index));
         MESH_GATEWAY_NVRAM_DEBUG(("\n ====== \n"));
-        for (j = 0 ; j < mesh_dct_info.mesh_nv_data[i].len ; j++)
+        for (j = 0 ; j < dct->mesh_nv_data[i].len ; j++)
         {
-            MESH_GATEWAY_NVRAM_DEBUG(( "  %d " , mesh_dct_info.mesh_nv_data[i].data[j] ));
+            MESH_GATEWAY_NVRAM_DEBUG(( "  %d " , dct->mesh_nv_data[i].data[j] ));
         }
         MESH_GATEWAY_NVRAM_DEBUG(("\n ====== \n"));
     }
@@ -65,13 +75,36 @@ static void print_mesh_dct_info()
 }
 #endif
 
+/* Makes the image available; unless it is resident, 'load' reads it from KVStore */
+static cy_rslt_t dct_acquire(bool load)
+{
+#if !MESH_NVRAM_RESIDENT
+    if (dct)
+    {
+        return CY_RSLT_SUCCESS;
+    }
+    dct = (mesh_dct_t*)calloc(1, sizeof(mesh_dct_t));
+    if (!dct)
+    {
+        MESH_GATEWAY_NVRAM_INFO(("[App] Error - no memory for the Mesh NVRAM data\n"));
+        return CY_RSLT_MW_ERROR;
+    }
+    if (load && mesh_kvstore_read() != CY_RSLT_SUCCESS)
+    {
+        mesh_release_nvram_data();
+        return CY_RSLT_MW_ERROR;
+    }
+#endif
+    return CY_RSLT_SUCCESS;
+}
+
 static int find_index(int id)
 {
   int index = -1;
   int i;
   for ( i = 0; i < MESH_NV_DATA_MAX_ENTRIES; i++ )
   {
-      if(mesh_dct_info.mesh_nv_data[ i ].index == id)
+      if(dct->mesh_nv_data[ i ].index == id)
       {
           index = i;
       }
@@ -85,6 +118,11 @@ cy_rslt_t mesh_kvstore_read(void)
     int res = MBED_ERROR_NOT_READY;
     kv_info_t info;
 
+    if (!dct)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
     MESH_GATEWAY_NVRAM_INFO(("[App] Reading from NVRAM..."));
 
     /* Start by getting key's information */
@@ -106,7 +144,7 @@ cy_rslt_t mesh_kvstore_read(void)
     }
 
     size_t actual_size;
-    res = kv_get(mesh_key_kvstore, (void *)&mesh_dct_info, sizeof(mesh_dct_t), &actual_size);
+    res = kv_get(mesh_key_kvstore, (void *)dct, sizeof(mesh_dct_t), &actual_size);
     if (err_code(res) != 0)
     {
         MESH_GATEWAY_NVRAM_INFO((" Error - Failed to fetch Mesh data from KVStore\n"));
@@ -127,6 +165,11 @@ cy_rslt_t mesh_kvstore_write(void)
     int res = MBED_ERROR_NOT_READY;
     kv_info_t info;
 
+    if (!dct)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
     /* Start by getting key's information */
     res = kv_get_info(mesh_key_kvstore, &info);
 
@@ -149,9 +192,13 @@ cy_rslt_t mesh_kvstore_write(void)
         return CY_RSLT_MW_ERROR;
     }
 
-    res = kv_set(mesh_key_kvstore, (const void*)&mesh_dct_info, sizeof(mesh_dct_t), 0);
+    uint32_t start_us = gateway_metrics_now_us();
+    res = kv_set(mesh_key_kvstore, (const void*)dct, sizeof(mesh_dct_t), 0);
+    gateway_metrics_observe(GATEWAY_HISTOGRAM_NVRAM_WRITE_US, gateway_metrics_now_us() - start_us);
+    gateway_metrics_increment(GATEWAY_COUNTER_NVRAM_WRITES, 1);
     if (err_code(res) != 0)
     {
+        gateway_metrics_increment(GATEWAY_COUNTER_NVRAM_ERRORS, 1);
         MESH_GATEWAY_NVRAM_INFO((" Error - Failed to Set Mesh data to KVStore\n"));
         return CY_RSLT_MW_ERROR;
     }
@@ -161,6 +208,10 @@ cy_rslt_t mesh_kvstore_write(void)
 
 cy_rslt_t mesh_read_dct(void)
 {
+    if (dct_acquire(false) != CY_RSLT_SUCCESS)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
     int result = mesh_kvstore_read();
     if (result != 0)
     {
@@ -174,22 +225,27 @@ cy_rslt_t mesh_read_dct(void)
 
 cy_rslt_t mesh_write_dct(uint16_t id, uint8_t *packet, uint32_t packet_len)
 {
-    int index = mesh_dct_info.index_used + 1;
+    if (dct_acquire(true) != CY_RSLT_SUCCESS)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    int index = dct->index_used + 1;
     int dct_index = find_index(id);
 
     if( dct_index != -1)
     {
         MESH_GATEWAY_NVRAM_DEBUG(("mesh_write_dct ,existing  index: %d index %d\n", id, dct_index));
-        memcpy( (uint8_t*) mesh_dct_info.mesh_nv_data[ dct_index ].data, packet, packet_len );
-        mesh_dct_info.mesh_nv_data[ dct_index ].len = (uint8_t) packet_len;
-        mesh_dct_info.mesh_nv_data[ dct_index ].index = id;
+        memcpy( (uint8_t*) dct->mesh_nv_data[ dct_index ].data, packet, packet_len );
+        dct->mesh_nv_data[ dct_index ].len = (uint8_t) packet_len;
+        dct->mesh_nv_data[ dct_index ].index = id;
 #if ENABLE_NVRAM_DEBUG
         int val = 0;
         uint32_t i, j;
         MESH_GATEWAY_NVRAM_DEBUG (("\n length of data = %d , data = ", packet_len));
-        for (j = 0 ; j < mesh_dct_info.mesh_nv_data[dct_index].len ; j++)
+        for (j = 0 ; j < dct->mesh_nv_data[dct_index].len ; j++)
         {
-            MESH_GATEWAY_NVRAM_DEBUG(( "  %d " , mesh_dct_info.mesh_nv_data[dct_index].data[j] ));
+            MESH_GATEWAY_NVRAM_DEBUG(( "  %d " , dct->mesh_nv_data[dct_index].data[j] ));
         }
         MESH_GATEWAY_NVRAM_DEBUG (("\n"));
 #endif
@@ -199,24 +255,26 @@ cy_rslt_t mesh_write_dct(uint16_t id, uint8_t *packet, uint32_t packet_len)
         if (index >= MESH_NV_DATA_MAX_ENTRIES)
         {
             MESH_GATEWAY_NVRAM_INFO(("[App] Mesh NVRAM Data - exceeding array bound(idx:%d)\n", index));
+            mesh_release_nvram_data();
             return CY_RSLT_MW_ERROR;
         }
         MESH_GATEWAY_NVRAM_INFO(("mesh_write_dct, to a new index , requested index : %d new index  %d\n", id, index));
-        memcpy( (uint8_t*) mesh_dct_info.mesh_nv_data[ index ].data, packet, packet_len );
-        mesh_dct_info.mesh_nv_data[ index ].len = (uint8_t) packet_len;
-        mesh_dct_info.mesh_nv_data[ index ].index = id;
+        memcpy( (uint8_t*) dct->mesh_nv_data[ index ].data, packet, packet_len );
+        dct->mesh_nv_data[ index ].len = (uint8_t) packet_len;
+        dct->mesh_nv_data[ index ].index = id;
 #if ENABLE_NVRAM_DEBUG
         MESH_GATEWAY_NVRAM_DEBUG (("\n length of data = %d , data = ", packet_len));
-        for (int j = 0 ; j < mesh_dct_info.mesh_nv_data[index].len ; j++)
+        for (int j = 0 ; j < dct->mesh_nv_data[index].len ; j++)
         {
-            MESH_GATEWAY_NVRAM_DEBUG(("  %d " , mesh_dct_info.mesh_nv_data[index].data[j]));
+            MESH_GATEWAY_NVRAM_DEBUG(("  %d " , dct->mesh_nv_data[index].data[j]));
         }
         printf ("\n");
 #endif
-        mesh_dct_info.index_used++;
+        dct->index_used++;
     }
 
     int result = mesh_kvstore_write();
+    mesh_release_nvram_data();
 
     if (result)
         return CY_RSLT_MW_ERROR;
@@ -224,6 +282,33 @@ cy_rslt_t mesh_write_dct(uint16_t id, uint8_t *packet, uint32_t packet_len)
     return CY_RSLT_SUCCESS;
 }
 
+cy_rslt_t mesh_set_provisioned(void)
+{
+    cy_rslt_t result;
+
+    if (dct_acquire(true) != CY_RSLT_SUCCESS)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+    dct->node_authenticated = MESH_NODE_PROVISIONED;
+    result = mesh_kvstore_write();
+    mesh_release_nvram_data();
+    return result;
+}
+
+mesh_dct_t* mesh_get_dct(void)
+{
+    return dct;
+}
+
+void mesh_release_nvram_data(void)
+{
+#if !MESH_NVRAM_RESIDENT
+    free(dct);
+    dct = NULL;
+#endif
+}
+
 cy_rslt_t mesh_reset_nvram_data(void)
 {
     int res = MBED_ERROR_NOT_READY;
@@ -253,6 +338,11 @@ cy_rslt_t mesh_init_nvram_data(void)
     int res = MBED_ERROR_NOT_READY;
     kv_info_t info;
 
+    if (dct_acquire(false) != CY_RSLT_SUCCESS)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
     /* Start by getting key's information */
     MESH_GATEWAY_NVRAM_INFO(("[App] Fetching NVRAM details...\n"));
     res = kv_get_info(mesh_key_kvstore, &info);
@@ -261,10 +351,10 @@ cy_rslt_t mesh_init_nvram_data(void)
         MESH_GATEWAY_NVRAM_INFO(("[App] Setting up Mesh NVRAM Data for first-time..."));
         /* Writing ["/kv/mesh"] =  0 */
 
-        res = kv_set(mesh_key_kvstore, (const void*)&mesh_dct_info, sizeof(mesh_dct_info), 0);
+        res = kv_set(mesh_key_kvstore, (const void*)dct, sizeof(mesh_dct_t), 0);
 #if ENABLE_NVRAM_DEBUG
         MESH_GATEWAY_NVRAM_DEBUG("\n[App] kv_set for Key: \"%s\" sizeof:%d (returns: %d) ...",
-                mesh_key_kvstore, sizeof(mesh_dct_info), err_code(res));
+                mesh_key_kvstore, sizeof(mesh_dct_t), err_code(res));
 #endif
         if (err_code(res) != 0)
         {
@@ -301,7 +391,7 @@ cy_rslt_t mesh_init_nvram_data(void)
         }
 
         size_t actual_size;
-        res = kv_get(mesh_key_kvstore, (void *)&mesh_dct_info, sizeof(mesh_dct_t), &actual_size);
+        res = kv_get(mesh_key_kvstore, (void *)dct, sizeof(mesh_dct_t), &actual_size);
         if (err_code(res) != 0)
         {
             MESH_GATEWAY_NVRAM_INFO((" Error - Failed to fetch Mesh data from KVStore\n"));
@@ -19,6 +19,7 @@
 
 #include <stdint.h>
 #include "cy_result_mw.h"
+#include "gateway_footprint.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -26,6 +27,11 @@ extern "C" {
 
 #define MESH_NV_DATA_MAX_ENTRIES    (15)
 #define MESH_NV_DATA_MAX_PAYLOAD    (200)
+/* Keep the NVRAM image in RAM; when 0 it is allocated and loaded from KVStore only while it is used */
+#define MESH_NVRAM_RESIDENT         (GATEWAY_FOOTPRINT_NVRAM_RESIDENT)
+
+#define MESH_NODE_UNPROVISIONED         0   // NODE in UNPROVISIONED STATE
+#define MESH_NODE_PROVISIONED           1   // NODE in PROVISIONED STATE
 
 typedef struct
 {
@@ -47,6 +53,12 @@ cy_rslt_t mesh_reset_nvram_data(void);
 cy_rslt_t mesh_init_nvram_data(void);
 cy_rslt_t mesh_kvstore_read(void);
 cy_rslt_t mesh_kvstore_write(void);
+cy_rslt_t mesh_set_provisioned(void);
+
+/* The image loaded by mesh_init_nvram_data(), or NULL once it has been released */
+mesh_dct_t* mesh_get_dct(void);
+/* Frees the image unless it is resident */
+void mesh_release_nvram_data(void);
 
 
 #ifdef __cplusplus
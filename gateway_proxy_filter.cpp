@@ -0,0 +1,426 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway proxy filter management implementation
+ */
+
+#include "mbed.h"
+
+#include "KVStore.h"
+#include "kvstore_global_api.h"
+
+#include "gateway_proxy_filter.h"
+#include "gateway_idle.h"
+#include "gateway_mesh_pdu.h"
+#include "gateway_metrics.h"
+#include "gateway_trace.h"
+#include "cy_string_utils.h"
+
+#define err_code(res) MBED_GET_ERROR_CODE(res)
+
+#define PROXY_FILTER_STORE_MAGIC        (0x50464C54)
+
+/* Proxy configuration opcode and filter type of a Filter Status message */
+#define PROXY_OPCODE_FILTER_STATUS      (0x03)
+#define PROXY_FILTER_TYPE_ACCEPT        (0x00)
+
+
+typedef struct
+{
+    uint32_t    magic;
+    uint32_t    count;
+    uint16_t    addresses[GATEWAY_PROXY_FILTER_MAX_CONFIGURED];
+} proxy_filter_store_t;
+
+typedef struct
+{
+    uint16_t    addr;
+    uint32_t    sent_ms;
+} commanded_t;
+
+static const char* filter_key = "/kv/proxy_filter";
+static proxy_filter_store_t filter_store;
+static Mutex filter_mutex;
+
+/* Written on the mesh TX thread, read by the mesh event callback and the requests under filter_mutex.
+ * An empty list means the default filter, which forwards everything.
+ */
+static uint16_t wanted[GATEWAY_PROXY_FILTER_WANTED_MAX];
+static uint32_t wanted_count = 0;
+
+static commanded_t commanded[GATEWAY_PROXY_FILTER_MAX_COMMANDED];
+static uint32_t commanded_count = 0;
+static uint32_t last_update_ms = 0;
+static gateway_proxy_filter_changed_t changed_callback = NULL;
+static gateway_proxy_filter_sources_t local_sources_callback = NULL;
+
+static void sort_addresses(uint16_t* addresses, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 1; i < count; i++)
+    {
+        uint16_t addr = addresses[i];
+        uint32_t j = i;
+        while (j > 0 && addresses[j - 1] > addr)
+        {
+            addresses[j] = addresses[j - 1];
+            j--;
+        }
+        addresses[j] = addr;
+    }
+}
+
+/* Sorts and removes duplicates and unassigned addresses. Returns the new count. */
+static uint32_t normalize_addresses(uint16_t* addresses, uint32_t count)
+{
+    uint32_t unique = 0;
+    uint32_t i;
+
+    sort_addresses(addresses, count);
+    for (i = 0; i < count; i++)
+    {
+        if (addresses[i] != MESH_ADDR_UNASSIGNED && (unique == 0 || addresses[unique - 1] != addresses[i]))
+        {
+            addresses[unique++] = addresses[i];
+        }
+    }
+    return unique;
+}
+
+static bool contains(const uint16_t* addresses, uint32_t count, uint16_t addr)
+{
+    uint32_t low = 0;
+    uint32_t high = count;
+
+    while (low < high)
+    {
+        uint32_t mid = (low + high) / 2;
+        if (addresses[mid] == addr)
+        {
+            return true;
+        }
+        if (addresses[mid] < addr)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return false;
+}
+
+static uint32_t collect_desired(uint16_t* desired)
+{
+    uint32_t count;
+    uint32_t i;
+
+    filter_mutex.lock();
+    count = filter_store.count;
+    memcpy(desired, filter_store.addresses, count * sizeof(uint16_t));
+    filter_mutex.unlock();
+
+    if (count == 0)
+    {
+        return 0;
+    }
+    if (local_sources_callback)
+    {
+        count += local_sources_callback(&desired[count], GATEWAY_PROXY_FILTER_MAX_LOCAL);
+    }
+    for (i = 0; i < commanded_count; i++)
+    {
+        desired[count++] = commanded[i].addr;
+    }
+    return normalize_addresses(desired, count);
+}
+
+static void expire_commanded(uint32_t now)
+{
+    uint32_t i = 0;
+
+    while (i < commanded_count)
+    {
+        if (now - commanded[i].sent_ms >= GATEWAY_PROXY_FILTER_COMMANDED_HOLD_MSEC)
+        {
+            commanded[i] = commanded[--commanded_count];
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+static cy_rslt_t filter_save(void)
+{
+    size_t size = offsetof(proxy_filter_store_t, addresses) + filter_store.count * sizeof(uint16_t);
+
+    if (err_code(kv_set(filter_key, &filter_store, size, 0)) != 0)
+    {
+        gateway_metrics_increment(GATEWAY_COUNTER_NVRAM_ERRORS, 1);
+        return CY_RSLT_MW_ERROR;
+    }
+    gateway_metrics_increment(GATEWAY_COUNTER_NVRAM_WRITES, 1);
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t gateway_proxy_filter_init(gateway_proxy_filter_changed_t changed, gateway_proxy_filter_sources_t local_sources)
+{
+    size_t actual_size = 0;
+
+    if (!changed)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+    changed_callback       = changed;
+    local_sources_callback = local_sources;
+    commanded_count        = 0;
+    gateway_proxy_filter_reset();
+
+    filter_mutex.lock();
+    if (err_code(kv_get(filter_key, &filter_store, sizeof(filter_store), &actual_size)) != 0 ||
+        actual_size < offsetof(proxy_filter_store_t, addresses) || filter_store.magic != PROXY_FILTER_STORE_MAGIC ||
+        filter_store.count > GATEWAY_PROXY_FILTER_MAX_CONFIGURED ||
+        actual_size != offsetof(proxy_filter_store_t, addresses) + filter_store.count * sizeof(uint16_t))
+    {
+        filter_store.magic = PROXY_FILTER_STORE_MAGIC;
+        filter_store.count = 0;
+    }
+    filter_mutex.unlock();
+
+    return CY_RSLT_SUCCESS;
+}
+
+void gateway_proxy_filter_reset(void)
+{
+    filter_mutex.lock();
+    wanted_count = 0;
+    filter_mutex.unlock();
+    /* Report the filter again on the next poll */
+    last_update_ms = (uint32_t)Kernel::get_ms_count() - GATEWAY_PROXY_FILTER_UPDATE_MSEC;
+}
+
+void gateway_proxy_filter_note_command(uint16_t dst)
+{
+    uint32_t now = (uint32_t)Kernel::get_ms_count();
+    uint32_t oldest = 0;
+    uint32_t i;
+
+    if (!changed_callback || dst == MESH_ADDR_UNASSIGNED)
+    {
+        return;
+    }
+
+    for (i = 0; i < commanded_count && commanded[i].addr != dst; i++)
+    {
+        if (now - commanded[i].sent_ms > now - commanded[oldest].sent_ms)
+        {
+            oldest = i;
+        }
+    }
+    if (i == commanded_count)
+    {
+        i = (commanded_count < GATEWAY_PROXY_FILTER_MAX_COMMANDED) ? commanded_count++ : oldest;
+    }
+    commanded[i].addr    = dst;
+    commanded[i].sent_ms = now;
+
+    filter_mutex.lock();
+    if (wanted_count > 0 && !contains(wanted, wanted_count, dst))
+    {
+        /* Report the new address on the next poll rather than after the update interval */
+        last_update_ms = (uint32_t)Kernel::get_ms_count() - GATEWAY_PROXY_FILTER_UPDATE_MSEC;
+    }
+    filter_mutex.unlock();
+}
+
+static void filter_update(uint32_t now)
+{
+    uint16_t desired[GATEWAY_PROXY_FILTER_WANTED_MAX];
+    uint32_t desired_count;
+    bool changed;
+
+    expire_commanded(now);
+
+    desired_count = collect_desired(desired);
+    filter_mutex.lock();
+    changed = desired_count != wanted_count || memcmp(desired, wanted, desired_count * sizeof(uint16_t)) != 0;
+    if (changed)
+    {
+        memcpy(wanted, desired, desired_count * sizeof(uint16_t));
+        wanted_count = desired_count;
+    }
+    filter_mutex.unlock();
+
+    if (changed)
+    {
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_INFO, "[App] Proxy filter wants %lu addresses\n", desired_count);
+        changed_callback();
+    }
+}
+
+uint32_t gateway_proxy_filter_poll(void)
+{
+    uint32_t now = (uint32_t)Kernel::get_ms_count();
+
+    if (!changed_callback)
+    {
+        return GATEWAY_IDLE_FOREVER;
+    }
+    if (now - last_update_ms >= GATEWAY_PROXY_FILTER_UPDATE_MSEC)
+    {
+        last_update_ms = gateway_idle_slot_start(now);
+        filter_update(now);
+    }
+    /* The filter may lag a little; the updates share the wakeups of the other timers */
+    return gateway_idle_align(now, gateway_idle_until(now, last_update_ms + GATEWAY_PROXY_FILTER_UPDATE_MSEC));
+}
+
+void gateway_proxy_filter_status(const uint8_t* message, uint32_t length)
+{
+    uint16_t list_size;
+    uint32_t expected;
+
+    if (!message || length < 5 || (message[0] & 0x3F) != MESH_PROXY_TYPE_PROXY_CONFIG || message[1] != PROXY_OPCODE_FILTER_STATUS)
+    {
+        return;
+    }
+
+    list_size = (uint16_t)((message[3] << 8) | message[4]);
+    gateway_metrics_set(GATEWAY_GAUGE_PROXY_FILTER_SIZE, list_size);
+    filter_mutex.lock();
+    expected = wanted_count;
+    filter_mutex.unlock();
+    if (message[2] == PROXY_FILTER_TYPE_ACCEPT && list_size < expected)
+    {
+        /* The proxy node ran out of filter entries; traffic of the missing nodes is lost */
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_WARN, "[App] Proxy node holds %u of %lu filter addresses\n", list_size, expected);
+    }
+}
+
+cy_rslt_t gateway_proxy_filter_apply_request(const char* request, uint32_t request_len)
+{
+    uint16_t addresses[GATEWAY_PROXY_FILTER_MAX_CONFIGURED];
+    uint32_t count = 0;
+    uint32_t start = 0;
+    uint32_t i;
+    cy_rslt_t result;
+
+    if (!request || request_len == 0)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    for (i = 0; i <= request_len; i++)
+    {
+        uint32_t value = 0;
+
+        if (i < request_len && request[i] != ',')
+        {
+            continue;
+        }
+        if (i == start || i - start > 4 || cy_string_to_unsigned(&request[start], i - start, &value, 1) == 0 ||
+            count == GATEWAY_PROXY_FILTER_MAX_CONFIGURED)
+        {
+            return CY_RSLT_MW_ERROR;
+        }
+        addresses[count++] = (uint16_t)value;
+        start = i + 1;
+    }
+
+    filter_mutex.lock();
+    filter_store.count = normalize_addresses(addresses, count);
+    memcpy(filter_store.addresses, addresses, filter_store.count * sizeof(uint16_t));
+    result = filter_save();
+    filter_mutex.unlock();
+
+    return result;
+}
+
+uint32_t gateway_proxy_filter_to_json(char* buffer, uint32_t buffer_len)
+{
+    uint32_t written = 0;
+    uint32_t i;
+    int ret;
+
+    if (!buffer || buffer_len == 0)
+    {
+        return 0;
+    }
+
+    ret = snprintf(buffer, buffer_len, "{\"addresses\":[");
+    if (ret < 0 || (uint32_t)ret >= buffer_len)
+    {
+        return 0;
+    }
+    written = ret;
+
+    filter_mutex.lock();
+    for (i = 0; i < filter_store.count; i++)
+    {
+        ret = snprintf(buffer + written, buffer_len - written, "%s\"%04X\"", (i > 0) ? "," : "", filter_store.addresses[i]);
+        if (ret < 0 || (uint32_t)ret >= buffer_len - written)
+        {
+            filter_mutex.unlock();
+            return 0;
+        }
+        written += ret;
+    }
+    ret = snprintf(buffer + written, buffer_len - written, "],\"filter\":\"%s\",\"wanted\":%lu}",
+                   (wanted_count > 0) ? "accept" : "all", (unsigned long)wanted_count);
+    filter_mutex.unlock();
+
+    if (ret < 0 || (uint32_t)ret >= buffer_len - written)
+    {
+        return 0;
+    }
+    return written + ret;
+}
+
+uint32_t gateway_proxy_filter_wanted_to_text(char* buffer, uint32_t buffer_len)
+{
+    uint32_t written = 0;
+    uint32_t i;
+    int ret = 0;
+
+    if (!buffer || buffer_len == 0)
+    {
+        return 0;
+    }
+
+    filter_mutex.lock();
+    if (wanted_count == 0)
+    {
+        ret = snprintf(buffer, buffer_len, "%04X", MESH_ADDR_UNASSIGNED);
+    }
+    for (i = 0; ret >= 0 && (uint32_t)ret < buffer_len - written && i < wanted_count; i++)
+    {
+        written += ret;
+        ret = snprintf(buffer + written, buffer_len - written, "%s%04X", (i > 0) ? "," : "", wanted[i]);
+    }
+    filter_mutex.unlock();
+
+    if (ret < 0 || (uint32_t)ret >= buffer_len - written)
+    {
+        return 0;
+    }
+    return written + ret;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway proxy filter management
+ *
+ * The proxy node forwards every network PDU to the gateway unless its proxy
+ * filter says otherwise. Once addresses of interest are configured (by the
+ * cloud, over MQTT or HTTP), the wanted filter is an accept list holding
+ * those addresses plus the ones local consumers need: the sources of local
+ * rules and the nodes recently sent a command, whose status replies must get
+ * through. With no addresses configured the filter is left at its default,
+ * i.e. everything is forwarded.
+ *
+ * Proxy configuration messages are encrypted with the network key, which the
+ * gateway does not hold. The gateway therefore does not set the filter
+ * itself: it reports the wanted list whenever it changes, at most every
+ * GATEWAY_PROXY_FILTER_UPDATE_MSEC, and the cloud sends the encrypted
+ * Set Filter Type and Add/Remove Addresses messages as mesh data.
+ *
+ * All functions except the configuration run on the mesh TX thread.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GATEWAY_PROXY_FILTER_MAX_CONFIGURED         (32)
+#define GATEWAY_PROXY_FILTER_MAX_LOCAL              (16)
+#define GATEWAY_PROXY_FILTER_MAX_COMMANDED          (16)
+/* How long a node that was sent a command stays in the filter */
+#define GATEWAY_PROXY_FILTER_COMMANDED_HOLD_MSEC    (30000)
+#define GATEWAY_PROXY_FILTER_UPDATE_MSEC            (1000)
+#define GATEWAY_PROXY_FILTER_JSON_SIZE              (GATEWAY_PROXY_FILTER_MAX_CONFIGURED * 7 + 64)
+#define GATEWAY_PROXY_FILTER_WANTED_MAX             (GATEWAY_PROXY_FILTER_MAX_CONFIGURED + GATEWAY_PROXY_FILTER_MAX_LOCAL + \
+                                                     GATEWAY_PROXY_FILTER_MAX_COMMANDED)
+/* "<addr>,<addr>,..." with a terminating NUL */
+#define GATEWAY_PROXY_FILTER_TEXT_SIZE              (GATEWAY_PROXY_FILTER_WANTED_MAX * 5)
+
+/* Called when the wanted filter has changed, so that it can be reported to the cloud */
+typedef void (*gateway_proxy_filter_changed_t)(void);
+
+/* Copies up to 'max' addresses needed by local consumers into 'addresses'. Returns the number copied. */
+typedef uint32_t (*gateway_proxy_filter_sources_t)(uint16_t* addresses, uint32_t max);
+
+/* Loads the configured addresses. 'local_sources' may be NULL. */
+cy_rslt_t gateway_proxy_filter_init(gateway_proxy_filter_changed_t changed, gateway_proxy_filter_sources_t local_sources);
+
+/* Reports the wanted filter again, e.g. after the proxy connection was set up again */
+void gateway_proxy_filter_reset(void);
+
+/* Makes sure the replies of 'dst' pass the filter; call before sending it a command */
+void gateway_proxy_filter_note_command(uint16_t dst);
+
+/* Updates the wanted filter once GATEWAY_PROXY_FILTER_UPDATE_MSEC has passed. Returns the time until the next update. */
+uint32_t gateway_proxy_filter_poll(void);
+
+/* Handles a proxy configuration message received from the proxy node (Filter Status, decrypted by the controller) */
+void gateway_proxy_filter_status(const uint8_t* message, uint32_t length);
+
+/* Applies a request "<addr>,<addr>,..." (all hex) that replaces the configured addresses; "0000" clears them.
+ * The addresses are saved to KVStore.
+ */
+cy_rslt_t gateway_proxy_filter_apply_request(const char* request, uint32_t request_len);
+
+/* Renders the configured addresses and the wanted filter as JSON into 'buffer'. Returns the length written. */
+uint32_t gateway_proxy_filter_to_json(char* buffer, uint32_t buffer_len);
+
+/* Renders the wanted addresses as "<addr>,<addr>,..." into 'buffer', or "0000" for the default filter. Returns the length written. */
+uint32_t gateway_proxy_filter_wanted_to_text(char* buffer, uint32_t buffer_len);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
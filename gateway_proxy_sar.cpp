@@ -0,0 +1,118 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway Proxy PDU reassembly implementation
+ */
+
+#include "mbed.h"
+
+#include "gateway_proxy_sar.h"
+#include "gateway_mesh_pdu.h"
+#include "gateway_metrics.h"
+#include "gateway_trace.h"
+
+#define PROXY_HEADER_LEN            (1)
+#define PROXY_SAR(header)           (((header) >> 6) & 0x03)
+#define PROXY_TYPE(header)          ((header) & 0x3F)
+
+static uint8_t sar_buffer[GATEWAY_PROXY_SAR_MAX];
+static uint32_t sar_length = 0;
+static uint32_t sar_started_ms = 0;
+static bool sar_active = false;
+
+static void sar_discard(void)
+{
+    if (sar_active)
+    {
+        sar_active = false;
+        gateway_metrics_increment(GATEWAY_COUNTER_UPLINK_SAR_ERRORS, 1);
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_DEBUG, "[App] Incomplete proxy message of %lu bytes discarded\n", sar_length);
+    }
+}
+
+gateway_proxy_sar_result_t gateway_proxy_sar_process(const uint8_t* packet, uint32_t length, const uint8_t** message, uint32_t* message_len)
+{
+    uint8_t sar;
+    uint8_t type;
+
+    if (!packet || length < PROXY_HEADER_LEN || !message || !message_len)
+    {
+        return GATEWAY_PROXY_SAR_DROPPED;
+    }
+
+    sar  = PROXY_SAR(packet[0]);
+    type = PROXY_TYPE(packet[0]);
+
+    if (sar_active && (uint32_t)Kernel::get_ms_count() - sar_started_ms >= GATEWAY_PROXY_SAR_TIMEOUT_MSEC)
+    {
+        sar_discard();
+    }
+
+    switch (sar)
+    {
+        case MESH_PROXY_SAR_COMPLETE:
+            sar_discard();
+            *message     = packet;
+            *message_len = length;
+            return GATEWAY_PROXY_SAR_COMPLETE;
+
+        case MESH_PROXY_SAR_FIRST:
+            sar_discard();
+            if (length > GATEWAY_PROXY_SAR_MAX)
+            {
+                gateway_metrics_increment(GATEWAY_COUNTER_UPLINK_SAR_ERRORS, 1);
+                return GATEWAY_PROXY_SAR_DROPPED;
+            }
+            /* The reassembled PDU keeps the message type with the SAR field cleared (complete) */
+            sar_buffer[0] = type;
+            memcpy(&sar_buffer[PROXY_HEADER_LEN], &packet[PROXY_HEADER_LEN], length - PROXY_HEADER_LEN);
+            sar_length     = length;
+            sar_started_ms = (uint32_t)Kernel::get_ms_count();
+            sar_active     = true;
+            return GATEWAY_PROXY_SAR_PENDING;
+
+        default:
+            if (!sar_active)
+            {
+                /* The first segment was lost or timed out */
+                gateway_metrics_increment(GATEWAY_COUNTER_UPLINK_SAR_ERRORS, 1);
+                return GATEWAY_PROXY_SAR_DROPPED;
+            }
+            if (PROXY_TYPE(sar_buffer[0]) != type)
+            {
+                sar_discard();
+                return GATEWAY_PROXY_SAR_DROPPED;
+            }
+            if (sar_length + length - PROXY_HEADER_LEN > GATEWAY_PROXY_SAR_MAX)
+            {
+                sar_discard();
+                return GATEWAY_PROXY_SAR_DROPPED;
+            }
+            memcpy(&sar_buffer[sar_length], &packet[PROXY_HEADER_LEN], length - PROXY_HEADER_LEN);
+            sar_length += length - PROXY_HEADER_LEN;
+            if (sar == MESH_PROXY_SAR_CONTINUATION)
+            {
+                return GATEWAY_PROXY_SAR_PENDING;
+            }
+            sar_active   = false;
+            *message     = sar_buffer;
+            *message_len = sar_length;
+            gateway_metrics_increment(GATEWAY_COUNTER_UPLINK_REASSEMBLED, 1);
+            return GATEWAY_PROXY_SAR_COMPLETE;
+    }
+}
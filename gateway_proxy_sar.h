@@ -0,0 +1,63 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway Proxy PDU reassembly
+ *
+ * A proxy PDU larger than the GATT MTU reaches the gateway as a first
+ * segment, any number of continuation segments and a last segment (SAR
+ * field of the proxy header). The segments are collected here so that each
+ * proxy message is parsed and published once, as a complete PDU.
+ *
+ * Segments of different messages are never interleaved on a proxy
+ * connection, so a single buffer is enough. A message that is not completed
+ * within GATEWAY_PROXY_SAR_TIMEOUT_MSEC, or is interrupted by another
+ * message, is discarded and counted in "uplink_sar_errors".
+ *
+ * Only used from the mesh event callback.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Proxy header and the largest proxy PDU carried by the mesh controller; a
+ * network PDU is at most 29 bytes, proxy configuration messages are shorter */
+#define GATEWAY_PROXY_SAR_MAX               (96)
+/* Proxy SAR timeout from the Mesh Profile specification */
+#define GATEWAY_PROXY_SAR_TIMEOUT_MSEC      (20000)
+
+typedef enum
+{
+    GATEWAY_PROXY_SAR_COMPLETE,     /* 'message' holds a complete proxy PDU */
+    GATEWAY_PROXY_SAR_PENDING,      /* Segment stored, more to come */
+    GATEWAY_PROXY_SAR_DROPPED,      /* Malformed or out of sequence segment */
+} gateway_proxy_sar_result_t;
+
+/* Feeds a received proxy packet. On GATEWAY_PROXY_SAR_COMPLETE 'message' points at the complete PDU, with the SAR
+ * field set to complete; it is either 'packet' itself or the reassembly buffer, valid until the next call.
+ */
+gateway_proxy_sar_result_t gateway_proxy_sar_process(const uint8_t* packet, uint32_t length, const uint8_t** message, uint32_t* message_len);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
@@ -0,0 +1,433 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway local rule engine implementation
+ */
+
+#include <ctype.h>
+#include "mbed.h"
+
+#include "KVStore.h"
+#include "kvstore_global_api.h"
+
+#include "gateway_rules.h"
+#include "gateway_metrics.h"
+#include "gateway_trace.h"
+#include "gateway_latency.h"
+#include "cy_string_utils.h"
+
+#define err_code(res) MBED_GET_ERROR_CODE(res)
+
+#define RULES_STORE_MAGIC           (0x52554C32)
+#define RULES_INDEX_EMPTY           (0xFF)
+
+MBED_STATIC_ASSERT((MESH_RULES_INDEX_SLOTS & (MESH_RULES_INDEX_SLOTS - 1)) == 0, "MESH_RULES_INDEX_SLOTS must be a power of two");
+MBED_STATIC_ASSERT(MESH_RULES_INDEX_SLOTS > MESH_RULES_MAX, "MESH_RULES_INDEX_SLOTS must leave free slots");
+MBED_STATIC_ASSERT(MESH_RULES_ACTION_MAX <= GATEWAY_MESH_TX_MAX_PAYLOAD, "A rule action must fit in a mesh TX message");
+
+typedef struct
+{
+    uint32_t    opcode;
+    uint16_t    src;
+    uint8_t     action_count;
+    uint8_t     action_len[MESH_RULES_ACTIONS_PER_RULE];
+    /* Proxy packets in the byte order of their hex text */
+    uint8_t     actions[MESH_RULES_ACTIONS_PER_RULE][MESH_RULES_PDU_MAX];
+} mesh_rule_t;
+
+typedef struct
+{
+    uint32_t    magic;
+    uint32_t    count;
+    mesh_rule_t rules[MESH_RULES_MAX];
+} mesh_rules_store_t;
+
+static const char* rules_key = "/kv/rules";
+static const char* rules_used_key = "/kv/rules_used";
+static mesh_rules_store_t rules_store;
+/* Actions of each rule sent so far; kept apart from the rules, as it changes on every firing */
+static uint8_t rules_used[MESH_RULES_MAX];
+static uint32_t rules_fired_ms[MESH_RULES_MAX];
+static uint8_t rules_index[MESH_RULES_INDEX_SLOTS];
+
+MBED_STATIC_ASSERT(sizeof(mesh_rule_t) <= GATEWAY_FOOTPRINT_RULE_ENTRY, "A rule exceeds its size in the footprint profile");
+MBED_STATIC_ASSERT(sizeof(rules_store) <= GATEWAY_FOOTPRINT_RULES_KVSTORE, "The stored rules exceed their KVStore share of the footprint profile");
+MBED_STATIC_ASSERT(sizeof(rules_store) + sizeof(rules_used) + sizeof(rules_fired_ms) + sizeof(rules_index) <= GATEWAY_FOOTPRINT_RULES_RAM, "Rule tables exceed their share of the footprint profile");
+
+static Mutex rules_mutex;
+
+static uint32_t rules_hash(uint16_t src, uint32_t opcode)
+{
+    uint32_t key = ((uint32_t)src << 16) ^ opcode;
+    return (key * 2654435761u) & (MESH_RULES_INDEX_SLOTS - 1);
+}
+
+/* Returns the index slot holding the rule for (src, opcode), or the free slot where it belongs */
+static uint8_t* rules_index_find(uint16_t src, uint32_t opcode)
+{
+    uint32_t slot = rules_hash(src, opcode);
+
+    /* There is always a free slot, so the probe terminates */
+    while (rules_index[slot] != RULES_INDEX_EMPTY)
+    {
+        const mesh_rule_t* rule = &rules_store.rules[rules_index[slot]];
+        if (rule->src == src && rule->opcode == opcode)
+        {
+            break;
+        }
+        slot = (slot + 1) & (MESH_RULES_INDEX_SLOTS - 1);
+    }
+    return &rules_index[slot];
+}
+
+static void rules_compile(void)
+{
+    uint32_t i;
+
+    memset(rules_index, RULES_INDEX_EMPTY, sizeof(rules_index));
+    memset(rules_fired_ms, 0, sizeof(rules_fired_ms));
+    for (i = 0; i < rules_store.count; i++)
+    {
+        *rules_index_find(rules_store.rules[i].src, rules_store.rules[i].opcode) = (uint8_t)i;
+    }
+}
+
+static uint8_t hex_value(char c)
+{
+    return isdigit((unsigned char)c) ? (uint8_t)(c - '0') : (uint8_t)(toupper((unsigned char)c) - 'A' + 10);
+}
+
+/* Renders a stored action as the hex text taken by the mesh TX queue */
+static void action_to_hex(const uint8_t* packet, uint32_t len, char* action)
+{
+    static const char hex_digits[] = "0123456789ABCDEF";
+    uint32_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        action[i * 2]     = hex_digits[packet[i] >> 4];
+        action[i * 2 + 1] = hex_digits[packet[i] & 0x0F];
+    }
+    action[len * 2] = '\0';
+}
+
+/* The action must be a complete network PDU (proxy header 00, stored last) in whole hex bytes */
+static bool action_is_valid(const char* action, uint32_t action_len)
+{
+    uint32_t i;
+
+    if (!action || action_len % 2 != 0 || action_len < MESH_PDU_HEADER_LEN * 2 || action_len > MESH_RULES_ACTION_MAX ||
+        action[action_len - 2] != '0' || action[action_len - 1] != '0')
+    {
+        return false;
+    }
+    for (i = 0; i < action_len; i++)
+    {
+        if (!isxdigit((unsigned char)action[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static cy_rslt_t rules_kv_set(const char* key, const void* data, size_t size)
+{
+    if (err_code(kv_set(key, data, size, 0)) != 0)
+    {
+        gateway_metrics_increment(GATEWAY_COUNTER_NVRAM_ERRORS, 1);
+        return CY_RSLT_MW_ERROR;
+    }
+    gateway_metrics_increment(GATEWAY_COUNTER_NVRAM_WRITES, 1);
+    return CY_RSLT_SUCCESS;
+}
+
+static cy_rslt_t rules_save(void)
+{
+    /* Only the rules in use are written */
+    size_t size = offsetof(mesh_rules_store_t, rules) + rules_store.count * sizeof(mesh_rule_t);
+
+    return rules_kv_set(rules_key, &rules_store, size);
+}
+
+cy_rslt_t mesh_rules_init(void)
+{
+    size_t actual_size = 0;
+
+    rules_mutex.lock();
+    if (err_code(kv_get(rules_key, &rules_store, sizeof(rules_store), &actual_size)) != 0 ||
+        actual_size < offsetof(mesh_rules_store_t, rules) || rules_store.magic != RULES_STORE_MAGIC ||
+        rules_store.count > MESH_RULES_MAX ||
+        actual_size != offsetof(mesh_rules_store_t, rules) + rules_store.count * sizeof(mesh_rule_t))
+    {
+        rules_store.magic = RULES_STORE_MAGIC;
+        rules_store.count = 0;
+    }
+    /* Without the counts, a stock may have been partly sent before the reset; treat it as used up */
+    if (err_code(kv_get(rules_used_key, rules_used, sizeof(rules_used), &actual_size)) != 0 ||
+        actual_size != sizeof(rules_used))
+    {
+        memset(rules_used, MESH_RULES_ACTIONS_PER_RULE, sizeof(rules_used));
+    }
+    rules_compile();
+    rules_mutex.unlock();
+
+    if (rules_store.count > 0)
+    {
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_INFO, "[App] %lu local rules loaded\n", rules_store.count);
+    }
+    return CY_RSLT_SUCCESS;
+}
+
+bool mesh_rules_process(const mesh_pdu_t* pdu)
+{
+    char action[MESH_RULES_ACTION_MAX + 1];
+    uint32_t now = (uint32_t)Kernel::get_ms_count();
+    bool fired = false;
+    bool exhausted = false;
+    uint8_t index;
+
+    if (!pdu || pdu->src == MESH_ADDR_UNASSIGNED || pdu->opcode == MESH_PDU_OPCODE_INVALID)
+    {
+        return false;
+    }
+
+    rules_mutex.lock();
+    index = *rules_index_find(pdu->src, pdu->opcode);
+    if (index != RULES_INDEX_EMPTY &&
+        (rules_fired_ms[index] == 0 || now - rules_fired_ms[index] >= MESH_RULES_HOLDOFF_MSEC))
+    {
+        const mesh_rule_t* rule = &rules_store.rules[index];
+
+        if (rules_used[index] < rule->action_count)
+        {
+            action_to_hex(rule->actions[rules_used[index]], rule->action_len[rules_used[index]], action);
+            rules_used[index]++;
+            fired = true;
+        }
+        else
+        {
+            exhausted = true;
+        }
+        /* The hold-off also limits the warnings of a rule that is used up */
+        rules_fired_ms[index] = now ? now : 1;
+    }
+    rules_mutex.unlock();
+
+    if (exhausted)
+    {
+        gateway_metrics_increment(GATEWAY_COUNTER_RULES_EXHAUSTED, 1);
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_WARN, "[App] Local rule %04X/%06lX has no actions left\n", pdu->src, pdu->opcode);
+    }
+    if (fired)
+    {
+        gateway_metrics_increment(GATEWAY_COUNTER_RULES_FIRED, 1);
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_DEBUG, "[App] Local rule %04X/%06lX fired\n", pdu->src, pdu->opcode);
+        /* Not written here: this runs in the BLE stack's callback */
+        gateway_persist_post(GATEWAY_PERSIST_RULES_USED, 0, NULL, 0);
+        gateway_mesh_tx_post(GATEWAY_MESH_TX_DATA, action, GATEWAY_LATENCY_NO_TRACE, MESH_ADDR_UNASSIGNED);
+    }
+    return fired;
+}
+
+void mesh_rules_save_used(void)
+{
+    uint8_t used[MESH_RULES_MAX];
+
+    /* Only this thread writes the counts, so the last snapshot written is the latest */
+    rules_mutex.lock();
+    memcpy(used, rules_used, sizeof(used));
+    rules_mutex.unlock();
+    rules_kv_set(rules_used_key, used, sizeof(used));
+}
+
+cy_rslt_t mesh_rules_set(uint16_t src, uint32_t opcode, const char* const* actions, const uint32_t* action_lens,
+                         uint32_t action_count)
+{
+    cy_rslt_t result = CY_RSLT_SUCCESS;
+    uint8_t* slot;
+    uint32_t i;
+    uint32_t j;
+
+    if (src == MESH_ADDR_UNASSIGNED || opcode == MESH_PDU_OPCODE_INVALID ||
+        action_count > MESH_RULES_ACTIONS_PER_RULE || (action_count > 0 && (!actions || !action_lens)))
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+    for (i = 0; i < action_count; i++)
+    {
+        if (!action_is_valid(actions[i], action_lens[i]))
+        {
+            return CY_RSLT_MW_ERROR;
+        }
+    }
+
+    rules_mutex.lock();
+    slot = rules_index_find(src, opcode);
+    if (action_count == 0)
+    {
+        if (*slot == RULES_INDEX_EMPTY)
+        {
+            rules_mutex.unlock();
+            return CY_RSLT_SUCCESS;
+        }
+        /* Keep the rules packed; the index is rebuilt below */
+        rules_store.rules[*slot] = rules_store.rules[rules_store.count - 1];
+        rules_used[*slot] = rules_used[rules_store.count - 1];
+        rules_store.count--;
+    }
+    else
+    {
+        uint32_t index;
+        if (*slot != RULES_INDEX_EMPTY)
+        {
+            index = *slot;
+        }
+        else if (rules_store.count < MESH_RULES_MAX)
+        {
+            index = rules_store.count++;
+        }
+        else
+        {
+            rules_mutex.unlock();
+            return CY_RSLT_MW_ERROR;
+        }
+        mesh_rule_t* rule = &rules_store.rules[index];
+        memset(rule, 0, sizeof(mesh_rule_t));
+        rule->src          = src;
+        rule->opcode       = opcode;
+        rule->action_count = (uint8_t)action_count;
+        for (i = 0; i < action_count; i++)
+        {
+            rule->action_len[i] = (uint8_t)(action_lens[i] / 2);
+            for (j = 0; j < rule->action_len[i]; j++)
+            {
+                rule->actions[i][j] = (uint8_t)((hex_value(actions[i][j * 2]) << 4) | hex_value(actions[i][j * 2 + 1]));
+            }
+        }
+        /* A new stock starts over */
+        rules_used[index] = 0;
+    }
+    rules_compile();
+    result = rules_save();
+    rules_mutex.unlock();
+
+    gateway_persist_post(GATEWAY_PERSIST_RULES_USED, 0, NULL, 0);
+    return result;
+}
+
+cy_rslt_t mesh_rules_apply_request(const char* request, uint32_t request_len)
+{
+    const char* fields[2 + MESH_RULES_ACTIONS_PER_RULE] = { request };
+    uint32_t lengths[2 + MESH_RULES_ACTIONS_PER_RULE] = { 0 };
+    uint32_t count = 1;
+    uint32_t src = 0;
+    uint32_t opcode = 0;
+    uint32_t i;
+
+    if (!request || request_len == 0)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    for (i = 0; i < request_len; i++)
+    {
+        if (request[i] == ',')
+        {
+            if (count == 2 + MESH_RULES_ACTIONS_PER_RULE)
+            {
+                return CY_RSLT_MW_ERROR;
+            }
+            fields[count++] = &request[i + 1];
+        }
+        else
+        {
+            lengths[count - 1]++;
+        }
+    }
+
+    if (count < 2 || lengths[0] == 0 || lengths[0] > 4 || lengths[1] == 0 || lengths[1] > 6 ||
+        cy_string_to_unsigned(fields[0], lengths[0], &src, 1) == 0 ||
+        cy_string_to_unsigned(fields[1], lengths[1], &opcode, 1) == 0)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    return mesh_rules_set((uint16_t)src, opcode, &fields[2], &lengths[2], count - 2);
+}
+
+uint32_t mesh_rules_to_json(char* buffer, uint32_t buffer_len)
+{
+    uint32_t written = 0;
+    uint32_t i;
+    int ret;
+
+    if (!buffer || buffer_len == 0)
+    {
+        return 0;
+    }
+
+    ret = snprintf(buffer, buffer_len, "{\"rules\":[");
+    if (ret < 0 || (uint32_t)ret >= buffer_len)
+    {
+        return 0;
+    }
+    written = ret;
+
+    rules_mutex.lock();
+    for (i = 0; i < rules_store.count; i++)
+    {
+        const mesh_rule_t* rule = &rules_store.rules[i];
+        uint32_t left = (rules_used[i] < rule->action_count) ? rule->action_count - rules_used[i] : 0;
+        ret = snprintf(buffer + written, buffer_len - written, "%s{\"src\":\"%04X\",\"opcode\":\"%lX\",\"actions\":%u,\"left\":%lu}",
+                       (i > 0) ? "," : "", rule->src, (unsigned long)rule->opcode, (unsigned)rule->action_count,
+                       (unsigned long)left);
+        /* Leave room for the closing brackets */
+        if (ret < 0 || (uint32_t)ret + 2 >= buffer_len - written)
+        {
+            break;
+        }
+        written += ret;
+    }
+    rules_mutex.unlock();
+
+    ret = snprintf(buffer + written, buffer_len - written, "]}");
+    if (ret < 0 || (uint32_t)ret >= buffer_len - written)
+    {
+        return 0;
+    }
+    return written + ret;
+}
+
+uint32_t mesh_rules_get_sources(uint16_t* sources, uint32_t max)
+{
+    uint32_t count = 0;
+
+    if (!sources)
+    {
+        return 0;
+    }
+
+    rules_mutex.lock();
+    for (count = 0; count < rules_store.count && count < max; count++)
+    {
+        sources[count] = rules_store.rules[count].src;
+    }
+    rules_mutex.unlock();
+    return count;
+}
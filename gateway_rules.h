@@ -0,0 +1,93 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway local rule engine
+ *
+ * A rule sends a downlink network PDU whenever an uplink packet with a given
+ * source address and opcode arrives, e.g. "motion sensor 0005 reports Sensor
+ * Status -> send Generic OnOff Set to the corridor group". Rules run on the
+ * gateway, so they answer without a cloud round trip and keep working while
+ * the WAN is down.
+ *
+ * The gateway holds no mesh keys, so it cannot give a PDU a new sequence
+ * number: SEQ is obfuscated and bound into the NetMIC. Instead the Mesh
+ * controller encrypts a stock of up to MESH_RULES_ACTIONS_PER_RULE action PDUs
+ * per rule, with increasing SEQ values from a source address used by the rules
+ * only. Every firing sends the next unused one; once the stock is used up the
+ * rule no longer fires until it is set again. The number used is saved by the
+ * persistence thread, so no PDU is sent twice across resets. Matching the
+ * trigger relies on the controller handing over decrypted PDUs.
+ *
+ * Rules are kept in KVStore and compiled into an open addressed index keyed
+ * by (source, opcode); matching a packet is a single hash lookup. A rule does
+ * not fire again within MESH_RULES_HOLDOFF_MSEC, so a rule whose action makes
+ * its own trigger node report again cannot loop.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+#include "gateway_mesh_pdu.h"
+#include "gateway_threads.h"
+#include "gateway_footprint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MESH_RULES_MAX                  (GATEWAY_FOOTPRINT_RULES_MAX)
+/* Must be a power of two, and larger than MESH_RULES_MAX */
+#define MESH_RULES_INDEX_SLOTS          (GATEWAY_FOOTPRINT_RULES_INDEX_SLOTS)
+#define MESH_RULES_ACTIONS_PER_RULE     (4)
+/* Proxy header and the longest network PDU */
+#define MESH_RULES_PDU_MAX              (30)
+/* An action is queued for the mesh TX thread as hex text */
+#define MESH_RULES_ACTION_MAX           (MESH_RULES_PDU_MAX * 2)
+#define MESH_RULES_HOLDOFF_MSEC         (1000)
+#define MESH_RULES_JSON_SIZE            (MESH_RULES_MAX * 64 + 16)
+
+/* Loads the stored rules */
+cy_rslt_t mesh_rules_init(void);
+
+/* Queues the next unused action of the rule matching 'pdu', if any. Returns true if a rule fired. */
+bool mesh_rules_process(const mesh_pdu_t* pdu);
+
+/* Adds or replaces the rule for (src, opcode) with 'action_count' hex proxy packets, in the order they are
+ * to be sent; no actions remove it. The rules are saved to KVStore.
+ */
+cy_rslt_t mesh_rules_set(uint16_t src, uint32_t opcode, const char* const* actions, const uint32_t* action_lens,
+                         uint32_t action_count);
+
+/* Applies a request "<src>,<opcode>,<hex proxy packet>[,<hex proxy packet>...]" (all hex);
+ * "<src>,<opcode>" removes the rule
+ */
+cy_rslt_t mesh_rules_apply_request(const char* request, uint32_t request_len);
+
+/* Writes the number of used actions of every rule to KVStore; runs on the persistence thread */
+void mesh_rules_save_used(void);
+
+/* Renders all rules as JSON into 'buffer'. Returns the length written. */
+uint32_t mesh_rules_to_json(char* buffer, uint32_t buffer_len);
+
+/* Copies the source addresses of up to 'max' rules into 'sources'. Returns the number copied. */
+uint32_t mesh_rules_get_sources(uint16_t* sources, uint32_t max);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
@@ -0,0 +1,368 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway sensor aggregation implementation
+ */
+
+#include "mbed.h"
+
+#include "gateway_sensor_agg.h"
+#include "gateway_idle.h"
+
+#define SENSOR_MPID_FORMAT_B                (0x01)
+#define SENSOR_FORMAT_B_ZERO_LENGTH         (0x7F)
+
+/* Properties carried as signed values (Temperature 8 characteristics) */
+static const uint16_t signed_properties[] =
+{
+    0x004F,     /* Present Ambient Temperature */
+    0x0056,     /* Present Indoor Ambient Temperature */
+    0x005B,     /* Present Outdoor Ambient Temperature */
+};
+
+static mesh_sensor_series_t sensor_series[MESH_SENSOR_AGG_MAX_SERIES];
+static uint16_t raw_nodes[MESH_SENSOR_AGG_MAX_RAW_NODES];
+
+MBED_STATIC_ASSERT(sizeof(mesh_sensor_series_t) <= GATEWAY_FOOTPRINT_SENSOR_SERIES_ENTRY, "A sensor series exceeds its size in the footprint profile");
+MBED_STATIC_ASSERT(sizeof(sensor_series) + sizeof(raw_nodes) <= GATEWAY_FOOTPRINT_SENSOR_AGG_RAM, "Sensor series exceed their share of the footprint profile");
+
+static mesh_sensor_summary_callback_t summary_callback = NULL;
+static Mutex sensor_mutex;
+
+static bool is_signed_property(uint16_t property_id)
+{
+    uint32_t i;
+    for (i = 0; i < sizeof(signed_properties) / sizeof(signed_properties[0]); i++)
+    {
+        if (signed_properties[i] == property_id)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool is_raw_node(uint16_t src)
+{
+    uint32_t i;
+    for (i = 0; i < MESH_SENSOR_AGG_MAX_RAW_NODES; i++)
+    {
+        if (raw_nodes[i] == src)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int mesh_sensor_decode_status(const uint8_t* data, uint16_t len, mesh_sensor_reading_t* readings)
+{
+    uint16_t offset = 0;
+    int count = 0;
+
+    while (offset < len)
+    {
+        uint16_t property_id;
+        uint8_t value_len;
+        uint32_t raw = 0;
+        uint8_t i;
+
+        if ((data[offset] & SENSOR_MPID_FORMAT_B) == 0)
+        {
+            if (offset + 2 > len)
+            {
+                return -1;
+            }
+            uint16_t mpid = (uint16_t)(data[offset] | (data[offset + 1] << 8));
+            value_len   = ((mpid >> 1) & 0x0F) + 1;
+            property_id = mpid >> 5;
+            offset += 2;
+        }
+        else
+        {
+            if (offset + 3 > len)
+            {
+                return -1;
+            }
+            value_len   = (data[offset] >> 1) & 0x7F;
+            value_len   = (value_len == SENSOR_FORMAT_B_ZERO_LENGTH) ? 0 : value_len + 1;
+            property_id = (uint16_t)(data[offset + 1] | (data[offset + 2] << 8));
+            offset += 3;
+        }
+
+        if (value_len == 0 || value_len > 4 || offset + value_len > len || count >= MESH_SENSOR_MAX_PROPERTIES_PER_STATUS)
+        {
+            return -1;
+        }
+
+        for (i = 0; i < value_len; i++)
+        {
+            raw |= (uint32_t)data[offset + i] << (8 * i);
+        }
+        if (is_signed_property(property_id) && value_len < 4 && (raw & (1u << (value_len * 8 - 1))))
+        {
+            raw |= 0xFFFFFFFFu << (value_len * 8);
+        }
+
+        readings[count].property_id = property_id;
+        readings[count].value       = (int32_t)raw;
+        count++;
+        offset += value_len;
+    }
+
+    return count;
+}
+
+/* Returns the series of (src, property_id), or NULL if there is none */
+static mesh_sensor_series_t* lookup_series(uint16_t src, uint16_t property_id)
+{
+    uint32_t i;
+
+    for (i = 0; i < MESH_SENSOR_AGG_MAX_SERIES; i++)
+    {
+        if (sensor_series[i].src == src && sensor_series[i].property_id == property_id)
+        {
+            return &sensor_series[i];
+        }
+    }
+    return NULL;
+}
+
+static uint32_t free_series_count(void)
+{
+    uint32_t count = 0;
+    uint32_t i;
+
+    for (i = 0; i < MESH_SENSOR_AGG_MAX_SERIES; i++)
+    {
+        if (sensor_series[i].src == MESH_ADDR_UNASSIGNED)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+static mesh_sensor_series_t* find_series(uint16_t src, uint16_t property_id)
+{
+    mesh_sensor_series_t* series = lookup_series(src, property_id);
+    uint32_t i;
+
+    for (i = 0; !series && i < MESH_SENSOR_AGG_MAX_SERIES; i++)
+    {
+        if (sensor_series[i].src == MESH_ADDR_UNASSIGNED)
+        {
+            series = &sensor_series[i];
+            memset(series, 0, sizeof(mesh_sensor_series_t));
+            series->src         = src;
+            series->property_id = property_id;
+        }
+    }
+    return series;
+}
+
+void mesh_sensor_agg_init(mesh_sensor_summary_callback_t callback)
+{
+    sensor_mutex.lock();
+    memset(sensor_series, 0, sizeof(sensor_series));
+    summary_callback = callback;
+    sensor_mutex.unlock();
+}
+
+bool mesh_sensor_agg_process(const mesh_pdu_t* pdu)
+{
+    mesh_sensor_reading_t readings[MESH_SENSOR_MAX_PROPERTIES_PER_STATUS];
+    mesh_sensor_series_t summaries[MESH_SENSOR_MAX_PROPERTIES_PER_STATUS];
+    uint32_t summary_count = 0;
+    uint32_t now = (uint32_t)Kernel::get_ms_count();
+    uint32_t missing = 0;
+    int count;
+    int i;
+
+    if (!pdu || pdu->opcode != MESH_OPCODE_SENSOR_STATUS || pdu->params_len == 0)
+    {
+        return false;
+    }
+
+    count = mesh_sensor_decode_status(pdu->params, pdu->params_len, readings);
+    if (count <= 0)
+    {
+        return false;
+    }
+
+    sensor_mutex.lock();
+    if (is_raw_node(pdu->src))
+    {
+        sensor_mutex.unlock();
+        return false;
+    }
+
+    /* Either every reading of the status is aggregated, or the raw packet is
+     * forwarded and none is; a reading must not be counted twice */
+    for (i = 0; i < count; i++)
+    {
+        if (!lookup_series(pdu->src, readings[i].property_id))
+        {
+            missing++;
+        }
+    }
+    if (missing > free_series_count())
+    {
+        /* Out of windows; keep the raw readings so nothing is lost */
+        sensor_mutex.unlock();
+        return false;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        mesh_sensor_series_t* series = find_series(pdu->src, readings[i].property_id);
+
+        if (series->count > 0 && (now - series->window_start_ms) >= MESH_SENSOR_AGG_WINDOW_MSEC)
+        {
+            memcpy(&summaries[summary_count++], series, sizeof(mesh_sensor_series_t));
+            series->count = 0;
+        }
+
+        if (series->count == 0)
+        {
+            series->window_start_ms = now;
+            series->min = readings[i].value;
+            series->max = readings[i].value;
+            series->sum = 0;
+        }
+        series->min  = (readings[i].value < series->min) ? readings[i].value : series->min;
+        series->max  = (readings[i].value > series->max) ? readings[i].value : series->max;
+        series->sum += readings[i].value;
+        series->count++;
+    }
+    sensor_mutex.unlock();
+
+    for (i = 0; i < (int)summary_count; i++)
+    {
+        if (summary_callback)
+        {
+            summary_callback(&summaries[i]);
+        }
+    }
+
+    return true;
+}
+
+uint32_t mesh_sensor_agg_poll(void)
+{
+    uint32_t now = (uint32_t)Kernel::get_ms_count();
+    uint32_t next_ms = GATEWAY_IDLE_FOREVER;
+    mesh_sensor_series_t summary;
+    uint32_t i;
+
+    for (i = 0; i < MESH_SENSOR_AGG_MAX_SERIES; i++)
+    {
+        bool expired = false;
+        uint32_t remaining;
+
+        sensor_mutex.lock();
+        mesh_sensor_series_t* series = &sensor_series[i];
+        if (series->src == MESH_ADDR_UNASSIGNED || series->count == 0)
+        {
+            sensor_mutex.unlock();
+            continue;
+        }
+        remaining = gateway_idle_until(now, series->window_start_ms + MESH_SENSOR_AGG_WINDOW_MSEC);
+        if (remaining == 0)
+        {
+            memcpy(&summary, series, sizeof(mesh_sensor_series_t));
+            /* A node that stopped reporting gives its window back */
+            series->src = MESH_ADDR_UNASSIGNED;
+            series->count = 0;
+            expired = true;
+        }
+        else if (remaining < next_ms)
+        {
+            next_ms = remaining;
+        }
+        sensor_mutex.unlock();
+
+        if (expired && summary_callback)
+        {
+            summary_callback(&summary);
+        }
+    }
+    /* A summary a little late is fine; it shares the wakeup of the other timers */
+    return gateway_idle_align(now, next_ms);
+}
+
+cy_rslt_t mesh_sensor_agg_set_raw(uint16_t src, bool raw)
+{
+    cy_rslt_t result = CY_RSLT_MW_ERROR;
+    uint32_t i;
+
+    if (src == MESH_ADDR_UNASSIGNED)
+    {
+        return result;
+    }
+
+    sensor_mutex.lock();
+    if (is_raw_node(src) == raw)
+    {
+        result = CY_RSLT_SUCCESS;
+    }
+    else
+    {
+        uint16_t match = raw ? MESH_ADDR_UNASSIGNED : src;
+        for (i = 0; i < MESH_SENSOR_AGG_MAX_RAW_NODES; i++)
+        {
+            if (raw_nodes[i] == match)
+            {
+                raw_nodes[i] = raw ? src : MESH_ADDR_UNASSIGNED;
+                result = CY_RSLT_SUCCESS;
+                break;
+            }
+        }
+    }
+    sensor_mutex.unlock();
+
+    return result;
+}
+
+uint32_t mesh_sensor_agg_to_json(const mesh_sensor_series_t* summary, char* buffer, uint32_t buffer_len)
+{
+    int64_t mean_x100;
+    int64_t mean_abs;
+    int ret;
+
+    if (!summary || !buffer || summary->count == 0)
+    {
+        return 0;
+    }
+
+    mean_x100 = (summary->sum * 100) / (int64_t)summary->count;
+    mean_abs  = (mean_x100 < 0) ? -mean_x100 : mean_x100;
+
+    ret = snprintf(buffer, buffer_len,
+                   "{\"src\":\"%04X\",\"property\":\"%04X\",\"count\":%lu,\"min\":%ld,\"max\":%ld,\"mean\":%s%ld.%02ld,\"window_ms\":%lu}",
+                   summary->src, summary->property_id, (unsigned long)summary->count,
+                   (long)summary->min, (long)summary->max,
+                   (mean_x100 < 0) ? "-" : "", (long)(mean_abs / 100), (long)(mean_abs % 100),
+                   (unsigned long)MESH_SENSOR_AGG_WINDOW_MSEC);
+
+    if (ret < 0 || (uint32_t)ret >= buffer_len)
+    {
+        return 0;
+    }
+    return ret;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway sensor aggregation
+ *
+ * Decodes Sensor Status messages and folds every numeric property value into
+ * a per node/property window. One summary (count, min, max, mean) is reported
+ * per window instead of every raw reading. Nodes can be switched back to raw
+ * pass-through individually.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+#include "gateway_mesh_pdu.h"
+#include "gateway_footprint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MESH_OPCODE_SENSOR_STATUS           (0x52)
+
+#define MESH_SENSOR_AGG_MAX_SERIES          (GATEWAY_FOOTPRINT_SENSOR_SERIES)
+#define MESH_SENSOR_AGG_MAX_RAW_NODES       (GATEWAY_FOOTPRINT_SENSOR_RAW_NODES)
+#define MESH_SENSOR_AGG_WINDOW_MSEC         (60 * 1000)
+#define MESH_SENSOR_MAX_PROPERTIES_PER_STATUS (8)
+
+typedef struct
+{
+    uint16_t    property_id;
+    int32_t     value;
+} mesh_sensor_reading_t;
+
+typedef struct
+{
+    uint16_t    src;
+    uint16_t    property_id;
+    uint32_t    count;
+    int32_t     min;
+    int32_t     max;
+    int64_t     sum;
+    uint32_t    window_start_ms;
+} mesh_sensor_series_t;
+
+typedef void (*mesh_sensor_summary_callback_t)(const mesh_sensor_series_t* summary);
+
+/* Decodes the marshalled sensor data of a Sensor Status into up to MESH_SENSOR_MAX_PROPERTIES_PER_STATUS
+ * readings. Returns the number of readings, or -1 if not all are numeric.
+ */
+int mesh_sensor_decode_status(const uint8_t* data, uint16_t len, mesh_sensor_reading_t* readings);
+
+void mesh_sensor_agg_init(mesh_sensor_summary_callback_t callback);
+
+/* Returns true if 'pdu' was consumed by the aggregation and must not be forwarded raw. A Sensor Status
+ * is consumed with all of its readings, or not at all. */
+bool mesh_sensor_agg_process(const mesh_pdu_t* pdu);
+
+/* Reports windows that expired without receiving a new reading. Returns the time until the next window expires. */
+uint32_t mesh_sensor_agg_poll(void);
+
+cy_rslt_t mesh_sensor_agg_set_raw(uint16_t src, bool raw);
+
+/* Renders 'summary' as JSON into 'buffer'. Returns the length written. */
+uint32_t mesh_sensor_agg_to_json(const mesh_sensor_series_t* summary, char* buffer, uint32_t buffer_len);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
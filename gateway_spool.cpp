@@ -0,0 +1,366 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway store-and-forward spool implementation
+ */
+
+#include "mbed.h"
+
+#include "KVStore.h"
+#include "kvstore_global_api.h"
+
+#include "gateway_spool.h"
+#include "gateway_trace.h"
+#include "gateway_warmboot.h"
+
+#define err_code(res) MBED_GET_ERROR_CODE(res)
+
+#define SPOOL_INDEX_MAGIC           (0x53504F4C)
+#define SPOOL_KEY_SIZE              (24)
+
+typedef struct
+{
+    uint16_t    len;
+    char        topic[GATEWAY_SPOOL_TOPIC_MAX + 1];
+    uint8_t     payload[GATEWAY_SPOOL_PAYLOAD_MAX];
+} spool_entry_t;
+
+typedef struct
+{
+    uint32_t    magic;
+    uint16_t    head;
+    uint16_t    count;
+} spool_index_t;
+
+/* Only the used part of the payload is written to flash */
+#define SPOOL_ENTRY_SIZE(entry)     (offsetof(spool_entry_t, payload) + (entry)->len)
+
+static spool_entry_t ram_ring[GATEWAY_SPOOL_RAM_ENTRIES];
+static uint32_t ram_head = 0;
+static uint32_t ram_count = 0;
+static gateway_spool_stats_t spool_stats;
+static Mutex spool_mutex;
+
+#if GATEWAY_SPOOL_FLASH_ENTRIES > 0
+static const char* spool_index_key = "/kv/spool_idx";
+static spool_index_t flash_index;
+/* The last index write failed, so the one in flash is behind */
+static bool flash_index_stale = false;
+static spool_entry_t flash_scratch;
+
+MBED_STATIC_ASSERT(sizeof(spool_entry_t) <= GATEWAY_FOOTPRINT_SPOOL_ENTRY, "A spool entry exceeds its size in the footprint profile");
+MBED_STATIC_ASSERT(GATEWAY_SPOOL_FLASH_ENTRIES * sizeof(spool_entry_t) <= GATEWAY_FOOTPRINT_SPOOL_KVSTORE, "Spooled records exceed their KVStore share of the footprint profile");
+MBED_STATIC_ASSERT(sizeof(ram_ring) + sizeof(flash_scratch) <= GATEWAY_FOOTPRINT_SPOOL_RAM, "Spool entries exceed their share of the footprint profile");
+
+static void flash_entry_key(uint32_t slot, char* key)
+{
+    snprintf(key, SPOOL_KEY_SIZE, "/kv/spool_%02lu", (unsigned long)slot);
+}
+
+static void flash_save_index(void)
+{
+    flash_index_stale = err_code(kv_set(spool_index_key, &flash_index, sizeof(flash_index), 0)) != 0;
+    if (flash_index_stale)
+    {
+        spool_stats.flash_errors++;
+    }
+}
+
+static cy_rslt_t flash_append(const spool_entry_t* entry)
+{
+    char key[SPOOL_KEY_SIZE];
+
+    flash_entry_key((flash_index.head + flash_index.count) % GATEWAY_SPOOL_FLASH_ENTRIES, key);
+    if (err_code(kv_set(key, entry, SPOOL_ENTRY_SIZE(entry), 0)) != 0)
+    {
+        spool_stats.flash_errors++;
+        return CY_RSLT_MW_ERROR;
+    }
+    flash_index.count++;
+    flash_save_index();
+    return CY_RSLT_SUCCESS;
+}
+
+/* Removes the oldest flash record and reads it into 'entry' */
+static cy_rslt_t flash_pop(spool_entry_t* entry)
+{
+    char key[SPOOL_KEY_SIZE];
+    size_t actual_size = 0;
+    cy_rslt_t result = CY_RSLT_SUCCESS;
+
+    flash_entry_key(flash_index.head, key);
+    if (err_code(kv_get(key, entry, sizeof(spool_entry_t), &actual_size)) != 0 ||
+        actual_size < offsetof(spool_entry_t, payload) || actual_size != SPOOL_ENTRY_SIZE(entry))
+    {
+        spool_stats.flash_errors++;
+        result = CY_RSLT_MW_ERROR;
+    }
+    entry->topic[GATEWAY_SPOOL_TOPIC_MAX] = '\0';
+    kv_remove(key);
+
+    flash_index.head = (flash_index.head + 1) % GATEWAY_SPOOL_FLASH_ENTRIES;
+    flash_index.count--;
+    flash_save_index();
+    return result;
+}
+#endif
+
+static spool_entry_t* ram_tail(void)
+{
+    return &ram_ring[(ram_head + ram_count) % GATEWAY_SPOOL_RAM_ENTRIES];
+}
+
+static uint32_t flash_count(void)
+{
+#if GATEWAY_SPOOL_FLASH_ENTRIES > 0
+    return flash_index.count;
+#else
+    return 0;
+#endif
+}
+
+/* Moves flash records up into free RAM slots, keeping the FIFO order */
+static void refill_from_flash(void)
+{
+#if GATEWAY_SPOOL_FLASH_ENTRIES > 0
+    while (ram_count < GATEWAY_SPOOL_RAM_ENTRIES && flash_index.count > 0)
+    {
+        if (flash_pop(ram_tail()) == CY_RSLT_SUCCESS)
+        {
+            ram_count++;
+        }
+        else
+        {
+            spool_stats.dropped++;
+        }
+    }
+#endif
+}
+
+cy_rslt_t gateway_spool_init(void)
+{
+    memset(&spool_stats, 0, sizeof(spool_stats));
+    ram_head = 0;
+    ram_count = 0;
+
+#if GATEWAY_SPOOL_FLASH_ENTRIES > 0
+    size_t actual_size = 0;
+    if (err_code(kv_get(spool_index_key, &flash_index, sizeof(flash_index), &actual_size)) != 0 ||
+        actual_size != sizeof(flash_index) || flash_index.magic != SPOOL_INDEX_MAGIC ||
+        flash_index.head >= GATEWAY_SPOOL_FLASH_ENTRIES || flash_index.count > GATEWAY_SPOOL_FLASH_ENTRIES)
+    {
+        flash_index.magic = SPOOL_INDEX_MAGIC;
+        flash_index.head  = 0;
+        flash_index.count = 0;
+        flash_save_index();
+    }
+    else if (flash_index.count > 0)
+    {
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_INFO, "[App] %u spooled messages recovered from flash\n", flash_index.count);
+    }
+    /* Moved up into RAM by the first drain, after any restored messages */
+#endif
+
+    return CY_RSLT_SUCCESS;
+}
+
+static void entry_fill(spool_entry_t* entry, const char* topic, uint32_t topic_len, const uint8_t* payload, uint32_t len)
+{
+    entry->len = (uint16_t)len;
+    memcpy(entry->topic, topic, topic_len + 1);
+    if (len > 0)
+    {
+        memcpy(entry->payload, payload, len);
+    }
+}
+
+cy_rslt_t gateway_spool_restore(const char* topic, const uint8_t* payload, uint32_t len)
+{
+    uint32_t topic_len = topic ? strlen(topic) : 0;
+
+    if (topic_len == 0 || topic_len > GATEWAY_SPOOL_TOPIC_MAX || len > GATEWAY_SPOOL_PAYLOAD_MAX || (len > 0 && !payload))
+    {
+        spool_stats.too_large++;
+        return CY_RSLT_MW_ERROR;
+    }
+
+    spool_mutex.lock();
+    if (ram_count == GATEWAY_SPOOL_RAM_ENTRIES)
+    {
+        spool_stats.dropped++;
+        spool_mutex.unlock();
+        return CY_RSLT_MW_ERROR;
+    }
+    entry_fill(ram_tail(), topic, topic_len, payload, len);
+    ram_count++;
+    spool_stats.spooled++;
+    spool_mutex.unlock();
+    return CY_RSLT_SUCCESS;
+}
+
+static cy_rslt_t spool_push(const char* topic, uint32_t topic_len, const uint8_t* payload, uint32_t len)
+{
+    spool_entry_t* entry;
+
+    if (ram_count == GATEWAY_SPOOL_RAM_ENTRIES && flash_count() == GATEWAY_SPOOL_FLASH_ENTRIES)
+    {
+#if GATEWAY_SPOOL_DROP_POLICY == GATEWAY_SPOOL_DROP_NEWEST
+        spool_stats.dropped++;
+        return CY_RSLT_MW_ERROR;
+#else
+        ram_head = (ram_head + 1) % GATEWAY_SPOOL_RAM_ENTRIES;
+        ram_count--;
+        spool_stats.dropped++;
+        refill_from_flash();
+#endif
+    }
+
+#if GATEWAY_SPOOL_FLASH_ENTRIES > 0
+    /* Anything newer than a flash record has to go to flash too */
+    if (ram_count == GATEWAY_SPOOL_RAM_ENTRIES || flash_index.count > 0)
+    {
+        entry = &flash_scratch;
+    }
+    else
+#endif
+    {
+        entry = ram_tail();
+    }
+
+    entry_fill(entry, topic, topic_len, payload, len);
+
+#if GATEWAY_SPOOL_FLASH_ENTRIES > 0
+    if (entry == &flash_scratch)
+    {
+        if (flash_append(entry) != CY_RSLT_SUCCESS)
+        {
+            spool_stats.dropped++;
+            return CY_RSLT_MW_ERROR;
+        }
+        spool_stats.spooled++;
+        return CY_RSLT_SUCCESS;
+    }
+#endif
+    ram_count++;
+    spool_stats.spooled++;
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t gateway_spool_push(const char* topic, const uint8_t* payload, uint32_t len)
+{
+    uint32_t topic_len = topic ? strlen(topic) : 0;
+    cy_rslt_t result;
+
+    if (topic_len == 0 || topic_len > GATEWAY_SPOOL_TOPIC_MAX || len > GATEWAY_SPOOL_PAYLOAD_MAX || (len > 0 && !payload))
+    {
+        spool_stats.too_large++;
+        return CY_RSLT_MW_ERROR;
+    }
+
+    spool_mutex.lock();
+    result = spool_push(topic, topic_len, payload, len);
+    spool_mutex.unlock();
+    return result;
+}
+
+bool gateway_spool_is_empty(void)
+{
+    bool empty;
+
+    spool_mutex.lock();
+    empty = ram_count == 0 && flash_count() == 0;
+    spool_mutex.unlock();
+    return empty;
+}
+
+uint32_t gateway_spool_drain(gateway_spool_publish_t publish, uint32_t max_entries)
+{
+    uint32_t published = 0;
+
+    if (!publish)
+    {
+        return 0;
+    }
+
+    spool_mutex.lock();
+    refill_from_flash();
+    while (published < max_entries && ram_count > 0)
+    {
+        /* Only this thread removes entries, so the head stays put while it is published */
+        spool_entry_t* entry = &ram_ring[ram_head];
+        spool_mutex.unlock();
+        if (publish(entry->topic, entry->payload, entry->len) != CY_RSLT_SUCCESS)
+        {
+            return published;
+        }
+        spool_mutex.lock();
+        ram_head = (ram_head + 1) % GATEWAY_SPOOL_RAM_ENTRIES;
+        ram_count--;
+        published++;
+        spool_stats.drained++;
+        refill_from_flash();
+    }
+    spool_mutex.unlock();
+    return published;
+}
+
+void gateway_spool_get_stats(gateway_spool_stats_t* stats)
+{
+    if (!stats)
+    {
+        return;
+    }
+    spool_mutex.lock();
+    memcpy(stats, &spool_stats, sizeof(gateway_spool_stats_t));
+    stats->depth = ram_count + flash_count();
+    spool_mutex.unlock();
+}
+
+void gateway_spool_retain(void)
+{
+    gateway_warmboot_record_t record;
+
+    /* The network thread may still be in the spool, or be stuck in it */
+    if (!spool_mutex.trylock_for(GATEWAY_SPOOL_RETAIN_WAIT_MSEC))
+    {
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_ERROR, "[App] Spool busy, %lu messages in RAM not retained\n", (unsigned long)ram_count);
+        return;
+    }
+
+#if GATEWAY_SPOOL_FLASH_ENTRIES > 0
+    /* The flash ring has to start right after the RAM ring retained here. With a stale index the next
+     * boot looks for records already moved up into RAM, and misses the ones appended last.
+     */
+    if (flash_index_stale)
+    {
+        flash_save_index();
+    }
+#endif
+
+    memset(&record, 0, sizeof(record));
+    record.type = GATEWAY_WARMBOOT_SPOOLED;
+    for (uint32_t i = 0; i < ram_count; i++)
+    {
+        const spool_entry_t* entry = &ram_ring[(ram_head + i) % GATEWAY_SPOOL_RAM_ENTRIES];
+        record.topic = entry->topic;
+        record.data  = entry->payload;
+        record.len   = entry->len;
+        gateway_warmboot_put(&record);
+    }
+    spool_mutex.unlock();
+}
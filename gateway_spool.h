@@ -0,0 +1,98 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway store-and-forward spool
+ *
+ * Holds messages that could not be published while the cloud is unreachable
+ * and hands them back, oldest first, once it is reachable again. The spool is
+ * a FIFO made of a RAM ring followed by an optional ring of KVStore records:
+ * messages go to RAM while it has room and nothing is waiting in flash, and
+ * flash records move up into RAM as it drains. The flash ring survives a
+ * reset.
+ *
+ * When both rings are full GATEWAY_SPOOL_DROP_POLICY decides whether the
+ * oldest spooled message or the new one is lost.
+ *
+ * The spool is used from the network thread. gateway_spool_retain() runs on
+ * the main thread while that thread may still be running, so the spool state
+ * is guarded by a mutex; it is not held while a drained message is published.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+#include "gateway_footprint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GATEWAY_SPOOL_RAM_ENTRIES           (GATEWAY_FOOTPRINT_SPOOL_RAM_ENTRIES)
+/* Set to 0 to keep the spool in RAM only */
+#define GATEWAY_SPOOL_FLASH_ENTRIES         (GATEWAY_FOOTPRINT_SPOOL_FLASH_ENTRIES)
+#define GATEWAY_SPOOL_TOPIC_MAX             (32)
+#define GATEWAY_SPOOL_PAYLOAD_MAX           (256)
+
+/* Messages published per network poll while the spool drains */
+#define GATEWAY_SPOOL_DRAIN_PER_POLL        (4)
+
+#define GATEWAY_SPOOL_DROP_OLDEST           (0)
+#define GATEWAY_SPOOL_DROP_NEWEST           (1)
+#define GATEWAY_SPOOL_DROP_POLICY           GATEWAY_SPOOL_DROP_OLDEST
+
+/* Longest gateway_spool_retain() waits for the network thread to leave the spool */
+#define GATEWAY_SPOOL_RETAIN_WAIT_MSEC      (500)
+
+typedef struct
+{
+    uint32_t    depth;
+    uint32_t    spooled;
+    uint32_t    drained;
+    uint32_t    dropped;
+    uint32_t    too_large;
+    uint32_t    flash_errors;
+} gateway_spool_stats_t;
+
+typedef cy_rslt_t (*gateway_spool_publish_t)(const char* topic, const uint8_t* payload, uint32_t len);
+
+/* Picks up the messages left in the flash ring by a previous run */
+cy_rslt_t gateway_spool_init(void);
+
+/* Puts a message saved by gateway_spool_retain() back in front of the flash ring.
+ * Call after gateway_spool_init() and before gateway_spool_push().
+ */
+cy_rslt_t gateway_spool_restore(const char* topic, const uint8_t* payload, uint32_t len);
+
+cy_rslt_t gateway_spool_push(const char* topic, const uint8_t* payload, uint32_t len);
+
+bool gateway_spool_is_empty(void);
+
+/* Publishes up to 'max_entries' messages, oldest first, and stops at the first failure. Returns the number published. */
+uint32_t gateway_spool_drain(gateway_spool_publish_t publish, uint32_t max_entries);
+
+void gateway_spool_get_stats(gateway_spool_stats_t* stats);
+
+/* Copies the messages held in RAM into the warm boot store before a restart. The flash ring survives on its own;
+ * its index is written again if the last write of it failed.
+ */
+void gateway_spool_retain(void);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
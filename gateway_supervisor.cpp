@@ -0,0 +1,127 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway supervisor implementation
+ */
+
+#include "mbed.h"
+
+#include "gateway_supervisor.h"
+#include "gateway_idle.h"
+#include "gateway_warmboot.h"
+#include "gateway_trace.h"
+
+#define SUPERVISOR_NO_THREAD        (-1)
+
+static const char* thread_names[GATEWAY_SUPERVISOR_THREAD_MAX] =
+{
+    "network",
+    "mesh TX",
+    "persistence",
+};
+
+static volatile uint32_t heartbeat_ms[GATEWAY_SUPERVISOR_THREAD_MAX];
+static volatile int32_t stopped_thread = SUPERVISOR_NO_THREAD;
+
+void gateway_supervisor_heartbeat(gateway_supervisor_thread_t thread)
+{
+    if (thread < GATEWAY_SUPERVISOR_THREAD_MAX)
+    {
+        heartbeat_ms[thread] = (uint32_t)Kernel::get_ms_count();
+    }
+}
+
+void gateway_supervisor_stopped(gateway_supervisor_thread_t thread)
+{
+    if (thread < GATEWAY_SUPERVISOR_THREAD_MAX)
+    {
+        stopped_thread = thread;
+    }
+}
+
+static void restart(gateway_restart_reason_t reason, uint32_t thread, gateway_supervisor_retain_t retain, uint32_t warm_restarts)
+{
+    /* A restart after a long enough good run starts a new series */
+    uint32_t restarts = Kernel::get_ms_count() >= GATEWAY_SUPERVISOR_STABLE_MSEC ? 1 : warm_restarts + 1;
+
+    MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_ERROR, "[App] %s thread %s, restarting\n", thread_names[thread],
+                       reason == GATEWAY_RESTART_STOPPED ? "stopped" : "stalled");
+    if (restarts <= GATEWAY_SUPERVISOR_WARM_RESTARTS)
+    {
+        gateway_warmboot_begin(restarts, (uint8_t)reason, (uint8_t)thread);
+        if (retain)
+        {
+            retain();
+        }
+        gateway_warmboot_commit();
+    }
+    else
+    {
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_ERROR, "[App] %lu warm restarts in a row, dropping queued traffic\n", warm_restarts);
+    }
+
+    /* Gives the trace thread a chance to print the reason */
+    ThisThread::sleep_for(100);
+    system_reset();
+}
+
+void gateway_supervisor_run(gateway_supervisor_retain_t retain, uint32_t warm_restarts)
+{
+    Watchdog& watchdog = Watchdog::get_instance();
+    uint32_t timeout = GATEWAY_WATCHDOG_TIMEOUT_MSEC;
+    uint32_t now = (uint32_t)Kernel::get_ms_count();
+    uint32_t period;
+    uint32_t delay;
+
+    for (uint32_t i = 0; i < GATEWAY_SUPERVISOR_THREAD_MAX; i++)
+    {
+        heartbeat_ms[i] = now;
+    }
+
+    if (timeout > watchdog.get_max_timeout())
+    {
+        timeout = watchdog.get_max_timeout();
+    }
+    if (!watchdog.start(timeout))
+    {
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_WARN, "[App] Failed to start the watchdog\n");
+    }
+    period = (GATEWAY_SUPERVISOR_PERIOD_MSEC < timeout / 2) ? GATEWAY_SUPERVISOR_PERIOD_MSEC : timeout / 2;
+
+    while (true)
+    {
+        /* Wakes up together with the worker threads, unless that brings the watchdog too close */
+        delay = gateway_idle_align(now, period);
+        ThisThread::sleep_for(delay <= timeout / 2 ? delay : period);
+        gateway_idle_wakeup(GATEWAY_WAKE_HEARTBEAT);
+
+        if (stopped_thread != SUPERVISOR_NO_THREAD)
+        {
+            restart(GATEWAY_RESTART_STOPPED, (uint32_t)stopped_thread, retain, warm_restarts);
+        }
+        now = (uint32_t)Kernel::get_ms_count();
+        for (uint32_t i = 0; i < GATEWAY_SUPERVISOR_THREAD_MAX; i++)
+        {
+            if (now - heartbeat_ms[i] >= GATEWAY_SUPERVISOR_STALL_MSEC)
+            {
+                restart(GATEWAY_RESTART_STALLED, i, retain, warm_restarts);
+            }
+        }
+        watchdog.kick();
+    }
+}
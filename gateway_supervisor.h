@@ -0,0 +1,88 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway supervisor
+ *
+ * Watches the worker threads and restarts the gateway when one of them
+ * stops or stops making progress, instead of leaving the board dead until
+ * it is power cycled.
+ *
+ * Every worker thread reports a heartbeat from its loop. The supervisor runs
+ * on the main thread once the workers are started; it checks the heartbeats
+ * every GATEWAY_SUPERVISOR_PERIOD_MSEC and kicks the hardware watchdog while
+ * all of them are recent. A thread that has not reported for
+ * GATEWAY_SUPERVISOR_STALL_MSEC, or that reports having stopped, triggers a
+ * warm restart: the 'retain' callback saves the queued traffic in the warm
+ * boot store (gateway_warmboot.h) and the board is reset. If the supervisor
+ * itself hangs, the watchdog resets the board (a cold boot).
+ *
+ * A gateway that keeps failing soon after each warm restart is given a cold
+ * one instead, dropping the retained traffic in case it is the cause.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* At most half of the watchdog timeout */
+#define GATEWAY_SUPERVISOR_PERIOD_MSEC      (3000)
+/* Long enough for a TLS connect to the broker */
+#define GATEWAY_SUPERVISOR_STALL_MSEC       (60000)
+/* Longest a worker thread sleeps without reporting a heartbeat */
+#define GATEWAY_SUPERVISOR_HEARTBEAT_MSEC   (GATEWAY_SUPERVISOR_STALL_MSEC / 4)
+/* Limited to what the hardware supports */
+#define GATEWAY_WATCHDOG_TIMEOUT_MSEC       (8000)
+/* Warm restarts in a row, each within GATEWAY_SUPERVISOR_STABLE_MSEC of the previous one, before a cold one */
+#define GATEWAY_SUPERVISOR_WARM_RESTARTS    (3)
+#define GATEWAY_SUPERVISOR_STABLE_MSEC      (10 * 60 * 1000)
+
+typedef enum
+{
+    GATEWAY_SUPERVISOR_NET,
+    GATEWAY_SUPERVISOR_MESH_TX,
+    GATEWAY_SUPERVISOR_PERSIST,
+    GATEWAY_SUPERVISOR_THREAD_MAX
+} gateway_supervisor_thread_t;
+
+typedef enum
+{
+    GATEWAY_RESTART_STALLED = 1,
+    GATEWAY_RESTART_STOPPED
+} gateway_restart_reason_t;
+
+/* Saves the queued traffic with gateway_warmboot_put(); runs on the main thread while the workers may still be running */
+typedef void (*gateway_supervisor_retain_t)(void);
+
+void gateway_supervisor_heartbeat(gateway_supervisor_thread_t thread);
+
+/* Reports that a worker thread has stopped; the supervisor restarts the gateway right away */
+void gateway_supervisor_stopped(gateway_supervisor_thread_t thread);
+
+/* Starts the watchdog and supervises the workers; never returns.
+ * 'warm_restarts' is the number of warm restarts that led to this run.
+ */
+void gateway_supervisor_run(gateway_supervisor_retain_t retain, uint32_t warm_restarts);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
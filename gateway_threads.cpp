@@ -0,0 +1,389 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway worker threads implementation
+ */
+
+#include "mbed.h"
+
+#include "bluetooth_gateway.h"
+#include "gateway_threads.h"
+#include "gateway_idle.h"
+#include "gateway_metrics.h"
+#include "gateway_rules.h"
+#include "gateway_supervisor.h"
+#include "gateway_trace.h"
+#include "gateway_warmboot.h"
+
+/* The BLE stack hands over all NVRAM entries in a burst after provisioning */
+MBED_STATIC_ASSERT(GATEWAY_PERSIST_QUEUE_DEPTH > MESH_NV_DATA_MAX_ENTRIES, "The persistence queue of the footprint profile must hold every NVRAM entry");
+
+typedef struct
+{
+    const char* topic;
+    uint32_t    len;
+    uint8_t     payload[GATEWAY_PUBLISH_MAX_PAYLOAD];
+} publish_msg_t;
+
+typedef struct
+{
+    gateway_mesh_tx_type_t  type;
+    uint32_t                trace;
+    uint16_t                dst;
+    char                    payload[GATEWAY_MESH_TX_MAX_PAYLOAD + 1];
+} mesh_tx_msg_t;
+
+typedef struct
+{
+    gateway_persist_type_t  type;
+    uint16_t                id;
+    uint16_t                len;
+    uint8_t                 data[MESH_NV_DATA_MAX_PAYLOAD];
+} persist_msg_t;
+
+static Mail<publish_msg_t, GATEWAY_NET_QUEUE_DEPTH> publish_mail;
+static Mail<mesh_tx_msg_t, GATEWAY_MESH_TX_QUEUE_DEPTH> mesh_tx_mail;
+static Mail<persist_msg_t, GATEWAY_PERSIST_QUEUE_DEPTH> persist_mail;
+
+static Thread net_thread(GATEWAY_NET_THREAD_PRIORITY, GATEWAY_NET_THREAD_STACK_SIZE, NULL, "gateway_net");
+static Thread mesh_tx_thread(GATEWAY_MESH_TX_THREAD_PRIORITY, GATEWAY_MESH_TX_THREAD_STACK_SIZE, NULL, "gateway_mesh_tx");
+static Thread persist_thread(GATEWAY_PERSIST_THREAD_PRIORITY, GATEWAY_PERSIST_THREAD_STACK_SIZE, NULL, "gateway_persist");
+
+static gateway_thread_handlers_t thread_handlers;
+
+/* NVRAM writes queued or in progress; gateway_threads_retain() waits for them */
+static volatile uint32_t persist_pending = 0;
+
+/* Time at which the network thread wakes up by itself */
+static volatile uint32_t net_wake_ms = 0;
+
+/* Limits a wait of 'wait_ms' to the next heartbeat, which falls on a slot boundary */
+static uint32_t heartbeat_wait(uint32_t wait_ms)
+{
+    uint32_t heartbeat_ms = gateway_idle_align((uint32_t)Kernel::get_ms_count(),
+                                               GATEWAY_SUPERVISOR_HEARTBEAT_MSEC - GATEWAY_IDLE_SLOT_MSEC);
+
+    return (wait_ms < heartbeat_ms) ? wait_ms : heartbeat_ms;
+}
+
+/* Counts what ended a wait of 'wait_ms' for a timer due in 'timer_ms'; a wait of 0 did not sleep */
+static void count_wakeup(const osEvent& evt, uint32_t wait_ms, uint32_t timer_ms)
+{
+    if (wait_ms == 0)
+    {
+        return;
+    }
+    if (evt.status == osEventMail)
+    {
+        gateway_idle_wakeup(GATEWAY_WAKE_QUEUE);
+    }
+    else
+    {
+        gateway_idle_wakeup((wait_ms < timer_ms) ? GATEWAY_WAKE_HEARTBEAT : GATEWAY_WAKE_TIMER);
+    }
+}
+
+static void net_thread_main(void)
+{
+    cy_rslt_t result = CY_RSLT_SUCCESS;
+    uint32_t timer_ms = 0;
+
+    while (result == CY_RSLT_SUCCESS)
+    {
+        gateway_supervisor_heartbeat(GATEWAY_SUPERVISOR_NET);
+
+        /* Sleep until something is queued for publishing, or until the next poll is due */
+        uint32_t wait_ms = publish_mail.empty() ? heartbeat_wait(timer_ms) : 0;
+        core_util_atomic_store_u32(&net_wake_ms, (uint32_t)Kernel::get_ms_count() + wait_ms);
+        osEvent evt = publish_mail.get(wait_ms);
+        core_util_atomic_store_u32(&net_wake_ms, (uint32_t)Kernel::get_ms_count());
+        count_wakeup(evt, wait_ms, timer_ms);
+        while (evt.status == osEventMail)
+        {
+            publish_msg_t* msg = (publish_msg_t*)evt.value.p;
+            /* A message without a topic only wakes the thread up */
+            if (msg->topic && thread_handlers.publish)
+            {
+                thread_handlers.publish(msg->topic, msg->payload, msg->len);
+            }
+            publish_mail.free(msg);
+            evt = publish_mail.get(0);
+        }
+
+        timer_ms = GATEWAY_IDLE_FOREVER;
+        if (thread_handlers.net_poll)
+        {
+            result = thread_handlers.net_poll(&timer_ms);
+        }
+    }
+    MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_ERROR, "[App] Network thread stopped (%lu)\n", result);
+    gateway_supervisor_stopped(GATEWAY_SUPERVISOR_NET);
+}
+
+static void mesh_tx_thread_main(void)
+{
+    uint32_t timer_ms = 0;
+
+    while (true)
+    {
+        gateway_supervisor_heartbeat(GATEWAY_SUPERVISOR_MESH_TX);
+
+        uint32_t wait_ms = mesh_tx_mail.empty() ? heartbeat_wait(timer_ms) : 0;
+        osEvent evt = mesh_tx_mail.get(wait_ms);
+        count_wakeup(evt, wait_ms, timer_ms);
+        if (evt.status == osEventMail)
+        {
+            mesh_tx_msg_t* msg = (mesh_tx_msg_t*)evt.value.p;
+            switch (msg->type)
+            {
+                case GATEWAY_MESH_TX_DATA:
+                    do_mesh_send_data(msg->payload, msg->trace, msg->dst);
+                    break;
+                case GATEWAY_MESH_TX_CONNECT:
+                    do_mesh_connect();
+                    break;
+                case GATEWAY_MESH_TX_DISCONNECT:
+                    do_mesh_disconnect();
+                    break;
+            }
+            mesh_tx_mail.free(msg);
+        }
+
+        /* A command may have started a timer, e.g. its delivery timeout */
+        timer_ms = thread_handlers.mesh_tx_poll ? thread_handlers.mesh_tx_poll() : GATEWAY_IDLE_FOREVER;
+    }
+}
+
+static void persist_thread_main(void)
+{
+    while (true)
+    {
+        gateway_supervisor_heartbeat(GATEWAY_SUPERVISOR_PERSIST);
+
+        /* Only wakes up without a message to show the supervisor it is alive */
+        uint32_t wait_ms = persist_mail.empty() ? heartbeat_wait(GATEWAY_IDLE_FOREVER) : 0;
+        osEvent evt = persist_mail.get(wait_ms);
+        count_wakeup(evt, wait_ms, GATEWAY_IDLE_FOREVER);
+        if (evt.status != osEventMail)
+        {
+            continue;
+        }
+
+        persist_msg_t* msg = (persist_msg_t*)evt.value.p;
+        if (msg->type == GATEWAY_PERSIST_PROVISIONED)
+        {
+            mesh_set_provisioned();
+        }
+#if APP_CONFIG_LOCAL_RULES
+        else if (msg->type == GATEWAY_PERSIST_RULES_USED)
+        {
+            mesh_rules_save_used();
+        }
+#endif
+        else
+        {
+            mesh_write_dct(msg->id, msg->data, msg->len);
+        }
+        persist_mail.free(msg);
+        core_util_atomic_decr_u32(&persist_pending, 1);
+    }
+}
+
+cy_rslt_t gateway_threads_start(const gateway_thread_handlers_t* handlers)
+{
+    if (!handlers)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+    thread_handlers = *handlers;
+
+    if (persist_thread.start(callback(persist_thread_main)) != osOK ||
+        mesh_tx_thread.start(callback(mesh_tx_thread_main)) != osOK ||
+        net_thread.start(callback(net_thread_main)) != osOK)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+    return CY_RSLT_SUCCESS;
+}
+
+void gateway_threads_join(void)
+{
+    net_thread.join();
+}
+
+void gateway_threads_retain(void)
+{
+    gateway_warmboot_record_t record;
+    osEvent evt;
+    uint32_t waited = 0;
+    uint32_t pending;
+
+    /* The NVRAM chunks carry the mesh SEQ; losing a write would make the nodes see old SEQ numbers again */
+    while ((pending = core_util_atomic_load_u32(&persist_pending)) > 0 && waited < GATEWAY_PERSIST_FLUSH_MSEC)
+    {
+        ThisThread::sleep_for(10);
+        waited += 10;
+    }
+    if (pending > 0)
+    {
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_ERROR, "[App] %lu NVRAM writes lost with the restart\n", (unsigned long)pending);
+    }
+
+    memset(&record, 0, sizeof(record));
+    record.type = GATEWAY_WARMBOOT_UPLINK;
+    for (evt = publish_mail.get(0); evt.status == osEventMail; evt = publish_mail.get(0))
+    {
+        publish_msg_t* msg = (publish_msg_t*)evt.value.p;
+        if (msg->topic)
+        {
+            record.topic = msg->topic;
+            record.data  = msg->payload;
+            record.len   = (uint16_t)msg->len;
+            gateway_warmboot_put(&record);
+        }
+        publish_mail.free(msg);
+    }
+
+    record.type  = GATEWAY_WARMBOOT_DOWNLINK;
+    record.topic = NULL;
+    for (evt = mesh_tx_mail.get(0); evt.status == osEventMail; evt = mesh_tx_mail.get(0))
+    {
+        mesh_tx_msg_t* msg = (mesh_tx_msg_t*)evt.value.p;
+        record.arg  = (uint8_t)msg->type;
+        record.dst  = msg->dst;
+        record.data = (const uint8_t*)msg->payload;
+        record.len  = (uint16_t)strlen(msg->payload);
+        gateway_warmboot_put(&record);
+        mesh_tx_mail.free(msg);
+    }
+}
+
+void gateway_threads_wake_net(uint32_t delay_ms)
+{
+    uint32_t due = (uint32_t)Kernel::get_ms_count() + delay_ms;
+    publish_msg_t* msg;
+
+    /* Nothing to do if the thread is awake, or wakes up in time by itself */
+    if ((int32_t)(core_util_atomic_load_u32(&net_wake_ms) - due) <= 0)
+    {
+        return;
+    }
+    core_util_atomic_store_u32(&net_wake_ms, due);
+
+    /* The thread polls right away and finds the new timer; a full queue wakes it up anyway */
+    msg = publish_mail.alloc();
+    if (msg)
+    {
+        msg->topic = NULL;
+        msg->len   = 0;
+        publish_mail.put(msg);
+    }
+}
+
+cy_rslt_t gateway_publish(const char* topic, const uint8_t* payload, uint32_t len)
+{
+    publish_msg_t* msg;
+
+    if (!topic || !payload)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    if (ThisThread::get_id() == net_thread.get_id())
+    {
+        if (!thread_handlers.publish)
+        {
+            return CY_RSLT_MW_ERROR;
+        }
+        return thread_handlers.publish(topic, payload, len);
+    }
+
+    if (len > GATEWAY_PUBLISH_MAX_PAYLOAD)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    msg = publish_mail.alloc();
+    if (!msg)
+    {
+        gateway_metrics_increment(GATEWAY_COUNTER_QUEUE_DROPS, 1);
+        return CY_RSLT_MW_ERROR;
+    }
+    msg->topic = topic;
+    msg->len   = len;
+    memcpy(msg->payload, payload, len);
+    publish_mail.put(msg);
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t gateway_mesh_tx_post(gateway_mesh_tx_type_t type, const char* payload, uint32_t trace, uint16_t dst)
+{
+    uint32_t len = payload ? strlen(payload) : 0;
+    mesh_tx_msg_t* msg;
+
+    if ((type == GATEWAY_MESH_TX_DATA && len == 0) || len > GATEWAY_MESH_TX_MAX_PAYLOAD)
+    {
+        gateway_metrics_increment(GATEWAY_COUNTER_DOWNLINK_ERRORS, 1);
+        return CY_RSLT_MW_ERROR;
+    }
+
+    msg = mesh_tx_mail.alloc();
+    if (!msg)
+    {
+        gateway_metrics_increment(GATEWAY_COUNTER_QUEUE_DROPS, 1);
+        return CY_RSLT_MW_ERROR;
+    }
+    msg->type  = type;
+    msg->trace = trace;
+    msg->dst   = dst;
+    if (len > 0)
+    {
+        memcpy(msg->payload, payload, len);
+    }
+    msg->payload[len] = '\0';
+    mesh_tx_mail.put(msg);
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t gateway_persist_post(gateway_persist_type_t type, uint16_t id, const uint8_t* data, uint32_t len)
+{
+    persist_msg_t* msg;
+
+    if (len > MESH_NV_DATA_MAX_PAYLOAD || (len > 0 && !data))
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    msg = persist_mail.alloc();
+    if (!msg)
+    {
+        gateway_metrics_increment(GATEWAY_COUNTER_QUEUE_DROPS, 1);
+        MESH_GATEWAY_TRACE(GATEWAY_TRACE_LEVEL_ERROR, "[App] Persistence queue full, NVRAM chunk %u dropped\n", id);
+        return CY_RSLT_MW_ERROR;
+    }
+    msg->type = type;
+    msg->id   = id;
+    msg->len  = (uint16_t)len;
+    if (len > 0)
+    {
+        memcpy(msg->data, data, len);
+    }
+    core_util_atomic_incr_u32(&persist_pending, 1);
+    persist_mail.put(msg);
+    return CY_RSLT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway worker threads
+ *
+ * The gateway work is split over three threads that only exchange data
+ * through bounded mail queues:
+ *
+ *  - network I/O: owns the MQTT client; yields and publishes
+ *  - mesh TX: sends downlink commands and connect/disconnect requests
+ *  - persistence: writes NVRAM data handed over by the BLE stack
+ *
+ * Stack sizes and queue depths come from the footprint profile, priorities
+ * from mbed_app.json. Posting
+ * never blocks; a message that does not fit its queue is dropped and counted
+ * in the "queue_drops" metric.
+ *
+ * The threads sleep until a message is queued for them or their poll handler
+ * has a timer due (gateway_idle.h). Each thread reports a heartbeat to the
+ * supervisor (gateway_supervisor.h) every time around its loop, and wakes
+ * up for that at least every GATEWAY_SUPERVISOR_HEARTBEAT_MSEC.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+#include "gateway_mesh_pdu.h"
+#include "gateway_footprint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GATEWAY_NET_THREAD_STACK_SIZE       (GATEWAY_FOOTPRINT_NET_STACK_SIZE)
+#define GATEWAY_MESH_TX_THREAD_STACK_SIZE   (GATEWAY_FOOTPRINT_MESH_TX_STACK_SIZE)
+#define GATEWAY_PERSIST_THREAD_STACK_SIZE   (GATEWAY_FOOTPRINT_PERSIST_STACK_SIZE)
+#define GATEWAY_NET_QUEUE_DEPTH             (GATEWAY_FOOTPRINT_NET_QUEUE_DEPTH)
+#define GATEWAY_MESH_TX_QUEUE_DEPTH         (GATEWAY_FOOTPRINT_MESH_TX_QUEUE_DEPTH)
+/* At least one per NVRAM entry, which the BLE stack hands over in a burst */
+#define GATEWAY_PERSIST_QUEUE_DEPTH         (GATEWAY_FOOTPRINT_PERSIST_QUEUE_DEPTH)
+
+#define GATEWAY_PUBLISH_MAX_PAYLOAD         (320)
+#define GATEWAY_MESH_TX_MAX_PAYLOAD         (160)
+/* Longest a warm restart waits for the queued NVRAM writes */
+#define GATEWAY_PERSIST_FLUSH_MSEC          (2000)
+
+typedef enum
+{
+    GATEWAY_MESH_TX_DATA,
+    GATEWAY_MESH_TX_CONNECT,
+    GATEWAY_MESH_TX_DISCONNECT
+} gateway_mesh_tx_type_t;
+
+typedef enum
+{
+    GATEWAY_PERSIST_CHUNK,
+    GATEWAY_PERSIST_PROVISIONED,
+    GATEWAY_PERSIST_RULES_USED
+} gateway_persist_type_t;
+
+typedef struct
+{
+    /* Runs on the network thread after the queued publishes; an error stops the thread.
+     * Sets 'wait_ms' to how long the thread may wait for a publish before it polls again.
+     */
+    cy_rslt_t (*net_poll)(uint32_t* wait_ms);
+    /* Runs on the network thread for every queued publish. Returns an error if the message was dropped. */
+    cy_rslt_t (*publish)(const char* topic, const uint8_t* payload, uint32_t len);
+    /* Runs on the mesh TX thread after every command, e.g. for delivery timeouts. Returns the time until it is due again. */
+    uint32_t (*mesh_tx_poll)(void);
+} gateway_thread_handlers_t;
+
+cy_rslt_t gateway_threads_start(const gateway_thread_handlers_t* handlers);
+
+/* Blocks until the network thread stops */
+void gateway_threads_join(void);
+
+/* Waits up to GATEWAY_PERSIST_FLUSH_MSEC for the queued NVRAM writes, then moves the messages still
+ * waiting in the publish and mesh TX queues into the warm boot store
+ */
+void gateway_threads_retain(void);
+
+/* Makes the network thread poll within 'delay_ms', e.g. after another thread started one of its timers */
+void gateway_threads_wake_net(uint32_t delay_ms);
+
+/* Publishes directly when called on the network thread and returns the result of the publish handler,
+ * queues the message otherwise. 'topic' must stay valid until the message is sent.
+ */
+cy_rslt_t gateway_publish(const char* topic, const uint8_t* payload, uint32_t len);
+
+/* Queues a downlink command ('payload' is the hex proxy packet) or a connect/disconnect request.
+ * Unless 'dst' is MESH_ADDR_UNASSIGNED, a command addressed to any other node is rejected.
+ */
+cy_rslt_t gateway_mesh_tx_post(gateway_mesh_tx_type_t type, const char* payload, uint32_t trace, uint16_t dst);
+
+/* Queues an NVRAM chunk, the provisioned flag or the used rule actions for writing */
+cy_rslt_t gateway_persist_post(gateway_persist_type_t type, uint16_t id, const uint8_t* data, uint32_t len);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
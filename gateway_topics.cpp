@@ -0,0 +1,151 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway per-node topic table implementation
+ */
+
+#include "mbed.h"
+
+#include "gateway_topics.h"
+#include "gateway_mesh_pdu.h"
+#include "cy_string_utils.h"
+
+#define GATEWAY_TOPIC_MAX_USED      ((GATEWAY_TOPIC_TABLE_SLOTS * 3) / 4)
+
+MBED_STATIC_ASSERT((GATEWAY_TOPIC_TABLE_SLOTS & (GATEWAY_TOPIC_TABLE_SLOTS - 1)) == 0, "GATEWAY_TOPIC_TABLE_SLOTS must be a power of two");
+
+typedef struct
+{
+    uint16_t    addr;
+    char        topic[GATEWAY_TOPIC_MAX + 1];
+} topic_entry_t;
+
+static topic_entry_t topic_table[GATEWAY_TOPIC_TABLE_SLOTS];
+
+MBED_STATIC_ASSERT(sizeof(topic_entry_t) <= GATEWAY_FOOTPRINT_TOPIC_ENTRY, "A topic table slot exceeds its size in the footprint profile");
+MBED_STATIC_ASSERT(sizeof(topic_table) <= GATEWAY_FOOTPRINT_TOPICS_RAM, "Topic table slots exceed their share of the footprint profile");
+
+static uint32_t topic_table_used = 0;
+static const char* topic_template = NULL;
+static const char* topic_fallback = NULL;
+static Mutex topic_mutex;
+
+static uint32_t topic_hash(uint16_t addr)
+{
+    return ((uint32_t)addr * 2654435761u) & (GATEWAY_TOPIC_TABLE_SLOTS - 1);
+}
+
+/* Returns the slot holding 'addr', or the free slot where it belongs. NULL if neither exists. */
+static topic_entry_t* topic_find(uint16_t addr)
+{
+    uint32_t slot = topic_hash(addr);
+    uint32_t i;
+
+    for (i = 0; i < GATEWAY_TOPIC_TABLE_SLOTS; i++)
+    {
+        topic_entry_t* entry = &topic_table[slot];
+        if (entry->addr == MESH_ADDR_UNASSIGNED || entry->addr == addr)
+        {
+            return entry;
+        }
+        slot = (slot + 1) & (GATEWAY_TOPIC_TABLE_SLOTS - 1);
+    }
+    return NULL;
+}
+
+cy_rslt_t gateway_topics_init(const char* node_template, const char* fallback_topic)
+{
+    char probe[GATEWAY_TOPIC_MAX + 1];
+
+    /* The widest address has to fit, or topics would be cut short */
+    if (!node_template || !fallback_topic ||
+        snprintf(probe, sizeof(probe), node_template, 0xFFFFu) > GATEWAY_TOPIC_MAX)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    topic_mutex.lock();
+    memset(topic_table, 0, sizeof(topic_table));
+    topic_table_used = 0;
+    topic_template = node_template;
+    topic_fallback = fallback_topic;
+    topic_mutex.unlock();
+    return CY_RSLT_SUCCESS;
+}
+
+const char* gateway_topic_for_node(uint16_t addr)
+{
+    const char* topic;
+    topic_entry_t* entry;
+
+    if (addr == MESH_ADDR_UNASSIGNED || !topic_template)
+    {
+        return topic_fallback;
+    }
+
+    topic_mutex.lock();
+    entry = topic_find(addr);
+    if (entry && entry->addr == MESH_ADDR_UNASSIGNED)
+    {
+        if (topic_table_used >= GATEWAY_TOPIC_MAX_USED)
+        {
+            entry = NULL;
+        }
+        else
+        {
+            snprintf(entry->topic, sizeof(entry->topic), topic_template, (unsigned int)addr);
+            entry->addr = addr;
+            topic_table_used++;
+        }
+    }
+    topic = entry ? entry->topic : topic_fallback;
+    topic_mutex.unlock();
+
+    return topic;
+}
+
+cy_rslt_t gateway_topic_parse_node(const char* topic, uint32_t topic_len, uint16_t* addr)
+{
+    const char* level = topic;
+    uint32_t level_len = topic_len;
+    uint32_t value = 0;
+    uint32_t i;
+
+    if (!topic || !addr)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    for (i = 0; i < topic_len; i++)
+    {
+        if (topic[i] == '/')
+        {
+            level = &topic[i + 1];
+            level_len = topic_len - i - 1;
+        }
+    }
+
+    if (level == topic || level_len == 0 || level_len > 4 ||
+        cy_string_to_unsigned(level, level_len, &value, 1) == 0 || value == MESH_ADDR_UNASSIGNED)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    *addr = (uint16_t)value;
+    return CY_RSLT_SUCCESS;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway per-node topic table
+ *
+ * Maps a mesh node address to its own uplink topic, e.g. "proxy_data/0002",
+ * and back. The topic of a node is formatted from the template once, the
+ * first time the node is seen, and kept in an open addressed table of
+ * GATEWAY_TOPIC_TABLE_SLOTS entries; publishing then only costs a lookup.
+ * Entries are never evicted, so the returned topics stay valid for queued
+ * publishes. Once the table is 3/4 full, new nodes use the fallback topic.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+#include "gateway_footprint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Must be a power of two */
+#define GATEWAY_TOPIC_TABLE_SLOTS           (GATEWAY_FOOTPRINT_TOPIC_SLOTS)
+#define GATEWAY_TOPIC_MAX                   (32)
+
+/* 'node_template' takes the node address as its only conversion, e.g. "proxy_data/%04X".
+ * Both strings must stay valid.
+ */
+cy_rslt_t gateway_topics_init(const char* node_template, const char* fallback_topic);
+
+/* Returns the topic of node 'addr', or the fallback topic if it has none */
+const char* gateway_topic_for_node(uint16_t addr);
+
+/* Reads the node address from the last level of 'topic', e.g. "mesh_data/0002" */
+cy_rslt_t gateway_topic_parse_node(const char* topic, uint32_t topic_len, uint16_t* addr);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
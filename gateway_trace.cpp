@@ -0,0 +1,131 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway deferred trace implementation
+ */
+
+#include "mbed.h"
+
+#include "gateway_trace.h"
+#include "gateway_idle.h"
+
+MBED_STATIC_ASSERT((GATEWAY_TRACE_RING_SIZE & (GATEWAY_TRACE_RING_SIZE - 1)) == 0, "GATEWAY_TRACE_RING_SIZE must be a power of two");
+
+typedef struct
+{
+    const char*         format;
+    uintptr_t           args[4];
+    uint32_t            timestamp_ms;
+    volatile uint32_t   ready;
+} trace_record_t;
+
+volatile uint8_t gateway_trace_level = GATEWAY_TRACE_DEFAULT_LEVEL;
+
+static trace_record_t trace_ring[GATEWAY_TRACE_RING_SIZE];
+
+MBED_STATIC_ASSERT(sizeof(trace_record_t) <= GATEWAY_FOOTPRINT_TRACE_ENTRY, "A trace record exceeds its size in the footprint profile");
+MBED_STATIC_ASSERT(sizeof(trace_ring) <= GATEWAY_FOOTPRINT_TRACE_RAM, "Trace records exceed their share of the footprint profile");
+
+/* Producers reserve records by advancing 'trace_head'; only the drain thread advances 'trace_tail' */
+static volatile uint32_t trace_head = 0;
+static volatile uint32_t trace_tail = 0;
+static volatile uint32_t trace_dropped = 0;
+
+#define TRACE_FLAG_WRITTEN          (0x01)
+
+static Thread trace_thread(osPriorityLow, GATEWAY_TRACE_THREAD_STACK_SIZE, NULL, "gateway_trace");
+/* Set by the producers, also from interrupt context */
+static EventFlags trace_flags;
+
+void gateway_trace_write(uint8_t level, const char* format, uintptr_t arg0, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3)
+{
+    uint32_t head = core_util_atomic_load_u32(&trace_head);
+    trace_record_t* record;
+
+    do
+    {
+        if (head - core_util_atomic_load_u32(&trace_tail) >= GATEWAY_TRACE_RING_SIZE)
+        {
+            core_util_atomic_incr_u32(&trace_dropped, 1);
+            return;
+        }
+    } while (!core_util_atomic_cas_u32(&trace_head, &head, head + 1));
+
+    record = &trace_ring[head & (GATEWAY_TRACE_RING_SIZE - 1)];
+    record->format       = format;
+    record->args[0]      = arg0;
+    record->args[1]      = arg1;
+    record->args[2]      = arg2;
+    record->args[3]      = arg3;
+    record->timestamp_ms = (uint32_t)Kernel::get_ms_count();
+    core_util_atomic_store_u32(&record->ready, 1);
+    trace_flags.set(TRACE_FLAG_WRITTEN);
+}
+
+static void trace_drain(void)
+{
+    uint32_t dropped;
+
+    while (trace_tail != core_util_atomic_load_u32(&trace_head))
+    {
+        trace_record_t* record = &trace_ring[trace_tail & (GATEWAY_TRACE_RING_SIZE - 1)];
+
+        /* The producer reserved this record but has not finished writing it yet */
+        if (!core_util_atomic_load_u32(&record->ready))
+        {
+            break;
+        }
+
+        printf("[%lu] ", (unsigned long)record->timestamp_ms);
+        printf(record->format, record->args[0], record->args[1], record->args[2], record->args[3]);
+
+        core_util_atomic_store_u32(&record->ready, 0);
+        core_util_atomic_incr_u32(&trace_tail, 1);
+    }
+
+    dropped = core_util_atomic_exchange_u32(&trace_dropped, 0);
+    if (dropped > 0)
+    {
+        printf("[App] Trace ring overflow, %lu records dropped\n", (unsigned long)dropped);
+    }
+}
+
+static void trace_thread_main(void)
+{
+    while (true)
+    {
+        /* Sleeps until a record is ready; records written meanwhile are drained together */
+        trace_flags.wait_any(TRACE_FLAG_WRITTEN);
+        gateway_idle_wakeup(GATEWAY_WAKE_QUEUE);
+        trace_drain();
+    }
+}
+
+cy_rslt_t gateway_trace_init(void)
+{
+    if (trace_thread.start(callback(trace_thread_main)) != osOK)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+    return CY_RSLT_SUCCESS;
+}
+
+void gateway_trace_set_level(uint8_t level)
+{
+    gateway_trace_level = (level > GATEWAY_TRACE_LEVEL_DEBUG) ? GATEWAY_TRACE_LEVEL_DEBUG : level;
+}
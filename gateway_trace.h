@@ -0,0 +1,74 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway deferred trace
+ *
+ * MESH_GATEWAY_TRACE() stores the format string pointer and up to four integer
+ * or pointer arguments in a lock-free ring; a low-priority thread renders them
+ * through printf later, so the caller never waits on the UART.
+ *
+ * Because rendering is deferred, "%s" arguments must point to strings that
+ * outlive the call (literals, __func__, static tables) and floating point
+ * arguments are not supported.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+#include "gateway_footprint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GATEWAY_TRACE_LEVEL_NONE            (0)
+#define GATEWAY_TRACE_LEVEL_ERROR           (1)
+#define GATEWAY_TRACE_LEVEL_WARN            (2)
+#define GATEWAY_TRACE_LEVEL_INFO            (3)
+#define GATEWAY_TRACE_LEVEL_DEBUG           (4)
+
+#define GATEWAY_TRACE_DEFAULT_LEVEL         GATEWAY_TRACE_LEVEL_INFO
+
+/* Must be a power of two */
+#define GATEWAY_TRACE_RING_SIZE             (GATEWAY_FOOTPRINT_TRACE_RING_SIZE)
+#define GATEWAY_TRACE_THREAD_STACK_SIZE     (1536)
+
+extern volatile uint8_t gateway_trace_level;
+
+void gateway_trace_write(uint8_t level, const char* format, uintptr_t arg0, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3);
+
+cy_rslt_t gateway_trace_init(void);
+void gateway_trace_set_level(uint8_t level);
+
+#define GATEWAY_TRACE_ARGS_(format, a0, a1, a2, a3, ...) \
+    format, (uintptr_t)(a0), (uintptr_t)(a1), (uintptr_t)(a2), (uintptr_t)(a3)
+
+/* MESH_GATEWAY_TRACE(level, format, up to four arguments) */
+#define MESH_GATEWAY_TRACE(level, ...)                                                  \
+    do                                                                                  \
+    {                                                                                   \
+        if ((level) <= gateway_trace_level)                                             \
+        {                                                                               \
+            gateway_trace_write((level), GATEWAY_TRACE_ARGS_(__VA_ARGS__, 0, 0, 0, 0)); \
+        }                                                                               \
+    } while (0)
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
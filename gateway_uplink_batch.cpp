@@ -0,0 +1,201 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway uplink batching implementation
+ */
+
+#include "mbed.h"
+
+#include "gateway_uplink_batch.h"
+#include "gateway_idle.h"
+#include "gateway_lz.h"
+#include "gateway_metrics.h"
+#include "gateway_trace.h"
+
+/* Time varint and length byte */
+#define BATCH_RECORD_OVERHEAD       (5 + 1)
+
+typedef struct
+{
+    uint16_t    len;
+    uint8_t     records[GATEWAY_UPLINK_BATCH_RECORDS_MAX];
+} batch_buffer_t;
+
+static batch_buffer_t open_batch;
+static uint32_t open_ms = 0;
+static batch_buffer_t sealed[GATEWAY_UPLINK_BATCH_QUEUE_DEPTH];
+static uint32_t sealed_head = 0;
+static uint32_t sealed_count = 0;
+static Mutex batch_mutex;
+
+/* Only used on the network thread */
+static batch_buffer_t publishing;
+static uint8_t frame[GATEWAY_UPLINK_BATCH_FRAME_MAX];
+static gateway_uplink_batch_publish_t publish_callback = NULL;
+
+MBED_STATIC_ASSERT(sizeof(batch_buffer_t) <= GATEWAY_FOOTPRINT_UPLINK_BATCH_BUFFER, "A batch buffer exceeds its size in the footprint profile");
+MBED_STATIC_ASSERT(sizeof(open_batch) + sizeof(sealed) + sizeof(publishing) + sizeof(frame) <= GATEWAY_FOOTPRINT_UPLINK_BATCH_RAM, "Uplink batch buffers exceed their share of the footprint profile");
+
+/* Queues the open frame for publishing; called with batch_mutex held */
+static void batch_seal(void)
+{
+    if (open_batch.len == 0)
+    {
+        return;
+    }
+    if (sealed_count == GATEWAY_UPLINK_BATCH_QUEUE_DEPTH)
+    {
+        /* The network thread is behind; the oldest frame is lost */
+        sealed_head = (sealed_head + 1) % GATEWAY_UPLINK_BATCH_QUEUE_DEPTH;
+        sealed_count--;
+        gateway_metrics_increment(GATEWAY_COUNTER_UPLINK_DROPPED, 1);
+    }
+    memcpy(&sealed[(sealed_head + sealed_count) % GATEWAY_UPLINK_BATCH_QUEUE_DEPTH], &open_batch,
+           offsetof(batch_buffer_t, records) + open_batch.len);
+    sealed_count++;
+    open_batch.len = 0;
+}
+
+static cy_rslt_t batch_publish(const batch_buffer_t* batch)
+{
+    uint32_t len = batch->len;
+
+    frame[0] = GATEWAY_UPLINK_BATCH_VERSION;
+    frame[1] = (uint8_t)(batch->len >> 8);
+    frame[2] = (uint8_t)batch->len;
+
+#if GATEWAY_UPLINK_BATCH_COMPRESS
+    /* Compression has to save at least one byte */
+    uint32_t start_us = gateway_metrics_now_us();
+    uint32_t compressed = gateway_lz_compress(batch->records, batch->len, &frame[GATEWAY_UPLINK_BATCH_HEADER_LEN],
+                                              batch->len - 1);
+    gateway_metrics_observe(GATEWAY_HISTOGRAM_UPLINK_COMPRESS_US, gateway_metrics_now_us() - start_us);
+    if (compressed > 0)
+    {
+        frame[0] |= GATEWAY_UPLINK_BATCH_FLAG_LZ;
+        len = compressed;
+        gateway_metrics_set(GATEWAY_GAUGE_UPLINK_BATCH_RATIO_PCT, compressed * 100 / batch->len);
+    }
+    else
+#endif
+    {
+        memcpy(&frame[GATEWAY_UPLINK_BATCH_HEADER_LEN], batch->records, batch->len);
+        gateway_metrics_set(GATEWAY_GAUGE_UPLINK_BATCH_RATIO_PCT, 100);
+    }
+
+    gateway_metrics_increment(GATEWAY_COUNTER_UPLINK_BATCHES, 1);
+    return publish_callback(frame, GATEWAY_UPLINK_BATCH_HEADER_LEN + len);
+}
+
+cy_rslt_t gateway_uplink_batch_init(gateway_uplink_batch_publish_t publish)
+{
+    if (!publish)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    batch_mutex.lock();
+    publish_callback = publish;
+    open_batch.len = 0;
+    sealed_head    = 0;
+    sealed_count   = 0;
+    batch_mutex.unlock();
+    return CY_RSLT_SUCCESS;
+}
+
+void gateway_uplink_batch_add(const uint8_t* packet, uint32_t len)
+{
+    uint32_t now = (uint32_t)Kernel::get_ms_count();
+    uint32_t delta_ms;
+
+    if (!publish_callback || !packet || len == 0 || len > 0xFF || len + BATCH_RECORD_OVERHEAD > GATEWAY_UPLINK_BATCH_RECORDS_MAX)
+    {
+        gateway_metrics_increment(GATEWAY_COUNTER_UPLINK_DROPPED, 1);
+        return;
+    }
+
+    batch_mutex.lock();
+    if (open_batch.len + len + BATCH_RECORD_OVERHEAD > GATEWAY_UPLINK_BATCH_RECORDS_MAX)
+    {
+        batch_seal();
+    }
+    if (open_batch.len == 0)
+    {
+        open_ms = now;
+    }
+
+    delta_ms = now - open_ms;
+    while (delta_ms >= 0x80)
+    {
+        open_batch.records[open_batch.len++] = (uint8_t)(delta_ms | 0x80);
+        delta_ms >>= 7;
+    }
+    open_batch.records[open_batch.len++] = (uint8_t)delta_ms;
+    open_batch.records[open_batch.len++] = (uint8_t)len;
+    memcpy(&open_batch.records[open_batch.len], packet, len);
+    open_batch.len += len;
+    batch_mutex.unlock();
+}
+
+uint32_t gateway_uplink_batch_poll(void)
+{
+    uint32_t next_ms = GATEWAY_IDLE_FOREVER;
+    bool ready = true;
+
+    if (!publish_callback)
+    {
+        return next_ms;
+    }
+
+    while (ready)
+    {
+        batch_mutex.lock();
+        if (open_batch.len > 0 && (uint32_t)Kernel::get_ms_count() - open_ms >= GATEWAY_UPLINK_BATCH_WINDOW_MSEC)
+        {
+            batch_seal();
+        }
+        ready = sealed_count > 0;
+        if (ready)
+        {
+            const batch_buffer_t* head = &sealed[sealed_head];
+            memcpy(&publishing, head, offsetof(batch_buffer_t, records) + head->len);
+            sealed_head = (sealed_head + 1) % GATEWAY_UPLINK_BATCH_QUEUE_DEPTH;
+            sealed_count--;
+        }
+        batch_mutex.unlock();
+
+        /* Compressed and published without holding the lock. After a failure the
+         * other frames wait for the next poll instead of being dropped as well. */
+        if (ready && batch_publish(&publishing) != CY_RSLT_SUCCESS)
+        {
+            break;
+        }
+    }
+
+    batch_mutex.lock();
+    if (sealed_count > 0)
+    {
+        next_ms = GATEWAY_UPLINK_BATCH_WINDOW_MSEC;
+    }
+    else if (open_batch.len > 0)
+    {
+        next_ms = gateway_idle_until((uint32_t)Kernel::get_ms_count(), open_ms + GATEWAY_UPLINK_BATCH_WINDOW_MSEC);
+    }
+    batch_mutex.unlock();
+    return next_ms;
+}
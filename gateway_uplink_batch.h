@@ -0,0 +1,80 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway uplink batching
+ *
+ * Collects uplink proxy packets for up to GATEWAY_UPLINK_BATCH_WINDOW_MSEC
+ * and publishes them together as one binary frame:
+ *
+ *   [0]      version (high nibble, 1) | flags (low nibble)
+ *   [1..2]   length of the records, big endian
+ *   [3..]    records, LZ4 block compressed if GATEWAY_UPLINK_BATCH_FLAG_LZ is set
+ *
+ * where each record is
+ *
+ *   varint   time since the first record of the frame (ms)
+ *   uint8    packet length
+ *   ...      proxy packet
+ *
+ * Packets from similar nodes share most of their headers and opcodes, which
+ * the compression (gateway_lz.h) removes. A frame is only sent compressed if
+ * that makes it smaller. The records length lets the cloud size the buffer
+ * for gateway_lz_decompress() or LZ4_decompress_safe().
+ *
+ * Packets are added from the mesh event callback; full frames are compressed
+ * and published by gateway_uplink_batch_poll() on the network thread.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+#include "gateway_footprint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GATEWAY_UPLINK_BATCH_WINDOW_MSEC    (1000)
+#define GATEWAY_UPLINK_BATCH_RECORDS_MAX    (240)
+/* Full frames waiting for the network thread */
+#define GATEWAY_UPLINK_BATCH_QUEUE_DEPTH    (GATEWAY_FOOTPRINT_UPLINK_BATCH_DEPTH)
+/* Set to 0 to always send the records uncompressed */
+#define GATEWAY_UPLINK_BATCH_COMPRESS       (1)
+
+#define GATEWAY_UPLINK_BATCH_VERSION        (0x10)
+#define GATEWAY_UPLINK_BATCH_FLAG_LZ        (0x01)
+#define GATEWAY_UPLINK_BATCH_HEADER_LEN     (3)
+#define GATEWAY_UPLINK_BATCH_FRAME_MAX      (GATEWAY_UPLINK_BATCH_HEADER_LEN + GATEWAY_UPLINK_BATCH_RECORDS_MAX)
+
+typedef cy_rslt_t (*gateway_uplink_batch_publish_t)(const uint8_t* frame, uint32_t len);
+
+cy_rslt_t gateway_uplink_batch_init(gateway_uplink_batch_publish_t publish);
+
+/* Adds a proxy packet to the open frame */
+void gateway_uplink_batch_add(const uint8_t* packet, uint32_t len);
+
+/* Closes the open frame once its window has expired and publishes the full ones,
+ * stopping at the first frame that cannot be published.
+ * Returns the time until the window of the open frame expires, or until the next attempt.
+ */
+uint32_t gateway_uplink_batch_poll(void);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
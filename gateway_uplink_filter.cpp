@@ -0,0 +1,195 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway uplink filter implementation
+ */
+
+#include "mbed.h"
+
+#include "gateway_uplink_filter.h"
+
+MBED_STATIC_ASSERT((MESH_UPLINK_DEDUP_SLOTS & (MESH_UPLINK_DEDUP_SLOTS - 1)) == 0, "MESH_UPLINK_DEDUP_SLOTS must be a power of two");
+
+/* A 64 bit digest and the length, so that distinct packets practically never collide */
+typedef struct
+{
+    uint64_t hash;
+    uint32_t seen_ms;
+    uint32_t length;
+} dedup_entry_t;
+
+/* Only accessed from the Mesh event callback */
+static dedup_entry_t dedup_set[MESH_UPLINK_DEDUP_SLOTS];
+
+#if APP_CONFIG_NODE_STATE_CACHE
+static uint16_t change_only_nodes[MESH_UPLINK_CHANGE_ONLY_MAX_NODES];
+static Mutex change_only_mutex;
+#endif
+
+static mesh_uplink_filter_stats_t filter_stats;
+
+MBED_STATIC_ASSERT(sizeof(dedup_entry_t) <= GATEWAY_FOOTPRINT_UPLINK_DEDUP_ENTRY, "An uplink dedup slot exceeds its size in the footprint profile");
+#if APP_CONFIG_NODE_STATE_CACHE
+MBED_STATIC_ASSERT(sizeof(dedup_set) + sizeof(change_only_nodes) <= GATEWAY_FOOTPRINT_UPLINK_FILTER_RAM, "Uplink filter tables exceed their share of the footprint profile");
+#else
+MBED_STATIC_ASSERT(sizeof(dedup_set) <= GATEWAY_FOOTPRINT_UPLINK_FILTER_RAM, "Uplink filter tables exceed their share of the footprint profile");
+#endif
+
+/* FNV-1a, 64 bit */
+static uint64_t packet_hash(const uint8_t* packet, uint32_t length)
+{
+    uint64_t hash = 14695981039346656037ull;
+    uint32_t i;
+
+    for (i = 0; i < length; i++)
+    {
+        hash ^= packet[i];
+        hash *= 1099511628211ull;
+    }
+    /* 0 marks an empty slot */
+    return (hash == 0) ? 1 : hash;
+}
+
+bool mesh_uplink_filter_is_duplicate(const uint8_t* packet, uint32_t length)
+{
+    uint32_t now = (uint32_t)Kernel::get_ms_count();
+    uint64_t hash = packet_hash(packet, length);
+    uint32_t slot = (uint32_t)hash & (MESH_UPLINK_DEDUP_SLOTS - 1);
+    dedup_entry_t* victim = NULL;
+    bool victim_expired = false;
+    uint32_t i;
+
+    filter_stats.received++;
+
+    for (i = 0; i < MESH_UPLINK_DEDUP_PROBES; i++)
+    {
+        dedup_entry_t* entry = &dedup_set[(slot + i) & (MESH_UPLINK_DEDUP_SLOTS - 1)];
+        bool expired = (entry->hash == 0) || (now - entry->seen_ms >= MESH_UPLINK_DEDUP_WINDOW_MSEC);
+
+        if (!expired && entry->hash == hash && entry->length == length)
+        {
+            filter_stats.duplicates_suppressed++;
+            return true;
+        }
+
+        /* Reuse an expired slot, otherwise evict the oldest one in the probe sequence */
+        if (victim_expired)
+        {
+            continue;
+        }
+        if (expired || !victim || (now - entry->seen_ms) > (now - victim->seen_ms))
+        {
+            victim = entry;
+            victim_expired = expired;
+        }
+    }
+
+    victim->hash    = hash;
+    victim->seen_ms = now;
+    victim->length  = length;
+    return false;
+}
+
+#if APP_CONFIG_NODE_STATE_CACHE
+static bool is_change_only(uint16_t src)
+{
+    bool found = false;
+    uint32_t i;
+
+    change_only_mutex.lock();
+    for (i = 0; i < MESH_UPLINK_CHANGE_ONLY_MAX_NODES; i++)
+    {
+        if (change_only_nodes[i] == src || change_only_nodes[i] == MESH_UPLINK_CHANGE_ONLY_ALL_NODES)
+        {
+            found = true;
+            break;
+        }
+    }
+    change_only_mutex.unlock();
+
+    return found;
+}
+#endif
+
+bool mesh_uplink_filter_should_publish(const mesh_pdu_t* pdu, bool state_changed)
+{
+#if APP_CONFIG_NODE_STATE_CACHE
+    if (pdu && pdu->opcode != MESH_PDU_OPCODE_INVALID && !state_changed && is_change_only(pdu->src))
+    {
+        filter_stats.unchanged_suppressed++;
+        return false;
+    }
+#else
+    (void)pdu;
+    (void)state_changed;
+#endif
+
+    filter_stats.published++;
+    return true;
+}
+
+#if APP_CONFIG_NODE_STATE_CACHE
+cy_rslt_t mesh_uplink_filter_set_change_only(uint16_t src, bool enable)
+{
+    cy_rslt_t result = enable ? CY_RSLT_MW_ERROR : CY_RSLT_SUCCESS;
+    uint32_t i;
+
+    if (src == MESH_ADDR_UNASSIGNED)
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    change_only_mutex.lock();
+    for (i = 0; i < MESH_UPLINK_CHANGE_ONLY_MAX_NODES; i++)
+    {
+        if (change_only_nodes[i] == src)
+        {
+            if (!enable)
+            {
+                change_only_nodes[i] = MESH_ADDR_UNASSIGNED;
+            }
+            result = CY_RSLT_SUCCESS;
+            break;
+        }
+    }
+
+    if (enable && result != CY_RSLT_SUCCESS)
+    {
+        for (i = 0; i < MESH_UPLINK_CHANGE_ONLY_MAX_NODES; i++)
+        {
+            if (change_only_nodes[i] == MESH_ADDR_UNASSIGNED)
+            {
+                change_only_nodes[i] = src;
+                result = CY_RSLT_SUCCESS;
+                break;
+            }
+        }
+    }
+    change_only_mutex.unlock();
+
+    return result;
+}
+#endif
+
+void mesh_uplink_filter_get_stats(mesh_uplink_filter_stats_t* stats)
+{
+    if (stats)
+    {
+        memcpy(stats, &filter_stats, sizeof(mesh_uplink_filter_stats_t));
+    }
+}
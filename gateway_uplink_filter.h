@@ -0,0 +1,70 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway uplink filter
+ *
+ * Suppresses identical proxy packets (mesh retransmissions) seen within
+ * MESH_UPLINK_DEDUP_WINDOW_MSEC, and optionally drops status messages of
+ * selected nodes that do not change the node's cached state. The latter
+ * needs the node state cache (APP_CONFIG_NODE_STATE_CACHE) and is compiled
+ * out without it.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+#include "gateway_mesh_pdu.h"
+#include "gateway_footprint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Must be a power of two */
+#define MESH_UPLINK_DEDUP_SLOTS             (GATEWAY_FOOTPRINT_UPLINK_DEDUP_SLOTS)
+#define MESH_UPLINK_DEDUP_PROBES            (4)
+#define MESH_UPLINK_DEDUP_WINDOW_MSEC       (1000)
+#define MESH_UPLINK_CHANGE_ONLY_MAX_NODES   (GATEWAY_FOOTPRINT_CHANGE_ONLY_NODES)
+
+/* Applies "publish only on change" to every node */
+#define MESH_UPLINK_CHANGE_ONLY_ALL_NODES   (0xFFFF)
+
+typedef struct
+{
+    uint32_t    received;
+    uint32_t    published;
+    uint32_t    duplicates_suppressed;
+    uint32_t    unchanged_suppressed;
+} mesh_uplink_filter_stats_t;
+
+/* Returns true if an identical packet was seen within the dedup window */
+bool mesh_uplink_filter_is_duplicate(const uint8_t* packet, uint32_t length);
+
+/* Returns false if 'pdu' comes from a "publish only on change" node and did not change its state */
+bool mesh_uplink_filter_should_publish(const mesh_pdu_t* pdu, bool state_changed);
+
+#if APP_CONFIG_NODE_STATE_CACHE
+cy_rslt_t mesh_uplink_filter_set_change_only(uint16_t src, bool enable);
+#endif
+
+void mesh_uplink_filter_get_stats(mesh_uplink_filter_stats_t* stats);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
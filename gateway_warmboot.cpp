@@ -0,0 +1,158 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway warm boot store implementation
+ */
+
+#include "mbed.h"
+
+#include "gateway_warmboot.h"
+
+#define WARMBOOT_MAGIC              (0x57524D42)
+#define WARMBOOT_RECORD_HEADER_LEN  (7)
+
+typedef struct
+{
+    uint32_t    magic;
+    uint32_t    crc;
+    /* Covered by the CRC from here on */
+    uint32_t    restarts;
+    uint8_t     reason;
+    uint8_t     detail;
+    uint16_t    records;
+    uint16_t    dropped;
+    uint16_t    len;
+    uint8_t     data[GATEWAY_WARMBOOT_SIZE];
+} warmboot_region_t;
+
+/* Not zeroed by the startup code, so it keeps its contents over a software reset */
+static warmboot_region_t region MBED_SECTION(".noinit");
+
+MBED_STATIC_ASSERT(sizeof(region) <= GATEWAY_FOOTPRINT_WARMBOOT_REGION, "The warm boot region exceeds its share of the footprint profile");
+
+static uint32_t loaded_len = 0;
+
+static uint32_t region_crc(void)
+{
+    MbedCRC<POLY_32BIT_ANSI, 32> ct;
+    uint32_t crc = 0;
+
+    ct.compute(&region.restarts, offsetof(warmboot_region_t, data) - offsetof(warmboot_region_t, restarts) + region.len, &crc);
+    return crc;
+}
+
+bool gateway_warmboot_load(gateway_warmboot_info_t* info)
+{
+    bool valid = region.magic == WARMBOOT_MAGIC && region.len <= GATEWAY_WARMBOOT_SIZE && region.crc == region_crc();
+
+    /* Whatever happens next, a later reset only finds this region again if it is committed again */
+    region.magic = 0;
+    loaded_len = valid ? region.len : 0;
+    if (!valid)
+    {
+        return false;
+    }
+
+    if (info)
+    {
+        info->restarts = region.restarts;
+        info->reason   = region.reason;
+        info->detail   = region.detail;
+        info->records  = region.records;
+        info->dropped  = region.dropped;
+    }
+    return true;
+}
+
+bool gateway_warmboot_next(uint32_t* offset, gateway_warmboot_record_t* record)
+{
+    const uint8_t* p;
+    uint32_t topic_len;
+
+    if (!offset || !record || *offset + WARMBOOT_RECORD_HEADER_LEN > loaded_len)
+    {
+        return false;
+    }
+
+    p = &region.data[*offset];
+    topic_len = p[4];
+    record->type  = p[0];
+    record->arg   = p[1];
+    record->dst   = (uint16_t)(p[2] | (p[3] << 8));
+    record->len   = (uint16_t)(p[5] | (p[6] << 8));
+    if (*offset + WARMBOOT_RECORD_HEADER_LEN + topic_len + record->len > loaded_len)
+    {
+        return false;
+    }
+    /* The topic is stored with its terminating zero */
+    record->topic = topic_len > 0 ? (const char*)&p[WARMBOOT_RECORD_HEADER_LEN] : NULL;
+    record->data  = &p[WARMBOOT_RECORD_HEADER_LEN + topic_len];
+    *offset += WARMBOOT_RECORD_HEADER_LEN + topic_len + record->len;
+    return true;
+}
+
+void gateway_warmboot_begin(uint32_t restarts, uint8_t reason, uint8_t detail)
+{
+    loaded_len = 0;
+    region.magic    = 0;
+    region.restarts = restarts;
+    region.reason   = reason;
+    region.detail   = detail;
+    region.records  = 0;
+    region.dropped  = 0;
+    region.len      = 0;
+}
+
+cy_rslt_t gateway_warmboot_put(const gateway_warmboot_record_t* record)
+{
+    uint32_t topic_len = (record && record->topic) ? strlen(record->topic) + 1 : 0;
+    uint8_t* p;
+
+    if (!record || topic_len > GATEWAY_WARMBOOT_TOPIC_MAX + 1 || (record->len > 0 && !record->data) ||
+        region.len + WARMBOOT_RECORD_HEADER_LEN + topic_len + record->len > GATEWAY_WARMBOOT_SIZE)
+    {
+        region.dropped++;
+        return CY_RSLT_MW_ERROR;
+    }
+
+    p = &region.data[region.len];
+    p[0] = record->type;
+    p[1] = record->arg;
+    p[2] = (uint8_t)record->dst;
+    p[3] = (uint8_t)(record->dst >> 8);
+    p[4] = (uint8_t)topic_len;
+    p[5] = (uint8_t)record->len;
+    p[6] = (uint8_t)(record->len >> 8);
+    if (topic_len > 0)
+    {
+        memcpy(&p[WARMBOOT_RECORD_HEADER_LEN], record->topic, topic_len);
+    }
+    if (record->len > 0)
+    {
+        memcpy(&p[WARMBOOT_RECORD_HEADER_LEN + topic_len], record->data, record->len);
+    }
+    region.len += WARMBOOT_RECORD_HEADER_LEN + topic_len + record->len;
+    region.records++;
+    return CY_RSLT_SUCCESS;
+}
+
+void gateway_warmboot_commit(void)
+{
+    region.crc   = region_crc();
+    region.magic = WARMBOOT_MAGIC;
+}
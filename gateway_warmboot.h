@@ -0,0 +1,88 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Bluetooth Mesh Gateway warm boot store
+ *
+ * Carries queued traffic across a software reset. Before the supervisor
+ * resets the board, the pending uplink and downlink messages are written as
+ * records into a RAM region that the startup code does not clear
+ * (".noinit"), followed by a header with a CRC over the records. On the next
+ * boot gateway_warmboot_load() accepts the region only if the header and CRC
+ * match, so a power cycle or a reset from the reset button, which leaves no
+ * valid header behind, is a cold boot as before.
+ *
+ * The region is consumed by loading it: a reset that does not go through
+ * gateway_warmboot_commit() again is a cold boot.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "cy_result_mw.h"
+#include "gateway_footprint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GATEWAY_WARMBOOT_SIZE               (GATEWAY_FOOTPRINT_WARMBOOT_SIZE)
+#define GATEWAY_WARMBOOT_TOPIC_MAX          (32)
+
+typedef enum
+{
+    GATEWAY_WARMBOOT_UPLINK = 1,            /* Message waiting to be published on 'topic' */
+    GATEWAY_WARMBOOT_DOWNLINK,              /* Mesh TX request; 'arg' is the gateway_mesh_tx_type_t */
+    GATEWAY_WARMBOOT_SPOOLED                /* Message from the RAM ring of the spool, older than its flash ring */
+} gateway_warmboot_type_t;
+
+typedef struct
+{
+    uint8_t         type;
+    uint8_t         arg;
+    uint16_t        dst;
+    const char*     topic;
+    const uint8_t*  data;
+    uint16_t        len;
+} gateway_warmboot_record_t;
+
+typedef struct
+{
+    uint32_t    restarts;                   /* Warm restarts in a row, including this one */
+    uint8_t     reason;                     /* As passed to gateway_warmboot_begin() */
+    uint8_t     detail;
+    uint16_t    records;
+    uint16_t    dropped;                    /* Records that did not fit the region */
+} gateway_warmboot_info_t;
+
+/* Returns true if the previous run ended with a committed warm restart; its records can then be read with gateway_warmboot_next() */
+bool gateway_warmboot_load(gateway_warmboot_info_t* info);
+
+/* Iterates over the loaded records; start with '*offset' 0 */
+bool gateway_warmboot_next(uint32_t* offset, gateway_warmboot_record_t* record);
+
+/* Starts writing the region for the 'restarts'-th warm restart in a row; drops any loaded records */
+void gateway_warmboot_begin(uint32_t restarts, uint8_t reason, uint8_t detail);
+
+cy_rslt_t gateway_warmboot_put(const gateway_warmboot_record_t* record);
+
+/* Seals the region; the next boot is a warm one */
+void gateway_warmboot_commit(void);
+
+#ifdef __cplusplus
+} /*extern "C" */
+#endif
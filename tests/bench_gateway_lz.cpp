@@ -0,0 +1,171 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Host benchmark for gateway_lz
+ *
+ * Builds uplink batch frames the way gateway_uplink_batch.cpp does and
+ * reports the compression ratio and the time per frame for compression and
+ * decompression. The host is much faster than the gateway's MCU, so the times
+ * compare builds with each other rather than predict the target.
+ *
+ * Two kinds of traffic are measured: network PDUs as the proxy delivers
+ * them, where everything after the first bytes is encrypted, and the decoded
+ * status messages a build with APP_CONFIG_MESH_PDU_DECRYPTED sees.
+ */
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+#include "gateway_lz.h"
+#include "test_common.h"
+
+#define BENCH_FRAMES            (2000)
+#define BENCH_REPEAT            (50)
+#define BENCH_RECORDS_MAX       (240)
+
+unsigned test_failures = 0;
+
+typedef struct
+{
+    uint8_t     data[BENCH_RECORDS_MAX];
+    uint32_t    len;
+} bench_frame_t;
+
+static bench_frame_t frames[BENCH_FRAMES];
+static uint8_t compressed[BENCH_FRAMES][GATEWAY_LZ_BOUND(BENCH_RECORDS_MAX)];
+static uint32_t compressed_len[BENCH_FRAMES];
+
+static uint32_t add_record(bench_frame_t* frame, uint32_t delta_ms, const uint8_t* packet, uint32_t len)
+{
+    if (frame->len + 2 + len > BENCH_RECORDS_MAX)
+    {
+        return 0;
+    }
+    frame->data[frame->len++] = (uint8_t)delta_ms;
+    frame->data[frame->len++] = (uint8_t)len;
+    memcpy(&frame->data[frame->len], packet, len);
+    frame->len += len;
+    return len;
+}
+
+/* Proxy PDU type, IVI/NID, then obfuscated header, encrypted payload and NetMIC */
+static void build_encrypted(bench_frame_t* frame, uint32_t* seed)
+{
+    uint8_t packet[29];
+    uint32_t len;
+
+    frame->len = 0;
+    do
+    {
+        len = 18 + test_random(seed) % 12;
+        packet[0] = 0x00;
+        packet[1] = 0x68;
+        for (uint32_t i = 2; i < len; i++)
+        {
+            packet[i] = (uint8_t)test_random(seed);
+        }
+    } while (add_record(frame, test_random(seed) % 100, packet, len) != 0);
+}
+
+/* Source, opcode and a short state from a handful of nodes reporting the same model */
+static void build_decrypted(bench_frame_t* frame, uint32_t* seed)
+{
+    uint8_t packet[8];
+
+    frame->len = 0;
+    do
+    {
+        uint16_t src = (uint16_t)(0x0004 + test_random(seed) % 8);
+        packet[0] = (uint8_t)(src >> 8);
+        packet[1] = (uint8_t)src;
+        packet[2] = 0xC0;
+        packet[3] = 0x00;
+        packet[4] = 0x82;
+        packet[5] = 0x04;
+        packet[6] = (uint8_t)(test_random(seed) & 1);
+        packet[7] = 0x00;
+    } while (add_record(frame, test_random(seed) % 100, packet, sizeof(packet)) != 0);
+}
+
+static double elapsed_us(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void bench(const char* name, void (*build)(bench_frame_t*, uint32_t*))
+{
+    static uint8_t out[BENCH_RECORDS_MAX];
+    uint32_t seed = 0x2468ACE1;
+    uint64_t in_total = 0;
+    uint64_t out_total = 0;
+    uint32_t smaller = 0;
+    double compress_us;
+    double decompress_us;
+
+    for (uint32_t i = 0; i < BENCH_FRAMES; i++)
+    {
+        build(&frames[i], &seed);
+        in_total += frames[i].len;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < BENCH_REPEAT; r++)
+    {
+        for (uint32_t i = 0; i < BENCH_FRAMES; i++)
+        {
+            compressed_len[i] = gateway_lz_compress(frames[i].data, frames[i].len, compressed[i], sizeof(compressed[i]));
+        }
+    }
+    compress_us = elapsed_us(start) / (BENCH_FRAMES * BENCH_REPEAT);
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < BENCH_REPEAT; r++)
+    {
+        for (uint32_t i = 0; i < BENCH_FRAMES; i++)
+        {
+            TEST_CHECK(gateway_lz_decompress(compressed[i], compressed_len[i], out, sizeof(out)) == (int32_t)frames[i].len);
+        }
+    }
+    decompress_us = elapsed_us(start) / (BENCH_FRAMES * BENCH_REPEAT);
+
+    for (uint32_t i = 0; i < BENCH_FRAMES; i++)
+    {
+        /* The batcher sends a frame uncompressed unless that is larger */
+        if (compressed_len[i] < frames[i].len)
+        {
+            smaller++;
+            out_total += compressed_len[i];
+        }
+        else
+        {
+            out_total += frames[i].len;
+        }
+    }
+
+    printf("%-10s %6.1f bytes/frame  ratio %.3f  compressed %3u%% of frames  compress %6.2f us/frame  decompress %6.2f us/frame\n",
+           name, (double)in_total / BENCH_FRAMES, (double)out_total / in_total, smaller * 100 / BENCH_FRAMES,
+           compress_us, decompress_us);
+}
+
+int main(void)
+{
+    bench("encrypted", build_encrypted);
+    bench("decrypted", build_decrypted);
+    return test_failures ? 1 : 0;
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Host stand-in for the deferred trace: MESH_GATEWAY_TRACE() is compiled in
+ * and its arguments evaluated, but nothing is printed.
+ */
+
+#include "gateway_trace.h"
+
+volatile uint8_t gateway_trace_level = GATEWAY_TRACE_LEVEL_DEBUG;
+
+void gateway_trace_write(uint8_t level, const char* format, uintptr_t arg0, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3)
+{
+    (void)level;
+    (void)format;
+    (void)arg0;
+    (void)arg1;
+    (void)arg2;
+    (void)arg3;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Host stand-in for the KVStore global API implementation
+ */
+
+#include <map>
+#include <string>
+#include <vector>
+#include <string.h>
+
+#include "kvstore_global_api.h"
+
+#define KV_HOST_ERROR               (-1)
+
+static std::map<std::string, std::vector<uint8_t> > store;
+static uint32_t writes = 0;
+static uint32_t fail_at = 0;
+static uint32_t cut_at = 0;
+static bool powered = true;
+
+/* Counts a write and returns false if it must not reach the store */
+static bool write_allowed(void)
+{
+    writes++;
+    if (cut_at != 0 && writes >= cut_at)
+    {
+        powered = false;
+    }
+    if (!powered)
+    {
+        return false;
+    }
+    if (fail_at != 0 && writes == fail_at)
+    {
+        fail_at = 0;
+        return false;
+    }
+    return true;
+}
+
+int kv_set(const char* full_name_key, const void* buffer, size_t size, uint32_t create_flags)
+{
+    (void)create_flags;
+    if (!full_name_key || (size > 0 && !buffer) || !write_allowed())
+    {
+        return KV_HOST_ERROR;
+    }
+    store[full_name_key].assign((const uint8_t*)buffer, (const uint8_t*)buffer + size);
+    return 0;
+}
+
+int kv_get(const char* full_name_key, void* buffer, size_t buffer_size, size_t* actual_size)
+{
+    auto item = full_name_key ? store.find(full_name_key) : store.end();
+    size_t size;
+
+    if (item == store.end())
+    {
+        return KV_HOST_ERROR;
+    }
+    size = item->second.size() < buffer_size ? item->second.size() : buffer_size;
+    if (size > 0)
+    {
+        memcpy(buffer, item->second.data(), size);
+    }
+    if (actual_size)
+    {
+        *actual_size = size;
+    }
+    return 0;
+}
+
+int kv_get_info(const char* full_name_key, kv_info_t* info)
+{
+    auto item = full_name_key ? store.find(full_name_key) : store.end();
+
+    if (item == store.end() || !info)
+    {
+        return KV_HOST_ERROR;
+    }
+    info->size = item->second.size();
+    info->flags = 0;
+    return 0;
+}
+
+int kv_remove(const char* full_name_key)
+{
+    if (!full_name_key || !write_allowed() || store.erase(full_name_key) == 0)
+    {
+        return KV_HOST_ERROR;
+    }
+    return 0;
+}
+
+void kv_host_reset(void)
+{
+    store.clear();
+    writes = 0;
+    fail_at = 0;
+    cut_at = 0;
+    powered = true;
+}
+
+void kv_host_fail_write(uint32_t n)
+{
+    fail_at = n ? writes + n : 0;
+}
+
+void kv_host_power_cut(uint32_t n)
+{
+    cut_at = n ? writes + n : 0;
+}
+
+bool kv_host_powered(void)
+{
+    return powered;
+}
+
+void kv_host_power_on(void)
+{
+    cut_at = 0;
+    powered = true;
+}
+
+uint32_t kv_host_writes(void)
+{
+    return writes;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Host stand-in for the KVStore global API
+ *
+ * Keeps the keys in memory and returns -1 for any error. Every kv_set() and kv_remove() is a write, and
+ * writes can be made to fail:
+ *
+ * - kv_host_fail_write(n): the n-th write from now fails and changes nothing;
+ *   the ones after it work again.
+ * - kv_host_power_cut(n): the n-th write from now and all after it are lost,
+ *   as if the power went just before it. kv_host_powered() then returns
+ *   false, so that the test can stop the run there too, and
+ *   kv_host_power_on() starts the next one on what was written.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+    size_t      size;
+    uint32_t    flags;
+} kv_info_t;
+
+int kv_set(const char* full_name_key, const void* buffer, size_t size, uint32_t create_flags);
+int kv_get(const char* full_name_key, void* buffer, size_t buffer_size, size_t* actual_size);
+int kv_get_info(const char* full_name_key, kv_info_t* info);
+int kv_remove(const char* full_name_key);
+
+/* Erases every key and clears the faults */
+void kv_host_reset(void);
+void kv_host_fail_write(uint32_t n);
+void kv_host_power_cut(uint32_t n);
+bool kv_host_powered(void);
+void kv_host_power_on(void);
+/* Writes attempted since kv_host_reset(), failed ones included */
+uint32_t kv_host_writes(void);
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Host stand-in for mbed.h
+ *
+ * Only what the modules built in tests/ use. The mutex does nothing, as the
+ * tests run on one thread, and the CRC is the same CRC-32 as MbedCRC's
+ * POLY_32BIT_ANSI.
+ *
+ * MBED_SECTION() puts everything in one section, "host_noinit", whose bounds
+ * the linker provides as __start_host_noinit and __stop_host_noinit, so that
+ * a test can corrupt the warm boot region as a reset or power cut would.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MBED_STATIC_ASSERT(expr, msg)       static_assert(expr, msg)
+#define MBED_GET_ERROR_CODE(x)              (x)
+#define MBED_SECTION(name)                  __attribute__((section("host_noinit"), used))
+
+#define POLY_32BIT_ANSI                     (0x04C11DB7)
+
+namespace rtos
+{
+class Mutex
+{
+public:
+    void lock(void)
+    {
+        depth++;
+    }
+    void unlock(void)
+    {
+        if (depth == 0)
+        {
+            abort();
+        }
+        depth--;
+    }
+    bool trylock_for(uint32_t millisec)
+    {
+        (void)millisec;
+        depth++;
+        return true;
+    }
+
+private:
+    uint32_t depth = 0;
+};
+} // namespace rtos
+
+using namespace rtos;
+
+/* Reflected CRC-32 with an initial and final value of 0xFFFFFFFF, as MbedCRC<POLY_32BIT_ANSI, 32> computes it */
+template <uint32_t polynomial, int width>
+class MbedCRC
+{
+public:
+    int32_t compute(const void* buffer, size_t size, uint32_t* crc)
+    {
+        const uint8_t* data = (const uint8_t*)buffer;
+        uint32_t value = 0xFFFFFFFF;
+
+        static_assert(polynomial == POLY_32BIT_ANSI && width == 32, "Only the 32-bit ANSI CRC is stubbed");
+        for (size_t i = 0; i < size; i++)
+        {
+            value ^= data[i];
+            for (int bit = 0; bit < 8; bit++)
+            {
+                value = (value >> 1) ^ (0xEDB88320 & (0 - (value & 1)));
+            }
+        }
+        *crc = value ^ 0xFFFFFFFF;
+        return 0;
+    }
+};
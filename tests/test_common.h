@@ -0,0 +1,58 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Host test helpers
+ *
+ * TEST_CHECK() reports a failed condition with its location and carries on,
+ * so that one run lists every failure; test_result() is the exit code.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+extern unsigned test_failures;
+
+#define TEST_CHECK(cond)                                                            \
+    do                                                                              \
+    {                                                                               \
+        if (!(cond))                                                                \
+        {                                                                           \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);         \
+            test_failures++;                                                        \
+        }                                                                           \
+    } while (0)
+
+/* Simple xorshift generator, so that runs are reproducible from the seed */
+static inline uint32_t test_random(uint32_t* state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static inline int test_result(const char* name)
+{
+    printf("%s: %s (%u failures)\n", name, test_failures ? "FAILED" : "passed", test_failures);
+    return test_failures ? 1 : 0;
+}
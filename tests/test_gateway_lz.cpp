@@ -0,0 +1,257 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Host tests for gateway_lz
+ *
+ * Round trips fixed and random inputs through gateway_lz_compress() and
+ * gateway_lz_decompress(), checks the output against a hand-built LZ4 block,
+ * and feeds corrupted blocks to the decompressor, which must reject them or
+ * stay inside its output buffer.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gateway_lz.h"
+#include "test_common.h"
+
+#define FUZZ_ROUNDS             (2000)
+#define FUZZ_MAX_LEN            (2048)
+#define CORRUPT_ROUNDS          (20000)
+#define GUARD_LEN               (16)
+#define GUARD_BYTE              (0xA5)
+
+unsigned test_failures = 0;
+
+static void round_trip(const uint8_t* src, uint32_t len)
+{
+    uint32_t bound = GATEWAY_LZ_BOUND(len);
+    uint8_t* compressed = (uint8_t*)malloc(bound);
+    /* Exactly 'len' bytes, so that an overrun is caught by the sanitizers */
+    uint8_t* out = (uint8_t*)malloc(len ? len : 1);
+    uint32_t compressed_len;
+
+    compressed_len = gateway_lz_compress(src, len, compressed, bound);
+    TEST_CHECK(compressed_len > 0 && compressed_len <= bound);
+    TEST_CHECK(gateway_lz_decompress(compressed, compressed_len, out, len) == (int32_t)len);
+    TEST_CHECK(memcmp(out, src, len) == 0);
+
+    /* One byte short on either side must be refused, not truncated */
+    TEST_CHECK(gateway_lz_compress(src, len, compressed, compressed_len - 1) == 0);
+    if (len > 0)
+    {
+        TEST_CHECK(gateway_lz_decompress(compressed, compressed_len, out, len - 1) == -1);
+    }
+
+    free(compressed);
+    free(out);
+}
+
+static void fill_random(uint8_t* data, uint32_t len, uint32_t* seed)
+{
+    for (uint32_t i = 0; i < len; i++)
+    {
+        data[i] = (uint8_t)test_random(seed);
+    }
+}
+
+/* Random data from a small alphabet with copies of earlier fragments, which gives matches of every length and distance */
+static void fill_compressible(uint8_t* data, uint32_t len, uint32_t* seed)
+{
+    uint32_t i = 0;
+
+    while (i < len)
+    {
+        uint32_t r = test_random(seed);
+        if (i > 4 && (r & 3) != 0)
+        {
+            uint32_t offset = 1 + (test_random(seed) % i);
+            uint32_t copy = 1 + (test_random(seed) % 300);
+            while (copy-- > 0 && i < len)
+            {
+                data[i] = data[i - offset];
+                i++;
+            }
+        }
+        else
+        {
+            data[i++] = (uint8_t)('a' + (r >> 8) % 4);
+        }
+    }
+}
+
+/* Records as gateway_uplink_batch.cpp lays them out: delta time, length, proxy network PDU */
+static uint32_t fill_batch_records(uint8_t* data, uint32_t cap, uint32_t* seed)
+{
+    uint32_t len = 0;
+
+    while (len + 2 + 29 <= cap)
+    {
+        uint32_t pdu_len = 18 + test_random(seed) % 12;
+        data[len++] = (uint8_t)(test_random(seed) % 100);
+        data[len++] = (uint8_t)pdu_len;
+        data[len] = 0x00;
+        data[len + 1] = 0x68;
+        fill_random(&data[len + 2], pdu_len - 2, seed);
+        len += pdu_len;
+    }
+    return len;
+}
+
+static void test_fixed_inputs(void)
+{
+    static uint8_t data[0xFFFF + 1];
+    static const char text[] =
+        "{\"src\":\"0x0004\",\"opcode\":\"0x8204\",\"state\":\"on\"},{\"src\":\"0x0005\",\"opcode\":\"0x8204\",\"state\":\"off\"},"
+        "{\"src\":\"0x0006\",\"opcode\":\"0x8204\",\"state\":\"on\"},{\"src\":\"0x0007\",\"opcode\":\"0x8204\",\"state\":\"on\"}";
+    uint32_t seed = 1;
+    uint32_t len;
+
+    round_trip(data, 0);
+    data[0] = 'x';
+    round_trip(data, 1);
+
+    /* Around the point where the format first allows a match */
+    memset(data, 'z', sizeof(data));
+    for (len = 11; len <= 20; len++)
+    {
+        round_trip(data, len);
+    }
+
+    /* Literal and match lengths that need several continuation bytes */
+    fill_random(data, 1000, &seed);
+    round_trip(data, 1000);
+    memset(data, 0, 1000);
+    round_trip(data, 1000);
+
+    round_trip((const uint8_t*)text, sizeof(text) - 1);
+
+    len = fill_batch_records(data, 240, &seed);
+    round_trip(data, len);
+
+    /* The largest input, and one byte more */
+    fill_compressible(data, 0xFFFF, &seed);
+    round_trip(data, 0xFFFF);
+    TEST_CHECK(gateway_lz_compress(data, 0xFFFF + 1, data, sizeof(data)) == 0);
+}
+
+/* Decompresses a block built by hand from the LZ4 block format description */
+static void test_reference_block(void)
+{
+    /* "ab", then a match of 6 at offset 2 (overlapping), then the last literal "c" */
+    static const uint8_t block[] = { 0x22, 'a', 'b', 0x02, 0x00, 0x10, 'c' };
+    /* 20 literals (15 + 5), then a match of 4 + 15 + 255 + 1 at offset 1, then no literals */
+    uint8_t long_block[1 + 1 + 20 + 2 + 2 + 1];
+    uint8_t out[512];
+    uint32_t i;
+
+    TEST_CHECK(gateway_lz_decompress(block, sizeof(block), out, sizeof(out)) == 9);
+    TEST_CHECK(memcmp(out, "ababababc", 9) == 0);
+
+    i = 0;
+    long_block[i++] = 0xFF;
+    long_block[i++] = 5;
+    memset(&long_block[i], 'q', 20);
+    i += 20;
+    long_block[i++] = 1;
+    long_block[i++] = 0;
+    long_block[i++] = 255;
+    long_block[i++] = 1;
+    long_block[i++] = 0x00;
+    TEST_CHECK(gateway_lz_decompress(long_block, i, out, sizeof(out)) == 20 + 4 + 15 + 255 + 1);
+    TEST_CHECK(out[0] == 'q' && out[20 + 4 + 15 + 255] == 'q');
+}
+
+static void test_random_round_trips(void)
+{
+    static uint8_t data[FUZZ_MAX_LEN];
+    uint32_t seed = 0x12345678;
+
+    for (uint32_t round = 0; round < FUZZ_ROUNDS; round++)
+    {
+        uint32_t len = test_random(&seed) % (FUZZ_MAX_LEN + 1);
+        if (round & 1)
+        {
+            fill_random(data, len, &seed);
+        }
+        else
+        {
+            fill_compressible(data, len, &seed);
+        }
+        round_trip(data, len);
+    }
+}
+
+/* The decompressor runs on data that came over the network, so any input must be safe */
+static void test_corrupt_blocks(void)
+{
+    static uint8_t data[FUZZ_MAX_LEN];
+    static uint8_t compressed[GATEWAY_LZ_BOUND(FUZZ_MAX_LEN)];
+    uint8_t* out = (uint8_t*)malloc(FUZZ_MAX_LEN + GUARD_LEN);
+    uint32_t seed = 0xCAFEF00D;
+
+    for (uint32_t round = 0; round < CORRUPT_ROUNDS; round++)
+    {
+        uint32_t len = 1 + test_random(&seed) % FUZZ_MAX_LEN;
+        uint32_t compressed_len;
+        uint32_t cap = test_random(&seed) % (FUZZ_MAX_LEN + 1);
+        int32_t result;
+
+        if (round % 4 == 0)
+        {
+            /* Not a block at all */
+            compressed_len = 1 + test_random(&seed) % 64;
+            fill_random(compressed, compressed_len, &seed);
+        }
+        else
+        {
+            fill_compressible(data, len, &seed);
+            compressed_len = gateway_lz_compress(data, len, compressed, sizeof(compressed));
+            TEST_CHECK(compressed_len > 0);
+            for (uint32_t flips = 1 + test_random(&seed) % 4; flips > 0; flips--)
+            {
+                compressed[test_random(&seed) % compressed_len] ^= (uint8_t)(1 + test_random(&seed) % 255);
+            }
+            if (round % 4 == 1)
+            {
+                compressed_len = 1 + test_random(&seed) % compressed_len;
+            }
+        }
+
+        memset(&out[cap], GUARD_BYTE, GUARD_LEN);
+        result = gateway_lz_decompress(compressed, compressed_len, out, cap);
+        TEST_CHECK(result >= -1 && result <= (int32_t)cap);
+        for (uint32_t i = 0; i < GUARD_LEN; i++)
+        {
+            TEST_CHECK(out[cap + i] == GUARD_BYTE);
+        }
+    }
+    free(out);
+
+    TEST_CHECK(gateway_lz_decompress(compressed, 0, data, sizeof(data)) == -1);
+    TEST_CHECK(gateway_lz_decompress(NULL, 1, data, sizeof(data)) == -1);
+}
+
+int main(void)
+{
+    test_fixed_inputs();
+    test_reference_block();
+    test_random_round_trips();
+    test_corrupt_blocks();
+    return test_result("test_gateway_lz");
+}
@@ -0,0 +1,480 @@
+/*
+ * Copyright 2020 Cypress Semiconductor Corporation
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/** @file
+ *
+ * Fault injection tests for the warm boot store and the spool
+ *
+ * Runs gateway_warmboot.cpp and gateway_spool.cpp as they are, with the
+ * warm boot region in a section the test can reach (stubs/mbed.h) and
+ * KVStore in memory with failing writes and power cuts
+ * (stubs/kvstore_global_api.h).
+ *
+ * Every message pushed carries a sequence number, so the publish callback
+ * can check that the spool hands them out oldest first and never twice, and
+ * the tests can count what was lost:
+ *
+ * - a failed write loses nothing that the spool does not count as dropped
+ * - a warm restart loses nothing, with or without a failed write before it
+ * - a power cut loses at most the RAM ring and the message being written
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gateway_spool.h"
+#include "gateway_warmboot.h"
+#include "kvstore_global_api.h"
+#include "test_common.h"
+
+#define SPOOL_CAPACITY              (GATEWAY_SPOOL_RAM_ENTRIES + GATEWAY_SPOOL_FLASH_ENTRIES)
+#define SCENARIO_OPS                (60)
+#define SCENARIO_SEED               (0x5EED1234)
+#define GARBAGE_ROUNDS              (50)
+#define MESSAGE_PAYLOAD_MAX         (4 + 40)
+
+/* The warm boot region, which is the only thing MBED_SECTION() places in this section */
+extern "C" uint8_t __start_host_noinit[];
+extern "C" uint8_t __stop_host_noinit[];
+
+unsigned test_failures = 0;
+
+static uint32_t pushed;
+static uint32_t delivered;
+static int64_t last_delivered;
+static uint32_t publish_seed;
+static bool publish_may_fail;
+
+static void model_reset(void)
+{
+    pushed = 0;
+    delivered = 0;
+    last_delivered = -1;
+    publish_seed = 0xB0B0;
+    publish_may_fail = false;
+}
+
+static uint32_t region_size(void)
+{
+    return (uint32_t)(__stop_host_noinit - __start_host_noinit);
+}
+
+static void message_topic(uint32_t seq, char* topic)
+{
+    snprintf(topic, GATEWAY_SPOOL_TOPIC_MAX + 1, "mesh/node%lu", (unsigned long)(seq % 3));
+}
+
+static uint32_t message_payload(uint32_t seq, uint8_t* payload)
+{
+    uint32_t len = 4 + seq % (MESSAGE_PAYLOAD_MAX - 4);
+
+    memcpy(payload, &seq, 4);
+    for (uint32_t i = 4; i < len; i++)
+    {
+        payload[i] = (uint8_t)(seq + i);
+    }
+    return len;
+}
+
+static cy_rslt_t push_next(void)
+{
+    char topic[GATEWAY_SPOOL_TOPIC_MAX + 1];
+    uint8_t payload[MESSAGE_PAYLOAD_MAX];
+    uint32_t len = message_payload(pushed, payload);
+
+    message_topic(pushed, topic);
+    pushed++;
+    return gateway_spool_push(topic, payload, len);
+}
+
+/* Checks the message against the one pushed with its sequence number, and that it is newer than the last one */
+static cy_rslt_t publish(const char* topic, const uint8_t* payload, uint32_t len)
+{
+    char expected_topic[GATEWAY_SPOOL_TOPIC_MAX + 1];
+    uint8_t expected[MESSAGE_PAYLOAD_MAX];
+    uint32_t seq;
+
+    /* Nothing runs after a power cut */
+    if (!kv_host_powered() || (publish_may_fail && test_random(&publish_seed) % 8 == 0))
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    TEST_CHECK(len >= 4);
+    if (len < 4)
+    {
+        return CY_RSLT_SUCCESS;
+    }
+    memcpy(&seq, payload, 4);
+    message_topic(seq, expected_topic);
+    TEST_CHECK(seq < pushed);
+    TEST_CHECK((int64_t)seq > last_delivered);
+    TEST_CHECK(strcmp(topic, expected_topic) == 0);
+    TEST_CHECK(len == message_payload(seq, expected) && memcmp(payload, expected, len) == 0);
+    last_delivered = seq;
+    delivered++;
+    return CY_RSLT_SUCCESS;
+}
+
+static void drain_all(void)
+{
+    publish_may_fail = false;
+    while (!gateway_spool_is_empty())
+    {
+        if (gateway_spool_drain(publish, SPOOL_CAPACITY) == 0)
+        {
+            TEST_CHECK(false);
+            return;
+        }
+    }
+}
+
+/* Bursts of pushes and drains with failing publishes, as while the cloud comes and goes; stops at a power cut */
+static void run_scenario(void)
+{
+    uint32_t seed = SCENARIO_SEED;
+
+    publish_may_fail = true;
+    for (uint32_t op = 0; op < SCENARIO_OPS && kv_host_powered(); op++)
+    {
+        uint32_t count = test_random(&seed) % (SPOOL_CAPACITY / 2 + 1);
+        if (test_random(&seed) % 2 == 0)
+        {
+            while (count-- > 0 && kv_host_powered())
+            {
+                push_next();
+            }
+        }
+        else
+        {
+            gateway_spool_drain(publish, count);
+        }
+    }
+}
+
+static uint32_t spool_dropped(void)
+{
+    gateway_spool_stats_t stats;
+
+    gateway_spool_get_stats(&stats);
+    return stats.dropped;
+}
+
+/* Boots as bluetooth_mesh_gateway.cpp does: spool first, then the messages from the warm boot store in front */
+static bool reboot(void)
+{
+    gateway_warmboot_record_t record;
+    uint32_t offset = 0;
+    bool warm = gateway_warmboot_load(NULL);
+
+    gateway_spool_init();
+    while (warm && gateway_warmboot_next(&offset, &record))
+    {
+        TEST_CHECK(record.type == GATEWAY_WARMBOOT_SPOOLED && record.topic);
+        gateway_spool_restore(record.topic, record.data, record.len);
+    }
+    return warm;
+}
+
+static void cold_start(void)
+{
+    kv_host_reset();
+    model_reset();
+    /* Leaves no valid region behind */
+    gateway_warmboot_begin(0, 0, 0);
+    gateway_spool_init();
+}
+
+static void test_warmboot_records(void)
+{
+    static const uint8_t command[] = { 0x82, 0x02, 0x01 };
+    gateway_warmboot_record_t record;
+    gateway_warmboot_info_t info;
+    uint32_t offset = 0;
+
+    memset(&record, 0, sizeof(record));
+    gateway_warmboot_begin(2, 1, 3);
+    record.type  = GATEWAY_WARMBOOT_UPLINK;
+    record.topic = "mesh/status";
+    record.data  = (const uint8_t*)"hello";
+    record.len   = 5;
+    TEST_CHECK(gateway_warmboot_put(&record) == CY_RSLT_SUCCESS);
+    memset(&record, 0, sizeof(record));
+    record.type = GATEWAY_WARMBOOT_DOWNLINK;
+    record.arg  = 2;
+    record.dst  = 0xC001;
+    record.data = command;
+    record.len  = sizeof(command);
+    TEST_CHECK(gateway_warmboot_put(&record) == CY_RSLT_SUCCESS);
+    memset(&record, 0, sizeof(record));
+    record.type  = GATEWAY_WARMBOOT_SPOOLED;
+    record.topic = "mesh/empty";
+    TEST_CHECK(gateway_warmboot_put(&record) == CY_RSLT_SUCCESS);
+    /* One character too many */
+    record.topic = "mesh/0123456789012345678901234567";
+    TEST_CHECK(gateway_warmboot_put(&record) == CY_RSLT_MW_ERROR);
+    gateway_warmboot_commit();
+
+    TEST_CHECK(gateway_warmboot_load(&info));
+    TEST_CHECK(info.restarts == 2 && info.reason == 1 && info.detail == 3 && info.records == 3 && info.dropped == 1);
+    TEST_CHECK(gateway_warmboot_next(&offset, &record));
+    TEST_CHECK(record.type == GATEWAY_WARMBOOT_UPLINK && strcmp(record.topic, "mesh/status") == 0 && record.len == 5 &&
+               memcmp(record.data, "hello", 5) == 0);
+    TEST_CHECK(gateway_warmboot_next(&offset, &record));
+    TEST_CHECK(record.type == GATEWAY_WARMBOOT_DOWNLINK && record.arg == 2 && record.dst == 0xC001 && !record.topic &&
+               record.len == sizeof(command) && memcmp(record.data, command, sizeof(command)) == 0);
+    TEST_CHECK(gateway_warmboot_next(&offset, &record));
+    TEST_CHECK(record.type == GATEWAY_WARMBOOT_SPOOLED && strcmp(record.topic, "mesh/empty") == 0 && record.len == 0);
+    TEST_CHECK(!gateway_warmboot_next(&offset, &record));
+
+    /* Loading consumes the region */
+    TEST_CHECK(!gateway_warmboot_load(&info));
+}
+
+static void test_warmboot_full(void)
+{
+    static uint8_t data[100];
+    gateway_warmboot_record_t record;
+    gateway_warmboot_info_t info;
+    uint32_t offset = 0;
+    uint32_t stored = 0;
+
+    memset(&record, 0, sizeof(record));
+    gateway_warmboot_begin(1, 0, 0);
+    record.type = GATEWAY_WARMBOOT_DOWNLINK;
+    record.data = data;
+    record.len  = sizeof(data);
+    for (uint32_t i = 0; i < GATEWAY_WARMBOOT_SIZE / sizeof(data) + 5; i++)
+    {
+        data[0] = (uint8_t)i;
+        if (gateway_warmboot_put(&record) == CY_RSLT_SUCCESS)
+        {
+            stored++;
+        }
+    }
+    gateway_warmboot_commit();
+
+    TEST_CHECK(stored > 0 && stored < GATEWAY_WARMBOOT_SIZE / sizeof(data) + 5);
+    TEST_CHECK(gateway_warmboot_load(&info));
+    TEST_CHECK(info.records == stored && info.dropped == GATEWAY_WARMBOOT_SIZE / sizeof(data) + 5 - stored);
+    for (uint32_t i = 0; i < stored; i++)
+    {
+        TEST_CHECK(gateway_warmboot_next(&offset, &record) && record.len == sizeof(data) && record.data[0] == (uint8_t)i);
+    }
+    TEST_CHECK(!gateway_warmboot_next(&offset, &record));
+}
+
+/* What a power cut, a reset before the commit or a damaged region leaves behind must be a cold boot */
+static void test_warmboot_rejected(void)
+{
+    static uint8_t snapshot[GATEWAY_WARMBOOT_SIZE + 64];
+    gateway_warmboot_record_t record;
+    gateway_warmboot_info_t info;
+    uint32_t size = region_size();
+    uint32_t seed = 77;
+    uint32_t rejected = 0;
+    uint32_t used = 0;
+
+    TEST_CHECK(size >= GATEWAY_WARMBOOT_SIZE && size <= sizeof(snapshot));
+    if (size < GATEWAY_WARMBOOT_SIZE || size > sizeof(snapshot))
+    {
+        return;
+    }
+
+    memset(__start_host_noinit, 0, size);
+    TEST_CHECK(!gateway_warmboot_load(&info));
+    for (uint32_t round = 0; round < GARBAGE_ROUNDS; round++)
+    {
+        for (uint32_t i = 0; i < size; i++)
+        {
+            __start_host_noinit[i] = (uint8_t)test_random(&seed);
+        }
+        TEST_CHECK(!gateway_warmboot_load(&info));
+    }
+
+    memset(&record, 0, sizeof(record));
+    record.type  = GATEWAY_WARMBOOT_UPLINK;
+    record.topic = "mesh/status";
+    record.data  = (const uint8_t*)"0123456789";
+    record.len   = 10;
+
+    /* Reset while the records are written */
+    gateway_warmboot_begin(1, 0, 0);
+    gateway_warmboot_put(&record);
+    TEST_CHECK(!gateway_warmboot_load(&info));
+
+    /* Reset while the next restart writes over a committed region */
+    gateway_warmboot_begin(1, 0, 0);
+    gateway_warmboot_put(&record);
+    gateway_warmboot_commit();
+    gateway_warmboot_begin(2, 0, 0);
+    gateway_warmboot_put(&record);
+    TEST_CHECK(!gateway_warmboot_load(&info));
+
+    /* Any byte changed is either rejected or outside the records */
+    gateway_warmboot_begin(1, 0, 0);
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        gateway_warmboot_put(&record);
+        used += 7 + strlen(record.topic) + 1 + record.len;
+    }
+    gateway_warmboot_commit();
+    memcpy(snapshot, __start_host_noinit, size);
+    for (uint32_t i = 0; i < size; i++)
+    {
+        uint32_t offset = 0;
+        uint32_t records = 0;
+
+        __start_host_noinit[i] ^= (uint8_t)(1 + test_random(&seed) % 255);
+        if (!gateway_warmboot_load(&info))
+        {
+            rejected++;
+        }
+        else
+        {
+            TEST_CHECK(info.records == 3 && info.restarts == 1);
+            while (gateway_warmboot_next(&offset, &record))
+            {
+                TEST_CHECK(strcmp(record.topic, "mesh/status") == 0 && record.len == 10 &&
+                           memcmp(record.data, "0123456789", 10) == 0);
+                records++;
+            }
+            TEST_CHECK(records == 3);
+        }
+        memcpy(__start_host_noinit, snapshot, size);
+    }
+    TEST_CHECK(rejected >= used);
+
+    TEST_CHECK(gateway_warmboot_load(&info));
+}
+
+static void test_spool_order(void)
+{
+    gateway_spool_stats_t stats;
+
+    cold_start();
+    for (uint32_t i = 0; i < SPOOL_CAPACITY; i++)
+    {
+        TEST_CHECK(push_next() == CY_RSLT_SUCCESS);
+    }
+    gateway_spool_get_stats(&stats);
+    TEST_CHECK(stats.depth == SPOOL_CAPACITY && stats.spooled == SPOOL_CAPACITY && stats.dropped == 0);
+    drain_all();
+    gateway_spool_get_stats(&stats);
+    TEST_CHECK(delivered == SPOOL_CAPACITY && stats.drained == SPOOL_CAPACITY && stats.depth == 0);
+
+    /* Full: the oldest ones make room */
+    cold_start();
+    for (uint32_t i = 0; i < SPOOL_CAPACITY + 10; i++)
+    {
+        push_next();
+    }
+    TEST_CHECK(spool_dropped() == 10);
+#if GATEWAY_SPOOL_DROP_POLICY == GATEWAY_SPOOL_DROP_OLDEST
+    last_delivered = 9;
+#endif
+    drain_all();
+    TEST_CHECK(delivered == SPOOL_CAPACITY);
+
+    /* Messages left in flash by a previous run come back after a cold boot */
+    cold_start();
+    for (uint32_t i = 0; i < SPOOL_CAPACITY; i++)
+    {
+        push_next();
+    }
+    TEST_CHECK(!reboot());
+    drain_all();
+    TEST_CHECK(delivered == GATEWAY_SPOOL_FLASH_ENTRIES);
+}
+
+static uint32_t scenario_writes(void)
+{
+    cold_start();
+    run_scenario();
+    drain_all();
+    TEST_CHECK(pushed == delivered + spool_dropped());
+    return kv_host_writes();
+}
+
+static void test_spool_write_faults(void)
+{
+    uint32_t writes = scenario_writes();
+
+    TEST_CHECK(writes > SPOOL_CAPACITY);
+    for (uint32_t n = 1; n <= writes; n++)
+    {
+        cold_start();
+        kv_host_fail_write(n);
+        run_scenario();
+        drain_all();
+        TEST_CHECK(pushed == delivered + spool_dropped());
+    }
+}
+
+static void test_spool_warm_restart(void)
+{
+    uint32_t writes = scenario_writes();
+
+    for (uint32_t n = 0; n <= writes; n++)
+    {
+        uint32_t dropped;
+
+        cold_start();
+        kv_host_fail_write(n);
+        run_scenario();
+
+        gateway_warmboot_begin(1, 0, 0);
+        gateway_spool_retain();
+        gateway_warmboot_commit();
+        dropped = spool_dropped();
+
+        TEST_CHECK(reboot());
+        drain_all();
+        TEST_CHECK(pushed == delivered + dropped + spool_dropped());
+    }
+}
+
+static void test_spool_power_cuts(void)
+{
+    uint32_t writes = scenario_writes();
+
+    for (uint32_t n = 1; n <= writes; n++)
+    {
+        uint32_t dropped;
+
+        cold_start();
+        kv_host_power_cut(n);
+        run_scenario();
+        dropped = spool_dropped();
+
+        kv_host_power_on();
+        TEST_CHECK(!reboot());
+        drain_all();
+        TEST_CHECK(pushed <= delivered + dropped + spool_dropped() + GATEWAY_SPOOL_RAM_ENTRIES + 1);
+    }
+}
+
+int main(void)
+{
+    test_warmboot_records();
+    test_warmboot_full();
+    test_warmboot_rejected();
+    test_spool_order();
+    test_spool_write_faults();
+    test_spool_warm_restart();
+    test_spool_power_cuts();
+    return test_result("test_gateway_warmboot_spool");
+}